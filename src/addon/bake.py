@@ -1344,7 +1344,10 @@ def __initialize_fluid_simulation_settings(fluidsim, data):
 
     # Internal Settings
 
-    fluidsim.set_mesh_output_format_as_bobj()
+    if __get_parameter_data(dprops.advanced.enable_compressed_mesh_cache, frameno):
+        fluidsim.set_mesh_output_format_as_mesh_cache()
+    else:
+        fluidsim.set_mesh_output_format_as_bobj()
     if is_whitewater_enabled:
         fluidsim.output_diffuse_material_as_separate_files = True
 
@@ -2721,6 +2724,10 @@ def __get_frame_stats_dict(cstats):
     stats["viscosity_solver_error"] = cstats.viscosity_solver_error
     stats["viscosity_solver_iterations"] = cstats.viscosity_solver_iterations
     stats["viscosity_solver_max_iterations"] = cstats.viscosity_solver_max_iterations
+    stats["advection_euler_steps"] = cstats.advection_euler_steps
+    stats["advection_rk2_steps"] = cstats.advection_rk2_steps
+    stats["advection_rk3_steps"] = cstats.advection_rk3_steps
+    stats["advection_rk4_steps"] = cstats.advection_rk4_steps
     stats["surface"] = __get_mesh_stats_dict(cstats.surface)
     stats["preview"] = __get_mesh_stats_dict(cstats.preview)
     stats["surfaceblur"] = __get_mesh_stats_dict(cstats.surfaceblur)
@@ -1137,6 +1137,9 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         if len(bobj_data) == 0:
             return [], []
 
+        if bobj_data[:4] == b'FFMC':
+            return self._import_mesh_cache(bobj_data, generate_flat_array)
+
         data_offset = 0
         num_vertices = struct.unpack_from('i', bobj_data, data_offset)[0]
         data_offset += 4
@@ -1166,6 +1169,28 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         return vertices, triangles
 
 
+    def _import_mesh_cache(self, mesh_cache_data, generate_flat_array=False):
+        from ..ffengine import meshcache
+        num_vertices, num_triangles, num_channels = meshcache.get_info(mesh_cache_data)
+        if num_vertices == 0 and num_triangles == 0 and num_channels > 0:
+            # Vector attributes are stored as a 3 component channel
+            flat_vertices = meshcache.decode_channel(mesh_cache_data)
+            flat_triangles = []
+        else:
+            mesh = meshcache.decode_mesh(mesh_cache_data)
+            flat_vertices = mesh.vertices
+            flat_triangles = mesh.triangles
+
+        if generate_flat_array:
+            return flat_vertices.tolist(), list(flat_triangles)
+
+        it = iter(flat_vertices)
+        vertices = list(zip(it, it, it))
+        it = iter(flat_triangles)
+        triangles = list(zip(it, it, it))
+        return vertices, triangles
+
+
     def import_ffp3(self, filename, pct_surface=1.0, pct_boundary=1.0, pct_interior=1.0, attribute_type='ATTRIBUTE_TYPE_UNKNOWN', generate_flat_array=False):
         with open(filename, "rb") as f:
             attribute_data = f.read()
@@ -1179,6 +1204,9 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         if pct_surface == 0.0 and pct_boundary == 0.0 and pct_interior == 0.0:
             return vertices, triangles, header_info_dict
 
+        if attribute_data[:4] == b'FFPC':
+            return self._import_ffp3_particle_cache(attribute_data, pct_surface, pct_boundary, pct_interior, generate_flat_array)
+
         if attribute_type == 'ATTRIBUTE_TYPE_VECTOR':
             sizeof_attribute = 12
             attribute_struct_format_str = '{0}f'
@@ -1256,6 +1284,48 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         return attribute_values, triangles, header_info_dict
 
 
+    def _import_ffp3_particle_cache(self, attribute_data, pct_surface, pct_boundary, pct_interior, generate_flat_array=False):
+        from ..ffengine import meshcache
+        bin_ends = meshcache.get_particle_bin_ends(attribute_data)
+        id_limit = len(bin_ends[0]) if bin_ends else 0
+
+        tol = 1e-9
+        id_counts = []
+        for pct in [pct_surface, pct_boundary, pct_interior]:
+            if pct < tol:
+                id_counts.append(0)
+            else:
+                id_counts.append(int(math.ceil(pct * (id_limit - 1))) + 1)
+
+        values, components = meshcache.decode_particle_channel(attribute_data, id_counts, bin_ends=bin_ends)
+        if components == 3 and not generate_flat_array:
+            it = iter(values)
+            attribute_values = list(zip(it, it, it))
+        else:
+            attribute_values = values.tolist()
+
+        header_info_dict = {}
+        header_info_dict["num_surface_particles"] = meshcache.get_particle_count(bin_ends, 0, id_limit)
+        header_info_dict["num_boundary_particles"] = meshcache.get_particle_count(bin_ends, 1, id_limit)
+        header_info_dict["num_interior_particles"] = meshcache.get_particle_count(bin_ends, 2, id_limit)
+        header_info_dict["id_limit"] = id_limit
+        header_info_dict["num_surface_particles_to_read"] = meshcache.get_particle_count(bin_ends, 0, id_counts[0])
+        header_info_dict["num_boundary_particles_to_read"] = meshcache.get_particle_count(bin_ends, 1, id_counts[1])
+        header_info_dict["num_interior_particles_to_read"] = meshcache.get_particle_count(bin_ends, 2, id_counts[2])
+
+        return attribute_values, [], header_info_dict
+
+
+    def _import_whitewater_particle_cache(self, data, pct, generate_flat_array=True):
+        from ..ffengine import meshcache
+        id_count = int(math.ceil((pct / 100) * 255)) + 1
+        values, components = meshcache.decode_particle_channel(data, [id_count])
+        if components == 3 and not generate_flat_array:
+            it = iter(values)
+            return list(zip(it, it, it)), []
+        return values.tolist(), []
+
+
     def import_wwp(self, filename, pct, generate_flat_array=False):
         if pct == 0:
             return [], []
@@ -1266,6 +1336,9 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         if len(wwp_data) == 0:
             return [], []
 
+        if wwp_data[:4] == b'FFPC':
+            return self._import_whitewater_particle_cache(wwp_data, pct, generate_flat_array)
+
         dataidx = int(math.ceil((pct / 100) * 255))
         num_vertices = struct.unpack_from('i', wwp_data, dataidx * 4)[0] + 1
         if num_vertices <= 0:
@@ -1294,6 +1367,9 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         if len(wwi_data) == 0:
             return [], []
 
+        if wwi_data[:4] == b'FFPC':
+            return self._import_whitewater_particle_cache(wwi_data, pct)
+
         dataidx = int(math.ceil((pct / 100) * 255))
         num_vertices = struct.unpack_from('i', wwi_data, dataidx * 4)[0] + 1
         if num_vertices <= 0:
@@ -1317,6 +1393,9 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         if len(wwi_data) == 0:
             return [], []
 
+        if wwi_data[:4] == b'FFPC':
+            return self._import_whitewater_particle_cache(wwi_data, pct)
+
         dataidx = int(math.ceil((pct / 100) * 255))
         num_vertices = struct.unpack_from('i', wwi_data, dataidx * 4)[0] + 1
         if num_vertices <= 0:
@@ -1337,6 +1416,10 @@ class FlipFluidMeshCache(bpy.types.PropertyGroup):
         if len(float_data) == 0:
             return []
 
+        if float_data[:4] == b'FFMC':
+            from ..ffengine import meshcache
+            return meshcache.decode_channel(float_data).tolist()
+
         datasize = len(float_data)
         num_floats = datasize // 4
         floats = list(struct.unpack_from('{0}f'.format(num_floats), float_data, 0))
@@ -181,6 +181,14 @@ class DomainAdvancedProperties(bpy.types.PropertyGroup):
             default = False,
             options={'HIDDEN'},
             )
+    enable_compressed_mesh_cache: BoolProperty(
+            name="Compress Mesh Cache",
+            description="Write the fluid surface, whitewater, and attribute cache"
+                " files as quantized compressed data. Greatly reduces cache size on disk"
+                " at the cost of a small loss of vertex precision",
+            default = False,
+            options={'HIDDEN'},
+            )
     enable_asynchronous_meshing: BoolProperty(
             name="Enable Async Meshing",
             description="Run mesh generation process in a separate thread while"
@@ -243,6 +251,7 @@ class DomainAdvancedProperties(bpy.types.PropertyGroup):
         add(path + ".num_threads_fixed",                         "Num Threads (fixed)",                group_id=1)
         add(path + ".enable_asynchronous_meshing",               "Async Meshing",                      group_id=1)
         add(path + ".enable_fracture_optimization",              "Enable Fracture Optimization",        group_id=1)
+        add(path + ".enable_compressed_mesh_cache",              "Compress Mesh Cache",                 group_id=1)
         add(path + ".precompute_static_obstacles",               "Precompute Static Obstacles",        group_id=1)
         add(path + ".reserve_temporary_grids",                   "Reserve Temporary Grid Memory",      group_id=1)
         add(path + ".disable_changing_topology_warning",         "Disable Changing Topology Warning",  group_id=1)
@@ -136,6 +136,7 @@ class FLIPFLUID_PT_DomainTypeAdvancedPanel(bpy.types.Panel):
 
             column = body.column()
             column.prop(aprops, "enable_fracture_optimization")
+            column.prop(aprops, "enable_compressed_mesh_cache")
         else:
             info_text = ""
             if aprops.threading_mode == 'THREADING_MODE_AUTO_DETECT':
@@ -23,7 +23,7 @@ IS_INSTALLATION_COMPLETE = False
 IS_STABLE_BUILD = True
 
 SUPPORT_LICENSE_TYPE = "GitHub"
-SUPPORT_LICENSE_ID = "108EM"
+SUPPORT_LICENSE_ID = "298BY"
 
 IS_MIXBOX_SUPPORTED = False
 IS_MIXBOX_INSTALLATION_COMPLETE = False
@@ -32,6 +32,7 @@ SOFTWARE.
 #include <random>
 
 #include "alembic_io.h"
+#include "../../engine/meshcache.h"
 
 #include "nlohmann/json.hpp"
 
@@ -336,6 +337,21 @@ void read_bobj(fs::path bobj_filepath, MeshData &mesh)
 
     std::ifstream infile(bobj_filepath, std::ios::binary);
 
+    // Meshes written with the compressed mesh cache option share the .bobj
+    // extension and are identified by their magic number
+    char magic[4] = {0, 0, 0, 0};
+    infile.read(magic, 4);
+    if (infile.gcount() == 4 && MeshCache::isMeshCacheData(magic, 4)) {
+        infile.seekg(0, std::ios::end);
+        std::vector<char> data((size_t)infile.tellg());
+        infile.seekg(0, std::ios::beg);
+        infile.read(data.data(), data.size());
+        read_mesh_cache(data, mesh);
+        return;
+    }
+    infile.clear();
+    infile.seekg(0, std::ios::beg);
+
     unsigned int num_vertices = 0;
     infile.read((char *)&num_vertices, bytes_per_int);
     mesh.num_vertices = num_vertices;
@@ -354,6 +370,24 @@ void read_bobj(fs::path bobj_filepath, MeshData &mesh)
 }
 
 
+void read_mesh_cache(std::vector<char> &data, MeshData &mesh)
+{
+    size_t ints_per_face = 3;
+
+    MeshCache::Info info = MeshCache::getInfo(data.data(), data.size());
+    mesh.num_vertices = info.numVertices;
+    mesh.num_faces = info.numTriangles;
+
+    mesh.vertex_data.resize(mesh.num_vertices);
+    mesh.face_data.resize(mesh.num_faces * ints_per_face);
+    MeshCache::decodeMesh(data.data(), data.size(),
+                          (float *)mesh.vertex_data.data(), mesh.face_data.data());
+
+    mesh.face_counts.clear();
+    mesh.face_counts.resize(mesh.num_faces, ints_per_face);
+}
+
+
 std::string zero_pad_int_to_string(int n, int width) 
 {
     std::ostringstream oss;
@@ -54,6 +54,7 @@ std::vector<Imath::V3f> offset_vertices(Alembic::Abc::float32_t *flat_vertices,
 void write_alembic_example();
 
 void read_bobj(fs::path bobj_filepath, MeshData &mesh);
+void read_mesh_cache(std::vector<char> &data, MeshData &mesh);
 std::string zero_pad_int_to_string(int n, int width);
 std::string format_seconds_to_MMSS(float total_seconds);
 std::string get_time_elapsed_string(std::chrono::time_point<std::chrono::steady_clock> time_start);
@@ -0,0 +1,189 @@
+/*
+MIT License
+
+Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "activecellindex.h"
+
+#include <algorithm>
+
+#include "particlelevelset.h"
+#include "threadutils.h"
+
+
+ActiveCellIndex::ActiveCellIndex() {
+}
+
+ActiveCellIndex::~ActiveCellIndex() {
+}
+
+void ActiveCellIndex::update(ParticleLevelSet &liquidSDF, int borderWidth) {
+    std::vector<GridIndex> blocks;
+    liquidSDF.getActiveBlocks(blocks);
+    _update(*(liquidSDF.getPhiGrid()), blocks, liquidSDF.getBlockWidth(), borderWidth);
+}
+
+void ActiveCellIndex::update(Array3d<float> &phi, int borderWidth) {
+    // Treat the whole grid as a single block
+    int blockwidth = std::max(std::max(phi.width, phi.height), std::max(phi.depth, 1));
+    std::vector<GridIndex> blocks({GridIndex(0, 0, 0)});
+    _update(phi, blocks, blockwidth, borderWidth);
+}
+
+std::vector<GridIndex>* ActiveCellIndex::getCells() {
+    return &_cells;
+}
+
+void ActiveCellIndex::_update(Array3d<float> &phi, std::vector<GridIndex> &blocks, 
+                              int blockwidth, int borderWidth) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+
+    if (phi.width != _isize || phi.height != _jsize || phi.depth != _ksize) {
+        _isize = phi.width;
+        _jsize = phi.height;
+        _ksize = phi.depth;
+        _keys.assign((size_t)_isize * (size_t)_jsize * (size_t)_ksize, -1);
+        _cells.clear();
+    } else if (!_cells.empty()) {
+        int numthreads = (int)std::min((size_t)numCPU, _cells.size());
+        std::vector<std::thread> threads(numthreads);
+        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _cells.size(), numthreads);
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&ActiveCellIndex::_clearKeysThread, this,
+                                     intervals[i], intervals[i + 1]);
+        }
+
+        for (int i = 0; i < numthreads; i++) {
+            threads[i].join();
+        }
+    }
+
+    _cells.clear();
+    _initializeBlockRows(blocks, blockwidth);
+
+    int kstart = borderWidth;
+    int kend = _ksize - borderWidth;
+    if (blocks.empty() || kend <= kstart) {
+        return;
+    }
+
+    // Each thread gathers the cells of a range of k-slices so that the 
+    // concatenated lists keep the lexicographic order
+    int numthreads = std::min(numCPU, kend - kstart);
+    _threadCells.resize(numthreads);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(kstart, kend, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        _threadCells[i].clear();
+        threads[i] = std::thread(&ActiveCellIndex::_findCellsThread, this,
+                                 intervals[i], intervals[i + 1], &phi, 
+                                 blockwidth, borderWidth, &(_threadCells[i]));
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    std::vector<int> offsets(numthreads + 1, 0);
+    for (int i = 0; i < numthreads; i++) {
+        offsets[i + 1] = offsets[i] + (int)_threadCells[i].size();
+    }
+    _cells.resize(offsets[numthreads]);
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ActiveCellIndex::_writeCellsThread, this,
+                                 i, i + 1, &offsets);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void ActiveCellIndex::_initializeBlockRows(std::vector<GridIndex> &blocks, int blockwidth) {
+    _bisize = (_isize + blockwidth - 1) / blockwidth;
+    _bjsize = (_jsize + blockwidth - 1) / blockwidth;
+    int bksize = (_ksize + blockwidth - 1) / blockwidth;
+
+    size_t numRows = (size_t)_bjsize * (size_t)bksize;
+    if (_blockRows.size() != numRows) {
+        _blockRows = std::vector<std::vector<int> >(numRows);
+    }
+    for (size_t i = 0; i < _blockRows.size(); i++) {
+        _blockRows[i].clear();
+    }
+
+    for (size_t bidx = 0; bidx < blocks.size(); bidx++) {
+        GridIndex b = blocks[bidx];
+        _blockRows[b.j + _bjsize * b.k].push_back(b.i);
+    }
+
+    for (size_t i = 0; i < _blockRows.size(); i++) {
+        std::sort(_blockRows[i].begin(), _blockRows[i].end());
+    }
+}
+
+void ActiveCellIndex::_findCellsThread(int kstart, int kend, Array3d<float> *phi, 
+                                       int blockwidth, int borderWidth, 
+                                       std::vector<GridIndex> *cells) {
+    int jstart = borderWidth;
+    int jend = _jsize - borderWidth;
+    int imin = borderWidth;
+    int imax = _isize - borderWidth;
+    for (int k = kstart; k < kend; k++) {
+        int bk = k / blockwidth;
+        for (int j = jstart; j < jend; j++) {
+            std::vector<int> *row = &(_blockRows[j / blockwidth + _bjsize * bk]);
+            for (size_t ridx = 0; ridx < row->size(); ridx++) {
+                int bi = row->at(ridx);
+                int istart = std::max(bi * blockwidth, imin);
+                int iend = std::min((bi + 1) * blockwidth, imax);
+                for (int i = istart; i < iend; i++) {
+                    if (phi->get(i, j, k) < 0.0f) {
+                        cells->push_back(GridIndex(i, j, k));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ActiveCellIndex::_clearKeysThread(int startidx, int endidx) {
+    for (int idx = startidx; idx < endidx; idx++) {
+        GridIndex g = _cells[idx];
+        _keys[(size_t)g.i + (size_t)_isize * ((size_t)g.j + (size_t)_jsize * (size_t)g.k)] = -1;
+    }
+}
+
+void ActiveCellIndex::_writeCellsThread(int startidx, int endidx, std::vector<int> *offsets) {
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        std::vector<GridIndex> *cells = &(_threadCells[tidx]);
+        int offset = offsets->at(tidx);
+        for (size_t i = 0; i < cells->size(); i++) {
+            GridIndex g = cells->at(i);
+            int key = offset + (int)i;
+            _cells[key] = g;
+            _keys[(size_t)g.i + (size_t)_isize * ((size_t)g.j + (size_t)_jsize * (size_t)g.k)] = key;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#if __MINGW32__ && !_WIN64
+    #include "mingw32_threads/mingw.thread.h"
+#else
+    #include <thread>
+#endif
+
+#include <vector>
+
+#include "fluidsimassert.h"
+#include "array3d.h"
+
+class ParticleLevelSet;
+
+/*
+    Compact, ordered list of the liquid cells (phi < 0) of a level set 
+    together with a grid sized key map from cell to list index. The 
+    structure is persistent: an update only clears the keys of the 
+    previous cell set and only visits the rows of the active level set 
+    blocks, so it can be rebuilt every substep and shared by the stages 
+    that iterate over liquid cells. Cells are stored in i-fastest 
+    lexicographic order.
+*/
+class ActiveCellIndex
+{
+public:
+    ActiveCellIndex();
+    ~ActiveCellIndex();
+
+    void update(ParticleLevelSet &liquidSDF, int borderWidth);
+    void update(Array3d<float> &phi, int borderWidth);
+
+    inline size_t size() {
+        return _cells.size();
+    }
+
+    inline bool empty() {
+        return _cells.empty();
+    }
+
+    inline GridIndex operator[](int i) {
+        return at(i);
+    }
+
+    inline GridIndex at(int i) {
+        FLUIDSIM_ASSERT(i >= 0 && i < (int)_cells.size());
+        return _cells[i];
+    }
+
+    inline int find(int i, int j, int k) {
+        FLUIDSIM_ASSERT(i >= 0 && j >= 0 && k >= 0 && i < _isize && j < _jsize && k < _ksize);
+        return _keys[(size_t)i + (size_t)_isize * ((size_t)j + (size_t)_jsize * (size_t)k)];
+    }
+
+    inline int find(GridIndex g) {
+        return find(g.i, g.j, g.k);
+    }
+
+    inline bool contains(int i, int j, int k) {
+        return find(i, j, k) != -1;
+    }
+
+    inline bool contains(GridIndex g) {
+        return find(g.i, g.j, g.k) != -1;
+    }
+
+    std::vector<GridIndex>* getCells();
+
+private:
+
+    void _update(Array3d<float> &phi, std::vector<GridIndex> &blocks, 
+                 int blockwidth, int borderWidth);
+    void _initializeBlockRows(std::vector<GridIndex> &blocks, int blockwidth);
+    void _findCellsThread(int kstart, int kend, Array3d<float> *phi, 
+                          int blockwidth, int borderWidth, 
+                          std::vector<GridIndex> *cells);
+    void _clearKeysThread(int startidx, int endidx);
+    void _writeCellsThread(int startidx, int endidx, std::vector<int> *offsets);
+
+    int _isize = 0;
+    int _jsize = 0;
+    int _ksize = 0;
+
+    std::vector<GridIndex> _cells;
+    std::vector<int> _keys;
+
+    int _bisize = 0;
+    int _bjsize = 0;
+    std::vector<std::vector<int> > _blockRows;
+    std::vector<std::vector<GridIndex> > _threadCells;
+};
@@ -27,6 +27,8 @@ SOFTWARE.
 #include <stdexcept>
 #include <sstream>
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <cmath>
 
 struct GridIndex {
@@ -84,10 +86,7 @@ public:
         _numElements = obj._numElements;
 
         _initializeGrid();
-
-        for (int i = 0; i < _numElements; i++) {
-            _grid[i] = obj._grid[i];
-        }
+        std::copy(obj._grid, obj._grid + _numElements, _grid);
 
         if (obj._isOutOfRangeValueSet) {
             _outOfRangeValue = obj._outOfRangeValue;
@@ -96,18 +95,13 @@ public:
     }
 
     Array3d operator=(const Array3d &rhs) {
-        delete[] _grid;
-
         width = rhs.width;
         height = rhs.height;
         depth = rhs.depth;
         _numElements = rhs._numElements;
 
         _initializeGrid();
-
-        for (int i = 0; i < _numElements; i++) {
-            _grid[i] = rhs._grid[i];
-        }
+        std::copy(rhs._grid, rhs._grid + _numElements, _grid);
 
         if (rhs._isOutOfRangeValueSet) {
             _outOfRangeValue = rhs._outOfRangeValue;
@@ -118,10 +112,53 @@ public:
     }
 
     ~Array3d() {
-        delete[] _grid;
+    }
+
+    /*
+        Copy-on-write snapshots
+
+        A snapshot shares the grid storage of another array without copying it.
+        The storage is reference counted and is only copied when detach()
+        is called while a snapshot is still alive. Writes through set(), add(),
+        getPointer() and getRawArray() do not detach automatically as they are
+        frequently made concurrently from worker threads, so the owner of a
+        snapshotted grid must call detach() before modifying it. fill()
+        overwrites every element and will replace shared storage without 
+        copying.
+    */
+    void constructSnapshot(Array3d<T> &other) {
+        width = other.width;
+        height = other.height;
+        depth = other.depth;
+        _numElements = other._numElements;
+        _gridStorage = other._gridStorage;
+        _grid = _gridStorage.get();
+
+        _isOutOfRangeValueSet = other._isOutOfRangeValueSet;
+        if (other._isOutOfRangeValueSet) {
+            _outOfRangeValue = other._outOfRangeValue;
+        }
+    }
+
+    bool isShared() {
+        return _gridStorage.use_count() > 1;
+    }
+
+    void detach() {
+        if (!isShared()) {
+            return;
+        }
+
+        std::shared_ptr<T[]> sharedStorage = _gridStorage;
+        _initializeGrid();
+        std::copy(sharedStorage.get(), sharedStorage.get() + _numElements, _grid);
     }
 
     void fill(T value) {
+        if (isShared()) {
+            _initializeGrid();
+        }
+
         for (int idx = 0; idx < _numElements; idx++) {
             _grid[idx] = value;
         }
@@ -703,7 +740,8 @@ private:
             }
         #endif
 
-        _grid = new T[width*height*depth];
+        _gridStorage = std::shared_ptr<T[]>(new T[width*height*depth]);
+        _grid = _gridStorage.get();
     }
 
     // vertices p are ordered {(0, 0, 0), (1, 0, 0), (0, 1, 0), (0, 0, 1), 
@@ -789,6 +827,7 @@ private:
         return sstream.str();
     }
 
+    std::shared_ptr<T[]> _gridStorage;
     T *_grid;
 
     bool _isOutOfRangeValueSet = false;
@@ -51,8 +51,14 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #pragma once
 
-#include "blockarray3d.h"
-#include "boundedbuffer.h"
+#include <vector>
+#include <cmath>
+
+#include "array3d.h"
+#include "grid3d.h"
+#include "gridutils.h"
+#include "threadutils.h"
+#include "vmath.h"
 
 
 template <class T>
@@ -69,173 +75,156 @@ struct AttributeTransferParameters {
 
 
 template <class T>
-class AttributeToGridTransfer {
+struct AttributeTransferChannel {
+    std::vector<T> *attributes = nullptr;
+    Array3d<T> *attributeGrid = nullptr;
+    Array3d<bool> *validGrid = nullptr;
+    double particleRadius = 1.0;
+    bool normalize = true;
+};
+
+
+/*
+    Transfers any number of float and vec3 particle attributes to grids 
+    in a single pass. Particles are sorted into blocks once using the 
+    largest channel radius and each block is splatted for every channel. 
+    All channel grids must have the same dimensions.
+*/
+class MultiAttributeToGridTransfer {
 
 public:
 
-    AttributeToGridTransfer() {}
-    ~AttributeToGridTransfer() {}
+    MultiAttributeToGridTransfer() {}
+    ~MultiAttributeToGridTransfer() {}
+
+    void addChannel(std::vector<float> *attributes, 
+                    Array3d<float> *attributeGrid, 
+                    Array3d<bool> *validGrid, 
+                    double particleRadius, 
+                    bool normalize = true) {
+        AttributeTransferChannel<float> c;
+        c.attributes = attributes;
+        c.attributeGrid = attributeGrid;
+        c.validGrid = validGrid;
+        c.particleRadius = particleRadius;
+        c.normalize = normalize;
+        _floatChannels.push_back(c);
+    }
 
-    void transfer(AttributeTransferParameters<T> params) {
-        _initializeParameters(params);
-
-        BlockArray3d<AttributeData> blockphi;
-        _initializeBlockGrid(blockphi);
-
-        ParticleGridCountData gridCountData;
-        _computeGridCountData(blockphi, gridCountData);
-
-        std::vector<PointData> sortedParticleData;
-        std::vector<int> blockToParticleDataIndex;
-        _sortParticlesIntoBlocks(gridCountData, 
-                                 sortedParticleData, 
-                                 blockToParticleDataIndex);
-
-        std::vector<GridBlock<AttributeData> > gridBlocks;
-        blockphi.getActiveGridBlocks(gridBlocks);
-        BoundedBuffer<ComputeBlock> computeBlockQueue(gridBlocks.size());
-        BoundedBuffer<ComputeBlock> finishedComputeBlockQueue(gridBlocks.size());
-        int numComputeBlocks = 0;
-        for (size_t bidx = 0; bidx < gridBlocks.size(); bidx++) {
-            GridBlock<AttributeData> b = gridBlocks[bidx];
-            if (gridCountData.totalGridCount[b.id] == 0) {
-                continue;
-            }
+    void addChannel(std::vector<vmath::vec3> *attributes, 
+                    Array3d<vmath::vec3> *attributeGrid, 
+                    Array3d<bool> *validGrid, 
+                    double particleRadius, 
+                    bool normalize = true) {
+        AttributeTransferChannel<vmath::vec3> c;
+        c.attributes = attributes;
+        c.attributeGrid = attributeGrid;
+        c.validGrid = validGrid;
+        c.particleRadius = particleRadius;
+        c.normalize = normalize;
+        _vectorChannels.push_back(c);
+    }
 
-            ComputeBlock computeBlock;
-            computeBlock.gridBlock = b;
-            computeBlock.particleData = &(sortedParticleData[blockToParticleDataIndex[b.id]]);
-            computeBlock.numParticles = gridCountData.totalGridCount[b.id];
-            computeBlock.radius = _particleRadius;
-            computeBlockQueue.push(computeBlock);
-            numComputeBlocks++;
-        }
+    int getNumChannels() {
+        return (int)(_floatChannels.size() + _vectorChannels.size());
+    }
 
-        int numCPU = ThreadUtils::getMaxThreadCount();
-        int numthreads = (int)fmin(numCPU, std::ceil((float)computeBlockQueue.size() / (float)_numBlocksPerJob));
-        std::vector<std::thread> producerThreads(numthreads);
-        for (int i = 0; i < numthreads; i++) {
-            producerThreads[i] = std::thread(&AttributeToGridTransfer::_transferProducerThread, this,
-                                             &computeBlockQueue, &finishedComputeBlockQueue);
+    void clearChannels() {
+        _floatChannels.clear();
+        _vectorChannels.clear();
+    }
+
+    void transfer(std::vector<vmath::vec3> *positions, vmath::vec3 gridOffset, double dx) {
+        if (getNumChannels() == 0 || positions->empty()) {
+            return;
         }
 
-        int numComputeBlocksProcessed = 0;
-        while (numComputeBlocksProcessed < numComputeBlocks) {
-            std::vector<ComputeBlock> finishedBlocks;
-            finishedComputeBlockQueue.popAll(finishedBlocks);
-
-            for (size_t i = 0; i < finishedBlocks.size(); i++) {
-                ComputeBlock block = finishedBlocks[i];
-                GridIndex gridOffset(block.gridBlock.index.i * _chunkWidth,
-                                     block.gridBlock.index.j * _chunkWidth,
-                                     block.gridBlock.index.k * _chunkWidth);
-
-                float eps = 1e-6;
-                int datasize = _chunkWidth * _chunkWidth * _chunkWidth;
-                for (int vidx = 0; vidx < datasize; vidx++) {
-                    GridIndex localidx = Grid3d::getUnflattenedIndex(vidx, _chunkWidth, _chunkWidth);
-                    GridIndex grididx = GridIndex(localidx.i + gridOffset.i,
-                                                  localidx.j + gridOffset.j,
-                                                  localidx.k + gridOffset.k);
-                    if (_attributeGrid->isIndexInRange(grididx)) {
-                        _attributeGrid->set(grididx, block.gridBlock.data[vidx].value);
-                        if (block.gridBlock.data[vidx].weight > eps) {
-                            _validGrid->set(grididx, true);
-                        }
-                    }
-                }
+        _initializeParameters(positions, gridOffset, dx);
+        _initializeBlockGrid();
+        _sortParticlesIntoBlocks();
+
+        std::vector<int> computeBlocks;
+        for (int bid = 0; bid < (int)_blockIndices.size(); bid++) {
+            if (_blockParticleStart[bid + 1] > _blockParticleStart[bid]) {
+                computeBlocks.push_back(bid);
             }
+        }
 
-            numComputeBlocksProcessed += finishedBlocks.size();
+        int numCPU = ThreadUtils::getMaxThreadCount();
+        int numthreads = (int)fmin(numCPU, computeBlocks.size());
+        std::vector<std::thread> threads(numthreads);
+        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, computeBlocks.size(), numthreads);
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&MultiAttributeToGridTransfer::_transferBlocksThread, this,
+                                     intervals[i], intervals[i + 1], &computeBlocks);
         }
 
-        computeBlockQueue.notifyFinished();
-        for (size_t i = 0; i < producerThreads.size(); i++) {
-            computeBlockQueue.notifyFinished();
-            producerThreads[i].join();
+        for (int i = 0; i < numthreads; i++) {
+            threads[i].join();
         }
+
+        _sortedParticleData.clear();
+        _sortedParticleData.shrink_to_fit();
     }
     
 private:
 
-    struct AttributeData {
-        T value;
-        float weight = 0.0f;
-    };
-
-
-    struct GridCountData {
-        std::vector<int> gridCount;
-        std::vector<int> simpleGridIndices;
-        std::vector<int> overlappingGridIndices;
-        std::vector<bool> invalidPoints;
-        int startidx = 0;
-        int endidx = 0;
-    };
-
-
-    struct ParticleGridCountData {
-        int numthreads = 1;
-        int gridsize = 1;
-        std::vector<int> totalGridCount;
-        std::vector<GridCountData> threadGridCountData;
-    };
-
-
     struct PointData {
         float x = 0.0f;
         float y = 0.0f;
         float z = 0.0f;
-        T v;
+        int id = -1;
 
         PointData() {}
-        PointData(float px, float py, float pz, T val)
-                    : x(px), y(py), z(pz), v(val) {}
+        PointData(float px, float py, float pz, int pid)
+                    : x(px), y(py), z(pz), id(pid) {}
     };
 
 
-    struct ComputeBlock {
-        GridBlock<AttributeData> gridBlock;
-        PointData *particleData = nullptr;
-        int numParticles = 0;
-        float radius = 0.0f;
-    };
+    void _initializeParameters(std::vector<vmath::vec3> *positions, vmath::vec3 gridOffset, double dx) {
+        if (!_floatChannels.empty()) {
+            _isize = _floatChannels[0].attributeGrid->width;
+            _jsize = _floatChannels[0].attributeGrid->height;
+            _ksize = _floatChannels[0].attributeGrid->depth;
+        } else {
+            _isize = _vectorChannels[0].attributeGrid->width;
+            _jsize = _vectorChannels[0].attributeGrid->height;
+            _ksize = _vectorChannels[0].attributeGrid->depth;
+        }
 
+        _maxParticleRadius = 0.0;
+        for (size_t i = 0; i < _floatChannels.size(); i++) {
+            FLUIDSIM_ASSERT(_floatChannels[i].attributeGrid->width == _isize && 
+                            _floatChannels[i].attributeGrid->height == _jsize && 
+                            _floatChannels[i].attributeGrid->depth == _ksize);
+            _maxParticleRadius = std::max(_maxParticleRadius, _floatChannels[i].particleRadius);
+        }
+        for (size_t i = 0; i < _vectorChannels.size(); i++) {
+            FLUIDSIM_ASSERT(_vectorChannels[i].attributeGrid->width == _isize && 
+                            _vectorChannels[i].attributeGrid->height == _jsize && 
+                            _vectorChannels[i].attributeGrid->depth == _ksize);
+            _maxParticleRadius = std::max(_maxParticleRadius, _vectorChannels[i].particleRadius);
+        }
 
-    void _initializeParameters(AttributeTransferParameters<T> params) {
-        _positions = *(params.positions);
-        _attributes = *(params.attributes);
-        _attributeGrid = params.attributeGrid;
-        _validGrid = params.validGrid;
-        _gridOffset = params.gridOffset;
-        _particleRadius = params.particleRadius;
-        _dx = params.dx;
+        _positions = positions;
+        _gridOffset = gridOffset;
+        _dx = dx;
         _chunkdx = _dx * _chunkWidth;
-        _normalize = params.normalize;
     }
 
 
-    void _initializeBlockGrid(BlockArray3d<AttributeData> &blockphi) {
-        int isize = _attributeGrid->width;
-        int jsize = _attributeGrid->height;
-        int ksize = _attributeGrid->depth;
-
-        BlockArray3dParameters params;
-        params.isize = isize;
-        params.jsize = jsize;
-        params.ksize = ksize;
-        params.blockwidth = _chunkWidth;
-        Dims3d dims = BlockArray3d<AttributeData>::getBlockDimensions(params);
-
-        Array3d<bool> activeBlocks(dims.i, dims.j, dims.k, false);
+    void _initializeBlockGrid() {
+        int bi = (int)std::ceil((double)_isize / (double)_chunkWidth);
+        int bj = (int)std::ceil((double)_jsize / (double)_chunkWidth);
+        int bk = (int)std::ceil((double)_ksize / (double)_chunkWidth);
+        Array3d<bool> activeBlocks(bi, bj, bk, false);
 
         int numCPU = ThreadUtils::getMaxThreadCount();
-        int numthreads = (int)fmin(numCPU, _positions.size());
+        int numthreads = (int)fmin(numCPU, _positions->size());
         std::vector<std::thread> threads(numthreads);
-        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _attributes.size(), numthreads);
-
+        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _positions->size(), numthreads);
         for (int i = 0; i < numthreads; i++) {
-            threads[i] = std::thread(&AttributeToGridTransfer::_initializeActiveBlocksThread, this,
+            threads[i] = std::thread(&MultiAttributeToGridTransfer::_initializeActiveBlocksThread, this,
                                      intervals[i], intervals[i + 1], &activeBlocks);
         }
 
@@ -245,29 +234,25 @@ private:
 
         GridUtils::featherGrid26(&activeBlocks, numthreads);
 
-        for (int k = 0; k < dims.k; k++) {
-            for (int j = 0; j < dims.j; j++) {
-                for (int i = 0; i < dims.i; i++) {
+        _blockIDs = Array3d<int>(bi, bj, bk, -1);
+        _blockIDs.setOutOfRangeValue(-1);
+        _blockIndices.clear();
+        for (int k = 0; k < bk; k++) {
+            for (int j = 0; j < bj; j++) {
+                for (int i = 0; i < bi; i++) {
                     if (activeBlocks(i, j, k)) {
-                        params.activeblocks.push_back(GridIndex(i, j, k));
+                        _blockIDs.set(i, j, k, (int)_blockIndices.size());
+                        _blockIndices.push_back(GridIndex(i, j, k));
                     }
                 }
             }
         }
-
-        AttributeData emptyData;
-        emptyData.value = T();
-        emptyData.weight = 0.0f;
-
-        blockphi = BlockArray3d<AttributeData>(params);
-        blockphi.fill(emptyData);
     }
 
 
     void _initializeActiveBlocksThread(int startidx, int endidx, Array3d<bool> *activeBlocks) {
-        vmath::vec3 offset = _getGridOffset();
         for (int i = startidx; i < endidx; i++) {
-            vmath::vec3 p = _positions[i] - offset;
+            vmath::vec3 p = _positions->at(i) - _gridOffset;
             GridIndex g = Grid3d::positionToGridIndex(p, _chunkdx);
             if (activeBlocks->isIndexInRange(g)) {
                 activeBlocks->set(g, true);
@@ -276,249 +261,235 @@ private:
     }
 
 
-    void _computeGridCountData(BlockArray3d<AttributeData> &blockphi, ParticleGridCountData &countdata) {
-        _initializeGridCountData(blockphi, countdata);
-
-        int numthreads = countdata.numthreads;
+    void _sortParticlesIntoBlocks() {
+        // Counting sort by block. Each thread counts the particles in its 
+        // range and then inserts them at its own offset within each block 
+        // so that particles remain ordered by index within a block.
+        int numblocks = (int)_blockIndices.size();
+        int numCPU = ThreadUtils::getMaxThreadCount();
+        int numthreads = (int)fmin(numCPU, _positions->size());
+        std::vector<std::vector<int> > threadBlockOffsets(numthreads, std::vector<int>(numblocks, 0));
         std::vector<std::thread> threads(numthreads);
-        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _positions.size(), numthreads);
+        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _positions->size(), numthreads);
         for (int i = 0; i < numthreads; i++) {
-            threads[i] = std::thread(&AttributeToGridTransfer::_computeGridCountDataThread, this,
-                                     intervals[i], intervals[i + 1],
-                                     &blockphi, 
-                                     &(countdata.threadGridCountData[i]));
+            threads[i] = std::thread(&MultiAttributeToGridTransfer::_sortParticlesIntoBlocksThread, this,
+                                     intervals[i], intervals[i + 1], &(threadBlockOffsets[i]), true);
         }
 
         for (int i = 0; i < numthreads; i++) {
             threads[i].join();
         }
 
-        for (int tidx = 0; tidx < countdata.numthreads; tidx++) {
-            std::vector<int> *threadGridCount = &(countdata.threadGridCountData[tidx].gridCount);
-            for (size_t i = 0; i < countdata.totalGridCount.size(); i++) {
-                countdata.totalGridCount[i] += threadGridCount->at(i);
+        _blockParticleStart.assign(numblocks + 1, 0);
+        int currentIndex = 0;
+        for (int bid = 0; bid < numblocks; bid++) {
+            _blockParticleStart[bid] = currentIndex;
+            for (int tidx = 0; tidx < numthreads; tidx++) {
+                int count = threadBlockOffsets[tidx][bid];
+                threadBlockOffsets[tidx][bid] = currentIndex;
+                currentIndex += count;
             }
         }
-    }
+        _blockParticleStart[numblocks] = currentIndex;
+        _sortedParticleData.resize(currentIndex);
 
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&MultiAttributeToGridTransfer::_sortParticlesIntoBlocksThread, this,
+                                     intervals[i], intervals[i + 1], &(threadBlockOffsets[i]), false);
+        }
 
-    void _initializeGridCountData(BlockArray3d<AttributeData> &blockphi, ParticleGridCountData &countdata) {
-        int numCPU = ThreadUtils::getMaxThreadCount();
-        int numthreads = (int)fmin(numCPU, _positions.size());
-        int numblocks = blockphi.getNumActiveGridBlocks();
-        countdata.numthreads = numthreads;
-        countdata.gridsize = numblocks;
-        countdata.threadGridCountData = std::vector<GridCountData>(numthreads);
         for (int i = 0; i < numthreads; i++) {
-            countdata.threadGridCountData[i].gridCount = std::vector<int>(numblocks, 0);
+            threads[i].join();
         }
-        countdata.totalGridCount = std::vector<int>(numblocks, 0);
     }
 
 
-    void _computeGridCountDataThread(int startidx, int endidx, 
-                                     BlockArray3d<AttributeData> *blockphi, 
-                                     GridCountData *countdata) {
-        
-        countdata->simpleGridIndices = std::vector<int>(endidx - startidx, -1);
-        countdata->invalidPoints = std::vector<bool>(endidx - startidx, false);
-        countdata->startidx = startidx;
-        countdata->endidx = endidx;
-
+    void _sortParticlesIntoBlocksThread(int startidx, int endidx, 
+                                        std::vector<int> *blockOffsets, 
+                                        bool isCountPass) {
         float eps = 1e-6;
-        float sr = _particleRadius + eps;
+        float sr = _maxParticleRadius + eps;
         float blockdx = _chunkdx;
-        vmath::vec3 offset = _getGridOffset();
         for (int i = startidx; i < endidx; i++) {
-            vmath::vec3 p = _positions[i] - offset;
+            vmath::vec3 p = _positions->at(i) - _gridOffset;
             GridIndex blockIndex = Grid3d::positionToGridIndex(p, blockdx);
             vmath::vec3 blockPosition = Grid3d::GridIndexToPosition(blockIndex, blockdx);
 
+            GridIndex gmin, gmax;
             if (p.x - sr > blockPosition.x && 
                     p.y - sr > blockPosition.y && 
                     p.z - sr > blockPosition.z && 
                     p.x + sr < blockPosition.x + blockdx && 
                     p.y + sr < blockPosition.y + blockdx && 
                     p.z + sr < blockPosition.z + blockdx) {
-                int blockid = blockphi->getBlockID(blockIndex);
-                countdata->simpleGridIndices[i - startidx] = blockid;
-
-                if (blockid != -1) {
-                    countdata->gridCount[blockid]++;
-                } else {
-                    countdata->invalidPoints[i - startidx] = true;
-                }
+                gmin = blockIndex;
+                gmax = blockIndex;
             } else {
-                GridIndex gmin = Grid3d::positionToGridIndex(p.x - sr, p.y - sr, p.z - sr, blockdx);
-                GridIndex gmax = Grid3d::positionToGridIndex(p.x + sr, p.y + sr, p.z + sr, blockdx);
-
-                int overlapCount = 0;
-                for (int gk = gmin.k; gk <= gmax.k; gk++) {
-                    for (int gj = gmin.j; gj <= gmax.j; gj++) {
-                        for (int gi = gmin.i; gi <= gmax.i; gi++) {
-                            int blockid = blockphi->getBlockID(gi, gj, gk);
-                            if (blockid != -1) {
-                                countdata->gridCount[blockid]++;
-                                countdata->overlappingGridIndices.push_back(blockid);
-                                overlapCount++;
-                            }
+                gmin = Grid3d::positionToGridIndex(p.x - sr, p.y - sr, p.z - sr, blockdx);
+                gmax = Grid3d::positionToGridIndex(p.x + sr, p.y + sr, p.z + sr, blockdx);
+            }
+
+            for (int gk = gmin.k; gk <= gmax.k; gk++) {
+                for (int gj = gmin.j; gj <= gmax.j; gj++) {
+                    for (int gi = gmin.i; gi <= gmax.i; gi++) {
+                        int blockid = _blockIDs(gi, gj, gk);
+                        if (blockid == -1) {
+                            continue;
                         }
-                    }
-                }
 
-                if (overlapCount == 0) {
-                    countdata->invalidPoints[i - startidx] = true;
+                        if (isCountPass) {
+                            (*blockOffsets)[blockid]++;
+                        } else {
+                            int sortedIndex = (*blockOffsets)[blockid]++;
+                            _sortedParticleData[sortedIndex] = PointData(p.x, p.y, p.z, i);
+                        }
+                    }
                 }
-                countdata->simpleGridIndices[i - startidx] = -overlapCount;
             }
         }
-
     }
 
 
-    void _sortParticlesIntoBlocks(ParticleGridCountData &countdata, 
-                                  std::vector<PointData> &sortedParticleData,
-                                  std::vector<int> &blockToParticleIndex) {
-
-        blockToParticleIndex = std::vector<int>(countdata.gridsize, 0);
-        int currentIndex = 0;
-        for (size_t i = 0; i < blockToParticleIndex.size(); i++) {
-            blockToParticleIndex[i] = currentIndex;
-            currentIndex += countdata.totalGridCount[i];
+    void _transferBlocksThread(int startidx, int endidx, std::vector<int> *computeBlocks) {
+        int datasize = _chunkWidth * _chunkWidth * _chunkWidth;
+        std::vector<float> weights(datasize);
+        std::vector<float> floatValues;
+        std::vector<vmath::vec3> vectorValues;
+        if (!_floatChannels.empty()) {
+            floatValues.resize(datasize);
+        }
+        if (!_vectorChannels.empty()) {
+            vectorValues.resize(datasize);
         }
-        std::vector<int> blockToParticleIndexCurrent = blockToParticleIndex;
-        int totalParticleCount = currentIndex;
-
-        vmath::vec3 offset = _getGridOffset();
-        sortedParticleData = std::vector<PointData>(totalParticleCount);
-
-        for (int tidx = 0; tidx < countdata.numthreads; tidx++) {
-            GridCountData *countData = &(countdata.threadGridCountData[tidx]);
-
-            int indexOffset = countData->startidx;
-            int currentOverlappingIndex = 0;
-            for (size_t i = 0; i < countData->simpleGridIndices.size(); i++) {
-                if (countData->invalidPoints[i]) {
-                    continue;
-                }
 
-                vmath::vec3 p = _positions[i + indexOffset] - offset;
-                T v = _attributes[i + indexOffset];
-                PointData pdata(p.x, p.y, p.z, v);
-
-                if (countData->simpleGridIndices[i] >= 0) {
-                    int blockid = countData->simpleGridIndices[i];
-                    int sortedIndex = blockToParticleIndexCurrent[blockid];
-                    sortedParticleData[sortedIndex] = pdata;
-                    blockToParticleIndexCurrent[blockid]++;
-                } else {
-                    int numblocks = -(countData->simpleGridIndices[i]);
-                    for (int blockidx = 0; blockidx < numblocks; blockidx++) {
-                        int blockid = countData->overlappingGridIndices[currentOverlappingIndex];
-                        currentOverlappingIndex++;
-
-                        int sortedIndex = blockToParticleIndexCurrent[blockid];
-                        sortedParticleData[sortedIndex] = pdata;
-                        blockToParticleIndexCurrent[blockid]++;
-                    }
-                }
+        for (int i = startidx; i < endidx; i++) {
+            int blockid = computeBlocks->at(i);
+            for (size_t cidx = 0; cidx < _floatChannels.size(); cidx++) {
+                _transferBlock(blockid, _floatChannels[cidx], floatValues, weights);
+            }
+            for (size_t cidx = 0; cidx < _vectorChannels.size(); cidx++) {
+                _transferBlock(blockid, _vectorChannels[cidx], vectorValues, weights);
             }
         }
-
     }
 
 
-    void _transferProducerThread(BoundedBuffer<ComputeBlock> *blockQueue, 
-                                 BoundedBuffer<ComputeBlock> *finishedBlockQueue) {
+    template <class T>
+    void _transferBlock(int blockid, AttributeTransferChannel<T> &channel, 
+                        std::vector<T> &values, std::vector<float> &weights) {
+        std::fill(values.begin(), values.end(), T());
+        std::fill(weights.begin(), weights.end(), 0.0f);
 
         float eps = 1e-6;
-        float r = _particleRadius;
-        float sr = _particleRadius + eps;
+        float r = channel.particleRadius;
+        float sr = channel.particleRadius + eps;
         float rsq = r * r;
         float coef1 = (4.0f / 9.0f) * (1.0f / (r*r*r*r*r*r));
         float coef2 = (17.0f / 9.0f) * (1.0f / (r*r*r*r));
         float coef3 = (22.0f / 9.0f) * (1.0f / (r*r));
 
-        while (blockQueue->size() > 0) {
-            std::vector<ComputeBlock> computeBlocks;
-            int numBlocks = blockQueue->pop(_numBlocksPerJob, computeBlocks);
-            if (numBlocks == 0) {
-                continue;
-            }
-
-            for (size_t bidx = 0; bidx < computeBlocks.size(); bidx++) {
-                ComputeBlock block = computeBlocks[bidx];
-                GridIndex blockIndex = block.gridBlock.index;
-                vmath::vec3 blockPositionOffset = Grid3d::GridIndexToPosition(blockIndex, _chunkWidth * _dx);
-
-                for (int pidx = 0; pidx < block.numParticles; pidx++) {
-                    PointData pdata = block.particleData[pidx];
-                    vmath::vec3 p(pdata.x, pdata.y, pdata.z);
-                    p -= blockPositionOffset;
-                    T value = pdata.v;
-
-                    vmath::vec3 pmin(p.x - sr, p.y - sr, p.z - sr);
-                    vmath::vec3 pmax(p.x + sr, p.y + sr, p.z + sr);
-                    GridIndex gmin = Grid3d::positionToGridIndex(pmin, _dx);
-                    GridIndex gmax = Grid3d::positionToGridIndex(pmax, _dx);
-                    gmin.i = std::max(gmin.i, 0);
-                    gmin.j = std::max(gmin.j, 0);
-                    gmin.k = std::max(gmin.k, 0);
-                    gmax.i = std::min(gmax.i, _chunkWidth - 1);
-                    gmax.j = std::min(gmax.j, _chunkWidth - 1);
-                    gmax.k = std::min(gmax.k, _chunkWidth - 1);
-
-                    for (int k = gmin.k; k <= gmax.k; k++) {
-                        for (int j = gmin.j; j <= gmax.j; j++) {
-                            for (int i = gmin.i; i <= gmax.i; i++) {
-                                vmath::vec3 gpos = Grid3d::GridIndexToPosition(i, j, k, _dx);
-                                vmath::vec3 v = gpos - p;
-                                float d2 = vmath::dot(v, v);
-                                if (d2 < rsq) {
-                                    float weight = 1.0f - coef1*d2*d2*d2 + coef2*d2*d2 - coef3*d2;
-
-                                    int flatidx = Grid3d::getFlatIndex(i, j, k, _chunkWidth, _chunkWidth);
-                                    block.gridBlock.data[flatidx].value += weight * value;
-                                    block.gridBlock.data[flatidx].weight += weight;
-                                }
-                            }
+        GridIndex blockIndex = _blockIndices[blockid];
+        vmath::vec3 blockPositionOffset = Grid3d::GridIndexToPosition(blockIndex, _chunkWidth * _dx);
+        std::vector<T> &attributes = *(channel.attributes);
+
+        for (int pidx = _blockParticleStart[blockid]; pidx < _blockParticleStart[blockid + 1]; pidx++) {
+            PointData pdata = _sortedParticleData[pidx];
+            vmath::vec3 p(pdata.x, pdata.y, pdata.z);
+            p -= blockPositionOffset;
+            T value = attributes[pdata.id];
+
+            vmath::vec3 pmin(p.x - sr, p.y - sr, p.z - sr);
+            vmath::vec3 pmax(p.x + sr, p.y + sr, p.z + sr);
+            GridIndex gmin = Grid3d::positionToGridIndex(pmin, _dx);
+            GridIndex gmax = Grid3d::positionToGridIndex(pmax, _dx);
+            gmin.i = std::max(gmin.i, 0);
+            gmin.j = std::max(gmin.j, 0);
+            gmin.k = std::max(gmin.k, 0);
+            gmax.i = std::min(gmax.i, _chunkWidth - 1);
+            gmax.j = std::min(gmax.j, _chunkWidth - 1);
+            gmax.k = std::min(gmax.k, _chunkWidth - 1);
+
+            for (int k = gmin.k; k <= gmax.k; k++) {
+                for (int j = gmin.j; j <= gmax.j; j++) {
+                    for (int i = gmin.i; i <= gmax.i; i++) {
+                        vmath::vec3 gpos = Grid3d::GridIndexToPosition(i, j, k, _dx);
+                        vmath::vec3 v = gpos - p;
+                        float d2 = vmath::dot(v, v);
+                        if (d2 < rsq) {
+                            float weight = 1.0f - coef1*d2*d2*d2 + coef2*d2*d2 - coef3*d2;
+
+                            int flatidx = Grid3d::getFlatIndex(i, j, k, _chunkWidth, _chunkWidth);
+                            values[flatidx] += weight * value;
+                            weights[flatidx] += weight;
                         }
                     }
                 }
+            }
+        }
 
-                if (_normalize) {
-                    int numVals = _chunkWidth * _chunkWidth * _chunkWidth;
-                    for (int i = 0; i < numVals; i++) {
-                        if (block.gridBlock.data[i].weight > eps) {
-                            block.gridBlock.data[i].value /= block.gridBlock.data[i].weight;
-                        }
-                    }
+        int numVals = _chunkWidth * _chunkWidth * _chunkWidth;
+        if (channel.normalize) {
+            for (int i = 0; i < numVals; i++) {
+                if (weights[i] > eps) {
+                    values[i] /= weights[i];
                 }
-
-                finishedBlockQueue->push(block);
             }
         }
 
+        // Blocks do not overlap so their cells can be written concurrently
+        GridIndex gridOffset(blockIndex.i * _chunkWidth,
+                             blockIndex.j * _chunkWidth,
+                             blockIndex.k * _chunkWidth);
+        for (int vidx = 0; vidx < numVals; vidx++) {
+            GridIndex localidx = Grid3d::getUnflattenedIndex(vidx, _chunkWidth, _chunkWidth);
+            GridIndex grididx = GridIndex(localidx.i + gridOffset.i,
+                                          localidx.j + gridOffset.j,
+                                          localidx.k + gridOffset.k);
+            if (channel.attributeGrid->isIndexInRange(grididx)) {
+                channel.attributeGrid->set(grididx, values[vidx]);
+                if (weights[vidx] > eps) {
+                    channel.validGrid->set(grididx, true);
+                }
+            }
+        }
     }
 
 
-    vmath::vec3 _getGridOffset() {
-        return _gridOffset;
-    }
-
+    std::vector<AttributeTransferChannel<float> > _floatChannels;
+    std::vector<AttributeTransferChannel<vmath::vec3> > _vectorChannels;
 
-    std::vector<vmath::vec3> _positions;
-    std::vector<T> _attributes;
-    Array3d<T> *_attributeGrid;
-    Array3d<bool> *_validGrid;
+    std::vector<vmath::vec3> *_positions = nullptr;
     vmath::vec3 _gridOffset;
-    double _particleRadius = 1.0;
+    double _maxParticleRadius = 1.0;
     double _dx = 0.0;
-    bool _normalize = true;
-
     double _chunkdx = 0.0;
+    int _isize = 0;
+    int _jsize = 0;
+    int _ksize = 0;
+
+    Array3d<int> _blockIDs;
+    std::vector<GridIndex> _blockIndices;
+    std::vector<int> _blockParticleStart;
+    std::vector<PointData> _sortedParticleData;
 
     int _chunkWidth = 10;
-    int _numBlocksPerJob = 10;
+    
+};
+
+
+template <class T>
+class AttributeToGridTransfer {
+
+public:
+
+    AttributeToGridTransfer() {}
+    ~AttributeToGridTransfer() {}
+
+    void transfer(AttributeTransferParameters<T> params) {
+        MultiAttributeToGridTransfer multiTransfer;
+        multiTransfer.addChannel(params.attributes, params.attributeGrid, params.validGrid, 
+                                 params.particleRadius, params.normalize);
+        multiTransfer.transfer(params.positions, params.gridOffset, params.dx);
+    }
     
 };
@@ -330,6 +330,60 @@ extern "C" {
         );
     }
 
+    EXPORTDLL void FluidSimulation_enable_adaptive_marker_particle_advection(FluidSimulation* obj, int *err) {
+        CBindings::safe_execute_method_void_0param(
+            obj, &FluidSimulation::enableAdaptiveMarkerParticleAdvection, err
+        );
+    }
+
+    EXPORTDLL void FluidSimulation_disable_adaptive_marker_particle_advection(FluidSimulation* obj, int *err) {
+        CBindings::safe_execute_method_void_0param(
+            obj, &FluidSimulation::disableAdaptiveMarkerParticleAdvection, err
+        );
+    }
+
+    EXPORTDLL int FluidSimulation_is_adaptive_marker_particle_advection_enabled(FluidSimulation* obj, int *err) {
+        return CBindings::safe_execute_method_ret_0param(
+            obj, &FluidSimulation::isAdaptiveMarkerParticleAdvectionEnabled, err
+        );
+    }
+
+    EXPORTDLL void FluidSimulation_enable_mixed_precision_pressure_solve(FluidSimulation* obj, int *err) {
+        CBindings::safe_execute_method_void_0param(
+            obj, &FluidSimulation::enableMixedPrecisionPressureSolve, err
+        );
+    }
+
+    EXPORTDLL void FluidSimulation_disable_mixed_precision_pressure_solve(FluidSimulation* obj, int *err) {
+        CBindings::safe_execute_method_void_0param(
+            obj, &FluidSimulation::disableMixedPrecisionPressureSolve, err
+        );
+    }
+
+    EXPORTDLL int FluidSimulation_is_mixed_precision_pressure_solve_enabled(FluidSimulation* obj, int *err) {
+        return CBindings::safe_execute_method_ret_0param(
+            obj, &FluidSimulation::isMixedPrecisionPressureSolveEnabled, err
+        );
+    }
+
+    EXPORTDLL void FluidSimulation_enable_pressure_solve_iterative_refinement(FluidSimulation* obj, int *err) {
+        CBindings::safe_execute_method_void_0param(
+            obj, &FluidSimulation::enablePressureSolveIterativeRefinement, err
+        );
+    }
+
+    EXPORTDLL void FluidSimulation_disable_pressure_solve_iterative_refinement(FluidSimulation* obj, int *err) {
+        CBindings::safe_execute_method_void_0param(
+            obj, &FluidSimulation::disablePressureSolveIterativeRefinement, err
+        );
+    }
+
+    EXPORTDLL int FluidSimulation_is_pressure_solve_iterative_refinement_enabled(FluidSimulation* obj, int *err) {
+        return CBindings::safe_execute_method_ret_0param(
+            obj, &FluidSimulation::isPressureSolveIterativeRefinementEnabled, err
+        );
+    }
+
     EXPORTDLL int FluidSimulation_get_viscosity_solver_max_iterations(FluidSimulation* obj, 
                                                                       int *err) {
         return CBindings::safe_execute_method_ret_0param(
@@ -583,6 +637,28 @@ extern "C" {
         );
     }
 
+    EXPORTDLL void FluidSimulation_set_mesh_output_format_as_mesh_cache(FluidSimulation* obj, 
+                                                                        int *err) {
+        CBindings::safe_execute_method_void_0param(
+            obj, &FluidSimulation::setMeshOutputFormatAsMeshCache, err
+        );
+    }
+
+    EXPORTDLL int FluidSimulation_get_mesh_cache_quantization_bits(FluidSimulation* obj, 
+                                                                   int *err) {
+        return CBindings::safe_execute_method_ret_0param(
+            obj, &FluidSimulation::getMeshCacheQuantizationBits, err
+        );
+    }
+
+    EXPORTDLL void FluidSimulation_set_mesh_cache_quantization_bits(FluidSimulation* obj, 
+                                                                    int bits,
+                                                                    int *err) {
+        CBindings::safe_execute_method_void_1param(
+            obj, &FluidSimulation::setMeshCacheQuantizationBits, bits, err
+        );
+    }
+
     EXPORTDLL void FluidSimulation_enable_console_output(FluidSimulation* obj,
                                                          int *err) {
         CBindings::safe_execute_method_void_0param(
@@ -0,0 +1,185 @@
+/*
+MIT License
+
+Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+
+#include "../meshcache.h"
+#include "cbindings.h"
+
+#ifdef _WIN32
+    #define EXPORTDLL __declspec(dllexport)
+#else
+    #define EXPORTDLL
+#endif
+
+
+struct MeshCacheInfo_t {
+    int num_vertices = 0;
+    int num_triangles = 0;
+    int num_channels = 0;
+};
+
+struct MeshCacheChannelInfo_t {
+    int components = 0;
+    int num_rows = 0;
+};
+
+struct MeshCacheParticleInfo_t {
+    int num_groups = 0;
+    int id_limit = 0;
+    int num_channels = 0;
+};
+
+struct MeshCacheParticleChannelInfo_t {
+    int type = 0;
+    int components = 0;
+};
+
+
+extern "C" {
+
+    EXPORTDLL MeshCacheInfo_t MeshCache_get_info(char *c_data, unsigned int size, int *err) {
+        *err = CBindings::SUCCESS;
+        MeshCacheInfo_t info;
+        try {
+            MeshCache::Info i = MeshCache::getInfo(c_data, size);
+            info.num_vertices = i.numVertices;
+            info.num_triangles = i.numTriangles;
+            info.num_channels = i.numChannels;
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+
+        return info;
+    }
+
+    EXPORTDLL void MeshCache_decode_mesh(char *c_data, unsigned int size, 
+                                         float *vertices, int *triangles, int *err) {
+        *err = CBindings::SUCCESS;
+        try {
+            MeshCache::decodeMesh(c_data, size, vertices, triangles);
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+    }
+
+    EXPORTDLL MeshCacheChannelInfo_t MeshCache_get_channel_info(char *c_data, unsigned int size, 
+                                                                int channel_index, int *err) {
+        *err = CBindings::SUCCESS;
+        MeshCacheChannelInfo_t info;
+        try {
+            MeshCache::ChannelInfo i = MeshCache::getChannelInfo(c_data, size, channel_index);
+            info.components = i.components;
+            info.num_rows = i.numRows;
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+
+        return info;
+    }
+
+    EXPORTDLL void MeshCache_decode_channel(char *c_data, unsigned int size, 
+                                            int channel_index, float *values, int *err) {
+        *err = CBindings::SUCCESS;
+        try {
+            MeshCache::Channel channel;
+            MeshCache::decodeChannel(c_data, size, channel_index, channel);
+            std::memcpy(values, channel.values.data(), channel.values.size() * sizeof(float));
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+    }
+
+    EXPORTDLL MeshCacheParticleInfo_t MeshCache_get_particle_info(char *c_data, unsigned int size, 
+                                                                  int *err) {
+        *err = CBindings::SUCCESS;
+        MeshCacheParticleInfo_t info;
+        try {
+            MeshCache::ParticleInfo i = MeshCache::getParticleInfo(c_data, size);
+            info.num_groups = i.numGroups;
+            info.id_limit = i.idLimit;
+            info.num_channels = i.numChannels;
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+
+        return info;
+    }
+
+    EXPORTDLL void MeshCache_get_particle_bin_ends(char *c_data, unsigned int size, 
+                                                   unsigned int *bin_ends, int *err) {
+        *err = CBindings::SUCCESS;
+        try {
+            MeshCache::ParticleInfo info = MeshCache::getParticleInfo(c_data, size);
+            for (int g = 0; g < info.numGroups; g++) {
+                std::memcpy(bin_ends + (size_t)g * info.idLimit, info.idBinEnds[g].data(), 
+                            info.idLimit * sizeof(unsigned int));
+            }
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+    }
+
+    EXPORTDLL MeshCacheParticleChannelInfo_t MeshCache_get_particle_channel_info(
+            char *c_data, unsigned int size, int channel_index, int *err) {
+        *err = CBindings::SUCCESS;
+        MeshCacheParticleChannelInfo_t info;
+        try {
+            MeshCache::ParticleChannelInfo i = MeshCache::getParticleChannelInfo(c_data, size, channel_index);
+            info.type = (int)i.type;
+            info.components = i.components;
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+
+        return info;
+    }
+
+    EXPORTDLL void MeshCache_decode_particle_channel(char *c_data, unsigned int size, 
+                                                     int channel_index, int *group_id_counts,
+                                                     void *values, int *err) {
+        *err = CBindings::SUCCESS;
+        try {
+            MeshCache::ParticleInfo info = MeshCache::getParticleInfo(c_data, size);
+            std::vector<int> groupIDCounts(group_id_counts, group_id_counts + info.numGroups);
+            MeshCache::ParticleChannel channel;
+            MeshCache::decodeParticleChannel(c_data, size, channel_index, groupIDCounts, channel);
+            if (channel.type == MeshCache::ParticleChannelType::ints) {
+                std::memcpy(values, channel.intValues.data(), channel.intValues.size() * sizeof(int));
+            } else {
+                std::memcpy(values, channel.values.data(), channel.values.size() * sizeof(float));
+            }
+        } catch (std::exception &ex) {
+            CBindings::set_error_message(ex);
+            *err = CBindings::FAIL;
+        }
+    }
+}
@@ -25,6 +25,7 @@ SOFTWARE.
 #include "diffuseparticlesimulation.h"
 
 #include <cstring>
+#include <algorithm>
 
 #include "threadutils.h"
 #include "interpolation.h"
@@ -645,6 +646,45 @@ double DiffuseParticleSimulation::getDomainScale() {
     return _domainScale;
 }
 
+void DiffuseParticleSimulation::enableParticleCacheOutput() {
+    _isParticleCacheOutputEnabled = true;
+}
+
+void DiffuseParticleSimulation::disableParticleCacheOutput() {
+    _isParticleCacheOutputEnabled = false;
+}
+
+bool DiffuseParticleSimulation::isParticleCacheOutputEnabled() {
+    return _isParticleCacheOutputEnabled;
+}
+
+void DiffuseParticleSimulation::setParticleCacheEncodeParameters(MeshCache::ParticleEncodeParameters params) {
+    _particleCacheEncodeParameters = params;
+}
+
+void DiffuseParticleSimulation::sortDiffuseParticlesByMortonOrder() {
+    // Output files bin particles by ID in storage order, so sorting the
+    // particle system keeps each bin spatially coherent
+    std::vector<vmath::vec3> *positions;
+    _diffuseParticles.getAttributeValues("POSITION", positions);
+
+    std::vector<std::pair<unsigned long long, size_t> > keys(positions->size());
+    for (size_t i = 0; i < positions->size(); i++) {
+        GridIndex g = Grid3d::positionToGridIndex(positions->at(i), _dx);
+        unsigned long long code = Grid3d::getMortonCode(std::max(g.i, 0), 
+                                                        std::max(g.j, 0), 
+                                                        std::max(g.k, 0));
+        keys[i] = std::make_pair(code, i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<size_t> order(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        order[i] = keys[i].second;
+    }
+    _diffuseParticles.reorderParticles(order);
+}
+
 void DiffuseParticleSimulation::getDiffuseParticleFileDataWWP(std::vector<char> &data) {
     std::vector<vmath::vec3> positions;
     std::vector<unsigned char> ids;
@@ -673,7 +713,7 @@ void DiffuseParticleSimulation::getDiffuseParticleFileDataWWP(std::vector<char>
         }
     }
 
-    _getDiffuseParticleFileDataWWP(positions, ids, data);
+    _getDiffuseParticleFileDataWWP(positions, ids, data, true);
 }
 
 void DiffuseParticleSimulation::getFoamParticleFileDataWWP(std::vector<char> &data) {
@@ -710,7 +750,7 @@ void DiffuseParticleSimulation::getFoamParticleFileDataWWP(std::vector<char> &da
         }
     }
 
-    _getDiffuseParticleFileDataWWP(positions, ids, data);
+    _getDiffuseParticleFileDataWWP(positions, ids, data, true);
 }
 
 void DiffuseParticleSimulation::getBubbleParticleFileDataWWP(std::vector<char> &data) {
@@ -747,7 +787,7 @@ void DiffuseParticleSimulation::getBubbleParticleFileDataWWP(std::vector<char> &
         }
     }
 
-    _getDiffuseParticleFileDataWWP(positions, ids, data);
+    _getDiffuseParticleFileDataWWP(positions, ids, data, true);
 }
 
 void DiffuseParticleSimulation::getSprayParticleFileDataWWP(std::vector<char> &data) {
@@ -785,7 +825,7 @@ void DiffuseParticleSimulation::getSprayParticleFileDataWWP(std::vector<char> &d
         }
     }
 
-    _getDiffuseParticleFileDataWWP(positions, ids, data);
+    _getDiffuseParticleFileDataWWP(positions, ids, data, true);
 }
 
 void DiffuseParticleSimulation::getDustParticleFileDataWWP(std::vector<char> &data) {
@@ -822,7 +862,7 @@ void DiffuseParticleSimulation::getDustParticleFileDataWWP(std::vector<char> &da
         }
     }
 
-    _getDiffuseParticleFileDataWWP(positions, ids, data);
+    _getDiffuseParticleFileDataWWP(positions, ids, data, true);
 }
 
 void DiffuseParticleSimulation::getFoamParticleBlurFileDataWWP(std::vector<char> &data, double dt) {
@@ -1545,9 +1585,8 @@ void DiffuseParticleSimulation::_trilinearInterpolateThread(int startidx, int en
                                                             std::vector<vmath::vec3> *input, 
                                                             MACVelocityField *vfield, 
                                                             std::vector<vmath::vec3> *output) {
-    for (int i = startidx; i < endidx; i++) {
-        (*output)[i] = vfield->evaluateVelocityAtPositionLinear(input->at(i));
-    }
+    vfield->evaluateVelocityAtPositionsLinear(input->data() + startidx, endidx - startidx, 
+                                              output->data() + startidx);
 }
 
 double DiffuseParticleSimulation::_getParticleJitter() {
@@ -2894,7 +2933,8 @@ void DiffuseParticleSimulation::_removeDiffuseParticles() {
 
 void DiffuseParticleSimulation::_getDiffuseParticleFileDataWWP(std::vector<vmath::vec3> &positions, 
                                                                std::vector<unsigned char> &ids,
-                                                               std::vector<char> &data) {
+                                                               std::vector<char> &data,
+                                                               bool isPositionData) {
     FLUIDSIM_ASSERT(positions.size() == ids.size())
 
     std::vector<unsigned int> idcounts(_diffuseParticleIDLimit, 0);
@@ -2918,6 +2958,21 @@ void DiffuseParticleSimulation::_getDiffuseParticleFileDataWWP(std::vector<vmath
         idBinIndices[ids[i]]++;
     }
 
+    if (_isParticleCacheOutputEnabled) {
+        MeshCache::ParticleChannel channel;
+        channel.type = isPositionData ? MeshCache::ParticleChannelType::positions : 
+                                        MeshCache::ParticleChannelType::floats;
+        channel.components = 3;
+        channel.values.resize(3 * positionData.size());
+        for (size_t i = 0; i < positionData.size(); i++) {
+            channel.values[3 * i + 0] = positionData[i].x;
+            channel.values[3 * i + 1] = positionData[i].y;
+            channel.values[3 * i + 2] = positionData[i].z;
+        }
+        _getDiffuseParticleCacheFileData(channel, idData, data);
+        return;
+    }
+
     unsigned int idDataSize = (unsigned int)idData.size() * sizeof(int);
     unsigned int numVertices = (unsigned int)positions.size();
     unsigned int vertexDataSize = 3 * numVertices * sizeof(float);
@@ -2960,6 +3015,14 @@ void DiffuseParticleSimulation::_getDiffuseParticleFileDataWWI(std::vector<int>
         idBinIndices[ids[i]]++;
     }
 
+    if (_isParticleCacheOutputEnabled) {
+        MeshCache::ParticleChannel channel;
+        channel.type = MeshCache::ParticleChannelType::ints;
+        channel.intValues.assign(intData.begin(), intData.end());
+        _getDiffuseParticleCacheFileData(channel, idData, data);
+        return;
+    }
+
     unsigned int idDataSize = (unsigned int)idData.size() * sizeof(int);
     unsigned int numVertices = (unsigned int)intvalues.size();
     unsigned int intDataSize = numVertices * sizeof(int);
@@ -3002,6 +3065,14 @@ void DiffuseParticleSimulation::_getDiffuseParticleFileDataWWF(std::vector<float
         idBinIndices[ids[i]]++;
     }
 
+    if (_isParticleCacheOutputEnabled) {
+        MeshCache::ParticleChannel channel;
+        channel.type = MeshCache::ParticleChannelType::floats;
+        channel.values = floatData;
+        _getDiffuseParticleCacheFileData(channel, idData, data);
+        return;
+    }
+
     unsigned int idDataSize = (int)idData.size() * sizeof(int);
     unsigned int numVertices = (int)floatvalues.size();
     unsigned int intDataSize = numVertices * sizeof(int);
@@ -3017,4 +3088,17 @@ void DiffuseParticleSimulation::_getDiffuseParticleFileDataWWF(std::vector<float
 
     std::memcpy(data.data() + byteOffset, (char *)floatData.data(), intDataSize);
     byteOffset += intDataSize;
+}
+
+void DiffuseParticleSimulation::_getDiffuseParticleCacheFileData(MeshCache::ParticleChannel &channel,
+                                                                 std::vector<unsigned int> &idData,
+                                                                 std::vector<char> &data) {
+    // WW* headers store the last index of each ID bin, the particle cache
+    // stores exclusive bin ends
+    std::vector<std::vector<unsigned int> > idBinEnds(1, std::vector<unsigned int>(idData.size()));
+    for (size_t i = 0; i < idData.size(); i++) {
+        idBinEnds[0][i] = idData[i] + 1;
+    }
+
+    MeshCache::encodeParticles(channel, idBinEnds, _particleCacheEncodeParameters, data);
 }
\ No newline at end of file
@@ -38,6 +38,7 @@ SOFTWARE.
 #include "turbulencefield.h"
 #include "particlesystem.h"
 #include "diffuseparticle.h"
+#include "meshcache.h"
 
 struct MarkerParticle;
 enum class DiffuseParticleType : char;
@@ -252,6 +253,11 @@ public:
     vmath::vec3 getDomainOffset();
     void setDomainScale(double scale);
     double getDomainScale();
+    void enableParticleCacheOutput();
+    void disableParticleCacheOutput();
+    bool isParticleCacheOutputEnabled();
+    void setParticleCacheEncodeParameters(MeshCache::ParticleEncodeParameters params);
+    void sortDiffuseParticlesByMortonOrder();
     void getDiffuseParticleFileDataWWP(std::vector<char> &data);
     void getFoamParticleFileDataWWP(std::vector<char> &data);
     void getBubbleParticleFileDataWWP(std::vector<char> &data);
@@ -399,13 +405,17 @@ private:
 
     void _getDiffuseParticleFileDataWWP(std::vector<vmath::vec3> &positions, 
                                         std::vector<unsigned char> &ids,
-                                        std::vector<char> &data);
+                                        std::vector<char> &data,
+                                        bool isPositionData=false);
     void _getDiffuseParticleFileDataWWI(std::vector<int> &intvalues, 
                                         std::vector<unsigned char> &ids,
                                         std::vector<char> &data);
     void _getDiffuseParticleFileDataWWF(std::vector<float> &floatvalues, 
                                         std::vector<unsigned char> &ids,
                                         std::vector<char> &data);
+    void _getDiffuseParticleCacheFileData(MeshCache::ParticleChannel &channel,
+                                          std::vector<unsigned int> &idData,
+                                          std::vector<char> &data);
 
     template<class T>
     void _removeItemsFromVector(FragmentedVector<T> &items, std::vector<bool> &isRemoved) {
@@ -539,4 +549,7 @@ private:
 
     int _currentDiffuseParticleID = 0;
     int _diffuseParticleIDLimit = 256;
+
+    bool _isParticleCacheOutputEnabled = false;
+    MeshCache::ParticleEncodeParameters _particleCacheEncodeParameters;
 };
@@ -34,4 +34,5 @@ from .forcefieldcurve import ForceFieldCurve
 from .trianglemesh import TriangleMesh, TriangleMesh_t
 from .gridindex import GridIndex, GridIndex_t
 from .vector3 import Vector3, Vector3_t
-from . import mixbox
\ No newline at end of file
+from . import mixbox
+from . import meshcache
\ No newline at end of file
@@ -332,6 +332,51 @@ class FluidSimulation(object):
         pb.init_lib_func(libfunc, [c_void_p, c_int, c_void_p], None)
         pb.execute_lib_func(libfunc, [self(), int(n)])
 
+    @property
+    def enable_adaptive_marker_particle_advection(self):
+        libfunc = lib.FluidSimulation_is_adaptive_marker_particle_advection_enabled
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], c_int)
+        return bool(pb.execute_lib_func(libfunc, [self()]))
+
+    @enable_adaptive_marker_particle_advection.setter
+    def enable_adaptive_marker_particle_advection(self, boolval):
+        if boolval:
+            libfunc = lib.FluidSimulation_enable_adaptive_marker_particle_advection
+        else:
+            libfunc = lib.FluidSimulation_disable_adaptive_marker_particle_advection
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], None)
+        pb.execute_lib_func(libfunc, [self()])
+
+    @property
+    def enable_mixed_precision_pressure_solve(self):
+        libfunc = lib.FluidSimulation_is_mixed_precision_pressure_solve_enabled
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], c_int)
+        return bool(pb.execute_lib_func(libfunc, [self()]))
+
+    @enable_mixed_precision_pressure_solve.setter
+    def enable_mixed_precision_pressure_solve(self, boolval):
+        if boolval:
+            libfunc = lib.FluidSimulation_enable_mixed_precision_pressure_solve
+        else:
+            libfunc = lib.FluidSimulation_disable_mixed_precision_pressure_solve
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], None)
+        pb.execute_lib_func(libfunc, [self()])
+
+    @property
+    def enable_pressure_solve_iterative_refinement(self):
+        libfunc = lib.FluidSimulation_is_pressure_solve_iterative_refinement_enabled
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], c_int)
+        return bool(pb.execute_lib_func(libfunc, [self()]))
+
+    @enable_pressure_solve_iterative_refinement.setter
+    def enable_pressure_solve_iterative_refinement(self, boolval):
+        if boolval:
+            libfunc = lib.FluidSimulation_enable_pressure_solve_iterative_refinement
+        else:
+            libfunc = lib.FluidSimulation_disable_pressure_solve_iterative_refinement
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], None)
+        pb.execute_lib_func(libfunc, [self()])
+
     @property
     def viscosity_solver_max_iterations(self):
         libfunc = lib.FluidSimulation_get_viscosity_solver_max_iterations
@@ -534,6 +579,25 @@ class FluidSimulation(object):
         pb.init_lib_func(libfunc, [c_void_p, c_void_p], None)
         pb.execute_lib_func(libfunc, [self()])
 
+    def set_mesh_output_format_as_mesh_cache(self):
+        libfunc = lib.FluidSimulation_set_mesh_output_format_as_mesh_cache
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], None)
+        pb.execute_lib_func(libfunc, [self()])
+
+    @property
+    def mesh_cache_quantization_bits(self):
+        libfunc = lib.FluidSimulation_get_mesh_cache_quantization_bits
+        pb.init_lib_func(libfunc, [c_void_p, c_void_p], c_int)
+        return pb.execute_lib_func(libfunc, [self()])
+
+    @mesh_cache_quantization_bits.setter
+    @decorators.check_ge(8)
+    @decorators.check_le(24)
+    def mesh_cache_quantization_bits(self, bits):
+        libfunc = lib.FluidSimulation_set_mesh_cache_quantization_bits
+        pb.init_lib_func(libfunc, [c_void_p, c_int, c_void_p], None)
+        pb.execute_lib_func(libfunc, [self(), int(bits)])
+
     @property
     def enable_console_output(self):
         libfunc = lib.FluidSimulation_is_console_output_enabled
@@ -3270,6 +3334,10 @@ class FluidSimulationFrameStats_t(ctypes.Structure):
                 ("viscosity_solver_error", c_double),
                 ("viscosity_solver_iterations", c_int),
                 ("viscosity_solver_max_iterations", c_int),
+                ("advection_euler_steps", c_int),
+                ("advection_rk2_steps", c_int),
+                ("advection_rk3_steps", c_int),
+                ("advection_rk4_steps", c_int),
                 ("surface", FluidSimulationMeshStats_t),
                 ("preview", FluidSimulationMeshStats_t),
                 ("surfaceblur", FluidSimulationMeshStats_t),
@@ -0,0 +1,183 @@
+# MIT License
+# 
+# Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+# 
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+import ctypes
+import array
+from ctypes import c_void_p, c_char, c_int, c_uint, c_float
+
+from .ffengine import ffengine as lib
+from .trianglemesh import TriangleMesh
+from . import pybindings as pb
+
+MESH_CACHE_MAGIC = b'FFMC'
+PARTICLE_CACHE_MAGIC = b'FFPC'
+
+PARTICLE_CHANNEL_TYPE_POSITIONS = 0
+PARTICLE_CHANNEL_TYPE_FLOATS = 1
+PARTICLE_CHANNEL_TYPE_INTS = 2
+
+
+class MeshCacheInfo_t(ctypes.Structure):
+    _fields_ = [("num_vertices", c_int),
+                ("num_triangles", c_int),
+                ("num_channels", c_int)]
+
+
+class MeshCacheChannelInfo_t(ctypes.Structure):
+    _fields_ = [("components", c_int),
+                ("num_rows", c_int)]
+
+
+class MeshCacheParticleInfo_t(ctypes.Structure):
+    _fields_ = [("num_groups", c_int),
+                ("id_limit", c_int),
+                ("num_channels", c_int)]
+
+
+class MeshCacheParticleChannelInfo_t(ctypes.Structure):
+    _fields_ = [("type", c_int),
+                ("components", c_int)]
+
+
+def is_mesh_cache_data(data):
+    return data[:4] == MESH_CACHE_MAGIC
+
+
+def is_particle_cache_data(data):
+    return data[:4] == PARTICLE_CACHE_MAGIC
+
+
+def _to_c_data(data):
+    return (c_char * len(data)).from_buffer_copy(data)
+
+
+def _get_info(c_data, size):
+    libfunc = lib.MeshCache_get_info
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_void_p], MeshCacheInfo_t)
+    return pb.execute_lib_func(libfunc, [c_data, size])
+
+
+def get_info(data):
+    info = _get_info(_to_c_data(data), len(data))
+    return info.num_vertices, info.num_triangles, info.num_channels
+
+
+def decode_mesh(data):
+    c_data = _to_c_data(data)
+    info = _get_info(c_data, len(data))
+
+    c_vertices = (c_float * (3 * info.num_vertices))()
+    c_triangles = (c_int * (3 * info.num_triangles))()
+    libfunc = lib.MeshCache_decode_mesh
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_void_p, c_void_p, c_void_p], None)
+    pb.execute_lib_func(libfunc, [c_data, len(data), c_vertices, c_triangles])
+
+    mesh = TriangleMesh()
+    mesh.vertices.frombytes(bytes(c_vertices))
+    mesh.triangles.frombytes(bytes(c_triangles))
+    return mesh
+
+
+def decode_channel(data, channel_index=0):
+    c_data = _to_c_data(data)
+    size = len(data)
+
+    libfunc = lib.MeshCache_get_channel_info
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_int, c_void_p], MeshCacheChannelInfo_t)
+    info = pb.execute_lib_func(libfunc, [c_data, size, channel_index])
+
+    c_values = (c_float * (info.components * info.num_rows))()
+    libfunc = lib.MeshCache_decode_channel
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_int, c_void_p, c_void_p], None)
+    pb.execute_lib_func(libfunc, [c_data, size, channel_index, c_values])
+
+    values = array.array('f')
+    values.frombytes(bytes(c_values))
+    return values
+
+
+def _get_particle_info(c_data, size):
+    libfunc = lib.MeshCache_get_particle_info
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_void_p], MeshCacheParticleInfo_t)
+    return pb.execute_lib_func(libfunc, [c_data, size])
+
+
+def get_particle_info(data):
+    info = _get_particle_info(_to_c_data(data), len(data))
+    return info.num_groups, info.id_limit, info.num_channels
+
+
+def _get_particle_bin_ends(c_data, size):
+    info = _get_particle_info(c_data, size)
+    c_bin_ends = (c_uint * (info.num_groups * info.id_limit))()
+    libfunc = lib.MeshCache_get_particle_bin_ends
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_void_p, c_void_p], None)
+    pb.execute_lib_func(libfunc, [c_data, size, c_bin_ends])
+
+    bin_ends = []
+    for g in range(info.num_groups):
+        bin_ends.append(array.array('I', c_bin_ends[g * info.id_limit:(g + 1) * info.id_limit]))
+    return bin_ends
+
+
+# Returns a list of arrays where bin_ends[g][id] is the exclusive end of 
+# display ID bin 'id' in particle group g
+def get_particle_bin_ends(data):
+    return _get_particle_bin_ends(_to_c_data(data), len(data))
+
+
+# Number of particles in the first id_count ID bins of a group
+def get_particle_count(bin_ends, group, id_count):
+    id_count = max(0, min(id_count, len(bin_ends[group])))
+    return 0 if id_count == 0 else bin_ends[group][id_count - 1]
+
+
+# Decodes the first group_id_counts[g] ID bins of each particle group. Returns
+# a flat array of values and the number of components per particle.
+def decode_particle_channel(data, group_id_counts, channel_index=0, bin_ends=None):
+    c_data = _to_c_data(data)
+    size = len(data)
+
+    libfunc = lib.MeshCache_get_particle_channel_info
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_int, c_void_p], MeshCacheParticleChannelInfo_t)
+    info = pb.execute_lib_func(libfunc, [c_data, size, channel_index])
+
+    if bin_ends is None:
+        bin_ends = _get_particle_bin_ends(c_data, size)
+    num_particles = 0
+    for group, id_count in enumerate(group_id_counts):
+        num_particles += get_particle_count(bin_ends, group, id_count)
+
+    c_group_id_counts = (c_int * len(group_id_counts))(*group_id_counts)
+    if info.type == PARTICLE_CHANNEL_TYPE_INTS:
+        c_values = (c_int * (info.components * num_particles))()
+        values = array.array('i')
+    else:
+        c_values = (c_float * (info.components * num_particles))()
+        values = array.array('f')
+
+    libfunc = lib.MeshCache_decode_particle_channel
+    pb.init_lib_func(libfunc, [c_void_p, c_uint, c_int, c_void_p, c_void_p, c_void_p], None)
+    pb.execute_lib_func(libfunc, [c_data, size, channel_index, c_group_id_counts, c_values])
+
+    values.frombytes(bytes(c_values))
+    return values, info.components
@@ -32,6 +32,7 @@ SOFTWARE.
 #include "stopwatch.h"
 #include "viscositysolver.h"
 #include "particlemesher.h"
+#include "meshingboundarysdf.h"
 #include "polygonizer3d.h"
 #include "diffuseparticle.h"
 #include "particlemaskgrid.h"
@@ -300,6 +301,60 @@ void FluidSimulation::setPressureSolverMaxIterations(int n) {
     _maxPressureSolveIterations = n;
 }
 
+void FluidSimulation::enableAdaptiveMarkerParticleAdvection() {
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " enableAdaptiveMarkerParticleAdvection" << std::endl);
+
+    _isAdaptiveMarkerParticleAdvectionEnabled = true;
+}
+
+void FluidSimulation::disableAdaptiveMarkerParticleAdvection() {
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " disableAdaptiveMarkerParticleAdvection" << std::endl);
+
+    _isAdaptiveMarkerParticleAdvectionEnabled = false;
+}
+
+bool FluidSimulation::isAdaptiveMarkerParticleAdvectionEnabled() {
+    return _isAdaptiveMarkerParticleAdvectionEnabled;
+}
+
+void FluidSimulation::enableMixedPrecisionPressureSolve() {
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " enableMixedPrecisionPressureSolve" << std::endl);
+
+    _isMixedPrecisionPressureSolveEnabled = true;
+}
+
+void FluidSimulation::disableMixedPrecisionPressureSolve() {
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " disableMixedPrecisionPressureSolve" << std::endl);
+
+    _isMixedPrecisionPressureSolveEnabled = false;
+}
+
+bool FluidSimulation::isMixedPrecisionPressureSolveEnabled() {
+    return _isMixedPrecisionPressureSolveEnabled;
+}
+
+void FluidSimulation::enablePressureSolveIterativeRefinement() {
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " enablePressureSolveIterativeRefinement" << std::endl);
+
+    _isPressureSolveIterativeRefinementEnabled = true;
+}
+
+void FluidSimulation::disablePressureSolveIterativeRefinement() {
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " disablePressureSolveIterativeRefinement" << std::endl);
+
+    _isPressureSolveIterativeRefinementEnabled = false;
+}
+
+bool FluidSimulation::isPressureSolveIterativeRefinementEnabled() {
+    return _isPressureSolveIterativeRefinementEnabled;
+}
+
 int FluidSimulation::getViscositySolverMaxIterations() {
     return _maxViscositySolveIterations;
 }
@@ -483,6 +538,7 @@ void FluidSimulation::setMeshingVolume(MeshObject *volumeObject) {
 
     _meshingVolume = volumeObject;
     _isMeshingVolumeSet = true;
+    _isMeshingBoundarySDFUpToDate = false;
 }
 
 int FluidSimulation::getMinPolyhedronTriangleCount() {
@@ -545,6 +601,30 @@ void FluidSimulation::setMeshOutputFormatAsBOBJ() {
     _meshOutputFormat = TriangleMeshFormat::bobj;
 }
 
+void FluidSimulation::setMeshOutputFormatAsMeshCache() {
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " setMeshOutputFormatAsMeshCache" << std::endl);
+
+    _meshOutputFormat = TriangleMeshFormat::meshcache;
+}
+
+int FluidSimulation::getMeshCacheQuantizationBits() {
+    return _meshCacheQuantizationBits;
+}
+
+void FluidSimulation::setMeshCacheQuantizationBits(int bits) {
+    if (bits < 8 || bits > 24) {
+        std::string msg = "Error: mesh cache quantization bits must be in range [8, 24].\n";
+        msg += "bits: " + _toString(bits) + "\n";
+        throw std::domain_error(msg);
+    }
+
+    _logfile.log(std::ostringstream().flush() << 
+                 _logfile.getTime() << " setMeshCacheQuantizationBits: " << bits << std::endl);
+
+    _meshCacheQuantizationBits = bits;
+}
+
 void FluidSimulation::enableConsoleOutput() {
     _logfile.enableConsole();
 
@@ -629,6 +709,7 @@ void FluidSimulation::enableObstacleMeshingOffset() {
                  _logfile.getTime() << " enableObstacleMeshingOffset" << std::endl);
 
     _isObstacleMeshingOffsetEnabled = true;
+    _isMeshingBoundarySDFUpToDate = false;
 }
 
 void FluidSimulation::disableObstacleMeshingOffset() {
@@ -636,6 +717,7 @@ void FluidSimulation::disableObstacleMeshingOffset() {
                  _logfile.getTime() << " disableObstacleMeshingOffset" << std::endl);
 
     _isObstacleMeshingOffsetEnabled = false;
+    _isMeshingBoundarySDFUpToDate = false;
 }
 
 bool FluidSimulation::isObstacleMeshingOffsetEnabled() {
@@ -651,6 +733,7 @@ void FluidSimulation::setObstacleMeshingOffset(double s) {
                  _logfile.getTime() << " setObstacleMeshingOffset: " << s << std::endl);
 
     _obstacleMeshingOffset = s; 
+    _isMeshingBoundarySDFUpToDate = false;
 }
 
 void FluidSimulation::enableInvertedContactNormals() {
@@ -4614,107 +4697,45 @@ void FluidSimulation::_upscaleParticleData() {
     int extrapolationLayers = (int)std::ceil(std::sqrt(3) * _CFLConditionNumber) + 3;
     vfield.extrapolateVelocityField(validVelocities, extrapolationLayers);
 
-    // Compute Age Grids
+    // Compute Attribute Grids
+    MarkerParticleAttributeGrids attributeGrids;
+
     Array3d<float> ageAttributeGrid;
     Array3d<bool> ageAttributeValidGrid;
     if (isAgeDataAvailable) {
         ageAttributeGrid = Array3d<float>(isize, jsize, ksize, 0.0f);
         ageAttributeValidGrid = Array3d<bool>(isize, jsize, ksize, false);
-
-        markerParticles.getAttributeValues("POSITION", positions);
-        markerParticles.getAttributeValues("AGE", ages);
-
-        AttributeTransferParameters<float> params;
-        params.positions = positions;
-        params.attributes = ages;
-        params.attributeGrid = &ageAttributeGrid;
-        params.gridOffset = vmath::vec3(0.5 * dx, 0.5 * dx, 0.5 * dx);
-        params.validGrid = &ageAttributeValidGrid;
-        params.particleRadius = _ageAttributeRadius * dx;
-        params.dx = dx;
-
-        AttributeToGridTransfer<float> attributeTransfer;
-        attributeTransfer.transfer(params);
-
-        GridUtils::extrapolateGrid(&ageAttributeGrid, &ageAttributeValidGrid, _CFLConditionNumber);
+        attributeGrids.age = &ageAttributeGrid;
+        attributeGrids.ageValid = &ageAttributeValidGrid;
     }
 
-    // Compute Lifetime Grids
     Array3d<float> lifetimeAttributeGrid;
     Array3d<bool> lifetimeAttributeValidGrid;
     if (isLifetimeDataAvailable) {
         lifetimeAttributeGrid = Array3d<float>(isize, jsize, ksize, 0.0f);
         lifetimeAttributeValidGrid = Array3d<bool>(isize, jsize, ksize, false);
-
-        markerParticles.getAttributeValues("POSITION", positions);
-        markerParticles.getAttributeValues("LIFETIME", lifetimes);
-
-        AttributeTransferParameters<float> params;
-        params.positions = positions;
-        params.attributes = lifetimes;
-        params.attributeGrid = &lifetimeAttributeGrid;
-        params.validGrid = &lifetimeAttributeValidGrid;
-        params.gridOffset = vmath::vec3(0.5 * dx, 0.5 * dx, 0.5 * dx);
-        params.particleRadius = _lifetimeAttributeRadius * dx;
-        params.dx = dx;
-
-        AttributeToGridTransfer<float> attributeTransfer;
-        attributeTransfer.transfer(params);
-
-        GridUtils::extrapolateGrid(&lifetimeAttributeGrid, &lifetimeAttributeValidGrid, _CFLConditionNumber);
+        attributeGrids.lifetime = &lifetimeAttributeGrid;
+        attributeGrids.lifetimeValid = &lifetimeAttributeValidGrid;
     }
 
-    // Compute Viscosity Grids
     Array3d<float> viscosityAttributeGrid;
     Array3d<bool> viscosityAttributeValidGrid;
     if (isViscosityDataAvailable) {
         viscosityAttributeGrid = Array3d<float>(isize, jsize, ksize, 0.0f);
         viscosityAttributeValidGrid = Array3d<bool>(isize, jsize, ksize, false);
-
-        markerParticles.getAttributeValues("POSITION", positions);
-        markerParticles.getAttributeValues("VISCOSITY", viscosities);
-
-        AttributeTransferParameters<float> params;
-        params.positions = positions;
-        params.attributes = viscosities;
-        params.attributeGrid = &viscosityAttributeGrid;
-        params.validGrid = &viscosityAttributeValidGrid;
-        params.gridOffset = vmath::vec3(0.5 * dx, 0.5 * dx, 0.5 * dx);
-        params.particleRadius = _viscosityAttributeRadius * dx;
-        params.dx = dx;
-
-        AttributeToGridTransfer<float> attributeTransfer;
-        attributeTransfer.transfer(params);
-
-        GridUtils::extrapolateGrid(&viscosityAttributeGrid, &viscosityAttributeValidGrid, _CFLConditionNumber);
+        attributeGrids.viscosity = &viscosityAttributeGrid;
+        attributeGrids.viscosityValid = &viscosityAttributeValidGrid;
     }
 
-    // Compute Density Grids
     Array3d<float> densityAttributeGrid;
     Array3d<bool> densityAttributeValidGrid;
     if (isDensityDataAvailable) {
         densityAttributeGrid = Array3d<float>(isize, jsize, ksize, 0.0f);
         densityAttributeValidGrid = Array3d<bool>(isize, jsize, ksize, false);
-
-        markerParticles.getAttributeValues("POSITION", positions);
-        markerParticles.getAttributeValues("DENSITY", densities);
-
-        AttributeTransferParameters<float> params;
-        params.positions = positions;
-        params.attributes = densities;
-        params.attributeGrid = &densityAttributeGrid;
-        params.validGrid = &densityAttributeValidGrid;
-        params.gridOffset = vmath::vec3(0.5 * dx, 0.5 * dx, 0.5 * dx);
-        params.particleRadius = _densityAttributeRadius * dx;
-        params.dx = dx;
-
-        AttributeToGridTransfer<float> attributeTransfer;
-        attributeTransfer.transfer(params);
-
-        GridUtils::extrapolateGrid(&densityAttributeGrid, &densityAttributeValidGrid, _CFLConditionNumber);
+        attributeGrids.density = &densityAttributeGrid;
+        attributeGrids.densityValid = &densityAttributeValidGrid;
     }
 
-    // Compute Color Grids
     Array3d<float> colorAttributeGridR;
     Array3d<float> colorAttributeGridG;
     Array3d<float> colorAttributeGridB;
@@ -4724,47 +4745,17 @@ void FluidSimulation::_upscaleParticleData() {
         colorAttributeGridG = Array3d<float>(isize, jsize, ksize, 0.0f);
         colorAttributeGridB = Array3d<float>(isize, jsize, ksize, 0.0f);
         colorAttributeValidGrid = Array3d<bool>(isize, jsize, ksize, false);
-        Array3d<vmath::vec3> colorAttributeGrid(isize, jsize, ksize, vmath::vec3());
-
-        markerParticles.getAttributeValues("POSITION", positions);
-        markerParticles.getAttributeValues("COLOR", colors);
-
-        AttributeTransferParameters<vmath::vec3> params;
-        params.positions = positions;
-        params.attributes = colors;
-        params.attributeGrid = &colorAttributeGrid;
-        params.validGrid = &colorAttributeValidGrid;
-        params.gridOffset = vmath::vec3(0.5 * dx, 0.5 * dx, 0.5 * dx);
-        params.particleRadius = _colorAttributeRadius * dx;
-        params.dx = dx;
-
-        AttributeToGridTransfer<vmath::vec3> attributeTransfer;
-        attributeTransfer.transfer(params);
-
-        for (int k = 0; k < colorAttributeGrid.depth; k++) {
-            for (int j = 0; j < colorAttributeGrid.height; j++) {
-                for (int i = 0; i < colorAttributeGrid.width; i++) {
-                    vmath::vec3 color = colorAttributeGrid(i, j, k);
-                    float rval = _clamp(color.x, 0.0f, 1.0f);
-                    float gval = _clamp(color.y, 0.0f, 1.0f);
-                    float bval = _clamp(color.z, 0.0f, 1.0f);
-                    colorAttributeGridR.set(i, j, k, rval);
-                    colorAttributeGridG.set(i, j, k, gval);
-                    colorAttributeGridB.set(i, j, k, bval);
-                }
-            }
-        }
-
-        GridUtils::extrapolateGrid(&colorAttributeGridR, &colorAttributeValidGrid, _CFLConditionNumber);
-        GridUtils::extrapolateGrid(&colorAttributeGridG, &colorAttributeValidGrid, _CFLConditionNumber);
-        GridUtils::extrapolateGrid(&colorAttributeGridB, &colorAttributeValidGrid, _CFLConditionNumber);
+        attributeGrids.colorR = &colorAttributeGridR;
+        attributeGrids.colorG = &colorAttributeGridG;
+        attributeGrids.colorB = &colorAttributeGridB;
+        attributeGrids.colorValid = &colorAttributeValidGrid;
     }
 
+    _transferMarkerParticleAttributesToGrids(markerParticles, dx, attributeGrids);
+
     // Initialize New Particles
     ParticleMaskGrid maskgrid(_isize, _jsize, _ksize, _dx);
-    for (unsigned int i = 0; i < positions->size(); i++) {
-        maskgrid.addParticle(positions->at(i));
-    }
+    maskgrid.addParticles(*positions);
 
     ParticleLevelSet liquidSDF(isize, jsize, ksize, dx);
     liquidSDF.calculateSignedDistanceField(markerParticles, particleRadius);
@@ -5422,6 +5413,7 @@ void FluidSimulation::_updateSolidLevelSet(double dt) {
 
     _isSolidLevelSetUpToDate = true;
     _isWeightGridUpToDate = false;
+    _obstacleInfluenceGrid.invalidateInfluenceSources();
 
 }
 
@@ -5614,6 +5606,7 @@ void FluidSimulation::_launchUpdateLiquidLevelSetThread() {
 void FluidSimulation::_joinUpdateLiquidLevelSetThread() {
     _updateLiquidLevelSetThread.join();
     _liquidSDF.postProcessSignedDistanceField(_solidSDF);
+    _liquidCellIndex.update(_liquidSDF, 1);
 }
 
 /********************************************************************************
@@ -5629,6 +5622,9 @@ _logfile.logString(_logfile.getTime() + " BEGIN       Advect Velocity Field");
     if (_isFluidInSimulation() || _isFluidGeneratingThisFrame()) {
         _validVelocities.reset();
         _MACVelocity.clear();
+    } else {
+        // The velocity field may still be shared with the mesher thread
+        _MACVelocity.detach();
     }
 
     if (_isFluidInSimulation()) {
@@ -6033,7 +6029,6 @@ void FluidSimulation::_applyViscosityToVelocityField(double dt) {
     params.errorTolerance = _viscositySolverErrorTolerance;
     params.maxIterations = _maxViscositySolveIterations;
 
-    _viscositySolver = ViscositySolver();
     bool success = _viscositySolver.applyViscosityToVelocityField(params);
     _viscositySolverStatus = _viscositySolver.getSolverStatus();
 
@@ -6211,12 +6206,17 @@ void FluidSimulation::_pressureSolve(double dt) {
         }
         */
 
-        Array3d<float> densityGrid = Array3d<float>(_isize, _jsize, _ksize, 1.0f);
+        // Without density attributes the solver uses its constant density path
+        Array3d<float> *densityGrid = nullptr;
         if (_isSurfaceDensityAttributeEnabled || _isFluidParticleDensityAttributeEnabled) {
-            // Compute variable density grid
-            densityGrid.fill(0.0f);
-            Array3d<bool> densityValidGrid = Array3d<bool>(_isize, _jsize, _ksize, false);
-            _updateMarkerParticleDensityAttributeGrid(densityGrid, densityValidGrid);
+            if (_pressureDensityGrid.width != _isize || 
+                    _pressureDensityGrid.height != _jsize || 
+                    _pressureDensityGrid.depth != _ksize) {
+                _pressureDensityGrid = Array3d<float>(_isize, _jsize, _ksize, 0.0f);
+                _pressureDensityValidGrid = Array3d<bool>(_isize, _jsize, _ksize, false);
+            }
+            _updateMarkerParticleDensityAttributeGrid(_pressureDensityGrid, _pressureDensityValidGrid);
+            densityGrid = &_pressureDensityGrid;
         }
 
         Array3d<float> pressureGrid(_isize, _jsize, _ksize, 0.0f);
@@ -6234,7 +6234,10 @@ void FluidSimulation::_pressureSolve(double dt) {
         params.liquidSDF = _liquidSDF.getPhiGrid();
         params.weightGrid = &_weightGrid;
         params.pressureGrid = &pressureGrid;
-        params.densityGrid = &densityGrid;
+        params.densityGrid = densityGrid;
+        params.liquidCells = &_liquidCellIndex;
+        params.isMixedPrecisionEnabled = _isMixedPrecisionPressureSolveEnabled;
+        params.isIterativeRefinementEnabled = _isPressureSolveIterativeRefinementEnabled;
 
         params.isSurfaceTensionEnabled = _isSurfaceTensionEnabled;
         if (_isSurfaceTensionEnabled) {
@@ -6562,6 +6565,8 @@ void FluidSimulation::_updateSheetSeeding() {
         _markerParticles.getAttributeValues("POSITION", positions);
         _markerParticles.getAttributeValues("VELOCITY", velocities);
 
+        MarkerParticleAttributeGrids tempAttributeGrids;
+
         std::vector<float> *ages;
         Array3d<float> tempAgeAttributeGrid;
         Array3d<bool> tempAgeAttributeValidGrid;
@@ -6569,7 +6574,8 @@ void FluidSimulation::_updateSheetSeeding() {
             tempAgeAttributeGrid = _ageAttributeGrid;
             tempAgeAttributeValidGrid = _ageAttributeValidGrid;
             _markerParticles.getAttributeValues("AGE", ages);
-            _updateMarkerParticleAgeAttributeGrid(tempAgeAttributeGrid, tempAgeAttributeValidGrid);
+            tempAttributeGrids.age = &tempAgeAttributeGrid;
+            tempAttributeGrids.ageValid = &tempAgeAttributeValidGrid;
         }
 
         std::vector<float> *lifetimes;
@@ -6579,7 +6585,8 @@ void FluidSimulation::_updateSheetSeeding() {
             tempLifetimeAttributeGrid = _lifetimeAttributeGrid;
             tempLifetimeAttributeValidGrid = _lifetimeAttributeValidGrid;
             _markerParticles.getAttributeValues("LIFETIME", lifetimes);
-            _updateMarkerParticleLifetimeAttributeGrid(tempLifetimeAttributeGrid, tempLifetimeAttributeValidGrid);
+            tempAttributeGrids.lifetime = &tempLifetimeAttributeGrid;
+            tempAttributeGrids.lifetimeValid = &tempLifetimeAttributeValidGrid;
         }
 
         std::vector<float> *viscosities;
@@ -6589,7 +6596,8 @@ void FluidSimulation::_updateSheetSeeding() {
             tempViscosityAttributeGrid = _viscosityAttributeGrid;
             tempViscosityAttributeValidGrid = _viscosityAttributeValidGrid;
             _markerParticles.getAttributeValues("VISCOSITY", viscosities);
-            _updateMarkerParticleViscosityAttributeGrid(tempViscosityAttributeGrid, tempViscosityAttributeValidGrid);
+            tempAttributeGrids.viscosity = &tempViscosityAttributeGrid;
+            tempAttributeGrids.viscosityValid = &tempViscosityAttributeValidGrid;
         }
 
         std::vector<float> *densities;
@@ -6599,7 +6607,8 @@ void FluidSimulation::_updateSheetSeeding() {
             tempDensityAttributeGrid = _densityAttributeGrid;
             tempDensityAttributeValidGrid = _densityAttributeValidGrid;
             _markerParticles.getAttributeValues("DENSITY", densities);
-            _updateMarkerParticleDensityAttributeGrid(tempDensityAttributeGrid, tempDensityAttributeValidGrid);
+            tempAttributeGrids.density = &tempDensityAttributeGrid;
+            tempAttributeGrids.densityValid = &tempDensityAttributeValidGrid;
         }
 
         std::vector<uint16_t> *ids;
@@ -6623,12 +6632,14 @@ void FluidSimulation::_updateSheetSeeding() {
             tempColorAttributeGridB = _colorAttributeGridB;
             tempColorAttributeValidGrid = _colorAttributeValidGrid;
             _markerParticles.getAttributeValues("COLOR", colors);
-            _updateMarkerParticleColorAttributeGrid(tempColorAttributeGridR,
-                                                    tempColorAttributeGridG,
-                                                    tempColorAttributeGridB,
-                                                    tempColorAttributeValidGrid);
+            tempAttributeGrids.colorR = &tempColorAttributeGridR;
+            tempAttributeGrids.colorG = &tempColorAttributeGridG;
+            tempAttributeGrids.colorB = &tempColorAttributeGridB;
+            tempAttributeGrids.colorValid = &tempColorAttributeValidGrid;
         }
 
+        _transferMarkerParticleAttributesToGrids(_markerParticles, _dx, tempAttributeGrids);
+
         int idLimit = _getFluidParticleOutputIDLimit();
         float solidSheetingWidth = 2.0f * _dx;
         for (size_t i = 0; i < sheetParticles.size(); i++) {
@@ -6706,80 +6717,24 @@ void FluidSimulation::_updateSheetSeeding() {
     #. Update MarkerParticle Velocities
 ********************************************************************************/
 
-void FluidSimulation::_getIndicesAndGradientWeights(vmath::vec3 p, GridIndex indices[8], vmath::vec3 weights[8], int dir) {
-    int U = 0; int V = 1; int W = 2;
-
-    vmath::vec3 offset;
-    float h = 0.5f * _dx;
-    if (dir == U) {
-        offset = vmath::vec3(0.0f, h, h);
-    } else if (dir == V) {
-        offset = vmath::vec3(h, 0.0f, h);
-    } else if (dir == W) {
-        offset = vmath::vec3(h, h, 0.0f);
-    }
-
-    p -= offset;
-    GridIndex g = Grid3d::positionToGridIndex(p, _dx);
-    vmath::vec3 gpos = Grid3d::GridIndexToPosition(g, _dx);
-    vmath::vec3 ipos = (p - gpos) / _dx;
-
-    indices[0] = GridIndex(g.i,     g.j,     g.k);
-    indices[1] = GridIndex(g.i + 1, g.j,     g.k);
-    indices[2] = GridIndex(g.i,     g.j + 1, g.k);
-    indices[3] = GridIndex(g.i + 1, g.j + 1, g.k);
-    indices[4] = GridIndex(g.i,     g.j,     g.k + 1);
-    indices[5] = GridIndex(g.i + 1, g.j,     g.k + 1);
-    indices[6] = GridIndex(g.i,     g.j + 1, g.k + 1);
-    indices[7] = GridIndex(g.i + 1, g.j + 1, g.k + 1);
-
-    float invdx = 1.0f / _dx;
-    weights[0] = vmath::vec3(
-        -invdx * (1.0f - ipos.y) * (1.0f - ipos.z),
-        -invdx * (1.0f - ipos.x) * (1.0f - ipos.z),
-        -invdx * (1.0f - ipos.x) * (1.0f - ipos.y));
-    weights[1] = vmath::vec3(
-        invdx * (1.0f - ipos.y) * (1.0f - ipos.z),
-        ipos.x * (-invdx) * (1.0f - ipos.z),
-        ipos.x * (1.0f - ipos.y) * (-invdx));
-    weights[2] = vmath::vec3(
-        (-invdx) * ipos.y * (1.0f - ipos.z),
-        (1.0f - ipos.x) * invdx * (1.0f - ipos.z),
-        (1.0f - ipos.x) * ipos.y * (-invdx));
-    weights[3] = vmath::vec3(
-        invdx * ipos.y * (1.0f - ipos.z),
-        ipos.x * invdx * (1.0f - ipos.z),
-        ipos.x * ipos.y * (-invdx));
-    weights[4] = vmath::vec3(
-        (-invdx) * (1.0f - ipos.y) * ipos.z,
-        (1.0f - ipos.x) * (-invdx) * ipos.z,
-        (1.0f - ipos.x) * (1.0f - ipos.y) * invdx);
-    weights[5] = vmath::vec3(
-        invdx * (1.0f - ipos.y) * ipos.z,
-        ipos.x * (-invdx) * ipos.z,
-        ipos.x * (1.0f - ipos.y) * invdx);
-    weights[6] = vmath::vec3(
-        (-invdx) * ipos.y * ipos.z,
-        (1.0f - ipos.x) * invdx * ipos.z,
-        (1.0f - ipos.x) * ipos.y * invdx);
-    weights[7] = vmath::vec3(
-        invdx * ipos.y * ipos.z,
-        ipos.x * invdx * ipos.z,
-        ipos.x * ipos.y * invdx);
-}
-
 void FluidSimulation::_updatePICFLIPMarkerParticleVelocitiesThread(int startidx, int endidx) {
     std::vector<vmath::vec3> *positions, *velocities;
     _markerParticles.getAttributeValues("POSITION", positions);
     _markerParticles.getAttributeValues("VELOCITY", velocities);
 
-    for (int i = startidx; i < endidx; i++) {
-        vmath::vec3 pos = positions->at(i);
-        vmath::vec3 vel = velocities->at(i);
-        vmath::vec3 vPIC = _MACVelocity.evaluateVelocityAtPositionLinear(pos);
-        vmath::vec3 vFLIP = vel + vPIC - _savedVelocityField.evaluateVelocityAtPositionLinear(pos);
+    int count = endidx - startidx;
+    std::vector<vmath::vec3> velocitiesPIC(count);
+    std::vector<vmath::vec3> velocitiesSaved(count);
+    vmath::vec3 *rangePositions = positions->data() + startidx;
+    _MACVelocity.evaluateVelocityAtPositionsLinear(rangePositions, count, velocitiesPIC.data());
+    _savedVelocityField.evaluateVelocityAtPositionsLinear(rangePositions, count, velocitiesSaved.data());
+
+    for (int i = 0; i < count; i++) {
+        vmath::vec3 vel = velocities->at(startidx + i);
+        vmath::vec3 vPIC = velocitiesPIC[i];
+        vmath::vec3 vFLIP = vel + vPIC - velocitiesSaved[i];
         vmath::vec3 v = (float)_ratioPICFLIP * vPIC + (float)(1 - _ratioPICFLIP) * vFLIP;
-        velocities->at(i) = v;
+        velocities->at(startidx + i) = v;
     }
 }
 
@@ -6797,49 +6752,14 @@ void FluidSimulation::_updatePICAPICMarkerParticleVelocitiesThread(int startidx,
     _markerParticles.getAttributeValues("AFFINEY", affineValuesY);
     _markerParticles.getAttributeValues("AFFINEZ", affineValuesZ);
 
-    int U = 0; int V = 1; int W = 2; 
-
-    GridIndex indices[8];
-    vmath::vec3 weights[8];
-    for (int i = startidx; i < endidx; i++) {
-        vmath::vec3 pos = positions->at(i);
-
-        vmath::vec3 affineX;
-        vmath::vec3 affineY;
-        vmath::vec3 affineZ;
-        
-        _getIndicesAndGradientWeights(pos, indices, weights, U);
-        for (int gidx = 0; gidx < 8; gidx++) {
-            GridIndex g = indices[gidx];
-            if (!_MACVelocity.isIndexInRangeU(g)) {
-                continue;
-            }
-            affineX += weights[gidx] * _MACVelocity.U(g);
-        }
-
-        _getIndicesAndGradientWeights(pos, indices, weights, V);
-        for (int gidx = 0; gidx < 8; gidx++) {
-            GridIndex g = indices[gidx];
-            if (!_MACVelocity.isIndexInRangeV(g)) {
-                continue;
-            }
-            affineY += weights[gidx] * _MACVelocity.V(g);
-        }
-
-        _getIndicesAndGradientWeights(pos, indices, weights, W);
-        for (int gidx = 0; gidx < 8; gidx++) {
-            GridIndex g = indices[gidx];
-            if (!_MACVelocity.isIndexInRangeW(g)) {
-                continue;
-            }
-            affineZ += weights[gidx] * _MACVelocity.W(g);
-        }
-
-        velocities->at(i) = _MACVelocity.evaluateVelocityAtPositionLinear(pos);
-        affineValuesX->at(i) = affineX;
-        affineValuesY->at(i) = affineY;
-        affineValuesZ->at(i) = affineZ;
-    }
+    // The affine values are the gradients of each velocity component
+    _MACVelocity.evaluateVelocityAndGradientsAtPositionsLinear(
+            positions->data() + startidx, endidx - startidx, 
+            velocities->data() + startidx,
+            affineValuesX->data() + startidx,
+            affineValuesY->data() + startidx,
+            affineValuesZ->data() + startidx
+            );
 }
 
 void FluidSimulation::_updateMarkerParticleVelocitiesThread() {
@@ -6887,7 +6807,6 @@ void FluidSimulation::_constrainMarkerParticleVelocities(MeshFluidSource *inflow
         _markerParticles.getAttributeValues("POSITION", positions);
         _markerParticles.getAttributeValues("VELOCITY", velocities);
 
-        MeshLevelSet *inflowSDF = inflow->getMeshLevelSet();
         vmath::vec3 v = inflow->getVelocity();
         RigidBodyVelocity rv = inflow->getRigidBodyVelocity(_currentFrameDeltaTime);
         VelocityFieldData *vdata = inflow->getVelocityFieldData();
@@ -6898,7 +6817,7 @@ void FluidSimulation::_constrainMarkerParticleVelocities(MeshFluidSource *inflow
                 continue;
             }
 
-            if (inflowSDF->trilinearInterpolate(p) > 0.0f) {
+            if (inflow->trilinearInterpolate(p) > 0.0f) {
                 continue;
             }
 
@@ -6988,56 +6907,140 @@ void FluidSimulation::_updateMarkerParticleVorticityAttributeGrid() {
     }
 }
 
-void FluidSimulation::_updateMarkerParticleAgeAttributeGrid(Array3d<float> &ageAttributeGrid,
-                                                            Array3d<bool> &ageAttributeValidGrid) {
-    ageAttributeGrid.fill(0.0f);
-    ageAttributeValidGrid.fill(false);
-
+void FluidSimulation::_transferMarkerParticleAttributesToGrids(ParticleSystem &particles, double dx,
+                                                               MarkerParticleAttributeGrids &grids) {
     std::vector<vmath::vec3> *positions;
+    particles.getAttributeValues("POSITION", positions);
+
+    MultiAttributeToGridTransfer attributeTransfer;
+
     std::vector<float> *ages;
-    _markerParticles.getAttributeValues("POSITION", positions);
-    _markerParticles.getAttributeValues("AGE", ages);
-    float radius = _ageAttributeRadius * _dx;
+    if (grids.age != nullptr) {
+        grids.age->fill(0.0f);
+        grids.ageValid->fill(false);
+        particles.getAttributeValues("AGE", ages);
+        attributeTransfer.addChannel(ages, grids.age, grids.ageValid, _ageAttributeRadius * dx);
+    }
 
-    AttributeTransferParameters<float> params;
-    params.positions = positions;
-    params.attributes = ages;
-    params.attributeGrid = &ageAttributeGrid;
-    params.validGrid = &ageAttributeValidGrid;
-    params.gridOffset = vmath::vec3(0.5 * _dx, 0.5 * _dx, 0.5 * _dx);
-    params.particleRadius = radius;
-    params.dx = _dx;
+    std::vector<float> *lifetimes;
+    if (grids.lifetime != nullptr) {
+        grids.lifetime->fill(0.0f);
+        grids.lifetimeValid->fill(false);
+        particles.getAttributeValues("LIFETIME", lifetimes);
+        attributeTransfer.addChannel(lifetimes, grids.lifetime, grids.lifetimeValid, _lifetimeAttributeRadius * dx);
+    }
 
-    AttributeToGridTransfer<float> attributeTransfer;
-    attributeTransfer.transfer(params);
+    std::vector<float> *viscosities;
+    if (grids.viscosity != nullptr) {
+        grids.viscosity->fill(0.0f);
+        grids.viscosityValid->fill(false);
+        particles.getAttributeValues("VISCOSITY", viscosities);
+        attributeTransfer.addChannel(viscosities, grids.viscosity, grids.viscosityValid, _viscosityAttributeRadius * dx);
+    }
+
+    std::vector<float> *densities;
+    if (grids.density != nullptr) {
+        grids.density->fill(0.0f);
+        grids.densityValid->fill(false);
+        particles.getAttributeValues("DENSITY", densities);
+        attributeTransfer.addChannel(densities, grids.density, grids.densityValid, _densityAttributeRadius * dx);
+    }
 
-    GridUtils::extrapolateGrid(&ageAttributeGrid, &ageAttributeValidGrid, _CFLConditionNumber);
+    std::vector<vmath::vec3> *colors;
+    Array3d<vmath::vec3> colorAttributeGrid;
+    if (grids.colorR != nullptr) {
+        grids.colorR->fill(0.0f);
+        grids.colorG->fill(0.0f);
+        grids.colorB->fill(0.0f);
+        grids.colorValid->fill(false);
+        colorAttributeGrid = Array3d<vmath::vec3>(grids.colorR->width, 
+                                                  grids.colorR->height, 
+                                                  grids.colorR->depth, 
+                                                  vmath::vec3());
+        particles.getAttributeValues("COLOR", colors);
+        attributeTransfer.addChannel(colors, &colorAttributeGrid, grids.colorValid, _colorAttributeRadius * dx);
+    }
+
+    if (attributeTransfer.getNumChannels() == 0) {
+        return;
+    }
+
+    vmath::vec3 gridOffset(0.5 * dx, 0.5 * dx, 0.5 * dx);
+    attributeTransfer.transfer(positions, gridOffset, dx);
+
+    if (grids.age != nullptr) {
+        GridUtils::extrapolateGrid(grids.age, grids.ageValid, _CFLConditionNumber);
+    }
+
+    if (grids.lifetime != nullptr) {
+        GridUtils::extrapolateGrid(grids.lifetime, grids.lifetimeValid, _CFLConditionNumber);
+    }
+
+    if (grids.viscosity != nullptr) {
+        GridUtils::extrapolateGrid(grids.viscosity, grids.viscosityValid, _CFLConditionNumber);
+    }
+
+    if (grids.density != nullptr) {
+        GridUtils::extrapolateGrid(grids.density, grids.densityValid, _CFLConditionNumber);
+    }
+
+    if (grids.colorR != nullptr) {
+        for (int k = 0; k < colorAttributeGrid.depth; k++) {
+            for (int j = 0; j < colorAttributeGrid.height; j++) {
+                for (int i = 0; i < colorAttributeGrid.width; i++) {
+                    vmath::vec3 color = colorAttributeGrid(i, j, k);
+                    float rval = _clamp(color.x, 0.0f, 1.0f);
+                    float gval = _clamp(color.y, 0.0f, 1.0f);
+                    float bval = _clamp(color.z, 0.0f, 1.0f);
+                    grids.colorR->set(i, j, k, rval);
+                    grids.colorG->set(i, j, k, gval);
+                    grids.colorB->set(i, j, k, bval);
+                }
+            }
+        }
+
+        GridUtils::extrapolateGrid(grids.colorR, grids.colorValid, _CFLConditionNumber);
+        GridUtils::extrapolateGrid(grids.colorG, grids.colorValid, _CFLConditionNumber);
+        GridUtils::extrapolateGrid(grids.colorB, grids.colorValid, _CFLConditionNumber);
+    }
 }
 
-void FluidSimulation::_updateMarkerParticleLifetimeAttributeGrid(Array3d<float> &lifetimeAttributeGrid,
-                                                                 Array3d<bool> &lifetimeAttributeValidGrid) {
-    lifetimeAttributeGrid.fill(0.0f);
-    lifetimeAttributeValidGrid.fill(false);
+void FluidSimulation::_updateMarkerParticleAttributeGrids() {
+    if (_currentFrameTimeStepNumber != 0) {
+        return;
+    }
 
-    std::vector<vmath::vec3> *positions;
-    std::vector<float> *lifetimes;
-    _markerParticles.getAttributeValues("POSITION", positions);
-    _markerParticles.getAttributeValues("LIFETIME", lifetimes);
-    float radius = _lifetimeAttributeRadius * _dx;
+    // The age, lifetime, and color grids are only needed for the surface 
+    // attributes
+    MarkerParticleAttributeGrids grids;
+    if (_isSurfaceAgeAttributeEnabled) {
+        grids.age = &_ageAttributeGrid;
+        grids.ageValid = &_ageAttributeValidGrid;
+    }
 
-    AttributeTransferParameters<float> params;
-    params.positions = positions;
-    params.attributes = lifetimes;
-    params.attributeGrid = &lifetimeAttributeGrid;
-    params.validGrid = &lifetimeAttributeValidGrid;
-    params.gridOffset = vmath::vec3(0.5 * _dx, 0.5 * _dx, 0.5 * _dx);
-    params.particleRadius = radius;
-    params.dx = _dx;
+    if (_isSurfaceLifetimeAttributeEnabled) {
+        grids.lifetime = &_lifetimeAttributeGrid;
+        grids.lifetimeValid = &_lifetimeAttributeValidGrid;
+    }
 
-    AttributeToGridTransfer<float> attributeTransfer;
-    attributeTransfer.transfer(params);
+    if (_isSurfaceSourceViscosityAttributeEnabled) {
+        grids.viscosity = &_viscosityAttributeGrid;
+        grids.viscosityValid = &_viscosityAttributeValidGrid;
+    }
+
+    if (_isSurfaceDensityAttributeEnabled || _isFluidParticleDensityAttributeEnabled) {
+        grids.density = &_densityAttributeGrid;
+        grids.densityValid = &_densityAttributeValidGrid;
+    }
+
+    if (_isSurfaceSourceColorAttributeEnabled) {
+        grids.colorR = &_colorAttributeGridR;
+        grids.colorG = &_colorAttributeGridG;
+        grids.colorB = &_colorAttributeGridB;
+        grids.colorValid = &_colorAttributeValidGrid;
+    }
 
-    GridUtils::extrapolateGrid(&lifetimeAttributeGrid, &lifetimeAttributeValidGrid, _CFLConditionNumber);
+    _transferMarkerParticleAttributesToGrids(_markerParticles, _dx, grids);
 }
 
 void FluidSimulation::_updateMarkerParticleWhitewaterProximityAttributeGrid(Array3d<vmath::vec3> &whitewaterProximityAttributeGrid,
@@ -7088,104 +7091,12 @@ void FluidSimulation::_updateMarkerParticleWhitewaterProximityAttributeGrid(Arra
     GridUtils::extrapolateGrid(&whitewaterProximityAttributeGrid, &whitewaterProximityAttributeValidGrid, _CFLConditionNumber);
 }
 
-void FluidSimulation::_updateMarkerParticleViscosityAttributeGrid(Array3d<float> &viscosityAttributeGrid,
-                                                                  Array3d<bool> &viscosityAttributeValidGrid) {
-    viscosityAttributeGrid.fill(0.0f);
-    viscosityAttributeValidGrid.fill(false);
-
-    std::vector<vmath::vec3> *positions;
-    std::vector<float> *viscosities;
-    _markerParticles.getAttributeValues("POSITION", positions);
-    _markerParticles.getAttributeValues("VISCOSITY", viscosities);
-    float radius = _viscosityAttributeRadius * _dx;
-
-    AttributeTransferParameters<float> params;
-    params.positions = positions;
-    params.attributes = viscosities;
-    params.attributeGrid = &viscosityAttributeGrid;
-    params.validGrid = &viscosityAttributeValidGrid;
-    params.gridOffset = vmath::vec3(0.5 * _dx, 0.5 * _dx, 0.5 * _dx);
-    params.particleRadius = radius;
-    params.dx = _dx;
-
-    AttributeToGridTransfer<float> attributeTransfer;
-    attributeTransfer.transfer(params);
-
-    GridUtils::extrapolateGrid(&viscosityAttributeGrid, &viscosityAttributeValidGrid, _CFLConditionNumber);
-}
-
 void FluidSimulation::_updateMarkerParticleDensityAttributeGrid(Array3d<float> &densityAttributeGrid,
                                                                 Array3d<bool> &densityAttributeValidGrid) {
-    densityAttributeGrid.fill(0.0f);
-    densityAttributeValidGrid.fill(false);
-
-    std::vector<vmath::vec3> *positions;
-    std::vector<float> *densities;
-    _markerParticles.getAttributeValues("POSITION", positions);
-    _markerParticles.getAttributeValues("DENSITY", densities);
-    float radius = _densityAttributeRadius * _dx;
-
-    AttributeTransferParameters<float> params;
-    params.positions = positions;
-    params.attributes = densities;
-    params.attributeGrid = &densityAttributeGrid;
-    params.validGrid = &densityAttributeValidGrid;
-    params.gridOffset = vmath::vec3(0.5 * _dx, 0.5 * _dx, 0.5 * _dx);
-    params.particleRadius = radius;
-    params.dx = _dx;
-
-    AttributeToGridTransfer<float> attributeTransfer;
-    attributeTransfer.transfer(params);
-
-    GridUtils::extrapolateGrid(&densityAttributeGrid, &densityAttributeValidGrid, _CFLConditionNumber);
-}
-
-void FluidSimulation::_updateMarkerParticleColorAttributeGrid(Array3d<float> &colorAttributeGridR,
-                                                              Array3d<float> &colorAttributeGridG,
-                                                              Array3d<float> &colorAttributeGridB,
-                                                              Array3d<bool> &colorAttributeValidGrid) {
-    colorAttributeGridR.fill(0.0f);
-    colorAttributeGridG.fill(0.0f);
-    colorAttributeGridB.fill(0.0f);
-    colorAttributeValidGrid.fill(false);
-
-    Array3d<vmath::vec3> colorAttributeGrid(_isize, _jsize, _ksize, vmath::vec3());
-
-    std::vector<vmath::vec3> *positions;
-    std::vector<vmath::vec3> *colors;
-    _markerParticles.getAttributeValues("POSITION", positions);
-    _markerParticles.getAttributeValues("COLOR", colors);
-    float radius = _colorAttributeRadius * _dx;
-
-    AttributeTransferParameters<vmath::vec3> params;
-    params.positions = positions;
-    params.attributes = colors;
-    params.attributeGrid = &colorAttributeGrid;
-    params.validGrid = &colorAttributeValidGrid;
-    params.gridOffset = vmath::vec3(0.5 * _dx, 0.5 * _dx, 0.5 * _dx);
-    params.particleRadius = radius;
-    params.dx = _dx;
-
-    AttributeToGridTransfer<vmath::vec3> attributeTransfer;
-    attributeTransfer.transfer(params);
-
-    for (int k = 0; k < _ksize; k++) {
-        for (int j = 0; j < _jsize; j++) {
-            for (int i = 0; i < _isize; i++) {
-                vmath::vec3 color = colorAttributeGrid(i, j, k);
-                float rval = _clamp(color.x, 0.0f, 1.0f);
-                float gval = _clamp(color.y, 0.0f, 1.0f);
-                float bval = _clamp(color.z, 0.0f, 1.0f);
-                colorAttributeGridR.set(i, j, k, rval);
-                colorAttributeGridG.set(i, j, k, gval);
-                colorAttributeGridB.set(i, j, k, bval);
-            }
-        }
-    }
-
-    GridUtils::extrapolateGrid(&colorAttributeGridR, &colorAttributeValidGrid, _CFLConditionNumber);
-    GridUtils::extrapolateGrid(&colorAttributeGridG, &colorAttributeValidGrid, _CFLConditionNumber);
-    GridUtils::extrapolateGrid(&colorAttributeGridB, &colorAttributeValidGrid, _CFLConditionNumber);
+    MarkerParticleAttributeGrids grids;
+    grids.density = &densityAttributeGrid;
+    grids.densityValid = &densityAttributeValidGrid;
+    _transferMarkerParticleAttributesToGrids(_markerParticles, _dx, grids);
 }
 
 void FluidSimulation::_updateMarkerParticleColorAttributeMixing(double dt) {
@@ -7203,11 +7114,17 @@ void FluidSimulation::_updateMarkerParticleColorAttributeMixing(double dt) {
     _markerParticles.getAttributeValues("POSITION", positions);
     _markerParticles.getAttributeValues("COLOR", colors);
 
-    SpatialPointGrid pointGrid(_isize, _jsize, _ksize, _dx);
-    pointGrid.insert(*(positions));
+    // The point grid is kept between substeps so that its buffers are reused
+    int pi, pj, pk;
+    _colorAttributeMixingPointGrid.getGridDimensions(&pi, &pj, &pk);
+    if (pi != _isize || pj != _jsize || pk != _ksize) {
+        _colorAttributeMixingPointGrid = SpatialPointGrid(_isize, _jsize, _ksize, _dx);
+    }
+    SpatialPointGrid *pointGrid = &_colorAttributeMixingPointGrid;
+    pointGrid->insert(*(positions));
 
     std::vector<vmath::vec3> colorsNew(colors->size(), vmath::vec3(0.0f, 0.0f, 0.0f));
-    std::vector<bool> colorsNewValid(colors->size(), false);
+    std::vector<char> colorsNewValid(colors->size(), false);
 
     int numCPU = ThreadUtils::getMaxThreadCount();
     int numthreads = (int)fmin(numCPU, positions->size());
@@ -7215,7 +7132,7 @@ void FluidSimulation::_updateMarkerParticleColorAttributeMixing(double dt) {
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, positions->size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&FluidSimulation::_updateMarkerParticleColorAttributeMixingThread, this,
-                                 intervals[i], intervals[i + 1], dt, &pointGrid,
+                                 intervals[i], intervals[i + 1], dt, pointGrid,
                                  colors, &colorsNew, &colorsNewValid);
     }
 
@@ -7339,63 +7256,63 @@ void FluidSimulation::_updateMarkerParticleColorAttributeMixingThread(int starti
                                                                       SpatialPointGrid *pointGrid,
                                                                       std::vector<vmath::vec3> *colors,
                                                                       std::vector<vmath::vec3> *colorsNew,
-                                                                      std::vector<bool> *colorsNewValid) {
+                                                                      std::vector<char> *colorsNewValid) {
     float mixRate = std::min(_colorAttributeMixingRate * dt, 1.0);
     float searchRadius = _colorAttributeMixingRadius * _dx;
 
+    std::vector<int> offsets;
     std::vector<GridPointReference> refs;
-    if (_isMixboxEnabled) {
-        // Mixbox Blending
-        for (int i = startidx; i < endidx; i++) {
-            GridPointReference ref(i);
-        
-            refs.clear();
-            pointGrid->queryPointReferencesInsideSphere(ref, searchRadius, refs);
-
-            if (refs.empty()) {
-                continue;
-            }
+    for (int batchstart = startidx; batchstart < endidx; batchstart += _colorAttributeMixingQueryBatchSize) {
+        int batchend = std::min(batchstart + _colorAttributeMixingQueryBatchSize, endidx);
+        pointGrid->queryPointReferencesInsideSphere(batchstart, batchend, searchRadius, offsets, refs);
+
+        if (_isMixboxEnabled) {
+            // Mixbox Blending
+            for (int i = batchstart; i < batchend; i++) {
+                int refstart = offsets[i - batchstart];
+                int refend = offsets[i - batchstart + 1];
+                if (refstart == refend) {
+                    continue;
+                }
 
-            vmath::vec3 colorOld = colors->at(i);
-            vmath::vec3 c0 = colors->at(refs[0].id);
-            float r = c0.x;
-            float g = c0.y;
-            float b = c0.z;
-            for (size_t ridx = 1; ridx < refs.size(); ridx++) {
-                vmath::vec3 ci = colors->at(refs[ridx].id);
-                float t = 1.0f / ((float)(ridx + 1));
-                mixbox_lerp_srgb32f(r, g, b, ci.x, ci.y, ci.z, t, &r,&g,&b);
-            }
+                vmath::vec3 colorOld = colors->at(i);
+                vmath::vec3 c0 = colors->at(refs[refstart].id);
+                float r = c0.x;
+                float g = c0.y;
+                float b = c0.z;
+                for (int ridx = refstart + 1; ridx < refend; ridx++) {
+                    vmath::vec3 ci = colors->at(refs[ridx].id);
+                    float t = 1.0f / ((float)(ridx - refstart + 1));
+                    mixbox_lerp_srgb32f(r, g, b, ci.x, ci.y, ci.z, t, &r,&g,&b);
+                }
 
-            if (refs.size() > 0) {
                 mixbox_lerp_srgb32f(colorOld.x, colorOld.y, colorOld.z, r, g, b, mixRate, &r,&g,&b);
                 vmath::vec3 colorNew(r, g, b);
                 colorsNew->at(i) = colorNew;
                 colorsNewValid->at(i) = true;
             }
-        }
 
-    } else {
-        // RGB Additive Blending
-        for (int i = startidx; i < endidx; i++) {
-            GridPointReference ref(i);
-            
-            refs.clear();
-            pointGrid->queryPointReferencesInsideSphere(ref, searchRadius, refs);
+        } else {
+            // RGB Additive Blending
+            for (int i = batchstart; i < batchend; i++) {
+                int refstart = offsets[i - batchstart];
+                int refend = offsets[i - batchstart + 1];
+                if (refstart == refend) {
+                    continue;
+                }
 
-            vmath::vec3 colorNew;
-            for (size_t ridx = 0; ridx < refs.size(); ridx++) {
-                colorNew += colors->at(refs[ridx].id);
-            }
+                vmath::vec3 colorNew;
+                for (int ridx = refstart; ridx < refend; ridx++) {
+                    colorNew += colors->at(refs[ridx].id);
+                }
 
-            if (refs.size() > 0) {
-                colorNew /= refs.size();
+                colorNew /= (float)(refend - refstart);
                 vmath::vec3 colorOld = colors->at(i);
                 colorsNew->at(i) = (1.0f - mixRate) * colorOld + mixRate * colorNew;
                 colorsNewValid->at(i) = true;
             }
-        }
 
+        }
     }
 
 }
@@ -7428,11 +7345,6 @@ void FluidSimulation::_updateMarkerParticleAgeAttribute(double dt) {
         return;
     }
 
-    if (_currentFrameTimeStepNumber == 0 && _isSurfaceAgeAttributeEnabled) {
-        // Only needed for the surface attribute
-        _updateMarkerParticleAgeAttributeGrid(_ageAttributeGrid, _ageAttributeValidGrid);
-    }
-
     std::vector<float> *ages;
     _markerParticles.getAttributeValues("AGE", ages);
     for (size_t i = 0; i < ages->size(); i++) {
@@ -7445,11 +7357,6 @@ void FluidSimulation::_updateMarkerParticleLifetimeAttribute(double dt) {
         return;
     }
 
-    if (_currentFrameTimeStepNumber == 0 && _isSurfaceLifetimeAttributeEnabled) {
-        // Only needed for the lifetime attribute
-        _updateMarkerParticleLifetimeAttributeGrid(_lifetimeAttributeGrid, _lifetimeAttributeValidGrid);
-    }
-
     std::vector<float> *lifetimes;
     _markerParticles.getAttributeValues("LIFETIME", lifetimes);
     for (size_t i = 0; i < lifetimes->size(); i++) {
@@ -7470,39 +7377,11 @@ void FluidSimulation::_updateMarkerParticleWhitewaterProximityAttribute() {
     }
 }
 
-void FluidSimulation::_updateMarkerParticleViscosityAttribute() {
-    if (!_isSurfaceSourceViscosityAttributeEnabled) {
+void FluidSimulation::_updateMarkerParticleColorAttribute(double dt) {
+    if (!_isSurfaceSourceColorAttributeEnabled && !_isFluidParticleSourceColorAttributeEnabled) {
         return;
     }
 
-    if (_currentFrameTimeStepNumber == 0) {
-        _updateMarkerParticleViscosityAttributeGrid(_viscosityAttributeGrid, _viscosityAttributeValidGrid);
-    }
-}
-
-void FluidSimulation::_updateMarkerParticleDensityAttribute() {
-    if (!_isSurfaceDensityAttributeEnabled && !_isFluidParticleDensityAttributeEnabled) {
-        return;
-    }
-
-    if (_currentFrameTimeStepNumber == 0) {
-        _updateMarkerParticleDensityAttributeGrid(_densityAttributeGrid, _densityAttributeValidGrid);
-    }
-}
-
-void FluidSimulation::_updateMarkerParticleColorAttribute(double dt) {
-    if (!_isSurfaceSourceColorAttributeEnabled && !_isFluidParticleSourceColorAttributeEnabled) {
-        return;
-    }
-
-    if (_currentFrameTimeStepNumber == 0 && _isSurfaceSourceColorAttributeEnabled) {
-        // Only needed for the surface attribute
-        _updateMarkerParticleColorAttributeGrid(_colorAttributeGridR, 
-                                                _colorAttributeGridG, 
-                                                _colorAttributeGridB,
-                                                _colorAttributeValidGrid);
-    }
-
     _updateMarkerParticleColorAttributeMixing(dt);
 }
 
@@ -7594,11 +7473,10 @@ void FluidSimulation::_updateMarkerParticleAttributes(double dt) {
 
     if (_isFluidInSimulation()) {
         _updateMarkerParticleVelocityBasedAttributes();
+        _updateMarkerParticleAttributeGrids();
         _updateMarkerParticleAgeAttribute(dt);
         _updateMarkerParticleLifetimeAttribute(dt);
         _updateMarkerParticleWhitewaterProximityAttribute();
-        _updateMarkerParticleViscosityAttribute();
-        _updateMarkerParticleDensityAttribute();
         _updateMarkerParticleColorAttribute(dt);
         _updateMarkerParticleUIDAttribute();
     }
@@ -7613,20 +7491,152 @@ void FluidSimulation::_updateMarkerParticleAttributes(double dt) {
     #. Advance MarkerParticles
 ********************************************************************************/
 
-vmath::vec3 FluidSimulation::_RK3(vmath::vec3 p0, double dt) {
-    vmath::vec3 k1 = _MACVelocity.evaluateVelocityAtPositionLinear(p0);
-    vmath::vec3 k2 = _MACVelocity.evaluateVelocityAtPositionLinear(p0 + (float)(0.5*dt)*k1);
-    vmath::vec3 k3 = _MACVelocity.evaluateVelocityAtPositionLinear(p0 + (float)(0.75*dt)*k2);
-    vmath::vec3 p1 = p0 + (float)(dt/9.0f)*(2.0f*k1 + 3.0f*k2 + 4.0f*k3);
+void FluidSimulation::_RK3(vmath::vec3 *positions, int numPositions, double dt, 
+                           vmath::vec3 *output) {
+    std::vector<vmath::vec3> k1(numPositions);
+    std::vector<vmath::vec3> k2(numPositions);
+    std::vector<vmath::vec3> k3(numPositions);
+
+    _MACVelocity.evaluateVelocityAtPositionsLinear(positions, numPositions, k1.data());
+    for (int i = 0; i < numPositions; i++) {
+        k2[i] = positions[i] + (float)(0.5*dt)*k1[i];
+    }
+
+    _MACVelocity.evaluateVelocityAtPositionsLinear(k2.data(), numPositions, k2.data());
+    for (int i = 0; i < numPositions; i++) {
+        k3[i] = positions[i] + (float)(0.75*dt)*k2[i];
+    }
+
+    _MACVelocity.evaluateVelocityAtPositionsLinear(k3.data(), numPositions, k3.data());
+    for (int i = 0; i < numPositions; i++) {
+        output[i] = positions[i] + (float)(dt/9.0f)*(2.0f*k1[i] + 3.0f*k2[i] + 4.0f*k3[i]);
+    }
+}
+
+/*
+    Local truncation error estimates in grid cells for a particle moving 
+    c = |v|dt/dx cells through a field deforming by s = |grad v|dt per step:
+        Euler: c*s/2
+        RK2:   c*s^2/6
+*/
+int FluidSimulation::_getAdvectionIntegratorOrder(vmath::vec3 p, vmath::vec3 v, 
+                                                  vmath::vec3 gradU, vmath::vec3 gradV, vmath::vec3 gradW, 
+                                                  double dt) {
+    double shear = dt * sqrt(vmath::dot(gradU, gradU) + 
+                             vmath::dot(gradV, gradV) + 
+                             vmath::dot(gradW, gradW));
+
+    GridIndex g = Grid3d::positionToGridIndex(p, _nearSolidGridCellSize);
+    bool isNearSolid = !_nearSolidGrid.isIndexInRange(g) || _nearSolidGrid(g);
+    if (shear > _adaptiveAdvectionShearLimit) {
+        return 4;
+    }
+    if (isNearSolid) {
+        return 3;
+    }
+
+    double cfl = vmath::length(v) * dt / _dx;
+    if (0.5 * cfl * shear < _adaptiveAdvectionErrorTolerance) {
+        return 1;
+    }
+    if (cfl * shear * shear / 6.0 < _adaptiveAdvectionErrorTolerance) {
+        return 2;
+    }
+
+    return 3;
+}
+
+void FluidSimulation::_evaluateAdvectionStage(std::vector<int> &indices, 
+                                              std::vector<vmath::vec3> &stagePositions,
+                                              std::vector<vmath::vec3> &k) {
+    _MACVelocity.evaluateVelocityAtPositionsLinear(stagePositions, stagePositions);
+    for (size_t i = 0; i < indices.size(); i++) {
+        k[indices[i]] = stagePositions[i];
+    }
+
+    indices.clear();
+    stagePositions.clear();
+}
+
+void FluidSimulation::_adaptiveRK(vmath::vec3 *positions, int numPositions, double dt, 
+                                  vmath::vec3 *output, AdvectionIntegratorCounts *counts) {
+    std::vector<vmath::vec3> k1(numPositions);
+    std::vector<vmath::vec3> k2(numPositions);
+    std::vector<vmath::vec3> k3(numPositions);
+    std::vector<vmath::vec3> k4(numPositions);
+    std::vector<vmath::vec3> gradU(numPositions);
+    std::vector<vmath::vec3> gradV(numPositions);
+    std::vector<vmath::vec3> gradW(numPositions);
+    _MACVelocity.evaluateVelocityAndGradientsAtPositionsLinear(
+            positions, numPositions, k1.data(), gradU.data(), gradV.data(), gradW.data()
+            );
+
+    std::vector<char> orders(numPositions);
+    for (int i = 0; i < numPositions; i++) {
+        orders[i] = (char)_getAdvectionIntegratorOrder(positions[i], k1[i], gradU[i], gradV[i], gradW[i], dt);
+    }
+
+    // Each stage is evaluated only for the particles whose integrator needs it
+    float hdt = (float)(0.5 * dt);
+    std::vector<int> indices;
+    std::vector<vmath::vec3> stagePositions;
+    for (int i = 0; i < numPositions; i++) {
+        if (orders[i] >= 2) {
+            indices.push_back(i);
+            stagePositions.push_back(positions[i] + hdt * k1[i]);
+        }
+    }
+    _evaluateAdvectionStage(indices, stagePositions, k2);
 
-    return p1;
+    for (int i = 0; i < numPositions; i++) {
+        if (orders[i] == 3) {
+            indices.push_back(i);
+            stagePositions.push_back(positions[i] + (float)(0.75 * dt) * k2[i]);
+        } else if (orders[i] == 4) {
+            indices.push_back(i);
+            stagePositions.push_back(positions[i] + hdt * k2[i]);
+        }
+    }
+    _evaluateAdvectionStage(indices, stagePositions, k3);
+
+    for (int i = 0; i < numPositions; i++) {
+        if (orders[i] == 4) {
+            indices.push_back(i);
+            stagePositions.push_back(positions[i] + (float)dt * k3[i]);
+        }
+    }
+    _evaluateAdvectionStage(indices, stagePositions, k4);
+
+    for (int i = 0; i < numPositions; i++) {
+        vmath::vec3 p0 = positions[i];
+        if (orders[i] == 1) {
+            output[i] = p0 + (float)dt * k1[i];
+            counts->euler++;
+        } else if (orders[i] == 2) {
+            output[i] = p0 + (float)dt * k2[i];
+            counts->rk2++;
+        } else if (orders[i] == 3) {
+            output[i] = p0 + (float)(dt/9.0f)*(2.0f*k1[i] + 3.0f*k2[i] + 4.0f*k3[i]);
+            counts->rk3++;
+        } else {
+            output[i] = p0 + (float)(dt/6.0f)*(k1[i] + 2.0f*k2[i] + 2.0f*k3[i] + k4[i]);
+            counts->rk4++;
+        }
+    }
 }
 
 void FluidSimulation::_advanceMarkerParticlesThread(double dt, int startidx, int endidx,
                                                     std::vector<vmath::vec3> *positions,
-                                                    std::vector<vmath::vec3> *output) {
-    for (int i = startidx; i < endidx; i++) {
-        (*output)[i] = _RK3(positions->at(i), dt);
+                                                    std::vector<vmath::vec3> *output,
+                                                    AdvectionIntegratorCounts *counts) {
+    vmath::vec3 *rangePositions = positions->data() + startidx;
+    vmath::vec3 *rangeOutput = output->data() + startidx;
+    int count = endidx - startidx;
+    if (_isAdaptiveMarkerParticleAdvectionEnabled) {
+        _adaptiveRK(rangePositions, count, dt, rangeOutput, counts);
+    } else {
+        _RK3(rangePositions, count, dt, rangeOutput);
+        counts->rk3 += count;
     }
 
     _resolveMarkerParticleCollisions(startidx, endidx, *positions, *output);
@@ -7868,16 +7878,30 @@ void FluidSimulation::_advanceMarkerParticles(double dt) {
         int numthreads = (int)fmin(numCPU, positionsCopy.size());
         std::vector<std::thread> threads(numthreads);
         std::vector<vmath::vec3> output(positionsCopy.size());
+        std::vector<AdvectionIntegratorCounts> threadCounts(numthreads);
         std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, positionsCopy.size(), numthreads);
         for (int i = 0; i < numthreads; i++) {
             threads[i] = std::thread(&FluidSimulation::_advanceMarkerParticlesThread, this,
-                                     dt, intervals[i], intervals[i + 1], &positionsCopy, &output);
+                                     dt, intervals[i], intervals[i + 1], &positionsCopy, &output,
+                                     &(threadCounts[i]));
         }
 
         for (int i = 0; i < numthreads; i++) {
             threads[i].join();
         }
 
+        _currentAdvectionIntegratorCounts = AdvectionIntegratorCounts();
+        for (int i = 0; i < numthreads; i++) {
+            _currentAdvectionIntegratorCounts.euler += threadCounts[i].euler;
+            _currentAdvectionIntegratorCounts.rk2 += threadCounts[i].rk2;
+            _currentAdvectionIntegratorCounts.rk3 += threadCounts[i].rk3;
+            _currentAdvectionIntegratorCounts.rk4 += threadCounts[i].rk4;
+        }
+        _frameAdvectionIntegratorCounts.euler += _currentAdvectionIntegratorCounts.euler;
+        _frameAdvectionIntegratorCounts.rk2 += _currentAdvectionIntegratorCounts.rk2;
+        _frameAdvectionIntegratorCounts.rk3 += _currentAdvectionIntegratorCounts.rk3;
+        _frameAdvectionIntegratorCounts.rk4 += _currentAdvectionIntegratorCounts.rk4;
+
         for (size_t i = 0; i < _markerParticles.size(); i++) {
             float distanceTravelled = vmath::length(positions->at(i) - output[i]);
             if (distanceTravelled < 1e-6) {
@@ -7909,37 +7933,9 @@ void FluidSimulation::_addNewFluidCells(std::vector<GridIndex> &cells,
                                         vmath::vec3 sdfoffset,
                                         MarkerParticleAttributes attributes,
                                         ParticleMaskGrid &maskgrid) {
-
-    int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, cells.size());
-    std::vector<std::thread> threads(numthreads);
-    std::vector<std::vector<vmath::vec3> > particleVectors(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, cells.size(), numthreads);
-    for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&FluidSimulation::_addNewFluidCellsThread, this,
-                                 intervals[i], intervals[i + 1], 
-                                 &cells, &meshSDF, sdfoffset, 
-                                 &(particleVectors[i]));
-    }
-
-    for (int i = 0; i < numthreads; i++) {
-        threads[i].join();
-    }
-
-    std::vector<MarkerParticle> newParticles;
-    for (size_t vidx = 0; vidx < particleVectors.size(); vidx++) {
-        for (size_t i = 0; i < particleVectors[vidx].size(); i++) {
-            vmath::vec3 p = particleVectors[vidx][i];
-            if (maskgrid.isSubCellSet(p)) {
-                continue;
-            }
-
-            newParticles.push_back(MarkerParticle(p, velocity));
-            maskgrid.addParticle(p);
-        }
-    }
-
-    _addMarkerParticles(newParticles, attributes);
+    std::vector<std::vector<vmath::vec3> > particleVectors;
+    _generateNewFluidCellParticles(cells, meshSDF, sdfoffset, maskgrid, particleVectors);
+    _appendNewFluidParticles(particleVectors, velocity, NULL, NULL, attributes, maskgrid);
 }
 
 void FluidSimulation::_addNewFluidCells(std::vector<GridIndex> &cells, 
@@ -7949,39 +7945,9 @@ void FluidSimulation::_addNewFluidCells(std::vector<GridIndex> &cells,
                                         vmath::vec3 sdfoffset,
                                         MarkerParticleAttributes attributes,
                                         ParticleMaskGrid &maskgrid) {
-
-    int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, cells.size());
-    std::vector<std::thread> threads(numthreads);
-    std::vector<std::vector<vmath::vec3> > particleVectors(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, cells.size(), numthreads);
-    for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&FluidSimulation::_addNewFluidCellsThread, this,
-                                 intervals[i], intervals[i + 1], 
-                                 &cells, &meshSDF, sdfoffset, 
-                                 &(particleVectors[i]));
-    }
-
-    for (int i = 0; i < numthreads; i++) {
-        threads[i].join();
-    }
-
-    std::vector<MarkerParticle> newParticles;
-    for (size_t vidx = 0; vidx < particleVectors.size(); vidx++) {
-        for (size_t i = 0; i < particleVectors[vidx].size(); i++) {
-            vmath::vec3 p = particleVectors[vidx][i];
-            if (maskgrid.isSubCellSet(p)) {
-                continue;
-            }
-
-            vmath::vec3 rotv = vmath::cross(rvelocity.angular * rvelocity.axis, p - rvelocity.centroid);
-            vmath::vec3 totv = velocity + rvelocity.linear + rotv;
-            newParticles.push_back(MarkerParticle(p, totv));
-            maskgrid.addParticle(p);
-        }
-    }
-
-    _addMarkerParticles(newParticles, attributes);
+    std::vector<std::vector<vmath::vec3> > particleVectors;
+    _generateNewFluidCellParticles(cells, meshSDF, sdfoffset, maskgrid, particleVectors);
+    _appendNewFluidParticles(particleVectors, velocity, &rvelocity, NULL, attributes, maskgrid);
 }
 
 void FluidSimulation::_addNewFluidCells(std::vector<GridIndex> &cells, 
@@ -7991,57 +7957,55 @@ void FluidSimulation::_addNewFluidCells(std::vector<GridIndex> &cells,
                                         vmath::vec3 sdfoffset,
                                         MarkerParticleAttributes attributes,
                                         ParticleMaskGrid &maskgrid) {
-    double q = 0.25 * _dx;
-    vmath::vec3 particleOffsets[8] = {
-        vmath::vec3(-q, -q, -q),
-        vmath::vec3( q, -q, -q),
-        vmath::vec3(-q,  q, -q),
-        vmath::vec3( q,  q, -q),
-        vmath::vec3(-q, -q,  q),
-        vmath::vec3( q, -q,  q),
-        vmath::vec3(-q,  q,  q),
-        vmath::vec3( q,  q,  q)
-    };
-
-    double jitter = _getMarkerParticleJitter();
-    std::vector<MarkerParticle> newParticles;
-    for (size_t i = 0; i < cells.size(); i++) {
-        GridIndex g = cells[i];
-        vmath::vec3 c = Grid3d::GridIndexToCellCenter(g, _dx);
+    std::vector<std::vector<vmath::vec3> > particleVectors;
+    _generateNewFluidCellParticles(cells, meshSDF, sdfoffset, maskgrid, particleVectors);
+    _appendNewFluidParticles(particleVectors, velocity, NULL, vdata, attributes, maskgrid);
+}
 
-        for (unsigned int oidx = 0; oidx < 8; oidx++) {
-            vmath::vec3 p = c + particleOffsets[oidx];
-            if (maskgrid.isSubCellSet(p)) {
-                continue;
-            }
+void FluidSimulation::_addNewFluidCellsAABB(AABB bbox, 
+                                            vmath::vec3 velocity,
+                                            MarkerParticleAttributes attributes,
+                                            ParticleMaskGrid &maskgrid) {
+    vmath::vec3 p1 = bbox.getMinPoint();
+    vmath::vec3 p2 = bbox.getMaxPoint();
+    GridIndex g1 = Grid3d::positionToGridIndex(p1, _dx);
+    GridIndex g2 = Grid3d::positionToGridIndex(p2, _dx);
 
-            double d = meshSDF.trilinearInterpolate(p - sdfoffset);
-            if (d > 0) {
-                continue;
-            }
+    g1.i = std::max(g1.i, 1);
+    g1.j = std::max(g1.j, 1);
+    g1.k = std::max(g1.k, 1);
+    g2.i = std::min(g2.i, _isize - 2);
+    g2.j = std::min(g2.j, _jsize - 2);
+    g2.k = std::min(g2.k, _ksize - 2);
 
-            if (_isJitterSurfaceMarkerParticlesEnabled || d < -_dx) {
-                p = _jitterMarkerParticlePosition(p, jitter);
-            }
+    if (g2.i < g1.i || g2.j < g1.j || g2.k < g1.k) {
+        return;
+    }
 
-            if (_solidSDF.trilinearInterpolate(p) > 0) {
-                vmath::vec3 datap = p - vdata->offset;
-                vmath::vec3 fv = vdata->vfield.evaluateVelocityAtPositionLinear(datap);
-                vmath::vec3 v = velocity + fv;
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, g2.k - g1.k + 1);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<std::vector<vmath::vec3> > particleVectors(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(g1.k, g2.k + 1, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        unsigned int seed = (unsigned int)_randomSeed();
+        threads[i] = std::thread(&FluidSimulation::_addNewFluidCellsAABBThread, this,
+                                 intervals[i], intervals[i + 1], g1, g2, 
+                                 &maskgrid, seed, &(particleVectors[i]));
+    }
 
-                newParticles.push_back(MarkerParticle(p, v));
-                maskgrid.addParticle(p);
-            }
-        }
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
     }
 
-    _addMarkerParticles(newParticles, attributes);
+    _appendNewFluidParticles(particleVectors, velocity, NULL, NULL, attributes, maskgrid);
 }
 
-void FluidSimulation::_addNewFluidCellsAABB(AABB bbox, 
-                                            vmath::vec3 velocity,
-                                            MarkerParticleAttributes attributes,
-                                            ParticleMaskGrid &maskgrid) {
+void FluidSimulation::_addNewFluidCellsAABBThread(int startk, int endk, 
+                                                  GridIndex g1, GridIndex g2,
+                                                  ParticleMaskGrid *maskgrid,
+                                                  unsigned int seed,
+                                                  std::vector<vmath::vec3> *particles) {
     double q = 0.25 * _dx;
     vmath::vec3 particleOffsets[8] = {
         vmath::vec3(-q, -q, -q),
@@ -8055,59 +8019,73 @@ void FluidSimulation::_addNewFluidCellsAABB(AABB bbox,
     };
 
     double jitter = _getMarkerParticleJitter();
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> jitterDistribution(-jitter, jitter);
 
-    vmath::vec3 p1 = bbox.getMinPoint();
-    vmath::vec3 p2 = bbox.getMaxPoint();
-    GridIndex g1 = Grid3d::positionToGridIndex(p1, _dx);
-    GridIndex g2 = Grid3d::positionToGridIndex(p2, _dx);
-
-    g1.i = std::max(g1.i, 1);
-    g1.j = std::max(g1.j, 1);
-    g1.k = std::max(g1.k, 1);
-    g2.i = std::min(g2.i, _isize - 2);
-    g2.j = std::min(g2.j, _jsize - 2);
-    g2.k = std::min(g2.k, _ksize - 2);
-
-    std::vector<MarkerParticle> newParticles;
-    for (int k = g1.k; k <= g2.k; k++) {
+    for (int k = startk; k < endk; k++) {
         for (int j = g1.j; j <= g2.j; j++) {
             for (int i = g1.i; i <= g2.i; i++) {
                 GridIndex g(i, j, k);
-                vmath::vec3 c = Grid3d::GridIndexToCellCenter(g, _dx);
+                if (maskgrid->isCellFull(g)) {
+                    continue;
+                }
 
+                vmath::vec3 c = Grid3d::GridIndexToCellCenter(g, _dx);
                 bool isSurfaceParticle = i == g1.i || j == g1.j || k == g1.k || 
                                          i == g2.i || j == g2.j || k == g2.k;
                 for (unsigned int oidx = 0; oidx < 8; oidx++) {
                     vmath::vec3 p = c + particleOffsets[oidx];
-                    if (maskgrid.isSubCellSet(p)) {
+                    if (maskgrid->isSubCellSet(p)) {
                         continue;
                     }
 
                     if (_isJitterSurfaceMarkerParticlesEnabled || !isSurfaceParticle) {
-                        p = _jitterMarkerParticlePosition(p, jitter);
+                        p.x += jitterDistribution(generator);
+                        p.y += jitterDistribution(generator);
+                        p.z += jitterDistribution(generator);
                     }
 
                     if (_solidSDF.trilinearInterpolate(p) > 0) {
-                        newParticles.push_back(MarkerParticle(p, velocity));
-                        maskgrid.addParticle(p);
+                        particles->push_back(p);
                     }
                 }
-
             }
         }
     }
+}
+
+void FluidSimulation::_generateNewFluidCellParticles(std::vector<GridIndex> &cells, 
+                                                     MeshLevelSet &meshSDF,
+                                                     vmath::vec3 sdfoffset,
+                                                     ParticleMaskGrid &maskgrid,
+                                                     std::vector<std::vector<vmath::vec3> > &particleVectors) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, cells.size());
+    std::vector<std::thread> threads(numthreads);
+    particleVectors = std::vector<std::vector<vmath::vec3> >(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, cells.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        unsigned int seed = (unsigned int)_randomSeed();
+        threads[i] = std::thread(&FluidSimulation::_generateNewFluidCellParticlesThread, this,
+                                 intervals[i], intervals[i + 1], 
+                                 &cells, &meshSDF, sdfoffset, &maskgrid, seed,
+                                 &(particleVectors[i]));
+    }
 
-    _addMarkerParticles(newParticles, attributes);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
 }
 
-void FluidSimulation::_addNewFluidCellsThread(int startidx, int endidx,
-                                              std::vector<GridIndex> *cells, 
-                                              MeshLevelSet *meshSDF,
-                                              vmath::vec3 sdfoffset,
-                                              std::vector<vmath::vec3> *particles) {
+void FluidSimulation::_generateNewFluidCellParticlesThread(int startidx, int endidx,
+                                                           std::vector<GridIndex> *cells, 
+                                                           MeshLevelSet *meshSDF,
+                                                           vmath::vec3 sdfoffset,
+                                                           ParticleMaskGrid *maskgrid,
+                                                           unsigned int seed,
+                                                           std::vector<vmath::vec3> *particles) {
 
     double q = 0.25 * _dx;
-    double jitter = _getMarkerParticleJitter();
     vmath::vec3 particleOffsets[8] = {
         vmath::vec3(-q, -q, -q),
         vmath::vec3( q, -q, -q),
@@ -8119,12 +8097,30 @@ void FluidSimulation::_addNewFluidCellsThread(int startidx, int endidx,
         vmath::vec3( q,  q,  q)
     };
 
+    double jitter = _getMarkerParticleJitter();
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> jitterDistribution(-jitter, jitter);
+
+    // Sub cell points are within sqrt(3)*q of the cell center, so a cell
+    // whose center is well outside of the source cannot emit any particles
+    double cellRejectDistance = 2.0 * _dx;
+
     for (int i = startidx; i < endidx; i++) {
         GridIndex g = cells->at(i);
+        if (maskgrid->isCellFull(g)) {
+            continue;
+        }
+
         vmath::vec3 c = Grid3d::GridIndexToCellCenter(g, _dx);
+        if (meshSDF->trilinearInterpolate(c - sdfoffset) > cellRejectDistance) {
+            continue;
+        }
 
         for (int oidx = 0; oidx < 8; oidx++) {
             vmath::vec3 p = c + particleOffsets[oidx];
+            if (maskgrid->isSubCellSet(p)) {
+                continue;
+            }
 
             double d = meshSDF->trilinearInterpolate(p - sdfoffset);
             if (d > 0) {
@@ -8132,7 +8128,14 @@ void FluidSimulation::_addNewFluidCellsThread(int startidx, int endidx,
             }
 
             if (_isJitterSurfaceMarkerParticlesEnabled || d < -_dx) {
-                p = _jitterMarkerParticlePosition(p, jitter);
+                p.x += jitterDistribution(generator);
+                p.y += jitterDistribution(generator);
+                p.z += jitterDistribution(generator);
+            }
+
+            GridIndex pg = Grid3d::positionToGridIndex(p, _dx);
+            if (!Grid3d::isGridIndexInRange(pg, _isize, _jsize, _ksize)) {
+                continue;
             }
 
             if (_solidSDF.trilinearInterpolate(p) > 0) {
@@ -8142,8 +8145,140 @@ void FluidSimulation::_addNewFluidCellsThread(int startidx, int endidx,
     }
 }
 
-void FluidSimulation::_updateInflowMeshFluidSource(MeshFluidSource *source,
-                                                   ParticleMaskGrid &maskgrid) {
+void FluidSimulation::_appendNewFluidParticles(std::vector<std::vector<vmath::vec3> > &particleVectors,
+                                               vmath::vec3 velocity,
+                                               RigidBodyVelocity *rvelocity,
+                                               VelocityFieldData *vdata,
+                                               MarkerParticleAttributes attributes,
+                                               ParticleMaskGrid &maskgrid) {
+    size_t startidx = _markerParticles.size();
+    std::vector<size_t> offsets(particleVectors.size() + 1, startidx);
+    for (size_t i = 0; i < particleVectors.size(); i++) {
+        offsets[i + 1] = offsets[i] + particleVectors[i].size();
+    }
+
+    size_t endidx = offsets.back();
+    if (endidx == startidx) {
+        return;
+    }
+
+    // Grow the particle system once, new attribute values are set to their
+    // defaults and then written in place by each thread
+    std::vector<vmath::vec3> *positions;
+    _markerParticles.getAttributeValues("POSITION", positions);
+    positions->resize(endidx);
+    _markerParticles.update();
+
+    int numthreads = (int)particleVectors.size();
+    std::vector<std::thread> threads(numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&FluidSimulation::_appendNewFluidParticlesThread, this,
+                                 &(particleVectors[i]), offsets[i], 
+                                 velocity, rvelocity, vdata, attributes);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    // Random attribute values are drawn serially from the shared generators
+    if (_isSurfaceLifetimeAttributeEnabled || _isFluidParticleLifetimeAttributeEnabled) {
+        std::vector<float> *sourcelifetimes;
+        _markerParticles.getAttributeValues("LIFETIME", sourcelifetimes);
+        float variance = attributes.sourceLifetimeVariance;
+        for (size_t i = startidx; i < endidx; i++) {
+            (*sourcelifetimes)[i] = attributes.sourceLifetime + _randomDouble(-variance, variance);
+        }
+    }
+
+    if (_isFluidParticleIDAttributeEnabled) {
+        std::vector<uint16_t> *ids;
+        _markerParticles.getAttributeValues("ID", ids);
+        for (size_t i = startidx; i < endidx; i++) {
+            (*ids)[i] = _generateRandomFluidParticleID();
+        }
+    }
+
+    if (_isFluidParticleUIDAttributeEnabled) {
+        std::vector<uint16_t> *ids = NULL;
+        if (_isFluidParticleIDAttributeEnabled) {
+            _markerParticles.getAttributeValues("ID", ids);
+        }
+
+        std::vector<int> *uids;
+        _markerParticles.getAttributeValues("UID", uids);
+        int idLimit = _getFluidParticleOutputIDLimit();
+        for (size_t i = startidx; i < endidx; i++) {
+            uint16_t id = ids != NULL ? (*ids)[i] : 0;
+            (*uids)[i] = id < idLimit ? (int)UIDAttribute::unset : (int)UIDAttribute::ignore;
+        }
+    }
+
+    maskgrid.addParticles(*positions, startidx, endidx);
+}
+
+void FluidSimulation::_appendNewFluidParticlesThread(std::vector<vmath::vec3> *particles, 
+                                                     size_t offset,
+                                                     vmath::vec3 velocity,
+                                                     RigidBodyVelocity *rvelocity,
+                                                     VelocityFieldData *vdata,
+                                                     MarkerParticleAttributes attributes) {
+    std::vector<vmath::vec3> *positions, *velocities;
+    _markerParticles.getAttributeValues("POSITION", positions);
+    _markerParticles.getAttributeValues("VELOCITY", velocities);
+
+    std::vector<int> *sourceids = nullptr;
+    if (_isSurfaceSourceIDAttributeEnabled || _isFluidParticleSourceIDAttributeEnabled) {
+        _markerParticles.getAttributeValues("SOURCEID", sourceids);
+    }
+
+    std::vector<float> *sourceviscosities = nullptr;
+    if (_isSurfaceSourceViscosityAttributeEnabled) {
+        _markerParticles.getAttributeValues("VISCOSITY", sourceviscosities);
+    }
+
+    std::vector<float> *sourcedensities = nullptr;
+    if (_isSurfaceDensityAttributeEnabled) {
+        _markerParticles.getAttributeValues("DENSITY", sourcedensities);
+    }
+
+    std::vector<vmath::vec3> *sourcecolors = nullptr;
+    if (_isSurfaceSourceColorAttributeEnabled || _isFluidParticleSourceColorAttributeEnabled) {
+        _markerParticles.getAttributeValues("COLOR", sourcecolors);
+    }
+
+    for (size_t i = 0; i < particles->size(); i++) {
+        vmath::vec3 p = particles->at(i);
+        vmath::vec3 v = velocity;
+        if (rvelocity != NULL) {
+            vmath::vec3 rotv = vmath::cross(rvelocity->angular * rvelocity->axis, p - rvelocity->centroid);
+            v += rvelocity->linear + rotv;
+        } else if (vdata != NULL) {
+            v += vdata->vfield.evaluateVelocityAtPositionLinear(p - vdata->offset);
+        }
+
+        size_t pidx = offset + i;
+        (*positions)[pidx] = p;
+        (*velocities)[pidx] = v;
+
+        if (sourceids != nullptr) {
+            (*sourceids)[pidx] = attributes.sourceID;
+        }
+        if (sourceviscosities != nullptr) {
+            (*sourceviscosities)[pidx] = attributes.sourceViscosity;
+        }
+        if (sourcedensities != nullptr) {
+            (*sourcedensities)[pidx] = attributes.sourceDensity;
+        }
+        if (sourcecolors != nullptr) {
+            (*sourcecolors)[pidx] = attributes.sourceColor;
+        }
+    }
+}
+
+void FluidSimulation::_getInflowEmissionFrameInterpolations(MeshFluidSource *source,
+                                                            std::vector<float> &frameInterpolations) {
+    frameInterpolations.clear();
     if (!source->isEnabled()) {
         return;
     }
@@ -8159,6 +8294,18 @@ void FluidSimulation::_updateInflowMeshFluidSource(MeshFluidSource *source,
     }
 
     float substepFactor = (_currentFrameTimeStep / _currentFrameDeltaTime) / (float)numSubsteps;
+    for (int i = 0; i < numSubsteps; i++) {
+        frameInterpolations.push_back(frameProgress + (float)i * substepFactor);
+    }
+}
+
+void FluidSimulation::_updateInflowMeshFluidSource(MeshFluidSource *source,
+                                                   ParticleMaskGrid &maskgrid) {
+    std::vector<float> frameInterpolations;
+    _getInflowEmissionFrameInterpolations(source, frameInterpolations);
+    if (frameInterpolations.empty()) {
+        return;
+    }
 
     MarkerParticleAttributes attributes;
     attributes.sourceID = source->getSourceID();
@@ -8168,8 +8315,8 @@ void FluidSimulation::_updateInflowMeshFluidSource(MeshFluidSource *source,
     attributes.sourceLifetimeVariance = source->getLifetimeVariance();
     attributes.sourceColor = source->getSourceColor();
 
-    for (int i = 0; i < numSubsteps; i++) {
-        float frameInterpolation = frameProgress + (float)i * substepFactor;
+    for (size_t i = 0; i < frameInterpolations.size(); i++) {
+        float frameInterpolation = frameInterpolations[i];
         source->setFrame(_currentFrame, frameInterpolation);
         source->update(_currentFrameDeltaTime);
 
@@ -8283,13 +8430,42 @@ void FluidSimulation::_updateInflowMeshFluidSources() {
     // Sort fluid sources according to priority level (higher priority is added first)
     std::sort(_meshFluidSources.begin(), _meshFluidSources.end(), compareMeshFluidSourcePointerDescending);
 
+    // The particle mask only needs to cover the cells that the inflow sources
+    // can emit into during this time step
+    GridIndex gmin(_isize, _jsize, _ksize);
+    GridIndex gmax(-1, -1, -1);
+    for (size_t i = 0; i < _meshFluidSources.size(); i++) {
+        MeshFluidSource *source = _meshFluidSources[i];
+        if (!source->isInflow()) {
+            continue;
+        }
+
+        std::vector<float> frameInterpolations;
+        _getInflowEmissionFrameInterpolations(source, frameInterpolations);
+        if (frameInterpolations.empty()) {
+            continue;
+        }
+
+        // Source meshes are linearly interpolated within a frame, so the bounds
+        // at the first and last emission contain all emissions in between
+        float interpolationBounds[2] = {frameInterpolations.front(), frameInterpolations.back()};
+        for (int bidx = 0; bidx < 2; bidx++) {
+            GridIndex smin, smax;
+            source->getGridBounds(interpolationBounds[bidx], smin, smax);
+            gmin = GridIndex(std::min(gmin.i, smin.i), std::min(gmin.j, smin.j), std::min(gmin.k, smin.k));
+            gmax = GridIndex(std::max(gmax.i, smax.i), std::max(gmax.j, smax.j), std::max(gmax.k, smax.k));
+        }
+    }
+
+    if (gmax.i < gmin.i || gmax.j < gmin.j || gmax.k < gmin.k) {
+        return;
+    }
+
     std::vector<vmath::vec3> *positions;
     _markerParticles.getAttributeValues("POSITION", positions);
 
-    ParticleMaskGrid maskgrid(_isize, _jsize, _ksize, _dx);
-    for (unsigned int i = 0; i < _markerParticles.size(); i++) {
-        maskgrid.addParticle(positions->at(i));
-    }
+    ParticleMaskGrid maskgrid(_isize, _jsize, _ksize, _dx, gmin, gmax);
+    maskgrid.addParticles(*positions);
 
     for (size_t i = 0; i < _meshFluidSources.size(); i++) {
         if (_meshFluidSources[i]->isInflow()) {
@@ -8373,9 +8549,7 @@ void FluidSimulation::_updateAddedFluidMeshObjectQueue() {
     _markerParticles.getAttributeValues("POSITION", positions);
 
     ParticleMaskGrid maskgrid(_isize, _jsize, _ksize, _dx);
-    for (unsigned int i = 0; i < positions->size(); i++) {
-        maskgrid.addParticle(positions->at(i));
-    }
+    maskgrid.addParticles(*positions);
 
     MeshLevelSet meshSDF(_isize, _jsize, _ksize, _dx);
     meshSDF.disableVelocityData();
@@ -8421,16 +8595,7 @@ void FluidSimulation::_updateAddedFluidMeshObjectQueue() {
 }
 
 int FluidSimulation::_getNumFluidCells() {
-    int count = 0;
-    for (int k = 1; k < _ksize - 1; k++) {
-        for (int j = 1; j < _jsize - 1; j++) {
-            for (int i = 1; i < _isize - 1; i++) {
-                if (_liquidSDF.get(i, j, k) < 0.0f) {
-                   count++;
-                }
-            }
-        }
-    }
+    int count = (int)_liquidCellIndex.size();
 
     std::vector<vmath::vec3> *positions;
     _markerParticles.getAttributeValues("POSITION", positions);
@@ -8479,7 +8644,52 @@ void FluidSimulation::_getTriangleMeshFileData(TriangleMesh &mesh, std::vector<c
         mesh.getMeshFileDataPLY(data);
     } else if (_meshOutputFormat == TriangleMeshFormat::bobj) {
         mesh.getMeshFileDataBOBJ(data);
+    } else if (_meshOutputFormat == TriangleMeshFormat::meshcache) {
+        // Surfaces are quantized relative to the domain
+        double width = _isize * _dx * _domainScale;
+        double height = _jsize * _dx * _domainScale;
+        double depth = _ksize * _dx * _domainScale;
+        MeshCache::EncodeParameters params;
+        params.positionBits = _meshCacheQuantizationBits;
+        params.bounds = AABB(_domainOffset, width, height, depth);
+        MeshCache::encode(mesh, params, data);
+    }
+}
+
+void FluidSimulation::_getVectorAttributeFileData(TriangleMesh &vectorData, std::vector<char> &data) {
+    if (_meshOutputFormat == TriangleMeshFormat::meshcache) {
+        // Stored as a 3 component channel quantized relative to its own range
+        MeshCache::Channel channel;
+        channel.components = 3;
+        channel.values.resize(3 * vectorData.vertices.size());
+        for (size_t i = 0; i < vectorData.vertices.size(); i++) {
+            vmath::vec3 v = vectorData.vertices[i];
+            channel.values[3 * i + 0] = v.x;
+            channel.values[3 * i + 1] = v.y;
+            channel.values[3 * i + 2] = v.z;
+        }
+
+        MeshCache::EncodeParameters params;
+        params.channelBits = _meshCacheQuantizationBits;
+        MeshCache::encode(channel, params, data);
+        return;
+    }
+
+    _getTriangleMeshFileData(vectorData, data);
+}
+
+void FluidSimulation::_getFloatAttributeFileData(std::vector<float> &values, std::vector<char> &data) {
+    if (_meshOutputFormat == TriangleMeshFormat::meshcache) {
+        MeshCache::Channel channel;
+        channel.components = 1;
+        channel.values = values;
+        MeshCache::encode(channel, MeshCache::EncodeParameters(), data);
+        return;
     }
+
+    size_t datasize = values.size() * sizeof(float);
+    data = std::vector<char>(datasize);
+    std::memcpy(data.data(), (char *)values.data(), datasize);
 }
 
 void FluidSimulation::_getForceFieldDebugFileData(std::vector<ForceFieldDebugNode> &debugNodes, 
@@ -8589,7 +8799,6 @@ void FluidSimulation::_removeMeshNearDomain(TriangleMesh &mesh) {
         return;
     }
 
-    Array3d<bool> validCells(_isize, _jsize, _ksize, false);
     int width = 2 + _removeSurfaceNearDomainDistance;
 
     int imin = _removeSurfaceNearDomainXNeg ? width : 0;
@@ -8599,14 +8808,6 @@ void FluidSimulation::_removeMeshNearDomain(TriangleMesh &mesh) {
     int jmax = _removeSurfaceNearDomainYPos ? _jsize - width : _jsize;
     int kmax = _removeSurfaceNearDomainZPos ? _ksize - width : _ksize;
 
-    for (int k = kmin; k < kmax; k++) {
-        for (int j = jmin; j < jmax; j++) {
-            for (int i = imin; i < imax; i++) {
-                validCells.set(i, j, k, true);
-            }
-        }
-    }
-
     std::vector<int> removalTriangles;
     for (size_t tidx = 0; tidx < mesh.triangles.size(); tidx++) {
         Triangle t = mesh.triangles[tidx];
@@ -8614,7 +8815,9 @@ void FluidSimulation::_removeMeshNearDomain(TriangleMesh &mesh) {
                                 mesh.vertices[t.tri[1]] + 
                                 mesh.vertices[t.tri[2]]) / 3.0;
         GridIndex g = Grid3d::positionToGridIndex(centroid, _dx);
-        if (!validCells.isIndexInRange(g) || !validCells(g)) {
+        bool isValidCell = g.i >= imin && g.j >= jmin && g.k >= kmin && 
+                           g.i < imax && g.j < jmax && g.k < kmax;
+        if (!isValidCell) {
             removalTriangles.push_back(tidx);
         } else {
             if (_isMeshingVolumeSet) {
@@ -8714,11 +8917,52 @@ void FluidSimulation::_computeDomainBoundarySDF(MeshLevelSet *sdf) {
     }
 }
 
+void FluidSimulation::_updateMeshingBoundarySDF() {
+    if (_isMeshingBoundarySDFUpToDate) {
+        return;
+    }
+
+    float eps = 1e-9;
+    float offset = (float)(_obstacleMeshingOffset * _dx);
+    if (!_isObstacleMeshingOffsetEnabled) {
+        _meshingBoundarySDF.constructMinimalLevelSet(_isize, _jsize, _ksize, _dx);
+        float fillval = 3.0 * _dx;
+        for (int k = 0; k < _ksize + 1; k++) {
+            for (int j = 0; j < _jsize + 1; j++) {
+                for (int i = 0; i < _isize + 1; i++) {
+                    _meshingBoundarySDF.set(i, j, k, fillval);
+                }
+            }
+        }
+        _computeDomainBoundarySDF(&_meshingBoundarySDF);
+        _isMeshingBoundarySDFSet = true;
+    } else if (_isMeshingVolumeSet) {
+        // The obstacle offset is applied after the meshing volume is merged 
+        // into the solid SDF, so the offset is baked into the cached values
+        _meshingBoundarySDF.constructMinimalSignedDistanceField(_meshingVolumeSDF);
+        if (std::abs(offset) > eps) {
+            _meshingBoundarySDF.detach();
+            for (int k = 3; k < _ksize - 2; k++) {
+                for (int j = 3; j < _jsize - 2; j++) {
+                    for (int i = 3; i < _isize - 2; i++) {
+                        _meshingBoundarySDF.set(i, j, k, _meshingBoundarySDF.get(i, j, k) + offset);
+                    }
+                }
+            }
+        }
+        _isMeshingBoundarySDFSet = true;
+    } else {
+        _meshingBoundarySDF = MeshLevelSet();
+        _isMeshingBoundarySDFSet = false;
+    }
+
+    _isMeshingBoundarySDFUpToDate = true;
+}
+
 void FluidSimulation::_generateOutputSurface(TriangleMesh &surface, TriangleMesh &preview,
                                                std::vector<vmath::vec3> *particles,
                                                MeshLevelSet *solidSDF) {
     
-    _applyMeshingVolumeToSDF(solidSDF);
     _filterParticlesOutsideMeshingVolume(particles);
 
     if (_markerParticles.empty()) {
@@ -8727,30 +8971,22 @@ void FluidSimulation::_generateOutputSurface(TriangleMesh &surface, TriangleMesh
         return;
     }
 
+    _updateMeshingBoundarySDF();
+
+    MeshingBoundarySDF boundarySDF(_isize, _jsize, _ksize, _dx);
     if (_isObstacleMeshingOffsetEnabled) {
+        boundarySDF.setSolidSDF(solidSDF);
+
         float eps = 1e-9;
         float offset = (float)(_obstacleMeshingOffset * _dx);
         if (std::abs(offset) > eps) {
             // Values near boundary are unchanged so that the mesh is generated
             // directly against domain boundary
-            for (int k = 3; k < _ksize - 2; k++) {
-                for (int j = 3; j < _jsize - 2; j++) {
-                    for (int i = 3; i < _isize - 2; i++) {
-                        solidSDF->set(i, j, k, solidSDF->get(i, j, k) + offset);
-                    }
-                }
-            }
+            boundarySDF.setSolidOffset(offset, 3);
         }
-    } else {
-        float fillval = 3.0 * _dx;
-        for (int k = 0; k < _ksize + 1; k++) {
-            for (int j = 0; j < _jsize + 1; j++) {
-                for (int i = 0; i < _isize + 1; i++) {
-                    solidSDF->set(i, j, k, fillval);
-                }
-            }
-        }
-        _computeDomainBoundarySDF(solidSDF);
+    }
+    if (_isMeshingBoundarySDFSet) {
+        boundarySDF.setBoundarySDF(&_meshingBoundarySDF);
     }
 
     ParticleMesherParameters params;
@@ -8762,7 +8998,7 @@ void FluidSimulation::_generateOutputSurface(TriangleMesh &surface, TriangleMesh
     params.computechunks = _numSurfaceReconstructionPolygonizerSlices;
     params.radius = _markerParticleRadius*_markerParticleScale;
     params.particles = particles;
-    params.solidSDF = solidSDF;
+    params.solidSDF = &boundarySDF;
     params.isPreviewMesherEnabled = _isPreviewSurfaceMeshEnabled;
     if (_isPreviewSurfaceMeshEnabled) {
         params.previewdx = _previewdx;
@@ -8800,31 +9036,7 @@ void FluidSimulation::_updateMeshingVolumeSDF() {
     _meshingVolumeSDF.negate();
 
     _isMeshingVolumeLevelSetUpToDate = true;
-}
-
-void FluidSimulation::_applyMeshingVolumeToSDF(MeshLevelSet *sdf) {
-    if (!_isMeshingVolumeSet) {
-        return;
-    }
-
-    int isdf, jsdf, ksdf;
-    sdf->getGridDimensions(&isdf, &jsdf, &ksdf);
-    if (isdf == 0 && jsdf == 0 && ksdf == 0) {
-        // SDF has not been initialized and does not need meshing volume applied
-        return;
-    }
-
-    for (int k = 0; k < _ksize + 1; k++) {
-        for (int j = 0; j < _jsize + 1; j++) {
-            for (int i = 0; i < _isize + 1; i++) {
-                float d1 = sdf->get(i, j, k);
-                float d2 = _meshingVolumeSDF(i, j, k);
-                if (d2 < d1) {
-                    sdf->set(i, j, k, d2);
-                }
-            }
-        }
-    }
+    _isMeshingBoundarySDFUpToDate = false;
 }
 
 void FluidSimulation::_filterParticlesOutsideMeshingVolume(std::vector<vmath::vec3> *particles) {
@@ -8851,7 +9063,7 @@ void FluidSimulation::_generateSurfaceMotionBlurData(TriangleMesh &surface, MACV
         blurData.vertices.push_back(t);
     }
 
-    _getTriangleMeshFileData(blurData, _outputData.surfaceBlurData);
+    _getVectorAttributeFileData(blurData, _outputData.surfaceBlurData);
     _outputData.frameData.surfaceblur.enabled = 1;
     _outputData.frameData.surfaceblur.vertices = (int)blurData.vertices.size();
     _outputData.frameData.surfaceblur.triangles = (int)blurData.triangles.size();
@@ -8888,7 +9100,7 @@ void FluidSimulation::_generateSurfaceVelocityAttributeData(TriangleMesh &surfac
     }
 
     if (_isSurfaceVelocityAttributeEnabled) {
-        _getTriangleMeshFileData(velocityData, _outputData.surfaceVelocityAttributeData);
+        _getVectorAttributeFileData(velocityData, _outputData.surfaceVelocityAttributeData);
         _outputData.frameData.surfacevelocity.enabled = 1;
         _outputData.frameData.surfacevelocity.vertices = (int)velocityData.vertices.size();
         _outputData.frameData.surfacevelocity.triangles = (int)velocityData.triangles.size();
@@ -8896,9 +9108,7 @@ void FluidSimulation::_generateSurfaceVelocityAttributeData(TriangleMesh &surfac
     }
 
     if (_isSurfaceSpeedAttributeEnabled) {
-        size_t datasize = speedData.size() * sizeof(float);
-        _outputData.surfaceSpeedAttributeData = std::vector<char>(datasize);
-        std::memcpy(_outputData.surfaceSpeedAttributeData.data(), (char *)speedData.data(), datasize);
+        _getFloatAttributeFileData(speedData, _outputData.surfaceSpeedAttributeData);
 
         _outputData.frameData.surfacespeed.enabled = 1;
         _outputData.frameData.surfacespeed.vertices = speedData.size();
@@ -8921,7 +9131,7 @@ void FluidSimulation::_generateSurfaceVorticityAttributeData(TriangleMesh &surfa
         vorticityData.vertices.push_back(curl);
     }
 
-    _getTriangleMeshFileData(vorticityData, _outputData.surfaceVorticityAttributeData);
+    _getVectorAttributeFileData(vorticityData, _outputData.surfaceVorticityAttributeData);
     _outputData.frameData.surfacevorticity.enabled = 1;
     _outputData.frameData.surfacevorticity.vertices = (int)vorticityData.vertices.size();
     _outputData.frameData.surfacevorticity.triangles = (int)vorticityData.triangles.size();
@@ -8941,9 +9151,7 @@ void FluidSimulation::_generateSurfaceAgeAttributeData(TriangleMesh &surface) {
         ageData.push_back(age);
     }
 
-    size_t datasize = ageData.size() * sizeof(float);
-    _outputData.surfaceAgeAttributeData = std::vector<char>(datasize);
-    std::memcpy(_outputData.surfaceAgeAttributeData.data(), (char *)ageData.data(), datasize);
+    _getFloatAttributeFileData(ageData, _outputData.surfaceAgeAttributeData);
 
     _outputData.frameData.surfaceage.enabled = 1;
     _outputData.frameData.surfaceage.vertices = ageData.size();
@@ -8964,9 +9172,7 @@ void FluidSimulation::_generateSurfaceLifetimeAttributeData(TriangleMesh &surfac
         lifetimeData.push_back(lifetime);
     }
 
-    size_t datasize = lifetimeData.size() * sizeof(float);
-    _outputData.surfaceLifetimeAttributeData = std::vector<char>(datasize);
-    std::memcpy(_outputData.surfaceLifetimeAttributeData.data(), (char *)lifetimeData.data(), datasize);
+    _getFloatAttributeFileData(lifetimeData, _outputData.surfaceLifetimeAttributeData);
 
     _outputData.frameData.surfacelifetime.enabled = 1;
     _outputData.frameData.surfacelifetime.vertices = lifetimeData.size();
@@ -8987,7 +9193,7 @@ void FluidSimulation::_generateSurfaceWhitewaterProximityAttributeData(TriangleM
         whitewaterProximityData.vertices.push_back(proximity);
     }
 
-    _getTriangleMeshFileData(whitewaterProximityData, _outputData.surfaceWhitewaterProximityAttributeData);
+    _getVectorAttributeFileData(whitewaterProximityData, _outputData.surfaceWhitewaterProximityAttributeData);
     _outputData.frameData.surfacewhitewaterproximity.enabled = 1;
     _outputData.frameData.surfacewhitewaterproximity.vertices = (int)whitewaterProximityData.vertices.size();
     _outputData.frameData.surfacewhitewaterproximity.triangles = (int)whitewaterProximityData.triangles.size();
@@ -9018,7 +9224,7 @@ void FluidSimulation::_generateSurfaceColorAttributeData(TriangleMesh &surface)
         colorData.vertices.push_back(color);
     }
 
-    _getTriangleMeshFileData(colorData, _outputData.surfaceColorAttributeData);
+    _getVectorAttributeFileData(colorData, _outputData.surfaceColorAttributeData);
     _outputData.frameData.surfacecolor.enabled = 1;
     _outputData.frameData.surfacecolor.vertices = (int)colorData.vertices.size();
     _outputData.frameData.surfacecolor.triangles = (int)colorData.triangles.size();
@@ -9162,9 +9368,7 @@ void FluidSimulation::_generateSurfaceViscosityAttributeData(TriangleMesh &surfa
         viscosityData.push_back(viscosity);
     }
 
-    size_t datasize = viscosityData.size() * sizeof(float);
-    _outputData.surfaceViscosityAttributeData = std::vector<char>(datasize);
-    std::memcpy(_outputData.surfaceViscosityAttributeData.data(), (char *)viscosityData.data(), datasize);
+    _getFloatAttributeFileData(viscosityData, _outputData.surfaceViscosityAttributeData);
 
     _outputData.frameData.surfaceviscosity.enabled = 1;
     _outputData.frameData.surfaceviscosity.vertices = viscosityData.size();
@@ -9185,9 +9389,7 @@ void FluidSimulation::_generateSurfaceDensityAttributeData(TriangleMesh &surface
         densityData.push_back(density);
     }
 
-    size_t datasize = densityData.size() * sizeof(float);
-    _outputData.surfaceDensityAttributeData = std::vector<char>(datasize);
-    std::memcpy(_outputData.surfaceDensityAttributeData.data(), (char *)densityData.data(), datasize);
+    _getFloatAttributeFileData(densityData, _outputData.surfaceDensityAttributeData);
 
     _outputData.frameData.surfacedensity.enabled = 1;
     _outputData.frameData.surfacedensity.vertices = densityData.size();
@@ -9198,7 +9400,8 @@ void FluidSimulation::_generateSurfaceDensityAttributeData(TriangleMesh &surface
 void FluidSimulation::_outputSurfaceMeshThread(std::vector<vmath::vec3> *particles,
                                                MeshLevelSet *solidSDF, 
                                                MACVelocityField *vfield,
-                                               std::vector<int> *sourceID) {
+                                               std::vector<int> *sourceID,
+                                               bool isParticleDataOwned) {
     if (!_isSurfaceMeshReconstructionEnabled) { 
         return; 
     }
@@ -9208,27 +9411,40 @@ void FluidSimulation::_outputSurfaceMeshThread(std::vector<vmath::vec3> *particl
     StopWatch t;
     t.start();
 
-    std::vector<vmath::vec3> particlesCopy;
-    if (_isSurfaceSourceIDAttributeEnabled) {
-        particlesCopy = *particles;
+    // Particle data may be shared with the simulation and must not be
+    // modified by the meshing volume filter
+    std::vector<vmath::vec3> filteredParticles;
+    std::vector<vmath::vec3> *meshingParticles = particles;
+    if (_isMeshingVolumeSet) {
+        filteredParticles = *particles;
+        meshingParticles = &filteredParticles;
     }
 
     TriangleMesh surfacemesh, previewmesh;
-    _generateOutputSurface(surfacemesh, previewmesh, particles, solidSDF);
-    delete particles;
+    _generateOutputSurface(surfacemesh, previewmesh, meshingParticles, solidSDF);
     delete solidSDF;
 
+    filteredParticles.clear();
+    filteredParticles.shrink_to_fit();
+    if (isParticleDataOwned && !_isSurfaceSourceIDAttributeEnabled) {
+        delete particles;
+        particles = nullptr;
+    }
+
     _generateSurfaceMotionBlurData(surfacemesh, vfield);
     _generateSurfaceVelocityAttributeData(surfacemesh, vfield);
     delete vfield;
 
     _generateSurfaceVorticityAttributeData(surfacemesh);
 
-    _generateSurfaceSourceIDAttributeData(surfacemesh, particlesCopy, sourceID);
-    delete sourceID;
+    if (_isSurfaceSourceIDAttributeEnabled) {
+        _generateSurfaceSourceIDAttributeData(surfacemesh, *particles, sourceID);
+    }
 
-    particlesCopy.clear();
-    particlesCopy.shrink_to_fit();
+    if (isParticleDataOwned) {
+        delete particles;
+        delete sourceID;
+    }
 
     _generateSurfaceViscosityAttributeData(surfacemesh);
     _generateSurfaceDensityAttributeData(surfacemesh);
@@ -9276,43 +9492,48 @@ void FluidSimulation::_launchOutputSurfaceMeshThread() {
     std::vector<vmath::vec3> *positions;
     _markerParticles.getAttributeValues("POSITION", positions);
 
-    // Particles will be deleted within the thread after use
-    std::vector<vmath::vec3> *particles = new std::vector<vmath::vec3>();
-    particles->reserve(positions->size());
-    for (size_t i = 0; i < positions->size(); i++) {
-        particles->push_back(positions->at(i));
+    std::vector<int> *ids = nullptr;
+    if (_isSurfaceSourceIDAttributeEnabled) {
+        _markerParticles.getAttributeValues("SOURCEID", ids);
+    }
+
+    // When meshing synchronously, the simulation is blocked until the mesher 
+    // thread completes and particle data can be read in place. Otherwise
+    // particles and sourceID are copied and will be deleted within the thread 
+    // after use.
+    std::vector<vmath::vec3> *particles = positions;
+    std::vector<int> *sourceID = ids;
+    bool isParticleDataOwned = _isAsynchronousMeshingEnabled;
+    if (isParticleDataOwned) {
+        particles = new std::vector<vmath::vec3>(*positions);
+        sourceID = new std::vector<int>();
+        if (_isSurfaceSourceIDAttributeEnabled) {
+            *sourceID = *ids;
+        }
     }
 
-    // solidSDF will be deleted within the thread after use
+    // The solid SDF and velocity field are copy-on-write snapshots that share 
+    // grid storage with the simulation. The simulation replaces or detaches
+    // these grids before modifying them, so grid data is only copied if it 
+    // is written before the mesher thread has finished.
+    //
+    // solidSDF and vfield will be deleted within the thread after use
     MeshLevelSet *tempSolidSDF = new MeshLevelSet();
     if (_isFluidInSimulation()) {
         tempSolidSDF->constructMinimalSignedDistanceField(_solidSDF);
     }
 
-    // Velocity Field will be deleted within the thread after use
     MACVelocityField *vfield = new MACVelocityField();
     if (_isSurfaceMotionBlurEnabled || _isSurfaceVelocityAttributeEnabled || _isSurfaceSpeedAttributeEnabled) {
         if (_isSurfaceVelocityAttributeAgainstObstaclesEnabled) {
-            *vfield = _velocityAttributeGrid;
+            vfield->constructSnapshot(_velocityAttributeGrid);
         } else {
-            *vfield = _MACVelocity;
-        }
-    }
-
-    // SourceID will be deleted within the thread after use
-    std::vector<int> *sourceID = new std::vector<int>();
-    if (_isSurfaceSourceIDAttributeEnabled) {
-        std::vector<int> *ids = nullptr;
-        _markerParticles.getAttributeValues("SOURCEID", ids);
-
-        sourceID->reserve(ids->size());
-        for (size_t i = 0; i < ids->size(); i++) {
-            sourceID->push_back(ids->at(i));
+            vfield->constructSnapshot(_MACVelocity);
         }
     }
 
     _mesherThread = std::thread(&FluidSimulation::_outputSurfaceMeshThread, this,
-                                particles, tempSolidSDF, vfield, sourceID);
+                                particles, tempSolidSDF, vfield, sourceID, isParticleDataOwned);
 
     if (!_isAsynchronousMeshingEnabled && _mesherThread.joinable()) {
         _mesherThread.join();
@@ -9328,6 +9549,14 @@ void FluidSimulation::_joinOutputSurfaceMeshThread() {
 void FluidSimulation::_outputDiffuseMaterial() {
     if (!_isDiffuseMaterialOutputEnabled) { return; }
 
+    if (_meshOutputFormat == TriangleMeshFormat::meshcache) {
+        _diffuseMaterial.enableParticleCacheOutput();
+        _diffuseMaterial.setParticleCacheEncodeParameters(_getParticleCacheEncodeParameters());
+        _diffuseMaterial.sortDiffuseParticlesByMortonOrder();
+    } else {
+        _diffuseMaterial.disableParticleCacheOutput();
+    }
+
     if (_isDiffuseMaterialFilesSeparated) {
         _diffuseMaterial.getFoamParticleFileDataWWP(_outputData.diffuseFoamData);
         _diffuseMaterial.getBubbleParticleFileDataWWP(_outputData.diffuseBubbleData);
@@ -9555,124 +9784,369 @@ void FluidSimulation::_generateFluidParticleDataFFP3(ParticleSystem &fluidPartic
     std::vector<MarkerParticleType> fluidParticleTypes;
     _classifyFluidParticleTypes(_markerParticles, fluidParticleTypes);
 
-    bool isSurfaceEnabled = _isFluidParticleSurfaceOutputEnabled;
-    bool isBoundaryEnabled = _isFluidParticleBoundaryOutputEnabled;
-    bool isInteriorEnabled = _isFluidParticleInteriorOutputEnabled;
-    bool isSourceIDEnabled = _isFluidParticleSourceIDAttributeEnabled;
-    int skipSourceID = _fluidParticleSourceIDBlacklist;
-
     std::vector<uint16_t> *particle_ids;
     _markerParticles.getAttributeValues("ID", particle_ids);
     int idLimit = _getFluidParticleOutputIDLimit();
 
     std::vector<int> *source_ids = NULL;
-    if (isSourceIDEnabled) {
+    if (_isFluidParticleSourceIDAttributeEnabled) {
         _markerParticles.getAttributeValues("SOURCEID", source_ids);
     }
 
-    int numsurface = 0;
-    int numboundary = 0;
-    int numinterior = 0;
-    for (size_t i = 0; i < fluidParticleTypes.size(); i++) {
-        MarkerParticleType ptype = fluidParticleTypes[i];
-        uint16_t pid = particle_ids->at(i);
-        if (pid >= idLimit) {
-            continue;
+    // Particles are bucketed by group (surface, boundary, interior) and then
+    // by ID. Each thread counts its own range so that the scatter pass can
+    // write in the same order as a serial pass.
+    size_t numParticles = fluidParticleTypes.size();
+    int particlesPerThread = 100000;
+    int workerThreads = (int)(numParticles / particlesPerThread) + 1;
+    int numthreads = std::min(ThreadUtils::getMaxThreadCount(), workerThreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numParticles, numthreads);
+
+    std::vector<char> particleGroups(numParticles, -1);
+    std::vector<std::vector<unsigned int> > threadBinCounts(numthreads);
+    std::vector<std::thread> threads(numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&FluidSimulation::_countFluidParticleBinsFFP3Thread, this,
+                                 intervals[i], intervals[i + 1], idLimit,
+                                 &fluidParticleTypes, particle_ids, source_ids,
+                                 &particleGroups, &(threadBinCounts[i]));
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    int numBins = 3 * idLimit;
+    std::vector<unsigned int> binCounts(numBins, 0);
+    for (int t = 0; t < numthreads; t++) {
+        for (int b = 0; b < numBins; b++) {
+            binCounts[b] += threadBinCounts[t][b];
         }
+    }
 
-        if (isSourceIDEnabled && skipSourceID >= 0) {
-            if (source_ids->at(i) == skipSourceID) {
-                continue;
-            }
+    // idHeaderData holds the exclusive end of each ID bin within its group
+    std::vector<unsigned int> idHeaderData[3];
+    unsigned int groupSizes[3] = {0, 0, 0};
+    for (int g = 0; g < 3; g++) {
+        idHeaderData[g] = std::vector<unsigned int>(idLimit, 0);
+        unsigned int currentIndex = 0;
+        for (int id = 0; id < idLimit; id++) {
+            currentIndex += binCounts[g * idLimit + id];
+            idHeaderData[g][id] = currentIndex;
         }
+        groupSizes[g] = currentIndex;
+    }
+
+    unsigned int groupOffsets[3] = {0, groupSizes[0], groupSizes[0] + groupSizes[1]};
+    std::vector<unsigned int> binOffsets(numBins, 0);
+    for (int g = 0; g < 3; g++) {
+        for (int id = 0; id < idLimit; id++) {
+            int b = g * idLimit + id;
+            binOffsets[b] = groupOffsets[g] + idHeaderData[g][id] - binCounts[b];
+        }
+    }
 
-        if (isSurfaceEnabled && ptype == MarkerParticleType::surface) {
-            numsurface++;
-        } else if (isBoundaryEnabled && ptype == MarkerParticleType::boundary) {
-            numboundary++;
-        } else if (isInteriorEnabled && ptype == MarkerParticleType::interior) {
-            numinterior++;
+    for (int t = 0; t < numthreads; t++) {
+        for (int b = 0; b < numBins; b++) {
+            unsigned int count = threadBinCounts[t][b];
+            threadBinCounts[t][b] = binOffsets[b];
+            binOffsets[b] += count;
         }
     }
-    int indexOffsetSurface = 0;
-    int indexOffsetBoundary = numsurface;
-    int indexOffsetInterior = numsurface + numboundary;
 
-    std::vector<unsigned int> idCountsSurface(idLimit, 0);
-    std::vector<unsigned int> idCountsBoundary(idLimit, 0);
-    std::vector<unsigned int> idCountsInterior(idLimit, 0);
-    for (size_t i = 0; i < fluidParticleTypes.size(); i++) {
-        MarkerParticleType ptype = fluidParticleTypes[i];
-        uint16_t pid = particle_ids->at(i);
-        if (ptype == MarkerParticleType::unset || pid >= idLimit) {
+    dataFFP3.sortedFluidParticleIndexTable = std::vector<int>(numParticles, -1);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&FluidSimulation::_scatterFluidParticleBinsFFP3Thread, this,
+                                 intervals[i], intervals[i + 1], idLimit,
+                                 particle_ids, &particleGroups, &(threadBinCounts[i]),
+                                 &(dataFFP3.sortedFluidParticleIndexTable));
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    dataFFP3.numFluidParticles = groupSizes[0] + groupSizes[1] + groupSizes[2];
+    dataFFP3.numFluidParticlesSurface = groupSizes[0];
+    dataFFP3.numFluidParticlesBoundary = groupSizes[1];
+    dataFFP3.numFluidParticlesInterior = groupSizes[2];
+
+    dataFFP3.idLimit = idLimit;
+    dataFFP3.idHeaderDataSurface = idHeaderData[0];
+    dataFFP3.idHeaderDataBoundary = idHeaderData[1];
+    dataFFP3.idHeaderDataInterior = idHeaderData[2];
+
+    if (_meshOutputFormat == TriangleMeshFormat::meshcache) {
+        _sortFluidParticleDataFFP3ByMortonOrder(dataFFP3);
+    }
+}
+
+void FluidSimulation::_countFluidParticleBinsFFP3Thread(int startidx, int endidx, int idLimit,
+                                                        std::vector<MarkerParticleType> *fluidParticleTypes,
+                                                        std::vector<uint16_t> *particleIDs,
+                                                        std::vector<int> *sourceIDs,
+                                                        std::vector<char> *particleGroups,
+                                                        std::vector<unsigned int> *binCounts) {
+    bool isGroupEnabled[3] = {_isFluidParticleSurfaceOutputEnabled,
+                              _isFluidParticleBoundaryOutputEnabled,
+                              _isFluidParticleInteriorOutputEnabled};
+    bool isSourceIDSkipped = _isFluidParticleSourceIDAttributeEnabled && 
+                             _fluidParticleSourceIDBlacklist >= 0;
+    int skipSourceID = _fluidParticleSourceIDBlacklist;
+
+    *binCounts = std::vector<unsigned int>(3 * idLimit, 0);
+    for (int i = startidx; i < endidx; i++) {
+        int pid = particleIDs->at(i);
+        if (pid >= idLimit) {
+            continue;
+        }
+
+        if (isSourceIDSkipped && sourceIDs->at(i) == skipSourceID) {
             continue;
         }
 
-        if (isSourceIDEnabled && skipSourceID >= 0) {
-            if (source_ids->at(i) == skipSourceID) {
-                continue;
-            }
+        int group = -1;
+        MarkerParticleType ptype = fluidParticleTypes->at(i);
+        if (ptype == MarkerParticleType::surface) {
+            group = 0;
+        } else if (ptype == MarkerParticleType::boundary) {
+            group = 1;
+        } else if (ptype == MarkerParticleType::interior) {
+            group = 2;
         }
 
-        if (isSurfaceEnabled && ptype == MarkerParticleType::surface) {
-            idCountsSurface[pid]++;
-        } else if (isBoundaryEnabled && ptype == MarkerParticleType::boundary) {
-            idCountsBoundary[pid]++;
-        } else if (isInteriorEnabled && ptype == MarkerParticleType::interior) {
-            idCountsInterior[pid]++;
+        if (group == -1 || !isGroupEnabled[group]) {
+            continue;
         }
-    }
 
-    std::vector<unsigned int> idBinStartIndexSurface(idLimit, 0);
-    std::vector<unsigned int> idBinStartIndexBoundary(idLimit, 0);
-    std::vector<unsigned int> idBinStartIndexInterior(idLimit, 0);
-    unsigned int currentIndexSurface = 0;
-    unsigned int currentIndexBoundary = 0;
-    unsigned int currentIndexInterior = 0;
-    for (size_t i = 0; i < (size_t)idLimit; i++) {
-        idBinStartIndexSurface[i] = currentIndexSurface;
-        idBinStartIndexBoundary[i] = currentIndexBoundary;
-        idBinStartIndexInterior[i] = currentIndexInterior;
-        currentIndexSurface += idCountsSurface[i];
-        currentIndexBoundary += idCountsBoundary[i];
-        currentIndexInterior += idCountsInterior[i];
+        particleGroups->at(i) = (char)group;
+        binCounts->at(group * idLimit + pid)++;
     }
+}
 
-    dataFFP3.sortedFluidParticleIndexTable = std::vector<int>(fluidParticleTypes.size(), -1);
-    for (size_t i = 0; i < fluidParticleTypes.size(); i++) {
-        MarkerParticleType ptype = fluidParticleTypes[i];
-        uint16_t pid = particle_ids->at(i);
-        if (ptype == MarkerParticleType::unset || pid >= idLimit) {
+void FluidSimulation::_scatterFluidParticleBinsFFP3Thread(int startidx, int endidx, int idLimit,
+                                                          std::vector<uint16_t> *particleIDs,
+                                                          std::vector<char> *particleGroups,
+                                                          std::vector<unsigned int> *binOffsets,
+                                                          std::vector<int> *sortedIndexTable) {
+    for (int i = startidx; i < endidx; i++) {
+        int group = particleGroups->at(i);
+        if (group == -1) {
             continue;
         }
 
-        if (isSourceIDEnabled && skipSourceID >= 0) {
-            if (source_ids->at(i) == skipSourceID) {
-                continue;
+        int b = group * idLimit + particleIDs->at(i);
+        sortedIndexTable->at(i) = (int)binOffsets->at(b);
+        binOffsets->at(b)++;
+    }
+}
+
+void FluidSimulation::_sortFluidParticleDataFFP3ByMortonOrder(FluidParticleDataFFP3 &dataFFP3) {
+    std::vector<int> sortedToParticleIndex(dataFFP3.numFluidParticles, -1);
+    for (size_t i = 0; i < dataFFP3.sortedFluidParticleIndexTable.size(); i++) {
+        int index = dataFFP3.sortedFluidParticleIndexTable[i];
+        if (index != -1) {
+            sortedToParticleIndex[index] = (int)i;
+        }
+    }
+
+    std::vector<unsigned int> *groupBinEnds[3] = {&(dataFFP3.idHeaderDataSurface),
+                                                  &(dataFFP3.idHeaderDataBoundary),
+                                                  &(dataFFP3.idHeaderDataInterior)};
+    std::vector<unsigned int> binStarts;
+    std::vector<unsigned int> binEnds;
+    unsigned int groupOffset = 0;
+    for (int g = 0; g < 3; g++) {
+        unsigned int previous = 0;
+        for (size_t id = 0; id < groupBinEnds[g]->size(); id++) {
+            unsigned int end = groupBinEnds[g]->at(id);
+            if (end > previous + 1) {
+                binStarts.push_back(groupOffset + previous);
+                binEnds.push_back(groupOffset + end);
             }
+            previous = end;
+        }
+        groupOffset += previous;
+    }
+
+    if (binStarts.empty()) {
+        return;
+    }
+
+    std::vector<vmath::vec3> *positions;
+    _markerParticles.getAttributeValues("POSITION", positions);
+
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, binStarts.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, binStarts.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&FluidSimulation::_sortFluidParticleDataFFP3ByMortonOrderThread, this,
+                                 intervals[i], intervals[i + 1], &binStarts, &binEnds,
+                                 &sortedToParticleIndex, positions);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    for (size_t i = 0; i < sortedToParticleIndex.size(); i++) {
+        dataFFP3.sortedFluidParticleIndexTable[sortedToParticleIndex[i]] = (int)i;
+    }
+}
+
+void FluidSimulation::_sortFluidParticleDataFFP3ByMortonOrderThread(int startidx, int endidx,
+                                                                    std::vector<unsigned int> *binStarts,
+                                                                    std::vector<unsigned int> *binEnds,
+                                                                    std::vector<int> *sortedToParticleIndex,
+                                                                    std::vector<vmath::vec3> *positions) {
+    std::vector<std::pair<unsigned long long, int> > keys;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        unsigned int start = binStarts->at(bidx);
+        unsigned int end = binEnds->at(bidx);
+
+        keys.clear();
+        for (unsigned int sidx = start; sidx < end; sidx++) {
+            int pidx = sortedToParticleIndex->at(sidx);
+            GridIndex g = Grid3d::positionToGridIndex(positions->at(pidx), _dx);
+            unsigned long long code = Grid3d::getMortonCode(std::max(g.i, 0), 
+                                                            std::max(g.j, 0), 
+                                                            std::max(g.k, 0));
+            keys.push_back(std::make_pair(code, pidx));
         }
 
-        if (isSurfaceEnabled && ptype == MarkerParticleType::surface) {
-            dataFFP3.sortedFluidParticleIndexTable[i] = indexOffsetSurface + idBinStartIndexSurface[pid];
-            idBinStartIndexSurface[pid]++;
-        } else if (isBoundaryEnabled && ptype == MarkerParticleType::boundary) {
-            dataFFP3.sortedFluidParticleIndexTable[i] = indexOffsetBoundary + idBinStartIndexBoundary[pid];
-            idBinStartIndexBoundary[pid]++;
-        } else if (isInteriorEnabled && ptype == MarkerParticleType::interior) {
-            dataFFP3.sortedFluidParticleIndexTable[i] = indexOffsetInterior + idBinStartIndexInterior[pid];
-            idBinStartIndexInterior[pid]++;
+        std::sort(keys.begin(), keys.end());
+        for (unsigned int sidx = start; sidx < end; sidx++) {
+            sortedToParticleIndex->at(sidx) = keys[sidx - start].second;
         }
     }
+}
+
+void FluidSimulation::_generateFluidParticlePositionFileData(std::vector<vmath::vec3> *positions, 
+                                                             FluidParticleDataFFP3 &dataFFP3, 
+                                                             std::vector<char> &filedata) {
+    if (_meshOutputFormat != TriangleMeshFormat::meshcache) {
+        _generateFluidParticleFFP3FileData(positions, dataFFP3, filedata);
+        return;
+    }
 
-    dataFFP3.numFluidParticles = numsurface + numboundary + numinterior;
-    dataFFP3.numFluidParticlesSurface = numsurface;
-    dataFFP3.numFluidParticlesBoundary = numboundary;
-    dataFFP3.numFluidParticlesInterior = numinterior;
+    std::vector<vmath::vec3> positionsSorted;
+    _sortFluidParticleAttributeFFP3(positions, dataFFP3, positionsSorted);
 
-    dataFFP3.idLimit = idLimit;
-    dataFFP3.idHeaderDataSurface = idBinStartIndexSurface;
-    dataFFP3.idHeaderDataBoundary = idBinStartIndexBoundary;
-    dataFFP3.idHeaderDataInterior = idBinStartIndexInterior;
+    MeshCache::ParticleChannel channel;
+    _getParticleCacheChannel(positionsSorted, channel);
+    channel.type = MeshCache::ParticleChannelType::positions;
+    _getFluidParticleCacheFileData(channel, dataFFP3, filedata);
+}
+
+void FluidSimulation::_getParticleCacheChannel(std::vector<vmath::vec3> &values, 
+                                               MeshCache::ParticleChannel &channel) {
+    channel.type = MeshCache::ParticleChannelType::floats;
+    channel.components = 3;
+    channel.values.resize(3 * values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        channel.values[3 * i + 0] = values[i].x;
+        channel.values[3 * i + 1] = values[i].y;
+        channel.values[3 * i + 2] = values[i].z;
+    }
+}
+
+void FluidSimulation::_getParticleCacheChannel(std::vector<float> &values, 
+                                               MeshCache::ParticleChannel &channel) {
+    channel.type = MeshCache::ParticleChannelType::floats;
+    channel.components = 1;
+    channel.values = values;
+}
+
+void FluidSimulation::_getParticleCacheChannel(std::vector<int> &values, 
+                                               MeshCache::ParticleChannel &channel) {
+    channel.type = MeshCache::ParticleChannelType::ints;
+    channel.components = 1;
+    channel.intValues = values;
+}
+
+void FluidSimulation::_getParticleCacheChannel(std::vector<uint16_t> &values, 
+                                               MeshCache::ParticleChannel &channel) {
+    channel.type = MeshCache::ParticleChannelType::ints;
+    channel.components = 1;
+    channel.intValues.assign(values.begin(), values.end());
+}
+
+MeshCache::ParticleEncodeParameters FluidSimulation::_getParticleCacheEncodeParameters() {
+    // Positions keep the same precision across the domain as surface meshes
+    int maxsize = std::max(std::max(_isize, _jsize), _ksize);
+    int cellBits = (int)std::ceil(std::log2((double)std::max(maxsize, 1)));
+
+    MeshCache::ParticleEncodeParameters params;
+    params.cellOrigin = _domainOffset;
+    params.cellSize = _dx * _domainScale;
+    params.positionBits = std::max(_meshCacheQuantizationBits - cellBits, 1);
+    return params;
+}
+
+void FluidSimulation::_getFluidParticleCacheFileData(MeshCache::ParticleChannel &channel, 
+                                                     FluidParticleDataFFP3 &dataFFP3, 
+                                                     std::vector<char> &filedata) {
+    std::vector<std::vector<unsigned int> > idBinEnds({dataFFP3.idHeaderDataSurface,
+                                                       dataFFP3.idHeaderDataBoundary,
+                                                       dataFFP3.idHeaderDataInterior});
+    MeshCache::encodeParticles(channel, idBinEnds, _getParticleCacheEncodeParameters(), filedata);
+}
+
+void FluidSimulation::_evaluateFluidParticleAttributes(std::vector<vmath::vec3> *transformedPositions,
+                                                       std::vector<float> *speedValues,
+                                                       std::vector<vmath::vec3> *vorticityValues,
+                                                       std::vector<float> *densityValues,
+                                                       std::vector<vmath::vec3> *proximityValues) {
+    size_t numParticles = _markerParticles.size();
+    int particlesPerThread = 50000;
+    int workerThreads = (int)(numParticles / particlesPerThread) + 1;
+    int numthreads = std::min(ThreadUtils::getMaxThreadCount(), workerThreads);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numParticles, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&FluidSimulation::_evaluateFluidParticleAttributesThread, this,
+                                 intervals[i], intervals[i + 1],
+                                 transformedPositions, speedValues, vorticityValues, 
+                                 densityValues, proximityValues);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void FluidSimulation::_evaluateFluidParticleAttributesThread(int startidx, int endidx,
+                                                             std::vector<vmath::vec3> *transformedPositions,
+                                                             std::vector<float> *speedValues,
+                                                             std::vector<vmath::vec3> *vorticityValues,
+                                                             std::vector<float> *densityValues,
+                                                             std::vector<vmath::vec3> *proximityValues) {
+    std::vector<vmath::vec3> *positions;
+    _markerParticles.getAttributeValues("POSITION", positions);
+
+    std::vector<vmath::vec3> *velocities = NULL;
+    if (speedValues != NULL) {
+        _markerParticles.getAttributeValues("VELOCITY", velocities);
+    }
+
+    for (int i = startidx; i < endidx; i++) {
+        vmath::vec3 p = positions->at(i);
+        (*transformedPositions)[i] = p * _domainScale + _domainOffset;
+
+        if (speedValues != NULL) {
+            (*speedValues)[i] = velocities->at(i).length();
+        }
+        if (vorticityValues != NULL) {
+            (*vorticityValues)[i] = Interpolation::trilinearInterpolate(p, _dx, _vorticityAttributeGrid);
+        }
+        if (densityValues != NULL) {
+            (*densityValues)[i] = Interpolation::trilinearInterpolate(p, _dx, _densityAttributeGrid);
+        }
+        if (proximityValues != NULL) {
+            (*proximityValues)[i] = Interpolation::trilinearInterpolate(p, _dx, _whitewaterProximityAttributeGrid);
+        }
+    }
 }
 
 void FluidSimulation::_outputFluidParticles() {
@@ -9696,12 +10170,36 @@ void FluidSimulation::_outputFluidParticles() {
     std::vector<vmath::vec3> *positions;
     _markerParticles.getAttributeValues("POSITION", positions);
 
-    std::vector<vmath::vec3> transformedPositions = *positions;
-    for (size_t i = 0; i < transformedPositions.size(); i++) {
-        transformedPositions[i] = transformedPositions[i] * _domainScale + _domainOffset;
+    // Position transform and all interpolated attributes are evaluated in a
+    // single parallel pass over the particles
+    size_t numParticles = positions->size();
+    std::vector<vmath::vec3> transformedPositions(numParticles);
+    std::vector<float> speedValues;
+    std::vector<vmath::vec3> vorticityValues;
+    std::vector<float> densityValues;
+    std::vector<vmath::vec3> proximityValues;
+    if (_isFluidParticleSpeedAttributeEnabled) {
+        speedValues = std::vector<float>(numParticles, 0.0f);
+    }
+    if (_isFluidParticleVorticityAttributeEnabled) {
+        vorticityValues = std::vector<vmath::vec3>(numParticles);
+    }
+    if (_isFluidParticleDensityAttributeEnabled) {
+        densityValues = std::vector<float>(numParticles, 0.0f);
+    }
+    if (_isFluidParticleWhitewaterProximityAttributeEnabled) {
+        proximityValues = std::vector<vmath::vec3>(numParticles);
     }
 
-    _generateFluidParticleFFP3FileData(&transformedPositions, dataFFP3, _outputData.fluidParticleData);
+    _evaluateFluidParticleAttributes(
+        &transformedPositions, 
+        _isFluidParticleSpeedAttributeEnabled ? &speedValues : NULL,
+        _isFluidParticleVorticityAttributeEnabled ? &vorticityValues : NULL,
+        _isFluidParticleDensityAttributeEnabled ? &densityValues : NULL,
+        _isFluidParticleWhitewaterProximityAttributeEnabled ? &proximityValues : NULL
+    );
+
+    _generateFluidParticlePositionFileData(&transformedPositions, dataFFP3, _outputData.fluidParticleData);
 
     _outputData.frameData.fluidparticles.enabled = 1;
     _outputData.frameData.fluidparticles.vertices = dataFFP3.numFluidParticles;
@@ -9752,14 +10250,6 @@ void FluidSimulation::_outputFluidParticles() {
         Fluid Particle Speed
     */
     if (_isFluidParticleSpeedAttributeEnabled) {
-        std::vector<vmath::vec3> *velocities;
-        _markerParticles.getAttributeValues("VELOCITY", velocities);
-
-        std::vector<float> speedValues(velocities->size(), 0.0f);
-        for (size_t i = 0; i < velocities->size(); i++) {
-            speedValues[i] = velocities->at(i).length();
-        }
-
         _generateFluidParticleFFP3FileData(&speedValues, dataFFP3, _outputData.fluidParticleSpeedAttributeData);
 
         _outputData.frameData.fluidparticlesspeed.enabled = 1;
@@ -9772,14 +10262,6 @@ void FluidSimulation::_outputFluidParticles() {
         Fluid Particle Vorticity
     */
     if (_isFluidParticleVorticityAttributeEnabled) {
-        // TODO: Multithread vorticity interpolation
-        vmath::vec3 offset(0.5 * _dx, 0.5 * _dx, 0.5 * _dx);
-        std::vector<vmath::vec3> vorticityValues(positions->size());
-        for (size_t i = 0; i < positions->size(); i++) {
-            vmath::vec3 p = positions->at(i);
-            vorticityValues[i] = Interpolation::trilinearInterpolate(p, _dx, _vorticityAttributeGrid);
-        }
-
         _generateFluidParticleFFP3FileData(&vorticityValues, dataFFP3, _outputData.fluidParticleVorticityAttributeData);
 
         _outputData.frameData.fluidparticlesvorticity.enabled = 1;
@@ -9859,13 +10341,6 @@ void FluidSimulation::_outputFluidParticles() {
         _outputData.frameData.fluidparticlesdensity.bytes = (unsigned int)_outputData.fluidParticleDensityAttributeData.size();
 
         // Density Average
-        // TODO: Multithread density interpolation
-        std::vector<float> densityValues(positions->size());
-        for (size_t i = 0; i < positions->size(); i++) {
-            vmath::vec3 p = positions->at(i);
-            densityValues[i] = Interpolation::trilinearInterpolate(p, _dx, _densityAttributeGrid);
-        }
-
         _generateFluidParticleFFP3FileData(&densityValues, dataFFP3, _outputData.fluidParticleDensityAverageAttributeData);
 
         _outputData.frameData.fluidparticlesdensityaverage.enabled = 1;
@@ -9878,13 +10353,6 @@ void FluidSimulation::_outputFluidParticles() {
         Fluid Particle Whitewater Proximity
     */
     if (_isFluidParticleWhitewaterProximityAttributeEnabled) {
-        // TODO: Multithread whitewater proximity interpolation
-        std::vector<vmath::vec3> proximityValues(positions->size());
-        for (size_t i = 0; i < positions->size(); i++) {
-            vmath::vec3 p = positions->at(i); 
-            proximityValues[i] = Interpolation::trilinearInterpolate(p, _dx, _whitewaterProximityAttributeGrid);
-        }
-
         _generateFluidParticleFFP3FileData(&proximityValues, dataFFP3, _outputData.fluidParticleWhitewaterProximityAttributeData);
 
         _outputData.frameData.fluidparticleswhitewaterproximity.enabled = 1;
@@ -10388,6 +10856,18 @@ void FluidSimulation::_logStepInfo() {
         _logfile.logString(dss.str());
     }
 
+    if (_isAdaptiveMarkerParticleAdvectionEnabled) {
+        AdvectionIntegratorCounts counts = _currentAdvectionIntegratorCounts;
+        std::stringstream ass;
+        ass << "Advection Integrators:" << std::endl << 
+          "    Euler:         " << counts.euler << std::endl << 
+          "    RK2:           " << counts.rk2 << std::endl << 
+          "    RK3:           " << counts.rk3 << std::endl << 
+          "    RK4:           " << counts.rk4;
+        _logfile.newline();
+        _logfile.logString(ass.str());
+    }
+
     if (_pressureSolverStatus.size() > 0) {
         _logfile.newline();
         _logfile.logString(_pressureSolverStatus);
@@ -10445,6 +10925,7 @@ void FluidSimulation::update(double dt) {
     _viscositySolverSuccess = true;
     _viscositySolverIterations = 0;
     _viscositySolverError = 0.0f;
+    _frameAdvectionIntegratorCounts = AdvectionIntegratorCounts();
 
     size_t totalFluidParticlesProcessed = 0;
     double totalFluidParticlesProcessedTime = 0.0f;
@@ -10533,6 +11014,11 @@ void FluidSimulation::update(double dt) {
     _outputData.frameData.viscositySolverIterations = _viscositySolverIterations;
     _outputData.frameData.viscositySolverMaxIterations = getViscositySolverMaxIterations();
 
+    _outputData.frameData.advectionEulerSteps = _frameAdvectionIntegratorCounts.euler;
+    _outputData.frameData.advectionRK2Steps = _frameAdvectionIntegratorCounts.rk2;
+    _outputData.frameData.advectionRK3Steps = _frameAdvectionIntegratorCounts.rk3;
+    _outputData.frameData.advectionRK4Steps = _frameAdvectionIntegratorCounts.rk4;
+
     _outputData.isInitialized = true;
 
     _outputSimulationLogFile();
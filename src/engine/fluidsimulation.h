@@ -41,6 +41,7 @@ SOFTWARE.
 #include "logfile.h"
 #include "particlelevelset.h"
 #include "pressuresolver.h"
+#include "activecellindex.h"
 #include "diffuseparticlesimulation.h"
 #include "velocityadvector.h"
 #include "meshfluidsource.h"
@@ -50,6 +51,7 @@ SOFTWARE.
 #include "markerparticle.h"
 #include "viscositysolver.h"
 #include "spatialpointgrid.h"
+#include "meshcache.h"
 
 class AABB;
 class MeshFluidSource;
@@ -97,6 +99,11 @@ struct FluidSimulationFrameStats {
     int viscositySolverIterations = 0;
     int viscositySolverMaxIterations = 0;
 
+    int advectionEulerSteps = 0;
+    int advectionRK2Steps = 0;
+    int advectionRK3Steps = 0;
+    int advectionRK4Steps = 0;
+
     FluidSimulationMeshStats surface;
     FluidSimulationMeshStats preview;
     FluidSimulationMeshStats surfaceblur;
@@ -347,6 +354,28 @@ public:
     int getPressureSolverMaxIterations();
     void setPressureSolverMaxIterations(int n);
 
+    /*
+        Advect marker particles with an integrator chosen per particle from
+        the local CFL number and velocity gradient. Calm regions use Euler
+        or RK2 steps, while obstacles and high shear regions use RK3 or RK4.
+        If disabled, all particles are advected with RK3.
+    */
+    void enableAdaptiveMarkerParticleAdvection();
+    void disableAdaptiveMarkerParticleAdvection();
+    bool isAdaptiveMarkerParticleAdvectionEnabled();
+
+    /*
+        Solve the pressure system in single precision with double precision
+        accumulation. Iterative refinement recovers the full pressure solve
+        tolerance from the single precision solves.
+    */
+    void enableMixedPrecisionPressureSolve();
+    void disableMixedPrecisionPressureSolve();
+    bool isMixedPrecisionPressureSolveEnabled();
+    void enablePressureSolveIterativeRefinement();
+    void disablePressureSolveIterativeRefinement();
+    bool isPressureSolveIterativeRefinementEnabled();
+
     int getViscositySolverMaxIterations();
     void setViscositySolverMaxIterations(int n);
 
@@ -451,6 +480,15 @@ public:
     void setMeshOutputFormatAsPLY();
     void setMeshOutputFormatAsBOBJ();
 
+    /*
+        Compact mesh cache format. Vertex positions are quantized to the
+        given number of bits per axis (16 by default) and float attributes
+        are stored as quantized channels. See meshcache.h.
+    */
+    void setMeshOutputFormatAsMeshCache();
+    int getMeshCacheQuantizationBits();
+    void setMeshCacheQuantizationBits(int bits);
+
     /*
         Enable/disable simulation info to console.
 
@@ -1625,6 +1663,21 @@ private:
         bool isInitialized = false;
     };
 
+    struct MarkerParticleAttributeGrids {
+        Array3d<float> *age = nullptr;
+        Array3d<bool> *ageValid = nullptr;
+        Array3d<float> *lifetime = nullptr;
+        Array3d<bool> *lifetimeValid = nullptr;
+        Array3d<float> *viscosity = nullptr;
+        Array3d<bool> *viscosityValid = nullptr;
+        Array3d<float> *density = nullptr;
+        Array3d<bool> *densityValid = nullptr;
+        Array3d<float> *colorR = nullptr;
+        Array3d<float> *colorG = nullptr;
+        Array3d<float> *colorB = nullptr;
+        Array3d<bool> *colorValid = nullptr;
+    };
+
     struct MarkerParticleLoadData {
         FragmentedVector<MarkerParticle> particles;
     };
@@ -1665,6 +1718,13 @@ private:
         FragmentedVector<MarkerParticleID> particles;
     };
 
+    struct AdvectionIntegratorCounts {
+        int euler = 0;
+        int rk2 = 0;
+        int rk3 = 0;
+        int rk4 = 0;
+    };
+
 
     struct MarkerParticleAttributes {
         int sourceID = 0;
@@ -1905,7 +1965,6 @@ private:
     void _updateMarkerParticleVelocitiesThread();
     void _updatePICFLIPMarkerParticleVelocitiesThread(int startidx, int endidx);
     void _updatePICAPICMarkerParticleVelocitiesThread(int startidx, int endidx);
-    void _getIndicesAndGradientWeights(vmath::vec3 p, GridIndex indices[8], vmath::vec3 weights[8], int dir);
     void _constrainMarkerParticleVelocities();
     void _constrainMarkerParticleVelocities(MeshFluidSource *inflow);
 
@@ -1916,25 +1975,16 @@ private:
     void _updateMarkerParticleVelocityAttributeGrid();
     void _updateMarkerParticleVelocityBasedAttributes();
     void _updateMarkerParticleVorticityAttributeGrid();
-    void _updateMarkerParticleAgeAttributeGrid(Array3d<float> &ageAttributeGrid,
-                                               Array3d<bool> &ageAttributeValidGrid);
+    void _transferMarkerParticleAttributesToGrids(ParticleSystem &particles, double dx,
+                                                  MarkerParticleAttributeGrids &grids);
+    void _updateMarkerParticleAttributeGrids();
     void _updateMarkerParticleAgeAttribute(double dt);
-    void _updateMarkerParticleLifetimeAttributeGrid(Array3d<float> &lifetimeAttributeGrid,
-                                               Array3d<bool> &lifetimeAttributeValidGrid);
     void _updateMarkerParticleLifetimeAttribute(double dt);
     void _updateMarkerParticleWhitewaterProximityAttributeGrid(Array3d<vmath::vec3> &whitewaterProximityAttributeGrid,
                                                                Array3d<bool> &whitewaterProximityAttributeValidGrid);
     void _updateMarkerParticleWhitewaterProximityAttribute();
-    void _updateMarkerParticleViscosityAttributeGrid(Array3d<float> &viscosityAttributeGrid,
-                                                     Array3d<bool> &viscosityAttributeValidGrid);
-    void _updateMarkerParticleViscosityAttribute();
     void _updateMarkerParticleDensityAttributeGrid(Array3d<float> &densityAttributeGrid,
                                                      Array3d<bool> &densityAttributeValidGrid);
-    void _updateMarkerParticleDensityAttribute();
-    void _updateMarkerParticleColorAttributeGrid(Array3d<float> &colorAttributeGridR,
-                                                 Array3d<float> &colorAttributeGridG,
-                                                 Array3d<float> &colorAttributeGridB,
-                                                 Array3d<bool> &colorAttributeValidGrid);
     void _updateMarkerParticleColorAttributeMixing(double dt);
     vmath::vec3 _RGBToHSV(vmath::vec3 in);
     vmath::vec3 _HSVToRGB(vmath::vec3 in);
@@ -1942,7 +1992,7 @@ private:
                                                          SpatialPointGrid *pointGrid,
                                                          std::vector<vmath::vec3> *colors,
                                                          std::vector<vmath::vec3> *colorsNew,
-                                                         std::vector<bool> *colorsNewValid);
+                                                         std::vector<char> *colorsNewValid);
     void _updateMarkerParticleColorAttribute(double dt);
     void _updateMarkerParticleUIDAttribute();
     void _updateMarkerParticleAttributes(double dt);
@@ -1953,8 +2003,17 @@ private:
     void _advanceMarkerParticles(double dt);
     void _advanceMarkerParticlesThread(double dt, int startidx, int endidx,
                                        std::vector<vmath::vec3> *positions,
-                                       std::vector<vmath::vec3> *output);
-    vmath::vec3 _RK3(vmath::vec3 p0, double dt);
+                                       std::vector<vmath::vec3> *output,
+                                       AdvectionIntegratorCounts *counts);
+    void _RK3(vmath::vec3 *positions, int numPositions, double dt, vmath::vec3 *output);
+    void _adaptiveRK(vmath::vec3 *positions, int numPositions, double dt, 
+                     vmath::vec3 *output, AdvectionIntegratorCounts *counts);
+    int _getAdvectionIntegratorOrder(vmath::vec3 p, vmath::vec3 v, 
+                                     vmath::vec3 gradU, vmath::vec3 gradV, vmath::vec3 gradW, 
+                                     double dt);
+    void _evaluateAdvectionStage(std::vector<int> &indices, 
+                                 std::vector<vmath::vec3> &stagePositions,
+                                 std::vector<vmath::vec3> &k);
 
     void _resolveMarkerParticleCollisions(int startidx, int endidx,
                                           std::vector<vmath::vec3> &positionsOld, 
@@ -1993,16 +2052,42 @@ private:
                                vmath::vec3 velocity,
                                MarkerParticleAttributes attributes,
                                ParticleMaskGrid &maskgrid);
-    void _addNewFluidCellsThread(int startidx, int endidx,
-                                 std::vector<GridIndex> *cells, 
-                                 MeshLevelSet *meshSDF,
-                                 vmath::vec3 sdfoffset,
-                                 std::vector<vmath::vec3> *particles);
+    void _addNewFluidCellsAABBThread(int startk, int endk, 
+                                     GridIndex g1, GridIndex g2,
+                                     ParticleMaskGrid *maskgrid,
+                                     unsigned int seed,
+                                     std::vector<vmath::vec3> *particles);
+    void _generateNewFluidCellParticles(std::vector<GridIndex> &cells, 
+                                        MeshLevelSet &meshSDF,
+                                        vmath::vec3 sdfoffset,
+                                        ParticleMaskGrid &maskgrid,
+                                        std::vector<std::vector<vmath::vec3> > &particleVectors);
+    void _generateNewFluidCellParticlesThread(int startidx, int endidx,
+                                              std::vector<GridIndex> *cells, 
+                                              MeshLevelSet *meshSDF,
+                                              vmath::vec3 sdfoffset,
+                                              ParticleMaskGrid *maskgrid,
+                                              unsigned int seed,
+                                              std::vector<vmath::vec3> *particles);
+    void _appendNewFluidParticles(std::vector<std::vector<vmath::vec3> > &particleVectors,
+                                  vmath::vec3 velocity,
+                                  RigidBodyVelocity *rvelocity,
+                                  VelocityFieldData *vdata,
+                                  MarkerParticleAttributes attributes,
+                                  ParticleMaskGrid &maskgrid);
+    void _appendNewFluidParticlesThread(std::vector<vmath::vec3> *particles, 
+                                        size_t offset,
+                                        vmath::vec3 velocity,
+                                        RigidBodyVelocity *rvelocity,
+                                        VelocityFieldData *vdata,
+                                        MarkerParticleAttributes attributes);
         
     void _updateMeshFluidSources();
     void _updateInflowMeshFluidSources();
     void _updateOutflowMeshFluidSources();
     void _updateOutflowBoundary();
+    void _getInflowEmissionFrameInterpolations(MeshFluidSource *source,
+                                               std::vector<float> &frameInterpolations);
     void _updateInflowMeshFluidSource(MeshFluidSource *source, ParticleMaskGrid &maskgrid);
     void _updateOutflowMeshFluidSource(MeshFluidSource *source);
     int _getNumFluidCells();
@@ -2025,25 +2110,63 @@ private:
     void _outputSurfaceMeshThread(std::vector<vmath::vec3> *particles,
                                   MeshLevelSet *solidSDF,
                                   MACVelocityField *vfield,
-                                  std::vector<int> *sourceID);
+                                  std::vector<int> *sourceID,
+                                  bool isParticleDataOwned);
     void _updateMeshingVolumeSDF();
-    void _applyMeshingVolumeToSDF(MeshLevelSet *sdf);
     void _filterParticlesOutsideMeshingVolume(std::vector<vmath::vec3> *particles);
     void _launchOutputSurfaceMeshThread();
     void _joinOutputSurfaceMeshThread();
     void _outputDiffuseMaterial();
 
     template<class T>
-    void _generateFluidParticleFFP3FileData(std::vector<T> *attribute, FluidParticleDataFFP3 &dataFFP3, 
-                                            std::vector<char> &filedata) {
+    void _sortFluidParticleAttributeFFP3(std::vector<T> *attribute, FluidParticleDataFFP3 &dataFFP3, 
+                                         std::vector<T> &attributeSorted) {
+        attributeSorted = std::vector<T>(dataFFP3.numFluidParticles);
+
+        // Sorted indices are unique, so each thread can scatter its range directly
+        size_t numParticles = dataFFP3.sortedFluidParticleIndexTable.size();
+        int particlesPerThread = 100000;
+        int workerThreads = (int)(numParticles / particlesPerThread) + 1;
+        int numthreads = std::min(ThreadUtils::getMaxThreadCount(), workerThreads);
+        std::vector<std::thread> threads(numthreads);
+        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numParticles, numthreads);
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&FluidSimulation::_sortFluidParticleAttributeFFP3Thread<T>, this,
+                                     intervals[i], intervals[i + 1],
+                                     attribute, &dataFFP3, &attributeSorted);
+        }
+
+        for (int i = 0; i < numthreads; i++) {
+            threads[i].join();
+        }
+    }
 
-        std::vector<T> attributeSorted(dataFFP3.numFluidParticles);
-        for (size_t i = 0; i < dataFFP3.sortedFluidParticleIndexTable.size(); i++) {
-            int index = dataFFP3.sortedFluidParticleIndexTable[i];
+    template<class T>
+    void _sortFluidParticleAttributeFFP3Thread(int startidx, int endidx, 
+                                               std::vector<T> *attribute, 
+                                               FluidParticleDataFFP3 *dataFFP3, 
+                                               std::vector<T> *attributeSorted) {
+        for (int i = startidx; i < endidx; i++) {
+            int index = dataFFP3->sortedFluidParticleIndexTable[i];
             if (index == -1) {
                 continue;
             }
-            attributeSorted[index] = attribute->at(i);
+            (*attributeSorted)[index] = attribute->at(i);
+        }
+    }
+
+    template<class T>
+    void _generateFluidParticleFFP3FileData(std::vector<T> *attribute, FluidParticleDataFFP3 &dataFFP3, 
+                                            std::vector<char> &filedata) {
+
+        std::vector<T> attributeSorted;
+        _sortFluidParticleAttributeFFP3(attribute, dataFFP3, attributeSorted);
+
+        if (_meshOutputFormat == TriangleMeshFormat::meshcache) {
+            MeshCache::ParticleChannel channel;
+            _getParticleCacheChannel(attributeSorted, channel);
+            _getFluidParticleCacheFileData(channel, dataFFP3, filedata);
+            return;
         }
 
         size_t infoHeaderBytes = 4 * sizeof(unsigned int);
@@ -2077,6 +2200,45 @@ private:
                                            Array3d<bool> *isBoundaryCell,
                                            std::vector<MarkerParticleType> *fluidParticleTypes);
     void _generateFluidParticleDataFFP3(ParticleSystem &fluidParticles, FluidParticleDataFFP3 &dataFFP3);
+    void _countFluidParticleBinsFFP3Thread(int startidx, int endidx, int idLimit,
+                                           std::vector<MarkerParticleType> *fluidParticleTypes,
+                                           std::vector<uint16_t> *particleIDs,
+                                           std::vector<int> *sourceIDs,
+                                           std::vector<char> *particleGroups,
+                                           std::vector<unsigned int> *binCounts);
+    void _scatterFluidParticleBinsFFP3Thread(int startidx, int endidx, int idLimit,
+                                             std::vector<uint16_t> *particleIDs,
+                                             std::vector<char> *particleGroups,
+                                             std::vector<unsigned int> *binOffsets,
+                                             std::vector<int> *sortedIndexTable);
+    void _sortFluidParticleDataFFP3ByMortonOrder(FluidParticleDataFFP3 &dataFFP3);
+    void _sortFluidParticleDataFFP3ByMortonOrderThread(int startidx, int endidx,
+                                                       std::vector<unsigned int> *binStarts,
+                                                       std::vector<unsigned int> *binEnds,
+                                                       std::vector<int> *sortedToParticleIndex,
+                                                       std::vector<vmath::vec3> *positions);
+    void _generateFluidParticlePositionFileData(std::vector<vmath::vec3> *positions, 
+                                                FluidParticleDataFFP3 &dataFFP3, 
+                                                std::vector<char> &filedata);
+    void _getParticleCacheChannel(std::vector<vmath::vec3> &values, MeshCache::ParticleChannel &channel);
+    void _getParticleCacheChannel(std::vector<float> &values, MeshCache::ParticleChannel &channel);
+    void _getParticleCacheChannel(std::vector<int> &values, MeshCache::ParticleChannel &channel);
+    void _getParticleCacheChannel(std::vector<uint16_t> &values, MeshCache::ParticleChannel &channel);
+    MeshCache::ParticleEncodeParameters _getParticleCacheEncodeParameters();
+    void _getFluidParticleCacheFileData(MeshCache::ParticleChannel &channel, 
+                                        FluidParticleDataFFP3 &dataFFP3, 
+                                        std::vector<char> &filedata);
+    void _evaluateFluidParticleAttributes(std::vector<vmath::vec3> *transformedPositions,
+                                          std::vector<float> *speedValues,
+                                          std::vector<vmath::vec3> *vorticityValues,
+                                          std::vector<float> *densityValues,
+                                          std::vector<vmath::vec3> *proximityValues);
+    void _evaluateFluidParticleAttributesThread(int startidx, int endidx,
+                                                std::vector<vmath::vec3> *transformedPositions,
+                                                std::vector<float> *speedValues,
+                                                std::vector<vmath::vec3> *vorticityValues,
+                                                std::vector<float> *densityValues,
+                                                std::vector<vmath::vec3> *proximityValues);
     void _outputFluidParticles();
 
     float _calculateParticleSpeedPercentileThreshold(float pct);
@@ -2086,6 +2248,8 @@ private:
     std::string _numberToString(int number);
     std::string _getFrameString(int number);
     void _getTriangleMeshFileData(TriangleMesh &mesh, std::vector<char> &data);
+    void _getVectorAttributeFileData(TriangleMesh &vectorData, std::vector<char> &data);
+    void _getFloatAttributeFileData(std::vector<float> &values, std::vector<char> &data);
     void _getForceFieldDebugFileData(std::vector<ForceFieldDebugNode> &debugNodes, 
                                      std::vector<char> &data);
     void _getFluidParticleDebugFileData(std::vector<vmath::vec3> &particles, 
@@ -2096,6 +2260,7 @@ private:
     void _invertContactNormals(TriangleMesh &mesh);
     void _removeMeshNearDomain(TriangleMesh &mesh);
     void _computeDomainBoundarySDF(MeshLevelSet *sdf);
+    void _updateMeshingBoundarySDF();
     void _generateOutputSurface(TriangleMesh &surface, TriangleMesh &preview,
                                   std::vector<vmath::vec3> *particles,
                                   MeshLevelSet *soldSDF);
@@ -2180,6 +2345,8 @@ private:
     int _currentNumFluidCells = 0;
     int _currentPerformanceScore = 0;
     int _currentExtremeVelocityParticlesRemoved = 0;
+    AdvectionIntegratorCounts _currentAdvectionIntegratorCounts;
+    AdvectionIntegratorCounts _frameAdvectionIntegratorCounts;
     bool _isLastFrameTimeStep = false;
     bool _isZeroLengthDeltaTime = false;
     bool _isSkippedFrame = false;
@@ -2193,6 +2360,7 @@ private:
 
     // Update fluid material
     ParticleLevelSet _liquidSDF;
+    ActiveCellIndex _liquidCellIndex;
     std::vector<MeshFluidSource*> _meshFluidSources;
     ParticleSystem _markerParticles;
     std::vector<FluidMeshObject> _addedFluidMeshObjectQueue;
@@ -2220,6 +2388,12 @@ private:
     Array3d<bool> _nearSolidGrid;
     int _nearSolidGridCellSizeFactor = 3;
     double _nearSolidGridCellSize = 0.0f;
+
+    // Adaptive advection. Error tolerances are measured in grid cells per 
+    // step and the shear limit is the velocity gradient norm times dt
+    bool _isAdaptiveMarkerParticleAdvectionEnabled = false;
+    double _adaptiveAdvectionErrorTolerance = 0.01;
+    double _adaptiveAdvectionShearLimit = 0.5;
     bool _isFractureOptimizationEnabled = false;
 
     // Compute levelset signed distance field
@@ -2325,6 +2499,7 @@ private:
     vmath::vec3 _domainOffset;
     double _domainScale = 1.0;
     TriangleMeshFormat _meshOutputFormat = TriangleMeshFormat::ply;
+    int _meshCacheQuantizationBits = 16;
     FluidSimulationOutputData _outputData;
     TimingData _timingData;
 
@@ -2333,6 +2508,12 @@ private:
     bool _isMeshingVolumeSet = false;
     bool _isMeshingVolumeLevelSetUpToDate = false;
 
+    // Static part of the surface meshing solid boundary: the domain boundary
+    // SDF or the offset meshing volume SDF
+    MeshLevelSet _meshingBoundarySDF;
+    bool _isMeshingBoundarySDFSet = false;
+    bool _isMeshingBoundarySDFUpToDate = false;
+
     bool _isAsynchronousMeshingEnabled = true;
     std::thread _mesherThread;
 
@@ -2378,6 +2559,8 @@ private:
     double _pressureSolveTolerance = 1e-9;
     double _pressureSolveAcceptableTolerance = 1.0;
     double _maxPressureSolveIterations = 900;
+    bool _isMixedPrecisionPressureSolveEnabled = false;
+    bool _isPressureSolveIterativeRefinementEnabled = true;
     std::string _pressureSolverStatus;
     bool _viscositySolverSuccess = true;
     int _viscositySolverIterations = 0;
@@ -2431,6 +2614,8 @@ private:
     Array3d<float> _densityAttributeGrid;
     Array3d<bool> _densityAttributeValidGrid;
     float _densityAttributeRadius = 1.0f;   // In # of voxels
+    Array3d<float> _pressureDensityGrid;
+    Array3d<bool> _pressureDensityValidGrid;
 
     Array3d<float> _colorAttributeGridR;
     Array3d<float> _colorAttributeGridG;
@@ -2440,6 +2625,8 @@ private:
     float _colorAttributeMixingRate = 1.0f;
     float _colorAttributeMixingRadius = 1.0f;   // In # of voxels
     bool _isMixboxEnabled = false;
+    SpatialPointGrid _colorAttributeMixingPointGrid;
+    int _colorAttributeMixingQueryBatchSize = 1024;
     float _mixboxSaturationFactor = 1.2f;
 
     // Advance MarkerParticles
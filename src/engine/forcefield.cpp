@@ -265,6 +265,11 @@ void ForceField::setGravityScaleWidth(float w) {
     _gravityScaleWidth = w;
 }
 
+void ForceField::getGridBounds(GridIndex &gmin, GridIndex &gmax) {
+    gmin = GridIndex(0, 0, 0);
+    gmax = GridIndex(_isize, _jsize, _ksize);
+}
+
 vmath::vec3 ForceField::_limitForceVector(vmath::vec3 v, float strength) {
     float eps = 1e-6;
     float maxForce = std::abs(strength) * _maxForceLimitFactor;
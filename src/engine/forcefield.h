@@ -92,8 +92,12 @@ public:
     void setGravityScaleWidth(float w);
     
     virtual void update(double dt, double frameInterpolation) = 0;
-    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid) = 0;
-    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid) = 0;
+    virtual void getGridBounds(GridIndex &gmin, GridIndex &gmax);
+
+    // fieldGrid and scaleGrid may cover a subregion of the domain starting 
+    // at cell offset. Only faces and nodes within getGridBounds() are modified.
+    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid, GridIndex offset) = 0;
+    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid, GridIndex offset) = 0;
     virtual std::vector<vmath::vec3> generateDebugProbes() = 0;
 
 protected:
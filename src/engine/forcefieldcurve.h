@@ -35,8 +35,9 @@ public:
     virtual ~ForceFieldCurve();
 
     virtual void update(double dt, double frameInterpolation);
-    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid);
-    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid);
+    virtual void getGridBounds(GridIndex &gmin, GridIndex &gmax);
+    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid, GridIndex offset);
+    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid, GridIndex offset);
     virtual std::vector<vmath::vec3> generateDebugProbes();
 
     float getFlowStrength();
@@ -57,9 +58,9 @@ protected:
 private:
 
     void _updateGridDimensions(TriangleMesh &mesh);
-    void _addForceFieldToGridMT(MACVelocityField &fieldGrid, int dir);
+    void _addForceFieldToGridMT(MACVelocityField &fieldGrid, GridIndex offset, int dir);
     void _addForceFieldToGridThread(int startidx, int endidx, 
-                                    MACVelocityField *fieldGrid, int dir);
+                                    MACVelocityField *fieldGrid, GridIndex offset, int dir);
     TriangleMesh _curveVerticesToTriangleMesh(std::vector<vmath::vec3> vertices);
     vmath::vec3 _getFlowDirection(vmath::vec3 p);
     bool _isPositionNearEndCap(vmath::vec3 p);
@@ -29,6 +29,7 @@ SOFTWARE.
 
 #include "forcefield.h"
 #include "aabb.h"
+#include "threadutils.h"
 
 
 ForceFieldGrid::ForceFieldGrid() {
@@ -51,6 +52,7 @@ void ForceFieldGrid::initialize(int isize, int jsize, int ksize, double dx) {
     _gravityScaleGrid = ForceFieldGravityScaleGrid(_isize + 1, _jsize + 1, _ksize + 1);
     for (size_t i = 0; i < _forceFields.size(); i++) {
         _forceFields[i]->initialize(isize, jsize, ksize, dx);
+        _contributions[i] = ForceFieldContribution();
     }
 
     _isStateChanged = true;
@@ -63,24 +65,31 @@ void ForceFieldGrid::addForceField(ForceField *field) {
     }
 
     _forceFields.push_back(field);
+    _contributions.push_back(ForceFieldContribution());
     _isStateChanged = true;
 }
 
 void ForceFieldGrid::update(double dt, double frameInterpolation) {
     _updateForceFields(dt, frameInterpolation);
 
+    // Only fields that have changed are re-evaluated. The contributions of
+    // unchanged fields are cached and re-accumulated into the total grids.
+    bool isFieldChanged = false;
     for (size_t i = 0; i < _forceFields.size(); i++) {
-        if (_forceFields[i]->isStateChanged()) {
-            _isStateChanged = true;
-            break;
+        if (_forceFields[i]->isStateChanged() || !_contributions[i].isValid) {
+            _updateContribution(i);
+            isFieldChanged = true;
         }
     }
 
-    if (!_isStateChanged) {
+    if (!isFieldChanged && !_isStateChanged) {
+        if (_isGravityVectorChanged) {
+            _forceField.setOutOfRangeVector(_gravityVector);
+            _isGravityVectorChanged = false;
+        }
         return;
     }
 
-    _forceField.clear();
     _applyForceFields();
     _applyGravity();
 
@@ -89,6 +98,7 @@ void ForceFieldGrid::update(double dt, double frameInterpolation) {
     }
 
     _isStateChanged = false;
+    _isGravityVectorChanged = false;
 }
 
 vmath::vec3 ForceFieldGrid::getGravityVector() {
@@ -98,7 +108,7 @@ vmath::vec3 ForceFieldGrid::getGravityVector() {
 void ForceFieldGrid::setGravityVector(vmath::vec3 g) {
     float eps = 1e-6;
     if ((g - _gravityVector).length() > eps) {
-        _isStateChanged = true;
+        _isGravityVectorChanged = true;
     }
     _gravityVector = g;
 }
@@ -263,21 +273,114 @@ void ForceFieldGrid::_updateForceFields(double dt, double frameInterpolation) {
     }
 }
 
+void ForceFieldGrid::_updateContribution(int fieldidx) {
+    ForceField *field = _forceFields[fieldidx];
+    ForceFieldContribution *c = &(_contributions[fieldidx]);
+    c->isValid = true;
+    c->isEnabled = field->isEnabled();
+    c->isEmpty = true;
+    if (!c->isEnabled) {
+        c->forceField = MACVelocityField();
+        c->gravityScaleGrid = ForceFieldGravityScaleGrid();
+        return;
+    }
+
+    GridIndex gmin, gmax;
+    field->getGridBounds(gmin, gmax);
+    gmin = GridIndex(std::max(gmin.i, 0), std::max(gmin.j, 0), std::max(gmin.k, 0));
+    gmax = GridIndex(std::min(gmax.i, _isize), std::min(gmax.j, _jsize), std::min(gmax.k, _ksize));
+    if (gmin.i >= gmax.i || gmin.j >= gmax.j || gmin.k >= gmax.k) {
+        c->forceField = MACVelocityField();
+        c->gravityScaleGrid = ForceFieldGravityScaleGrid();
+        return;
+    }
+
+    int isize = gmax.i - gmin.i;
+    int jsize = gmax.j - gmin.j;
+    int ksize = gmax.k - gmin.k;
+
+    int ci, cj, ck;
+    c->forceField.getGridDimensions(&ci, &cj, &ck);
+    if ((ci != isize || cj != jsize || ck != ksize || 
+            c->gravityScaleGrid.gravityScale.width != isize + 1)) {
+        c->forceField = MACVelocityField(isize, jsize, ksize, _dx);
+        c->gravityScaleGrid = ForceFieldGravityScaleGrid(isize + 1, jsize + 1, ksize + 1);
+    } else {
+        c->forceField.clear();
+        c->gravityScaleGrid.reset();
+    }
+
+    c->offset = gmin;
+    c->isEmpty = false;
+    field->addForceFieldToGrid(c->forceField, c->offset);
+    field->addGravityScaleToGrid(c->gravityScaleGrid, c->offset);
+}
+
 void ForceFieldGrid::_applyForceFields() {
-    for (size_t i = 0; i < _forceFields.size(); i++) {
-        if (_forceFields[i]->isEnabled()) {
-            _forceFields[i]->addForceFieldToGrid(_forceField);
+    _forceField.clear();
+    for (size_t i = 0; i < _contributions.size(); i++) {
+        ForceFieldContribution *c = &(_contributions[i]);
+        if (!c->isEnabled || c->isEmpty) {
+            continue;
         }
+
+        _addSubgridMT(*(c->forceField.getArray3dU()), *(_forceField.getArray3dU()), c->offset, 0.0f);
+        _addSubgridMT(*(c->forceField.getArray3dV()), *(_forceField.getArray3dV()), c->offset, 0.0f);
+        _addSubgridMT(*(c->forceField.getArray3dW()), *(_forceField.getArray3dW()), c->offset, 0.0f);
     }
 }
 
 void ForceFieldGrid::_applyGravity() {
-    _gravityScaleGrid.reset();
-    for (size_t i = 0; i < _forceFields.size(); i++) {
-        if (_forceFields[i]->isEnabled()) {
-            _forceFields[i]->addGravityScaleToGrid(_gravityScaleGrid);
+    // Outside of its bounds, a field contributes a scale and weight of 1.0 
+    // to every node. The totals start from this baseline and each field 
+    // adds its deviation from the baseline within its bounds.
+    int numEnabled = 0;
+    for (size_t i = 0; i < _contributions.size(); i++) {
+        if (_contributions[i].isEnabled) {
+            numEnabled++;
+        }
+    }
+
+    _gravityScaleGrid.gravityScale.fill((float)numEnabled);
+    _gravityScaleGrid.gravityWeight.fill((float)numEnabled);
+    for (size_t i = 0; i < _contributions.size(); i++) {
+        ForceFieldContribution *c = &(_contributions[i]);
+        if (!c->isEnabled || c->isEmpty) {
+            continue;
         }
+
+        _addSubgridMT(c->gravityScaleGrid.gravityScale, _gravityScaleGrid.gravityScale, c->offset, 1.0f);
+        _addSubgridMT(c->gravityScaleGrid.gravityWeight, _gravityScaleGrid.gravityWeight, c->offset, 1.0f);
     }
     _gravityScaleGrid.normalize();
     _forceField.setOutOfRangeVector(_gravityVector);
+}
+
+void ForceFieldGrid::_addSubgridMT(Array3d<float> &subgrid, Array3d<float> &grid, 
+                                   GridIndex offset, float bias) {
+    int gridsize = subgrid.depth;
+    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, gridsize);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ForceFieldGrid::_addSubgridThread, this,
+                                 intervals[i], intervals[i + 1], &subgrid, &grid, offset, bias);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void ForceFieldGrid::_addSubgridThread(int startk, int endk, 
+                                       Array3d<float> *subgrid, Array3d<float> *grid, 
+                                       GridIndex offset, float bias) {
+    for (int k = startk; k < endk; k++) {
+        for (int j = 0; j < subgrid->height; j++) {
+            for (int i = 0; i < subgrid->width; i++) {
+                grid->add(i + offset.i, j + offset.j, k + offset.k, subgrid->get(i, j, k) - bias);
+            }
+        }
+    }
 }
\ No newline at end of file
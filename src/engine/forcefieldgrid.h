@@ -32,6 +32,15 @@ SOFTWARE.
 
 class ForceField;
 
+struct ForceFieldContribution {
+    bool isValid = false;
+    bool isEnabled = false;
+    bool isEmpty = true;
+    GridIndex offset;
+    MACVelocityField forceField;
+    ForceFieldGravityScaleGrid gravityScaleGrid;
+};
+
 struct ForceFieldDebugNode {
     float x = 0.0f;
     float y = 0.0f;
@@ -63,8 +72,14 @@ public:
 private:
 
     void _updateForceFields(double dt, double frameInterpolation);
+    void _updateContribution(int fieldidx);
     void _applyForceFields();
     void _applyGravity();
+    void _addSubgridMT(Array3d<float> &subgrid, Array3d<float> &grid, 
+                       GridIndex offset, float bias);
+    void _addSubgridThread(int startk, int endk, 
+                           Array3d<float> *subgrid, Array3d<float> *grid, 
+                           GridIndex offset, float bias);
 
     int _isize = 0;
     int _jsize = 0;
@@ -72,8 +87,10 @@ private:
     double _dx = 1.0;
     bool _isInitialized = false;
     bool _isStateChanged = true;
+    bool _isGravityVectorChanged = false;
 
     std::vector<ForceField*> _forceFields;
+    std::vector<ForceFieldContribution> _contributions;
     MACVelocityField _forceField;
     ForceFieldGravityScaleGrid _gravityScaleGrid;
 
@@ -44,14 +44,30 @@ void ForceFieldPoint::update(double dt, double frameInterpolation) {
     _frameInterpolation = frameInterpolation;
 }
 
-void ForceFieldPoint::addForceFieldToGrid(MACVelocityField &fieldGrid) {
+void ForceFieldPoint::getGridBounds(GridIndex &gmin, GridIndex &gmax) {
+    if (!_isMaxDistanceEnabled) {
+        ForceField::getGridBounds(gmin, gmax);
+        return;
+    }
+
+    TriangleMesh m = _meshObject.getMesh(_frameInterpolation);
+    vmath::vec3 p = m.getCentroid();
+    vmath::vec3 r(_maxDistance, _maxDistance, _maxDistance);
+    GridIndex g1 = Grid3d::positionToGridIndex(p - r, _dx);
+    GridIndex g2 = Grid3d::positionToGridIndex(p + r, _dx);
+
+    gmin = GridIndex(std::max(g1.i - 1, 0), std::max(g1.j - 1, 0), std::max(g1.k - 1, 0));
+    gmax = GridIndex(std::min(g2.i + 2, _isize), std::min(g2.j + 2, _jsize), std::min(g2.k + 2, _ksize));
+}
+
+void ForceFieldPoint::addForceFieldToGrid(MACVelocityField &fieldGrid, GridIndex offset) {
     int U = 0; int V = 1; int W = 2;
-    _addForceFieldToGridMT(fieldGrid, U);
-    _addForceFieldToGridMT(fieldGrid, V);
-    _addForceFieldToGridMT(fieldGrid, W);
+    _addForceFieldToGridMT(fieldGrid, offset, U);
+    _addForceFieldToGridMT(fieldGrid, offset, V);
+    _addForceFieldToGridMT(fieldGrid, offset, W);
 }
 
-void ForceFieldPoint::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid) {
+void ForceFieldPoint::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid, GridIndex offset) {
     float scaleWidth = _gravityScaleWidth;
     if (_isMaxDistanceEnabled) {
         scaleWidth = std::min(scaleWidth, _maxDistance);
@@ -63,7 +79,7 @@ void ForceFieldPoint::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGri
     for (int k = 0; k < scaleGrid.gravityScale.depth; k++) {
         for (int j = 0; j < scaleGrid.gravityScale.height; j++) {
             for (int i = 0; i < scaleGrid.gravityScale.width; i++) {
-                vmath::vec3 gp = Grid3d::GridIndexToPosition(i, j, k, _dx);
+                vmath::vec3 gp = Grid3d::GridIndexToPosition(i + offset.i, j + offset.j, k + offset.k, _dx);
                 vmath::vec3 v = gp - p;
                 float distanceToPoint = vmath::length(v);
                 if (distanceToPoint > scaleWidth) {
@@ -127,17 +143,20 @@ void ForceFieldPoint::_clearSubclassState() {
     
 }
 
-void ForceFieldPoint::_addForceFieldToGridMT(MACVelocityField &fieldGrid, int dir) {
+void ForceFieldPoint::_addForceFieldToGridMT(MACVelocityField &fieldGrid, GridIndex offset, int dir) {
 
     int U = 0; int V = 1; int W = 2;
 
+    int isize, jsize, ksize;
+    fieldGrid.getGridDimensions(&isize, &jsize, &ksize);
+
     size_t gridsize = 0;
     if (dir == U) {
-        gridsize = (_isize + 1) * _jsize * _ksize;
+        gridsize = (isize + 1) * jsize * ksize;
     } else if (dir == V) {
-        gridsize = _isize * (_jsize + 1) * _ksize;
+        gridsize = isize * (jsize + 1) * ksize;
     } else if (dir == W) {
-        gridsize = _isize * _jsize * (_ksize + 1);
+        gridsize = isize * jsize * (ksize + 1);
     }
 
     size_t numCPU = ThreadUtils::getMaxThreadCount();
@@ -146,7 +165,7 @@ void ForceFieldPoint::_addForceFieldToGridMT(MACVelocityField &fieldGrid, int di
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&ForceFieldPoint::_addForceFieldToGridThread, this,
-                                 intervals[i], intervals[i + 1], &fieldGrid, dir);
+                                 intervals[i], intervals[i + 1], &fieldGrid, offset, dir);
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -155,9 +174,12 @@ void ForceFieldPoint::_addForceFieldToGridMT(MACVelocityField &fieldGrid, int di
 }
 
 void ForceFieldPoint::_addForceFieldToGridThread(int startidx, int endidx, 
-                                                 MACVelocityField *fieldGrid, int dir) {
+                                                 MACVelocityField *fieldGrid, GridIndex offset, int dir) {
     int U = 0; int V = 1; int W = 2;
 
+    int isize, jsize, ksize;
+    fieldGrid->getGridDimensions(&isize, &jsize, &ksize);
+
     TriangleMesh m = _meshObject.getMesh(_frameInterpolation);
     vmath::vec3 p = m.getCentroid();
 
@@ -175,8 +197,8 @@ void ForceFieldPoint::_addForceFieldToGridThread(int startidx, int endidx,
     if (dir == U) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize + 1, _jsize);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionU(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize + 1, jsize);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionU(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             vmath::vec3 v = gp - p;
             float r = std::max(vmath::length(v), minDistance);
             if (r < eps || r > maxDistance) {
@@ -191,8 +213,8 @@ void ForceFieldPoint::_addForceFieldToGridThread(int startidx, int endidx,
     } else if (dir == V) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize, _jsize + 1);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionV(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize + 1);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionV(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             vmath::vec3 v = gp - p;
             float r = std::max(vmath::length(v), minDistance);
             if (r < eps || r > maxDistance) {
@@ -207,8 +229,8 @@ void ForceFieldPoint::_addForceFieldToGridThread(int startidx, int endidx,
     } else if (dir == W) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize, _jsize);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionW(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionW(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             vmath::vec3 v = gp - p;
             float r = std::max(vmath::length(v), minDistance);
             if (r < eps || r > maxDistance) {
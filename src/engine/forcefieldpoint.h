@@ -34,8 +34,9 @@ public:
     virtual ~ForceFieldPoint();
 
     virtual void update(double dt, double frameInterpolation);
-    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid);
-    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid);
+    virtual void getGridBounds(GridIndex &gmin, GridIndex &gmax);
+    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid, GridIndex offset);
+    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid, GridIndex offset);
     virtual std::vector<vmath::vec3> generateDebugProbes();
 
 protected:
@@ -45,9 +46,9 @@ protected:
 
 private:
 
-    void _addForceFieldToGridMT(MACVelocityField &fieldGrid, int dir);
+    void _addForceFieldToGridMT(MACVelocityField &fieldGrid, GridIndex offset, int dir);
     void _addForceFieldToGridThread(int startidx, int endidx, 
-                                    MACVelocityField *fieldGrid, int dir);
+                                    MACVelocityField *fieldGrid, GridIndex offset, int dir);
 
     double _frameInterpolation = 0.0;
     int _numDebugProbes = 200;
@@ -68,14 +68,19 @@ void ForceFieldSurface::update(double dt, double frameInterpolation) {
     _isLevelsetUpToDate = true;
 }
 
-void ForceFieldSurface::addForceFieldToGrid(MACVelocityField &fieldGrid) {
+void ForceFieldSurface::getGridBounds(GridIndex &gmin, GridIndex &gmax) {
+    gmin = GridIndex(_ioffsetSDF, _joffsetSDF, _koffsetSDF);
+    gmax = GridIndex(_ioffsetSDF + _isizeSDF, _joffsetSDF + _jsizeSDF, _koffsetSDF + _ksizeSDF);
+}
+
+void ForceFieldSurface::addForceFieldToGrid(MACVelocityField &fieldGrid, GridIndex offset) {
     int U = 0; int V = 1; int W = 2;
-    _addForceFieldToGridMT(fieldGrid, U);
-    _addForceFieldToGridMT(fieldGrid, V);
-    _addForceFieldToGridMT(fieldGrid, W);
+    _addForceFieldToGridMT(fieldGrid, offset, U);
+    _addForceFieldToGridMT(fieldGrid, offset, V);
+    _addForceFieldToGridMT(fieldGrid, offset, W);
 }
 
-void ForceFieldSurface::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid) {
+void ForceFieldSurface::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid, GridIndex offset) {
     float scaleWidth = _gravityScaleWidth;
     if (_isMaxDistanceEnabled) {
         scaleWidth = std::min(scaleWidth, _maxDistance);
@@ -88,9 +93,9 @@ void ForceFieldSurface::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleG
         for (int j = 0; j < jsizeScaleGrid; j++) {
             for (int i = 0; i < isizeScaleGrid; i++) {
 
-                int iSDF = i - _ioffsetSDF;
-                int jSDF = j - _joffsetSDF;
-                int kSDF = k - _koffsetSDF;
+                int iSDF = i + offset.i - _ioffsetSDF;
+                int jSDF = j + offset.j - _joffsetSDF;
+                int kSDF = k + offset.k - _koffsetSDF;
                 if (iSDF >= 0 && jSDF >= 0 && kSDF >= 0 && iSDF < _isizeSDF + 1 && jSDF < _jsizeSDF + 1 && kSDF < _ksizeSDF + 1) {
                     vmath::vec3 vectToSurface = _vectorField(iSDF, jSDF, kSDF);
                     float distanceToSurface = vectToSurface.length();
@@ -154,16 +159,19 @@ void ForceFieldSurface::_clearSubclassState() {
 
 }
 
-void ForceFieldSurface::_addForceFieldToGridMT(MACVelocityField &fieldGrid, int dir) {
+void ForceFieldSurface::_addForceFieldToGridMT(MACVelocityField &fieldGrid, GridIndex offset, int dir) {
     int U = 0; int V = 1; int W = 2;
 
+    int isize, jsize, ksize;
+    fieldGrid.getGridDimensions(&isize, &jsize, &ksize);
+
     size_t gridsize = 0;
     if (dir == U) {
-        gridsize = (_isize + 1) * _jsize * _ksize;
+        gridsize = (isize + 1) * jsize * ksize;
     } else if (dir == V) {
-        gridsize = _isize * (_jsize + 1) * _ksize;
+        gridsize = isize * (jsize + 1) * ksize;
     } else if (dir == W) {
-        gridsize = _isize * _jsize * (_ksize + 1);
+        gridsize = isize * jsize * (ksize + 1);
     }
 
     size_t numCPU = ThreadUtils::getMaxThreadCount();
@@ -172,7 +180,7 @@ void ForceFieldSurface::_addForceFieldToGridMT(MACVelocityField &fieldGrid, int
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&ForceFieldSurface::_addForceFieldToGridThread, this,
-                                 intervals[i], intervals[i + 1], &fieldGrid, dir);
+                                 intervals[i], intervals[i + 1], &fieldGrid, offset, dir);
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -226,9 +234,12 @@ void ForceFieldSurface::_updateGridDimensions(TriangleMesh &mesh) {
 }
 
 void ForceFieldSurface::_addForceFieldToGridThread(int startidx, int endidx, 
-                                                   MACVelocityField *fieldGrid, int dir) {
+                                                   MACVelocityField *fieldGrid, GridIndex offset, int dir) {
     int U = 0; int V = 1; int W = 2;
 
+    int isize, jsize, ksize;
+    fieldGrid->getGridDimensions(&isize, &jsize, &ksize);
+
     float minDistance = -1.0f;
     float maxDistance = std::numeric_limits<float>::infinity();
     if (_isMinDistanceEnabled) {
@@ -243,8 +254,8 @@ void ForceFieldSurface::_addForceFieldToGridThread(int startidx, int endidx,
     if (dir == U) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize + 1, _jsize);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionU(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize + 1, jsize);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionU(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             if (!Grid3d::isPositionInGrid(gp - _offsetSDF, _dx, _isizeSDF, _jsizeSDF, _ksizeSDF)) {
                 continue;
             }
@@ -266,8 +277,8 @@ void ForceFieldSurface::_addForceFieldToGridThread(int startidx, int endidx,
     } else if (dir == V) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize, _jsize + 1);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionV(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize + 1);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionV(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             if (!Grid3d::isPositionInGrid(gp - _offsetSDF, _dx, _isizeSDF, _jsizeSDF, _ksizeSDF)) {
                 continue;
             }
@@ -289,8 +300,8 @@ void ForceFieldSurface::_addForceFieldToGridThread(int startidx, int endidx,
     } else if (dir == W) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize, _jsize);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionW(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionW(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             if (!Grid3d::isPositionInGrid(gp - _offsetSDF, _dx, _isizeSDF, _jsizeSDF, _ksizeSDF)) {
                 continue;
             }
@@ -35,8 +35,9 @@ public:
     virtual ~ForceFieldSurface();
 
     virtual void update(double dt, double frameInterpolation);
-    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid);
-    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid);
+    virtual void getGridBounds(GridIndex &gmin, GridIndex &gmax);
+    virtual void addForceFieldToGrid(MACVelocityField &fieldGrid, GridIndex offset);
+    virtual void addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid, GridIndex offset);
     virtual std::vector<vmath::vec3> generateDebugProbes();
 
 protected:
@@ -47,9 +48,9 @@ protected:
 private:
 
     void _updateGridDimensions(TriangleMesh &mesh);
-    void _addForceFieldToGridMT(MACVelocityField &fieldGrid, int dir);
+    void _addForceFieldToGridMT(MACVelocityField &fieldGrid, GridIndex offset, int dir);
     void _addForceFieldToGridThread(int startidx, int endidx, 
-                                    MACVelocityField *fieldGrid, int dir);
+                                    MACVelocityField *fieldGrid, GridIndex offset, int dir);
 
     int _ioffsetSDF = 0;
     int _joffsetSDF = 0;
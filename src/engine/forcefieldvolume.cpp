@@ -67,14 +67,19 @@ void ForceFieldVolume::update(double dt, double frameInterpolation) {
     _isLevelsetUpToDate = true;
 }
 
-void ForceFieldVolume::addForceFieldToGrid(MACVelocityField &fieldGrid) {
+void ForceFieldVolume::getGridBounds(GridIndex &gmin, GridIndex &gmax) {
+    gmin = GridIndex(_ioffsetSDF, _joffsetSDF, _koffsetSDF);
+    gmax = GridIndex(_ioffsetSDF + _isizeSDF, _joffsetSDF + _jsizeSDF, _koffsetSDF + _ksizeSDF);
+}
+
+void ForceFieldVolume::addForceFieldToGrid(MACVelocityField &fieldGrid, GridIndex offset) {
     int U = 0; int V = 1; int W = 2;
-    _addForceFieldToGridMT(fieldGrid, U);
-    _addForceFieldToGridMT(fieldGrid, V);
-    _addForceFieldToGridMT(fieldGrid, W);
+    _addForceFieldToGridMT(fieldGrid, offset, U);
+    _addForceFieldToGridMT(fieldGrid, offset, V);
+    _addForceFieldToGridMT(fieldGrid, offset, W);
 }
 
-void ForceFieldVolume::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid) {
+void ForceFieldVolume::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGrid, GridIndex offset) {
     float scaleWidth = _gravityScaleWidth;
     if (_isMaxDistanceEnabled) {
         scaleWidth = std::min(scaleWidth, _maxDistance);
@@ -87,9 +92,9 @@ void ForceFieldVolume::addGravityScaleToGrid(ForceFieldGravityScaleGrid &scaleGr
         for (int j = 0; j < jsizeScaleGrid; j++) {
             for (int i = 0; i < isizeScaleGrid; i++) {
 
-                int iSDF = i - _ioffsetSDF;
-                int jSDF = j - _joffsetSDF;
-                int kSDF = k - _koffsetSDF;
+                int iSDF = i + offset.i - _ioffsetSDF;
+                int jSDF = j + offset.j - _joffsetSDF;
+                int kSDF = k + offset.k - _koffsetSDF;
                 if (iSDF >= 0 && jSDF >= 0 && kSDF >= 0 && iSDF < _isizeSDF + 1 && jSDF < _jsizeSDF + 1 && kSDF < _ksizeSDF + 1) {
                     vmath::vec3 vectToSurface = _vectorField(iSDF, jSDF, kSDF);
                     float distanceToSurface = vectToSurface.length();
@@ -153,16 +158,19 @@ void ForceFieldVolume::_clearSubclassState() {
 
 }
 
-void ForceFieldVolume::_addForceFieldToGridMT(MACVelocityField &fieldGrid, int dir) {
+void ForceFieldVolume::_addForceFieldToGridMT(MACVelocityField &fieldGrid, GridIndex offset, int dir) {
     int U = 0; int V = 1; int W = 2;
 
+    int isize, jsize, ksize;
+    fieldGrid.getGridDimensions(&isize, &jsize, &ksize);
+
     size_t gridsize = 0;
     if (dir == U) {
-        gridsize = (_isize + 1) * _jsize * _ksize;
+        gridsize = (isize + 1) * jsize * ksize;
     } else if (dir == V) {
-        gridsize = _isize * (_jsize + 1) * _ksize;
+        gridsize = isize * (jsize + 1) * ksize;
     } else if (dir == W) {
-        gridsize = _isize * _jsize * (_ksize + 1);
+        gridsize = isize * jsize * (ksize + 1);
     }
 
     size_t numCPU = ThreadUtils::getMaxThreadCount();
@@ -171,7 +179,7 @@ void ForceFieldVolume::_addForceFieldToGridMT(MACVelocityField &fieldGrid, int d
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&ForceFieldVolume::_addForceFieldToGridThread, this,
-                                 intervals[i], intervals[i + 1], &fieldGrid, dir);
+                                 intervals[i], intervals[i + 1], &fieldGrid, offset, dir);
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -224,9 +232,12 @@ void ForceFieldVolume::_updateGridDimensions(TriangleMesh &mesh) {
 }
 
 void ForceFieldVolume::_addForceFieldToGridThread(int startidx, int endidx, 
-                                                   MACVelocityField *fieldGrid, int dir) {
+                                                   MACVelocityField *fieldGrid, GridIndex offset, int dir) {
     int U = 0; int V = 1; int W = 2;
 
+    int isize, jsize, ksize;
+    fieldGrid->getGridDimensions(&isize, &jsize, &ksize);
+
     float minDistance = -1.0f;
     float maxDistance = std::numeric_limits<float>::infinity();
     if (_isMinDistanceEnabled) {
@@ -241,8 +252,8 @@ void ForceFieldVolume::_addForceFieldToGridThread(int startidx, int endidx,
     if (dir == U) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize + 1, _jsize);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionU(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize + 1, jsize);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionU(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             if (!Grid3d::isPositionInGrid(gp - _offsetSDF, _dx, _isizeSDF, _jsizeSDF, _ksizeSDF)) {
                 continue;
             }
@@ -267,8 +278,8 @@ void ForceFieldVolume::_addForceFieldToGridThread(int startidx, int endidx,
     } else if (dir == V) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize, _jsize + 1);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionV(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize + 1);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionV(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             if (!Grid3d::isPositionInGrid(gp - _offsetSDF, _dx, _isizeSDF, _jsizeSDF, _ksizeSDF)) {
                 continue;
             }
@@ -293,8 +304,8 @@ void ForceFieldVolume::_addForceFieldToGridThread(int startidx, int endidx,
     } else if (dir == W) {
 
         for (int idx = startidx; idx < endidx; idx++) {
-            GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize, _jsize);
-            vmath::vec3 gp = Grid3d::FaceIndexToPositionW(g, _dx);
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
+            vmath::vec3 gp = Grid3d::FaceIndexToPositionW(g.i + offset.i, g.j + offset.j, g.k + offset.k, _dx);
             if (!Grid3d::isPositionInGrid(gp - _offsetSDF, _dx, _isizeSDF, _jsizeSDF, _ksizeSDF)) {
                 continue;
             }
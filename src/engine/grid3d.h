@@ -199,6 +199,21 @@ namespace Grid3d {
                g.i == gmax.i - 1 || g.j == gmax.j - 1 || g.k == gmax.k - 1;
     }
 
+    // Interleaves the low 21 bits of each index into a Z-order curve key
+    inline unsigned long long getMortonCode(int i, int j, int k) {
+        unsigned long long code = 0;
+        for (int b = 0; b < 21; b++) {
+            code |= (unsigned long long)((i >> b) & 1) << (3 * b);
+            code |= (unsigned long long)((j >> b) & 1) << (3 * b + 1);
+            code |= (unsigned long long)((k >> b) & 1) << (3 * b + 2);
+        }
+        return code;
+    }
+
+    inline unsigned long long getMortonCode(GridIndex g) {
+        return getMortonCode(g.i, g.j, g.k);
+    }
+
     inline void getNeighbourGridIndices6(int i, int j, int k, GridIndex n[6]) {
         n[0] = GridIndex(i-1, j,   k);
         n[1] = GridIndex(i+1, j,   k);
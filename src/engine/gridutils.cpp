@@ -96,80 +96,88 @@ void extrapolateGrid(Array3d<float> *grid, Array3d<bool> *valid, int numLayers)
 }
 */
 
-void _initializeStatusGridThread(int startidx, int endidx, Array3d<bool> *valid, Array3d<char> *status) {
-    char KNOWN = 0x02;
-    char DONE = 0x03;
-
-    int isize = status->width;
-    int jsize = status->height;
-    int ksize = status->depth;
-    char *rawstatus = status->getRawArray();
+void _initializeExtrapolationBlocksThread(int startidx, int endidx, 
+                                          Array3d<bool> *valid, 
+                                          Array3d<bool> *activeBlocks, 
+                                          int blockwidth) {
+    int isize = valid->width;
+    int jsize = valid->height;
+    bool *rawvalid = valid->getRawArray();
     for (int idx = startidx; idx < endidx; idx++) {
-        GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
-        if (Grid3d::isGridIndexOnBorder(g, isize, jsize, ksize)) {
-            rawstatus[idx] = DONE;
-            continue;
-        }
-
-        if (valid->get(g)) {
-            rawstatus[idx] = KNOWN;
+        if (rawvalid[idx]) {
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
+            activeBlocks->set(g.i / blockwidth, g.j / blockwidth, g.k / blockwidth, true);
         }
     }
 }
 
-void _findExtrapolationCells(int startidx, int endidx, Array3d<char> *status, std::vector<GridIndex> *cells) {
-    char UNKNOWN = 0x00;
-    char WAITING = 0x01;
-    char KNOWN = 0x02;
+void _initializeExtrapolationStatusThread(int startidx, int endidx, 
+                                          std::vector<GridIndex> *blocks, 
+                                          Array3d<bool> *valid, 
+                                          BlockArray3d<char> *status, 
+                                          std::vector<GridIndex> *front) {
     char DONE = 0x03;
 
-    int isize = status->width;
-    int jsize = status->height;
-
-    char *rawstatus = status->getRawArray();
-    for (int idx = startidx; idx < endidx; idx++) {
-        if (rawstatus[idx] != KNOWN) { 
-            continue; 
-        }
-
-        GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
-        GridIndex n(g.i + 1, g.j, g.k);
-        if (status->get(n) == UNKNOWN) {
-            status->set(n, WAITING);
-            cells->push_back(n);
-        }
-
-        n = GridIndex(g.i - 1, g.j, g.k);
-        if (status->get(n) == UNKNOWN) {
-            status->set(n, WAITING);
-            cells->push_back(n);
-        }
-
-        n = GridIndex(g.i, g.j + 1, g.k);
-        if (status->get(n) == UNKNOWN) {
-            status->set(n, WAITING);
-            cells->push_back(n);
-        }
-
-        n = GridIndex(g.i, g.j - 1, g.k);
-        if (status->get(n) == UNKNOWN) {
-            status->set(n, WAITING);
-            cells->push_back(n);
+    int isize = valid->width;
+    int jsize = valid->height;
+    int ksize = valid->depth;
+    int bw = status->blockwidth;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        GridIndex b = blocks->at(bidx);
+        int imax = std::min((b.i + 1) * bw, isize);
+        int jmax = std::min((b.j + 1) * bw, jsize);
+        int kmax = std::min((b.k + 1) * bw, ksize);
+        for (int k = b.k * bw; k < kmax; k++) {
+            for (int j = b.j * bw; j < jmax; j++) {
+                for (int i = b.i * bw; i < imax; i++) {
+                    if (Grid3d::isGridIndexOnBorder(i, j, k, isize, jsize, ksize)) {
+                        status->set(i, j, k, DONE);
+                        continue;
+                    }
+
+                    if (!valid->get(i, j, k)) {
+                        continue;
+                    }
+
+                    status->set(i, j, k, DONE);
+
+                    // Border cells are never extrapolated
+                    GridIndex nbs[6] = {
+                        GridIndex(i + 1, j, k), GridIndex(i - 1, j, k),
+                        GridIndex(i, j + 1, k), GridIndex(i, j - 1, k),
+                        GridIndex(i, j, k + 1), GridIndex(i, j, k - 1)
+                    };
+                    for (int nidx = 0; nidx < 6; nidx++) {
+                        GridIndex n = nbs[nidx];
+                        if (!valid->get(n) && !Grid3d::isGridIndexOnBorder(n, isize, jsize, ksize)) {
+                            front->push_back(GridIndex(i, j, k));
+                            break;
+                        }
+                    }
+                }
+            }
         }
+    }
+}
 
-        n = GridIndex(g.i, g.j, g.k + 1);
-        if (status->get(n) == UNKNOWN) {
-            status->set(n, WAITING);
-            cells->push_back(n);
-        }
+void _findExtrapolationFrontThread(int startidx, int endidx, 
+                                   std::vector<GridIndex> *front, 
+                                   BlockArray3d<char> *status, 
+                                   std::vector<GridIndex> *candidates) {
+    char UNKNOWN = 0x00;
 
-        n = GridIndex(g.i, g.j, g.k - 1);
-        if (status->get(n) == UNKNOWN) {
-            status->set(n, WAITING);
-            cells->push_back(n);
+    for (int idx = startidx; idx < endidx; idx++) {
+        GridIndex g = front->at(idx);
+        GridIndex nbs[6] = {
+            GridIndex(g.i + 1, g.j, g.k), GridIndex(g.i - 1, g.j, g.k),
+            GridIndex(g.i, g.j + 1, g.k), GridIndex(g.i, g.j - 1, g.k),
+            GridIndex(g.i, g.j, g.k + 1), GridIndex(g.i, g.j, g.k - 1)
+        };
+        for (int nidx = 0; nidx < 6; nidx++) {
+            if (status->get(nbs[nidx]) == UNKNOWN) {
+                candidates->push_back(nbs[nidx]);
+            }
         }
-
-        rawstatus[idx] = DONE;
     }
 }
 
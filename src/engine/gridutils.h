@@ -24,14 +24,30 @@ SOFTWARE.
 
 #pragma once
 
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
 #include "array3d.h"
+#include "blockarray3d.h"
 #include "grid3d.h"
 #include "threadutils.h"
 
 namespace GridUtils {
 
-    void _initializeStatusGridThread(int startidx, int endidx, Array3d<bool> *valid, Array3d<char> *status);
-    void _findExtrapolationCells(int startidx, int endidx, Array3d<char> *status, std::vector<GridIndex> *cells);
+    void _initializeExtrapolationBlocksThread(int startidx, int endidx, 
+                                              Array3d<bool> *valid, 
+                                              Array3d<bool> *activeBlocks, 
+                                              int blockwidth);
+    void _initializeExtrapolationStatusThread(int startidx, int endidx, 
+                                              std::vector<GridIndex> *blocks, 
+                                              Array3d<bool> *valid, 
+                                              BlockArray3d<char> *status, 
+                                              std::vector<GridIndex> *front);
+    void _findExtrapolationFrontThread(int startidx, int endidx, 
+                                       std::vector<GridIndex> *front, 
+                                       BlockArray3d<char> *status, 
+                                       std::vector<GridIndex> *candidates);
 
     void featherGrid6(Array3d<bool> *grid, int numthreads);
     void _featherGrid6Thread(Array3d<bool> *grid, Array3d<bool> *valid, int startidx, int endidx);
@@ -42,7 +58,7 @@ namespace GridUtils {
     template <class T>
     void _extrapolateCellsThread(int startidx, int endidx, 
                                  std::vector<GridIndex> *cells, 
-                                 Array3d<char> *status, 
+                                 BlockArray3d<char> *status, 
                                  Array3d<T> *grid) {
         char DONE = 0x03;
 
@@ -91,16 +107,28 @@ namespace GridUtils {
         }
     }
 
+    /*
+        Extrapolates valid values outward by numLayers layers. Only the 
+        current front is kept as a list and the next front is gathered from 
+        its neighbours, so the cost scales with the number of extrapolated 
+        cells. Cell status is stored in blocks around the valid region.
+    */
     template <class T>
     void extrapolateGrid(Array3d<T> *grid, Array3d<bool> *valid, int numLayers) {
-        // char UNKNOWN = 0x00;
-        // char WAITING = 0x01;
-        // char KNOWN = 0x02;
-        // char DONE = 0x03;
-
         char UNKNOWN = 0x00;
-        char KNOWN = 0x02;
-        Array3d<char> status(grid->width, grid->height, grid->depth, UNKNOWN);
+        char WAITING = 0x01;
+        char DONE = 0x03;
+
+        if (numLayers <= 0) {
+            return;
+        }
+
+        BlockArray3dParameters params;
+        params.isize = grid->width;
+        params.jsize = grid->height;
+        params.ksize = grid->depth;
+        params.blockwidth = 8;
+        Dims3d dims = BlockArray3d<char>::getBlockDimensions(params);
 
         size_t voxelsPerThread = 100000;
         size_t gridsize = grid->width * grid->height * grid->depth;
@@ -109,41 +137,86 @@ namespace GridUtils {
         size_t numthreads = (int)std::min(std::min(numCPU, recommendedThreads), gridsize);
         std::vector<std::thread> threads(numthreads);
         std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
+        Array3d<bool> activeBlocks(dims.i, dims.j, dims.k, false);
         for (size_t i = 0; i < numthreads; i++) {
-            threads[i] = std::thread(&_initializeStatusGridThread,
-                                     intervals[i], intervals[i + 1], valid, &status);
+            threads[i] = std::thread(&_initializeExtrapolationBlocksThread,
+                                     intervals[i], intervals[i + 1], valid, &activeBlocks, params.blockwidth);
         }
 
         for (size_t i = 0; i < numthreads; i++) {
             threads[i].join();
         }
 
-        std::vector<std::vector<GridIndex> > threadResults(numthreads);
-        std::vector<GridIndex> extrapolationCells;
-        for (int layers = 0; layers < numLayers; layers++) {
-            extrapolationCells.clear();
-            for (size_t i = 0; i < threadResults.size(); i++) {
-                threadResults[i].clear();
+        // The last front reads neighbours at a distance of numLayers + 1
+        int blockLayers = (numLayers + 1 + params.blockwidth - 1) / params.blockwidth;
+        for (int i = 0; i < blockLayers; i++) {
+            featherGrid26(&activeBlocks, (int)numCPU);
+        }
+
+        for (int k = 0; k < dims.k; k++) {
+            for (int j = 0; j < dims.j; j++) {
+                for (int i = 0; i < dims.i; i++) {
+                    if (activeBlocks(i, j, k)) {
+                        params.activeblocks.push_back(GridIndex(i, j, k));
+                    }
+                }
             }
+        }
 
-            threads = std::vector<std::thread>(numthreads);
-            for (size_t i = 0; i < numthreads; i++) {
-                threads[i] = std::thread(&_findExtrapolationCells,
-                                         intervals[i], intervals[i + 1], &status, &(threadResults[i]));
+        if (params.activeblocks.empty()) {
+            return;
+        }
+
+        BlockArray3d<char> status(params);
+        status.fill(UNKNOWN);
+
+        size_t blockThreads = std::min(numCPU, params.activeblocks.size());
+        threads = std::vector<std::thread>(blockThreads);
+        std::vector<std::vector<GridIndex> > threadResults(blockThreads);
+        intervals = ThreadUtils::splitRangeIntoIntervals(0, params.activeblocks.size(), blockThreads);
+        for (size_t i = 0; i < blockThreads; i++) {
+            threads[i] = std::thread(&_initializeExtrapolationStatusThread,
+                                     intervals[i], intervals[i + 1], &(params.activeblocks), 
+                                     valid, &status, &(threadResults[i]));
+        }
+
+        std::vector<GridIndex> front;
+        for (size_t i = 0; i < blockThreads; i++) {
+            threads[i].join();
+            front.insert(front.end(), threadResults[i].begin(), threadResults[i].end());
+        }
+
+        size_t cellsPerThread = 10000;
+        std::vector<GridIndex> extrapolationCells;
+        for (int layers = 0; layers < numLayers && !front.empty(); layers++) {
+            size_t frontThreads = (size_t)std::ceil((double)front.size() / (double)cellsPerThread);
+            frontThreads = std::min(numCPU, frontThreads);
+            threads = std::vector<std::thread>(frontThreads);
+            threadResults = std::vector<std::vector<GridIndex> >(frontThreads);
+            intervals = ThreadUtils::splitRangeIntoIntervals(0, front.size(), frontThreads);
+            for (size_t i = 0; i < frontThreads; i++) {
+                threads[i] = std::thread(&_findExtrapolationFrontThread,
+                                         intervals[i], intervals[i + 1], &front, &status, &(threadResults[i]));
             }
 
-            int cellcount = 0;
-            for (size_t i = 0; i < numthreads; i++) {
+            for (size_t i = 0; i < frontThreads; i++) {
                 threads[i].join();
-                cellcount += threadResults[i].size();
             }
-            
-            extrapolationCells.reserve(cellcount);
-            for (size_t i = 0; i < threadResults.size(); i++) {
-                extrapolationCells.insert(extrapolationCells.end(), threadResults[i].begin(), threadResults[i].end());
+
+            extrapolationCells.clear();
+            for (size_t tidx = 0; tidx < threadResults.size(); tidx++) {
+                std::vector<GridIndex> *candidates = &(threadResults[tidx]);
+                for (size_t i = 0; i < candidates->size(); i++) {
+                    GridIndex g = candidates->at(i);
+                    if (status(g) == UNKNOWN) {
+                        status.set(g, WAITING);
+                        extrapolationCells.push_back(g);
+                    }
+                }
             }
 
-            size_t extrapolationThreads = (size_t)std::min(numthreads, extrapolationCells.size());
+            size_t extrapolationThreads = (size_t)std::ceil((double)extrapolationCells.size() / (double)cellsPerThread);
+            extrapolationThreads = std::min(numCPU, extrapolationThreads);
             threads = std::vector<std::thread>(extrapolationThreads);
             std::vector<int> extrapolationIntervals = ThreadUtils::splitRangeIntoIntervals(0, extrapolationCells.size(), extrapolationThreads);
             for (size_t i = 0; i < extrapolationThreads; i++) {
@@ -156,9 +229,10 @@ namespace GridUtils {
                 threads[i].join();
             }
 
-            if (layers != numLayers - 1) {
-                status.set(extrapolationCells, KNOWN);
+            for (size_t i = 0; i < extrapolationCells.size(); i++) {
+                status.set(extrapolationCells[i], DONE);
             }
+            front.swap(extrapolationCells);
         }
     }
 }
@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include "influencegrid.h"
 
+#include <algorithm>
+
 #include "meshlevelset.h"
 #include "meshobject.h"
 #include "threadutils.h"
@@ -38,6 +40,7 @@ InfluenceGrid::InfluenceGrid(int isize, int jsize, int ksize, double dx, float b
                                 _isize(isize), _jsize(jsize), _ksize(ksize), _dx(dx),
                                 _baselevel(baselevel),
                                 _influence(isize, jsize, ksize, baselevel) {
+    _initializeBlocks();
 }
 
 InfluenceGrid::~InfluenceGrid() {
@@ -52,6 +55,9 @@ float InfluenceGrid::getBaseLevel() {
 }
 
 void InfluenceGrid::setBaseLevel(float level) {
+    if (level != _baselevel) {
+        std::fill(_isBlockActive.begin(), _isBlockActive.end(), 1);
+    }
     _baselevel = level;
 }
 
@@ -72,111 +78,319 @@ void InfluenceGrid::update(MeshLevelSet *solidSDF, double dt) {
     solidSDF->getGridDimensions(&si, &sj, &sk);
     FLUIDSIM_ASSERT(_isize == si + 1 && _jsize == sj + 1 && _ksize == sk + 1);
 
-    _updateDecay(dt);
-    if (isSpreadEnabled) {
-        _updateSpread(dt);
+    _updateInfluenceSourceCells(solidSDF);
+
+    std::vector<char> isBlockUpdated(_isBlockActive.size(), 0);
+    std::vector<int> activeBlocks;
+    for (size_t bidx = 0; bidx < _isBlockActive.size(); bidx++) {
+        if (_isBlockActive[bidx]) {
+            activeBlocks.push_back(bidx);
+            isBlockUpdated[bidx] = 1;
+        }
+    }
+
+    if (!activeBlocks.empty()) {
+        _updateDecay(activeBlocks, dt);
     }
-    _updateInfluenceSources(solidSDF);
-}
 
-void InfluenceGrid::_updateDecay(double dt) {
-    for (int k = 0; k < _influence.depth; k++) {
-        for (int j = 0; j < _influence.height; j++) {
-            for (int i = 0; i < _influence.width; i++) {
-                float value = _influence(i, j, k);
-                if (value < _baselevel) {
-                    value = std::min(value + _decayrate * (float)dt, _baselevel);
-                } else if (value > _baselevel) {
-                    value = std::max(value - _decayrate * (float)dt, _baselevel);
+    if (isSpreadEnabled && !activeBlocks.empty()) {
+        // Spreading reaches across block faces, so face neighbours of active 
+        // blocks need to be updated as well
+        for (size_t idx = 0; idx < activeBlocks.size(); idx++) {
+            GridIndex b = Grid3d::getUnflattenedIndex(activeBlocks[idx], _bisize, _bjsize);
+            GridIndex nbs[6];
+            Grid3d::getNeighbourGridIndices6(b, nbs);
+            for (int nidx = 0; nidx < 6; nidx++) {
+                if (Grid3d::isGridIndexInRange(nbs[nidx], _bisize, _bjsize, _bksize)) {
+                    isBlockUpdated[Grid3d::getFlatIndex(nbs[nidx], _bisize, _bjsize)] = 1;
                 }
-                _influence.set(i, j, k, value);
             }
         }
-    }   
-}
-
-void InfluenceGrid::_updateSpread(double dt) {
-    bool isInfluenceUniform = true;
-    float constvalue = _influence(0, 0, 0);
-    float eps = 1e-5;
-    for (int k = 0; k < _influence.depth; k++) {
-        for (int j = 0; j < _influence.height; j++) {
-            for (int i = 0; i < _influence.width; i++) {
-                if (std::abs(_influence(i, j, k) - constvalue) > eps) {
-                    isInfluenceUniform = false;
-                    goto endLoop;
-                }
+
+        std::vector<int> spreadBlocks;
+        for (size_t bidx = 0; bidx < isBlockUpdated.size(); bidx++) {
+            if (isBlockUpdated[bidx]) {
+                spreadBlocks.push_back(bidx);
             }
         }
+
+        _updateSpread(spreadBlocks, dt);
     }
-    endLoop:
 
-    if (isInfluenceUniform) {
+    _updateInfluenceSources(isBlockUpdated);
+}
+
+void InfluenceGrid::invalidateInfluenceSources() {
+    _isInfluenceSourcesValid = false;
+}
+
+void InfluenceGrid::_initializeBlocks() {
+    _bisize = (_isize + _blockwidth - 1) / _blockwidth;
+    _bjsize = (_jsize + _blockwidth - 1) / _blockwidth;
+    _bksize = (_ksize + _blockwidth - 1) / _blockwidth;
+
+    int numBlocks = _bisize * _bjsize * _bksize;
+    _isBlockActive = std::vector<char>(numBlocks, 0);
+    _blockSourceStarts = std::vector<int>(numBlocks + 1, 0);
+    _influenceSources.clear();
+    _isInfluenceSourcesValid = false;
+}
+
+void InfluenceGrid::_getBlockBounds(int blockidx, GridIndex &gmin, GridIndex &gmax) {
+    GridIndex b = Grid3d::getUnflattenedIndex(blockidx, _bisize, _bjsize);
+    gmin = GridIndex(b.i * _blockwidth, b.j * _blockwidth, b.k * _blockwidth);
+    gmax = GridIndex(std::min(gmin.i + _blockwidth, _isize), 
+                     std::min(gmin.j + _blockwidth, _jsize), 
+                     std::min(gmin.k + _blockwidth, _ksize));
+}
+
+void InfluenceGrid::_updateInfluenceSourceCells(MeshLevelSet *solidSDF) {
+    if (_isInfluenceSourcesValid) {
         return;
     }
 
+    // Cells that are no longer sources may be left away from the base level
+    int numBlocks = _isBlockActive.size();
+    for (int bidx = 0; bidx < numBlocks; bidx++) {
+        if (_blockSourceStarts[bidx + 1] > _blockSourceStarts[bidx]) {
+            _isBlockActive[bidx] = 1;
+        }
+    }
+
+    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, numBlocks);
+    std::vector<std::vector<InfluenceSource> > threadResults(numthreads);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numBlocks, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&InfluenceGrid::_findInfluenceSourceCellsThread, this,
+                                 intervals[i], intervals[i + 1], solidSDF, &(threadResults[i]));
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    // Threads process consecutive blocks, so the sources are grouped by block
+    _influenceSources.clear();
+    for (int i = 0; i < numthreads; i++) {
+        _influenceSources.insert(_influenceSources.end(), threadResults[i].begin(), threadResults[i].end());
+    }
+
+    std::fill(_blockSourceStarts.begin(), _blockSourceStarts.end(), 0);
+    for (size_t sidx = 0; sidx < _influenceSources.size(); sidx++) {
+        GridIndex g = _influenceSources[sidx].cell;
+        int bidx = Grid3d::getFlatIndex(g.i / _blockwidth, g.j / _blockwidth, g.k / _blockwidth, 
+                                        _bisize, _bjsize);
+        _blockSourceStarts[bidx + 1]++;
+    }
+
+    for (int bidx = 0; bidx < numBlocks; bidx++) {
+        _blockSourceStarts[bidx + 1] += _blockSourceStarts[bidx];
+    }
+
+    _isInfluenceSourcesValid = true;
+}
+
+void InfluenceGrid::_findInfluenceSourceCellsThread(int startidx, int endidx, 
+                                                    MeshLevelSet *solidSDF, 
+                                                    std::vector<InfluenceSource> *sources) {
+    float width = _narrowBandWidth * _dx;
+    GridIndex gmin, gmax;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        _getBlockBounds(bidx, gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    if (std::abs(solidSDF->get(i, j, k)) > width) {
+                        continue;
+                    }
+
+                    MeshObject *m = solidSDF->getClosestMeshObject(i, j, k);
+                    if (m != nullptr) {
+                        InfluenceSource source;
+                        source.cell = GridIndex(i, j, k);
+                        source.object = m;
+                        sources->push_back(source);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void InfluenceGrid::_updateDecay(std::vector<int> &blocks, double dt) {
+    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, blocks.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, blocks.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&InfluenceGrid::_updateDecayThread, this,
+                                 intervals[i], intervals[i + 1], &blocks, dt);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void InfluenceGrid::_updateDecayThread(int startidx, int endidx, std::vector<int> *blocks, double dt) {
+    GridIndex gmin, gmax;
+    for (int idx = startidx; idx < endidx; idx++) {
+        _getBlockBounds(blocks->at(idx), gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    float value = _influence(i, j, k);
+                    if (value < _baselevel) {
+                        value = std::min(value + _decayrate * (float)dt, _baselevel);
+                    } else if (value > _baselevel) {
+                        value = std::max(value - _decayrate * (float)dt, _baselevel);
+                    }
+                    _influence.set(i, j, k, value);
+                }
+            }
+        }
+    }
+}
+
+void InfluenceGrid::_updateSpread(std::vector<int> &blocks, double dt) {
     if (_tempinfluence.width != _influence.width || 
             _tempinfluence.height != _influence.height || 
             _tempinfluence.depth != _influence.depth) {
         _tempinfluence = Array3d<float>(_influence.width, _influence.height, _influence.depth);
     }
 
-    size_t gridsize = _isize * _jsize * _ksize;
     size_t numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, gridsize);
+    int numthreads = (int)fmin(numCPU, blocks.size());
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, blocks.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&InfluenceGrid::_updateSpreadThread, this,
-                                 intervals[i], intervals[i + 1], dt);
+                                 intervals[i], intervals[i + 1], &blocks, dt);
     }
 
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
     }
 
-    for (int k = 0; k < _influence.depth; k++) {
-        for (int j = 0; j < _influence.height; j++) {
-            for (int i = 0; i < _influence.width; i++) {
-                _influence.set(i, j, k, _tempinfluence(i, j, k));
-            }
-        }
-    }   
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&InfluenceGrid::_copySpreadValuesThread, this,
+                                 intervals[i], intervals[i + 1], &blocks);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
 }
 
-void InfluenceGrid::_updateSpreadThread(int startidx, int endidx, double dt) {
+void InfluenceGrid::_updateSpreadThread(int startidx, int endidx, std::vector<int> *blocks, double dt) {
     GridIndex nbs[6];
+    GridIndex gmin, gmax;
     float rate = _spreadFactor * _decayrate * dt;
     for (int idx = startidx; idx < endidx; idx++) {
-        GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize, _jsize);
-        Grid3d::getNeighbourGridIndices6(g, nbs);
-        float currentvalue = _influence(g);
-        float sum = 0.0f;
-        int n = 0;
-        for (int nidx = 0; nidx < 6; nidx++) {
-            if (_influence.isIndexInRange(nbs[nidx])) {
-                sum += rate * (_influence(nbs[nidx]) - currentvalue);
-                n++;
+        _getBlockBounds(blocks->at(idx), gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    GridIndex g(i, j, k);
+                    Grid3d::getNeighbourGridIndices6(g, nbs);
+                    float currentvalue = _influence(g);
+                    float sum = 0.0f;
+                    int n = 0;
+                    for (int nidx = 0; nidx < 6; nidx++) {
+                        if (_influence.isIndexInRange(nbs[nidx])) {
+                            sum += rate * (_influence(nbs[nidx]) - currentvalue);
+                            n++;
+                        }
+                    }
+                    _tempinfluence.set(g, currentvalue + (sum / (float)n));
+                }
             }
         }
-        _tempinfluence.set(g, currentvalue + (sum / (float)n));
     }
 }
 
-void InfluenceGrid::_updateInfluenceSources(MeshLevelSet *solidSDF) {
-    float width = _narrowBandWidth * _dx;
-    for (int k = 0; k < _ksize; k++) {
-        for (int j = 0; j < _jsize; j++) {
-            for (int i = 0; i < _isize; i++) {
-                if (std::abs(solidSDF->get(i, j, k)) > width) {
-                    continue;
+void InfluenceGrid::_copySpreadValuesThread(int startidx, int endidx, std::vector<int> *blocks) {
+    GridIndex gmin, gmax;
+    for (int idx = startidx; idx < endidx; idx++) {
+        _getBlockBounds(blocks->at(idx), gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    _influence.set(i, j, k, _tempinfluence(i, j, k));
                 }
+            }
+        }
+    }
+}
 
-                MeshObject *m = solidSDF->getClosestMeshObject(i, j, k);
-                if (m != nullptr) {
-                    _influence.set(i, j, k, m->getWhitewaterInfluence());
+void InfluenceGrid::_updateInfluenceSources(std::vector<char> &isBlockUpdated) {
+    int numBlocks = _isBlockActive.size();
+    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, numBlocks);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numBlocks, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&InfluenceGrid::_updateInfluenceSourcesThread, this,
+                                 intervals[i], intervals[i + 1], &isBlockUpdated);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void InfluenceGrid::_updateInfluenceSourcesThread(int startidx, int endidx, 
+                                                  std::vector<char> *isBlockUpdated) {
+    std::vector<char> isSourceCell(_blockwidth * _blockwidth * _blockwidth);
+    GridIndex gmin, gmax;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        int sourceStart = _blockSourceStarts[bidx];
+        int sourceEnd = _blockSourceStarts[bidx + 1];
+        bool isSourceOffBaseLevel = false;
+        for (int sidx = sourceStart; sidx < sourceEnd; sidx++) {
+            InfluenceSource source = _influenceSources[sidx];
+            float value = source.object->getWhitewaterInfluence();
+            _influence.set(source.cell, value);
+            isSourceOffBaseLevel = isSourceOffBaseLevel || value != _baselevel;
+        }
+
+        if (!isBlockUpdated->at(bidx)) {
+            if (isSpreadEnabled && isSourceOffBaseLevel) {
+                _isBlockActive[bidx] = 1;
+            }
+            continue;
+        }
+
+        // A block is at equilibrium when every cell is at the base level. 
+        // Without spreading, source cells do not affect other cells and are
+        // reset each update, so they do not keep a block active.
+        std::fill(isSourceCell.begin(), isSourceCell.end(), 0);
+        _getBlockBounds(bidx, gmin, gmax);
+        if (!isSpreadEnabled) {
+            for (int sidx = sourceStart; sidx < sourceEnd; sidx++) {
+                GridIndex g = _influenceSources[sidx].cell;
+                int localidx = Grid3d::getFlatIndex(g.i - gmin.i, g.j - gmin.j, g.k - gmin.k, 
+                                                    _blockwidth, _blockwidth);
+                isSourceCell[localidx] = 1;
+            }
+        }
+
+        bool isActive = false;
+        for (int k = gmin.k; k < gmax.k && !isActive; k++) {
+            for (int j = gmin.j; j < gmax.j && !isActive; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    int localidx = Grid3d::getFlatIndex(i - gmin.i, j - gmin.j, k - gmin.k, 
+                                                        _blockwidth, _blockwidth);
+                    if (!isSourceCell[localidx] && _influence(i, j, k) != _baselevel) {
+                        isActive = true;
+                        break;
+                    }
                 }
             }
         }
-    }   
+
+        _isBlockActive[bidx] = isActive;
+    }
 }
\ No newline at end of file
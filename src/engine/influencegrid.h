@@ -24,9 +24,12 @@ SOFTWARE.
 
 #pragma once
 
+#include <vector>
+
 #include "array3d.h"
 
 class MeshLevelSet;
+class MeshObject;
 
 class InfluenceGrid
 {
@@ -44,12 +47,31 @@ public:
 
     void update(MeshLevelSet *solidSDF, double dt);
 
+    // Must be called when the solid SDF has been recomputed so that the
+    // cached influence source cells are regenerated on the next update
+    void invalidateInfluenceSources();
+
 private:
 
-    void _updateDecay(double dt);
-    void _updateSpread(double dt);
-    void _updateSpreadThread(int startidx, int endidx, double dt);
-    void _updateInfluenceSources(MeshLevelSet *solidSDF);
+    struct InfluenceSource {
+        GridIndex cell;
+        MeshObject *object = nullptr;
+    };
+
+    void _initializeBlocks();
+    void _getBlockBounds(int blockidx, GridIndex &gmin, GridIndex &gmax);
+    void _updateInfluenceSourceCells(MeshLevelSet *solidSDF);
+    void _findInfluenceSourceCellsThread(int startidx, int endidx, 
+                                         MeshLevelSet *solidSDF, 
+                                         std::vector<InfluenceSource> *sources);
+    void _updateDecay(std::vector<int> &blocks, double dt);
+    void _updateDecayThread(int startidx, int endidx, std::vector<int> *blocks, double dt);
+    void _updateSpread(std::vector<int> &blocks, double dt);
+    void _updateSpreadThread(int startidx, int endidx, std::vector<int> *blocks, double dt);
+    void _copySpreadValuesThread(int startidx, int endidx, std::vector<int> *blocks);
+    void _updateInfluenceSources(std::vector<char> &isBlockUpdated);
+    void _updateInfluenceSourcesThread(int startidx, int endidx, 
+                                       std::vector<char> *isBlockUpdated);
 
     int _isize = 0;
     int _jsize = 0;
@@ -63,4 +85,16 @@ private:
 
     Array3d<float> _influence;
     Array3d<float> _tempinfluence;
+
+    // Blocks that may hold values that are not at equilibrium. All other 
+    // blocks are at the base level, except for their influence source cells.
+    int _blockwidth = 8;
+    int _bisize = 0;
+    int _bjsize = 0;
+    int _bksize = 0;
+    std::vector<char> _isBlockActive;
+
+    bool _isInfluenceSourcesValid = false;
+    std::vector<InfluenceSource> _influenceSources;
+    std::vector<int> _blockSourceStarts;
 };
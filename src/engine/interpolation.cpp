@@ -24,6 +24,9 @@ SOFTWARE.
 
 #include "interpolation.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "grid3d.h"
 
 /* 
@@ -256,4 +259,54 @@ void Interpolation::trilinearInterpolateGradient(
     grad->x = dv_dx;
     grad->y = dv_dy;
     grad->z = dv_dz;
-}
\ No newline at end of file
+}
+
+void Interpolation::trilinearInterpolatePoints(vmath::vec3 *points, int numPoints, double dx, 
+                                               Array3d<float> &grid, float *results) {
+    const int batchSize = 64;
+    int indices[3][batchSize];
+    float fractions[3][batchSize];
+
+    float invdx = (float)(1.0 / dx);
+    int isize = grid.width;
+    int jsize = grid.height;
+    int ksize = grid.depth;
+    int jstride = isize;
+    int kstride = isize * jsize;
+    float *data = grid.getRawArray();
+
+    for (int startidx = 0; startidx < numPoints; startidx += batchSize) {
+        int count = std::min(batchSize, numPoints - startidx);
+        vmath::vec3 *batch = points + startidx;
+        for (int b = 0; b < count; b++) {
+            float gx = batch[b].x * invdx;
+            float gy = batch[b].y * invdx;
+            float gz = batch[b].z * invdx;
+            float fx = std::floor(gx);
+            float fy = std::floor(gy);
+            float fz = std::floor(gz);
+            indices[0][b] = (int)fx;
+            indices[1][b] = (int)fy;
+            indices[2][b] = (int)fz;
+            fractions[0][b] = gx - fx;
+            fractions[1][b] = gy - fy;
+            fractions[2][b] = gz - fz;
+        }
+
+        for (int b = 0; b < count; b++) {
+            int i = indices[0][b];
+            int j = indices[1][b];
+            int k = indices[2][b];
+            bool isInterior = i >= 0 && j >= 0 && k >= 0 && 
+                              i < isize - 1 && j < jsize - 1 && k < ksize - 1;
+            if (isInterior) {
+                results[startidx + b] = trilinearInterpolateStrided(
+                        data + i + jstride * j + kstride * k, jstride, kstride, 
+                        fractions[0][b], fractions[1][b], fractions[2][b]
+                        );
+            } else {
+                results[startidx + b] = (float)trilinearInterpolate(batch[b], dx, grid);
+            }
+        }
+    }
+}
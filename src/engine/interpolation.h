@@ -41,4 +41,46 @@ namespace Interpolation {
     extern vmath::vec3 trilinearInterpolate(vmath::vec3 p, double dx, Array3d<vmath::vec3> &grid);
     extern void trilinearInterpolateGradient(
             vmath::vec3 p, double dx, Array3d<float> &grid, vmath::vec3 *grad);
+
+    /*
+        Batched trilinear interpolation of grid values located at (i, j, k) * dx.
+        Weights are computed once per point in single precision and stencils
+        that lie inside of the grid are gathered without bounds checks. Points
+        sorted by grid cell make the best use of the cache.
+    */
+    extern void trilinearInterpolatePoints(vmath::vec3 *points, int numPoints, double dx, 
+                                           Array3d<float> &grid, float *results);
+
+    // p points to the (0, 0, 0) corner of a stencil within a flat grid array
+    inline float trilinearInterpolateStrided(float *p, int jstride, int kstride, 
+                                             float ix, float iy, float iz) {
+        float v00 = p[0]                + ix * (p[1] - p[0]);
+        float v10 = p[jstride]          + ix * (p[jstride + 1] - p[jstride]);
+        float v01 = p[kstride]          + ix * (p[kstride + 1] - p[kstride]);
+        float v11 = p[jstride + kstride] + ix * (p[jstride + kstride + 1] - p[jstride + kstride]);
+        float v0 = v00 + iy * (v10 - v00);
+        float v1 = v01 + iy * (v11 - v01);
+        return v0 + iz * (v1 - v0);
+    }
+
+    inline vmath::vec3 trilinearInterpolateGradientStrided(float *p, int jstride, int kstride, 
+                                                           float ix, float iy, float iz, float invdx) {
+        float v000 = p[0];
+        float v100 = p[1];
+        float v010 = p[jstride];
+        float v110 = p[jstride + 1];
+        float v001 = p[kstride];
+        float v101 = p[kstride + 1];
+        float v011 = p[jstride + kstride];
+        float v111 = p[jstride + kstride + 1];
+
+        float gx = (1.0f - iy) * (1.0f - iz) * (v100 - v000) + iy * (1.0f - iz) * (v110 - v010) +
+                   (1.0f - iy) * iz * (v101 - v001) + iy * iz * (v111 - v011);
+        float gy = (1.0f - ix) * (1.0f - iz) * (v010 - v000) + ix * (1.0f - iz) * (v110 - v100) +
+                   (1.0f - ix) * iz * (v011 - v001) + ix * iz * (v111 - v101);
+        float gz = (1.0f - ix) * (1.0f - iy) * (v001 - v000) + ix * (1.0f - iy) * (v101 - v100) +
+                   (1.0f - ix) * iy * (v011 - v010) + ix * iy * (v111 - v110);
+
+        return vmath::vec3(gx * invdx, gy * invdx, gz * invdx);
+    }
 }
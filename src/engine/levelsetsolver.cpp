@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include <limits>
 #include <cmath>
+#include <algorithm>
 
 #include "threadutils.h"
 #include "grid3d.h"
@@ -79,62 +80,86 @@ void LevelSetSolver::reinitializeEno(Array3d<float> &inputSDF,
     }
 }
 
-void LevelSetSolver::reinitializeUpwind(Array3d<float> &inputSDF, 
-                                        float dx, 
-                                        float maxDistance, 
-                                        std::vector<GridIndex> &solverCells, 
-                                        Array3d<float> &outputSDF) {
-
-    _maxCFL = 0.5;
-
-    float dtau = _getPseudoTimeStep(inputSDF, dx);
-    int numIterations = _getNumberOfIterations(maxDistance, dtau);
+void LevelSetSolver::reinitializeFastSweeping(Array3d<float> &inputSDF, 
+                                              float dx, 
+                                              std::vector<GridIndex> &solverCells, 
+                                              Array3d<float> &outputSDF) {
 
     int isize = inputSDF.width;
     int jsize = inputSDF.height;
     int ksize = inputSDF.depth;
     outputSDF = inputSDF;
 
-    Array3d<float> tempSDF(isize, jsize, ksize);
-    Array3d<float> *tempPtr = &tempSDF;
-    Array3d<float> *outputPtr = &outputSDF;
-
-    float lastMaxDiff = -1.0f;
-    for (int n = 0; n < numIterations; n++) {
-        int numCPU = ThreadUtils::getMaxThreadCount();
-        int numthreads = (int)fmin(numCPU, solverCells.size());
-        std::vector<std::thread> threads(numthreads);
-        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, solverCells.size(), numthreads);
-        for (int i = 0; i < numthreads; i++) {
-            threads[i] = std::thread(&LevelSetSolver::_stepSolverThreadUpwind, this,
-                                     intervals[i], intervals[i + 1], tempPtr, outputPtr, dx, dtau, &solverCells);
-        }
+    if (solverCells.empty()) {
+        return;
+    }
 
-        for (int i = 0; i < numthreads; i++) {
-            threads[i].join();
-        }
+    int tw = _sweepTileWidth;
+    int tisize = (isize + tw - 1) / tw;
+    int tjsize = (jsize + tw - 1) / tw;
+    int tksize = (ksize + tw - 1) / tw;
+
+    Array3d<bool> solverMask(isize, jsize, ksize, false);
+    Array3d<bool> activeTiles(tisize, tjsize, tksize, false);
+    for (size_t i = 0; i < solverCells.size(); i++) {
+        GridIndex g = solverCells[i];
+        solverMask.set(g, true);
+        activeTiles.set(g.i / tw, g.j / tw, g.k / tw, true);
+    }
 
-        float maxDiff = 0;
-        for (size_t cidx = 0; cidx < solverCells.size(); cidx++) {
-            GridIndex g = solverCells[cidx];
-            float diff = std::abs(tempPtr->get(g) - outputPtr->get(g));
-            maxDiff = std::max(diff, maxDiff);
+    std::vector<GridIndex> tiles;
+    for (int k = 0; k < tksize; k++) {
+        for (int j = 0; j < tjsize; j++) {
+            for (int i = 0; i < tisize; i++) {
+                if (activeTiles(i, j, k)) {
+                    tiles.push_back(GridIndex(i, j, k));
+                }
+            }
         }
+    }
 
-        std::swap(tempPtr, outputPtr);
+    Array3d<bool> frozenCells(isize, jsize, ksize, false);
+
+    FastSweepingGrids grids;
+    grids.inputSDF = &inputSDF;
+    grids.outputSDF = &outputSDF;
+    grids.solverMask = &solverMask;
+    grids.frozenCells = &frozenCells;
+    grids.dx = dx;
+
+    _initializeFastSweepingMT(tiles, grids);
+
+    // Tiles on the same diagonal wavefront of a sweep ordering share no 
+    // faces, so they can be swept concurrently while still seeing every 
+    // upwind tile already updated.
+    int numPlanes = tisize + tjsize + tksize - 2;
+    std::vector<std::vector<GridIndex> > planeTiles(numPlanes);
+    for (int round = 0; round < _numSweepRounds; round++) {
+        for (int sweep = 0; sweep < 8; sweep++) {
+            GridIndex dir((sweep & 1) ? -1 : 1, 
+                          (sweep & 2) ? -1 : 1, 
+                          (sweep & 4) ? -1 : 1);
+
+            for (size_t pidx = 0; pidx < planeTiles.size(); pidx++) {
+                planeTiles[pidx].clear();
+            }
+            for (size_t tidx = 0; tidx < tiles.size(); tidx++) {
+                GridIndex t = tiles[tidx];
+                int pi = dir.i > 0 ? t.i : tisize - 1 - t.i;
+                int pj = dir.j > 0 ? t.j : tjsize - 1 - t.j;
+                int pk = dir.k > 0 ? t.k : tksize - 1 - t.k;
+                planeTiles[pi + pj + pk].push_back(t);
+            }
 
-        if (std::abs(maxDiff - lastMaxDiff) < _upwindErrorThreshold * dx) {
-            break;
+            for (size_t pidx = 0; pidx < planeTiles.size(); pidx++) {
+                if (!planeTiles[pidx].empty()) {
+                    _sweepTilesMT(planeTiles[pidx], dir, grids);
+                }
+            }
         }
-        lastMaxDiff = maxDiff;
     }
 
-    float *rawarraysrc = outputPtr->getRawArray();
-    float *rawarraydst = outputSDF.getRawArray();
-    int n = outputSDF.getNumElements();
-    for (int i = 0; i < n; i++) {
-        rawarraydst[i] = rawarraysrc[i];
-    }
+    _finalizeFastSweepingMT(tiles, grids);
 }
 
 float LevelSetSolver::_getPseudoTimeStep(Array3d<float> &sdf, float dx) {
@@ -314,78 +339,249 @@ std::array<float, 2> LevelSetSolver::_eno3(float *D0, float dx) {
     return dfx;
 }
 
-void LevelSetSolver::_stepSolverThreadUpwind(int startidx, int endidx, 
-                                       Array3d<float> *tempPtr,
-                                       Array3d<float> *outputPtr, 
-                                       float dx,
-                                       float dtau,
-                                       std::vector<GridIndex> *solverCells) {
+void LevelSetSolver::_getTileBounds(GridIndex tile, int isize, int jsize, int ksize,
+                                    GridIndex &gmin, GridIndex &gmax) {
+    int tw = _sweepTileWidth;
+    gmin = GridIndex(tile.i * tw, tile.j * tw, tile.k * tw);
+    gmax = GridIndex(std::min(gmin.i + tw, isize), 
+                     std::min(gmin.j + tw, jsize), 
+                     std::min(gmin.k + tw, ksize));
+}
 
-    std::array<float, 2> derx, dery, derz;
-    for (int idx = startidx; idx < endidx; idx++) {
-        GridIndex g = solverCells->at(idx);
+void LevelSetSolver::_initializeFastSweepingMT(std::vector<GridIndex> &tiles, 
+                                               FastSweepingGrids &grids) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, tiles.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, tiles.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&LevelSetSolver::_initializeFastSweepingThread, this,
+                                 intervals[i], intervals[i + 1], &tiles, &grids);
+    }
 
-        float s = _sign(*outputPtr, dx, g.i, g.j, g.k);
-        _getDerivativesUpwind(outputPtr, g.i, g.j, g.k, dx, &derx, &dery, &derz);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
 
-        float val = outputPtr->get(g)
-            - dtau * std::max(s, 0.0f)
-                * (std::sqrt(_square(std::max(derx[0], 0.0f))
-                           + _square(std::min(derx[1], 0.0f))
-                           + _square(std::max(dery[0], 0.0f))
-                           + _square(std::min(dery[1], 0.0f))
-                           + _square(std::max(derz[0], 0.0f))
-                           + _square(std::min(derz[1], 0.0f))) - 1.0f)
-            - dtau * std::min(s, 0.0f)
-                * (std::sqrt(_square(std::min(derx[0], 0.0f))
-                           + _square(std::max(derx[1], 0.0f))
-                           + _square(std::min(dery[0], 0.0f))
-                           + _square(std::max(dery[1], 0.0f))
-                           + _square(std::min(derz[0], 0.0f))
-                           + _square(std::max(derz[1], 0.0f))) - 1.0f);
+void LevelSetSolver::_initializeFastSweepingThread(int startidx, int endidx, 
+                                                   std::vector<GridIndex> *tiles, 
+                                                   FastSweepingGrids *grids) {
+    Array3d<float> *inputSDF = grids->inputSDF;
+    Array3d<float> *outputSDF = grids->outputSDF;
+    int isize = inputSDF->width;
+    int jsize = inputSDF->height;
+    int ksize = inputSDF->depth;
+    float inf = std::numeric_limits<float>::infinity();
+
+    GridIndex gmin, gmax;
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        _getTileBounds(tiles->at(tidx), isize, jsize, ksize, gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    if (!grids->solverMask->get(i, j, k)) {
+                        continue;
+                    }
+
+                    float phi = inputSDF->get(i, j, k);
+                    float d = _getInterfaceDistance(inputSDF, i, j, k, grids->dx);
+                    if (d < inf) {
+                        outputSDF->set(i, j, k, phi < 0.0f ? -d : d);
+                        grids->frozenCells->set(i, j, k, true);
+                    } else {
+                        outputSDF->set(i, j, k, phi < 0.0f ? -inf : inf);
+                    }
+                }
+            }
+        }
+    }
+}
 
-        tempPtr->set(g, val);
+/*
+    Distance from a cell centre to the interface estimated by linearly
+    locating the zero crossing along each axis. Returns infinity if the 
+    cell has no neighbour of opposite sign.
+*/
+float LevelSetSolver::_getInterfaceDistance(Array3d<float> *sdf, 
+                                            int i, int j, int k, float dx) {
+    float inf = std::numeric_limits<float>::infinity();
+    float phi = sdf->get(i, j, k);
+    if (phi == 0.0f) {
+        return 0.0f;
+    }
+
+    GridIndex nbs[6] = {
+        GridIndex(i - 1, j, k), GridIndex(i + 1, j, k),
+        GridIndex(i, j - 1, k), GridIndex(i, j + 1, k),
+        GridIndex(i, j, k - 1), GridIndex(i, j, k + 1)
+    };
+
+    bool isInterfaceCell = false;
+    float invDistSq = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float axisDist = inf;
+        for (int side = 0; side < 2; side++) {
+            GridIndex n = nbs[2 * axis + side];
+            if (!sdf->isIndexInRange(n)) {
+                continue;
+            }
+
+            float nphi = sdf->get(n);
+            if ((phi < 0.0f) == (nphi < 0.0f)) {
+                continue;
+            }
+
+            float theta = phi / (phi - nphi);
+            axisDist = std::min(axisDist, theta * dx);
+        }
+
+        if (axisDist < inf) {
+            if (axisDist <= 0.0f) {
+                return 0.0f;
+            }
+            invDistSq += 1.0f / (axisDist * axisDist);
+            isInterfaceCell = true;
+        }
+    }
+
+    if (!isInterfaceCell) {
+        return inf;
     }
+
+    return 1.0f / std::sqrt(invDistSq);
 }
 
-void LevelSetSolver::_getDerivativesUpwind(Array3d<float> *grid,
-                                        int i, int j, int k, float dx, 
-                                        std::array<float, 2> *derx,
-                                        std::array<float, 2> *dery,
-                                        std::array<float, 2> *derz) {
-    
-    float D0[3];
-    int isize = grid->width;
-    int jsize = grid->height;
-    int ksize = grid->depth;
+void LevelSetSolver::_sweepTilesMT(std::vector<GridIndex> &tiles, GridIndex dir, 
+                                   FastSweepingGrids &grids) {
+    if (tiles.size() == 1) {
+        _sweepTile(tiles[0], dir, &grids);
+        return;
+    }
 
-    int im1 = (i < 1) ? 0 : i - 1;
-    int ip1 = std::min(i + 1, isize - 1);
-    int jm1 = (j < 1) ? 0 : j - 1;
-    int jp1 = std::min(j + 1, jsize - 1);
-    int km1 = (k < 1) ? 0 : k - 1;
-    int kp1 = std::min(k + 1, ksize - 1);
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, tiles.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, tiles.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&LevelSetSolver::_sweepTilesThread, this,
+                                 intervals[i], intervals[i + 1], &tiles, dir, &grids);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void LevelSetSolver::_sweepTilesThread(int startidx, int endidx, 
+                                       std::vector<GridIndex> *tiles, GridIndex dir,
+                                       FastSweepingGrids *grids) {
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        _sweepTile(tiles->at(tidx), dir, grids);
+    }
+}
 
-    D0[0] = grid->get(im1, j, k);
-    D0[1] = grid->get(i, j, k);
-    D0[2] = grid->get(ip1, j, k);
-    *derx = _upwind1(D0, dx);
+void LevelSetSolver::_sweepTile(GridIndex tile, GridIndex dir, FastSweepingGrids *grids) {
+    Array3d<float> *outputSDF = grids->outputSDF;
+    GridIndex gmin, gmax;
+    _getTileBounds(tile, outputSDF->width, outputSDF->height, outputSDF->depth, gmin, gmax);
+
+    int istart = dir.i > 0 ? gmin.i : gmax.i - 1;
+    int jstart = dir.j > 0 ? gmin.j : gmax.j - 1;
+    int kstart = dir.k > 0 ? gmin.k : gmax.k - 1;
+    int ni = gmax.i - gmin.i;
+    int nj = gmax.j - gmin.j;
+    int nk = gmax.k - gmin.k;
+
+    for (int kn = 0, k = kstart; kn < nk; kn++, k += dir.k) {
+        for (int jn = 0, j = jstart; jn < nj; jn++, j += dir.j) {
+            for (int in = 0, i = istart; in < ni; in++, i += dir.i) {
+                if (grids->solverMask->get(i, j, k) && !grids->frozenCells->get(i, j, k)) {
+                    _updateCellDistance(i, j, k, grids);
+                }
+            }
+        }
+    }
+}
 
-    D0[0] = grid->get(i, jm1, k);
-    D0[1] = grid->get(i, j, k);
-    D0[2] = grid->get(i, jp1, k);
-    *dery = _upwind1(D0, dx);
+void LevelSetSolver::_updateCellDistance(int i, int j, int k, FastSweepingGrids *grids) {
+    float a = std::min(_getNeighbourDistance(i - 1, j, k, grids), 
+                       _getNeighbourDistance(i + 1, j, k, grids));
+    float b = std::min(_getNeighbourDistance(i, j - 1, k, grids), 
+                       _getNeighbourDistance(i, j + 1, k, grids));
+    float c = std::min(_getNeighbourDistance(i, j, k - 1, grids), 
+                       _getNeighbourDistance(i, j, k + 1, grids));
+
+    float d = _solveEikonal(a, b, c, grids->dx);
+    float phi = grids->outputSDF->get(i, j, k);
+    if (d < std::abs(phi)) {
+        grids->outputSDF->set(i, j, k, phi < 0.0f ? -d : d);
+    }
+}
 
-    D0[0] = grid->get(i, j, km1);
-    D0[1] = grid->get(i, j, k);
-    D0[2] = grid->get(i, j, kp1);
-    *derz = _upwind1(D0, dx);
+float LevelSetSolver::_getNeighbourDistance(int i, int j, int k, FastSweepingGrids *grids) {
+    if (!grids->solverMask->isIndexInRange(i, j, k) || !grids->solverMask->get(i, j, k)) {
+        return std::numeric_limits<float>::infinity();
+    }
+    return std::abs(grids->outputSDF->get(i, j, k));
 }
 
-std::array<float, 2> LevelSetSolver::_upwind1(float *D0, float dx) {
-    float invdx = 1.0f / dx;
-    std::array<float, 2> dfx;
-    dfx[0] = invdx * (D0[1] - D0[0]);
-    dfx[1] = invdx * (D0[2] - D0[1]);
-    return dfx;
-}
\ No newline at end of file
+/*
+    Godunov upwind solution of |grad d| = 1 given the smallest neighbour 
+    distance along each axis.
+*/
+float LevelSetSolver::_solveEikonal(float a, float b, float c, float h) {
+    if (a > b) { std::swap(a, b); }
+    if (b > c) { std::swap(b, c); }
+    if (a > b) { std::swap(a, b); }
+
+    float d = a + h;
+    if (d <= b) {
+        return d;
+    }
+
+    d = 0.5f * (a + b + std::sqrt(2.0f * h * h - _square(a - b)));
+    if (d <= c) {
+        return d;
+    }
+
+    float sum = a + b + c;
+    float discriminant = sum * sum - 3.0f * (a * a + b * b + c * c - h * h);
+    return (sum + std::sqrt(std::max(discriminant, 0.0f))) / 3.0f;
+}
+
+void LevelSetSolver::_finalizeFastSweepingMT(std::vector<GridIndex> &tiles, 
+                                             FastSweepingGrids &grids) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, tiles.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, tiles.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&LevelSetSolver::_finalizeFastSweepingThread, this,
+                                 intervals[i], intervals[i + 1], &tiles, &grids);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void LevelSetSolver::_finalizeFastSweepingThread(int startidx, int endidx, 
+                                                 std::vector<GridIndex> *tiles, 
+                                                 FastSweepingGrids *grids) {
+    Array3d<float> *outputSDF = grids->outputSDF;
+    GridIndex gmin, gmax;
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        _getTileBounds(tiles->at(tidx), outputSDF->width, outputSDF->height, outputSDF->depth, gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    // Cells not connected to the interface keep their input value
+                    if (grids->solverMask->get(i, j, k) && std::isinf(outputSDF->get(i, j, k))) {
+                        outputSDF->set(i, j, k, grids->inputSDF->get(i, j, k));
+                    }
+                }
+            }
+        }
+    }
+}
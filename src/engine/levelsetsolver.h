@@ -51,6 +51,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #pragma once
 
 #include <array>
+#include <vector>
 
 #include "array3d.h"
 
@@ -66,16 +67,31 @@ public:
                       std::vector<GridIndex> &solverCells, 
                       Array3d<float> &outputSDF);
 
-    void reinitializeUpwind(Array3d<float> &inputSDF, 
-                      float dx,
-                      float maxDistance,
-                      std::vector<GridIndex> &solverCells, 
-                      Array3d<float> &outputSDF);
+    /*
+        Redistances inputSDF over solverCells with a narrow-band fast 
+        sweeping method. The band is split into tiles and each of the 
+        eight sweep orderings processes tiles along diagonal wavefronts 
+        in parallel, so the amount of work does not depend on the width 
+        of the band. Cells not in solverCells are copied from inputSDF.
+    */
+    void reinitializeFastSweeping(Array3d<float> &inputSDF, 
+                                  float dx,
+                                  std::vector<GridIndex> &solverCells, 
+                                  Array3d<float> &outputSDF);
 
 private:
 
+    struct FastSweepingGrids {
+        Array3d<float> *inputSDF = nullptr;
+        Array3d<float> *outputSDF = nullptr;
+        Array3d<bool> *solverMask = nullptr;
+        Array3d<bool> *frozenCells = nullptr;
+        float dx = 0.0f;
+    };
+
     float _maxCFL = 0.25;
-    float _upwindErrorThreshold = 0.01;
+    int _sweepTileWidth = 8;
+    int _numSweepRounds = 1;
 
     float _getPseudoTimeStep(Array3d<float> &sdf, float dx);
     float _sign(Array3d<float> &sdf, float dx, int i, int j, int k);
@@ -94,18 +110,28 @@ private:
                         std::array<float, 2> *derz);
     std::array<float, 2> _eno3(float *D0, float dx);
 
-    void _stepSolverThreadUpwind(int startidx, int endidx, 
-                             Array3d<float> *tempPtr,
-                             Array3d<float> *outputPtr, 
-                             float dx,
-                             float dtau,
-                             std::vector<GridIndex> *solverCells);
-    void _getDerivativesUpwind(Array3d<float> *grid,
-                               int i, int j, int k, float dx, 
-                               std::array<float, 2> *derx,
-                               std::array<float, 2> *dery,
-                               std::array<float, 2> *derz);
-    std::array<float, 2> _upwind1(float *D0, float dx);
+    void _getTileBounds(GridIndex tile, int isize, int jsize, int ksize,
+                        GridIndex &gmin, GridIndex &gmax);
+    void _initializeFastSweepingMT(std::vector<GridIndex> &tiles, 
+                                   FastSweepingGrids &grids);
+    void _initializeFastSweepingThread(int startidx, int endidx, 
+                                       std::vector<GridIndex> *tiles, 
+                                       FastSweepingGrids *grids);
+    float _getInterfaceDistance(Array3d<float> *sdf, int i, int j, int k, float dx);
+    void _sweepTilesMT(std::vector<GridIndex> &tiles, GridIndex dir, 
+                       FastSweepingGrids &grids);
+    void _sweepTilesThread(int startidx, int endidx, 
+                           std::vector<GridIndex> *tiles, GridIndex dir,
+                           FastSweepingGrids *grids);
+    void _sweepTile(GridIndex tile, GridIndex dir, FastSweepingGrids *grids);
+    void _updateCellDistance(int i, int j, int k, FastSweepingGrids *grids);
+    float _getNeighbourDistance(int i, int j, int k, FastSweepingGrids *grids);
+    float _solveEikonal(float a, float b, float c, float h);
+    void _finalizeFastSweepingMT(std::vector<GridIndex> &tiles, 
+                                 FastSweepingGrids &grids);
+    void _finalizeFastSweepingThread(int startidx, int endidx, 
+                                     std::vector<GridIndex> *tiles, 
+                                     FastSweepingGrids *grids);
 
 
     inline float _square(float s) { return s * s; }
@@ -24,6 +24,9 @@ SOFTWARE.
 
 #include "macvelocityfield.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "interpolation.h"
 #include "threadutils.h"
 #include "gridutils.h"
@@ -85,6 +88,24 @@ void MACVelocityField::clear() {
     clearW();
 }
 
+// Shares the velocity grids of vfield without copying. Grids are only 
+// copied if detach() is called while the snapshot is still in use.
+void MACVelocityField::constructSnapshot(MACVelocityField &vfield) {
+    vfield.getGridDimensions(&_isize, &_jsize, &_ksize);
+    _dx = vfield.getGridCellSize();
+    _outOfRangeVector = vfield._outOfRangeVector;
+
+    _u.constructSnapshot(vfield._u);
+    _v.constructSnapshot(vfield._v);
+    _w.constructSnapshot(vfield._w);
+}
+
+void MACVelocityField::detach() {
+    _u.detach();
+    _v.detach();
+    _w.detach();
+}
+
 Array3d<float>* MACVelocityField::getArray3dU() {
     return &_u;
 }
@@ -612,6 +633,139 @@ double MACVelocityField::_interpolateLinearW(double x, double y, double z) {
     return Interpolation::trilinearInterpolate(points, ix, iy, iz);
 }
 
+vmath::vec3 MACVelocityField::_interpolateLinearGradient(Array3d<float> &grid, 
+                                                         vmath::vec3 p, vmath::vec3 offset) {
+    p -= offset;
+    GridIndex g = Grid3d::positionToGridIndex(p, _dx);
+    vmath::vec3 gpos = Grid3d::GridIndexToPosition(g, _dx);
+    vmath::vec3 ipos = (p - gpos) / _dx;
+
+    float points[8];
+    for (int k = 0; k < 2; k++) {
+        for (int j = 0; j < 2; j++) {
+            for (int i = 0; i < 2; i++) {
+                GridIndex n(g.i + i, g.j + j, g.k + k);
+                points[i + 2 * j + 4 * k] = grid.isIndexInRange(n) ? grid(n) : 0.0f;
+            }
+        }
+    }
+
+    float invdx = (float)(1.0 / _dx);
+    return Interpolation::trilinearInterpolateGradientStrided(points, 2, 4, ipos.x, ipos.y, ipos.z, invdx);
+}
+
+void MACVelocityField::_evaluateVelocityAtPositionsLinear(vmath::vec3 *positions, int numPositions, 
+                                                          vmath::vec3 *velocities,
+                                                          vmath::vec3 *gradientsU, 
+                                                          vmath::vec3 *gradientsV, 
+                                                          vmath::vec3 *gradientsW) {
+    // Face values lie on cell boundaries along the face normal and on 
+    // cell centers along the two tangent axes
+    const int batchSize = 64;
+    float coordinates[3][batchSize];
+    int nodeIndices[3][batchSize];
+    int centerIndices[3][batchSize];
+    float nodeFractions[3][batchSize];
+    float centerFractions[3][batchSize];
+
+    float invdx = (float)(1.0 / _dx);
+    float h = 0.5f * (float)_dx;
+    int gridsize[3] = {_isize, _jsize, _ksize};
+    float *udata = _u.getRawArray();
+    float *vdata = _v.getRawArray();
+    float *wdata = _w.getRawArray();
+    int ujstride = _isize + 1;
+    int ukstride = (_isize + 1) * _jsize;
+    int vjstride = _isize;
+    int vkstride = _isize * (_jsize + 1);
+    int wjstride = _isize;
+    int wkstride = _isize * _jsize;
+    bool isGradientEnabled = gradientsU != nullptr && gradientsV != nullptr && gradientsW != nullptr;
+
+    for (int startidx = 0; startidx < numPositions; startidx += batchSize) {
+        int count = std::min(batchSize, numPositions - startidx);
+        vmath::vec3 *batch = positions + startidx;
+        for (int b = 0; b < count; b++) {
+            coordinates[0][b] = batch[b].x;
+            coordinates[1][b] = batch[b].y;
+            coordinates[2][b] = batch[b].z;
+        }
+
+        for (int dim = 0; dim < 3; dim++) {
+            for (int b = 0; b < count; b++) {
+                float gn = coordinates[dim][b] * invdx;
+                float gc = gn - 0.5f;
+                float fn = std::floor(gn);
+                float fc = std::floor(gc);
+                nodeIndices[dim][b] = (int)fn;
+                centerIndices[dim][b] = (int)fc;
+                nodeFractions[dim][b] = gn - fn;
+                centerFractions[dim][b] = gc - fc;
+            }
+        }
+
+        for (int b = 0; b < count; b++) {
+            bool isInterior = true;
+            for (int dim = 0; dim < 3; dim++) {
+                isInterior = isInterior && centerIndices[dim][b] >= 0 && 
+                                           centerIndices[dim][b] < gridsize[dim] - 1 &&
+                                           nodeIndices[dim][b] < gridsize[dim];
+            }
+
+            int idx = startidx + b;
+            if (!isInterior) {
+                vmath::vec3 p = batch[b];
+                if (isGradientEnabled) {
+                    gradientsU[idx] = _interpolateLinearGradient(_u, p, vmath::vec3(0.0f, h, h));
+                    gradientsV[idx] = _interpolateLinearGradient(_v, p, vmath::vec3(h, 0.0f, h));
+                    gradientsW[idx] = _interpolateLinearGradient(_w, p, vmath::vec3(h, h, 0.0f));
+                }
+                velocities[idx] = evaluateVelocityAtPositionLinear(p);
+                continue;
+            }
+
+            float *pu = udata + nodeIndices[0][b] + 
+                                ujstride * centerIndices[1][b] + 
+                                ukstride * centerIndices[2][b];
+            float *pv = vdata + centerIndices[0][b] + 
+                                vjstride * nodeIndices[1][b] + 
+                                vkstride * centerIndices[2][b];
+            float *pw = wdata + centerIndices[0][b] + 
+                                wjstride * centerIndices[1][b] + 
+                                wkstride * nodeIndices[2][b];
+
+            if (isGradientEnabled) {
+                gradientsU[idx] = Interpolation::trilinearInterpolateGradientStrided(
+                        pu, ujstride, ukstride, 
+                        nodeFractions[0][b], centerFractions[1][b], centerFractions[2][b], invdx
+                        );
+                gradientsV[idx] = Interpolation::trilinearInterpolateGradientStrided(
+                        pv, vjstride, vkstride, 
+                        centerFractions[0][b], nodeFractions[1][b], centerFractions[2][b], invdx
+                        );
+                gradientsW[idx] = Interpolation::trilinearInterpolateGradientStrided(
+                        pw, wjstride, wkstride, 
+                        centerFractions[0][b], centerFractions[1][b], nodeFractions[2][b], invdx
+                        );
+            }
+
+            float u = Interpolation::trilinearInterpolateStrided(
+                    pu, ujstride, ukstride, 
+                    nodeFractions[0][b], centerFractions[1][b], centerFractions[2][b]
+                    );
+            float v = Interpolation::trilinearInterpolateStrided(
+                    pv, vjstride, vkstride, 
+                    centerFractions[0][b], nodeFractions[1][b], centerFractions[2][b]
+                    );
+            float w = Interpolation::trilinearInterpolateStrided(
+                    pw, wjstride, wkstride, 
+                    centerFractions[0][b], centerFractions[1][b], nodeFractions[2][b]
+                    );
+            velocities[idx] = vmath::vec3(u, v, w);
+        }
+    }
+}
+
 vmath::vec3 MACVelocityField::evaluateVelocityAtPosition(vmath::vec3 pos) {
     return evaluateVelocityAtPosition(pos.x, pos.y, pos.z);
 }
@@ -644,6 +798,29 @@ vmath::vec3 MACVelocityField::evaluateVelocityAtPositionLinear(double x, double
     return vmath::vec3(xvel, yvel, zvel);
 }
 
+void MACVelocityField::evaluateVelocityAtPositionsLinear(vmath::vec3 *positions, int numPositions, 
+                                                         vmath::vec3 *velocities) {
+    _evaluateVelocityAtPositionsLinear(positions, numPositions, velocities, 
+                                       nullptr, nullptr, nullptr);
+}
+
+void MACVelocityField::evaluateVelocityAtPositionsLinear(std::vector<vmath::vec3> &positions, 
+                                                         std::vector<vmath::vec3> &velocities) {
+    velocities.resize(positions.size());
+    _evaluateVelocityAtPositionsLinear(positions.data(), (int)positions.size(), velocities.data(), 
+                                       nullptr, nullptr, nullptr);
+}
+
+void MACVelocityField::evaluateVelocityAndGradientsAtPositionsLinear(vmath::vec3 *positions, 
+                                                                     int numPositions, 
+                                                                     vmath::vec3 *velocities,
+                                                                     vmath::vec3 *gradientsU, 
+                                                                     vmath::vec3 *gradientsV, 
+                                                                     vmath::vec3 *gradientsW) {
+    _evaluateVelocityAtPositionsLinear(positions, numPositions, velocities, 
+                                       gradientsU, gradientsV, gradientsW);
+}
+
 float MACVelocityField::evaluateVelocityAtPositionLinearU(double x, double y, double z) {
     if (!Grid3d::isPositionInGrid(x, y, z, _dx, _isize, _jsize, _ksize)) {
         return 0.0f;
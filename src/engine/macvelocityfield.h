@@ -30,6 +30,8 @@ SOFTWARE.
     #include <thread>
 #endif
 
+#include <vector>
+
 #include "grid3d.h"
 
 struct ValidVelocityComponentGrid {
@@ -98,6 +100,9 @@ public:
     void clearV();
     void clearW();
 
+    void constructSnapshot(MACVelocityField &vfield);
+    void detach();
+
     inline bool isIndexInRangeU(int i, int j, int k) {
         return Grid3d::isGridIndexInRange(i, j, k, _isize + 1, _jsize, _ksize);
     }
@@ -134,6 +139,25 @@ public:
     float evaluateVelocityAtPositionLinearW(double x, double y, double z);
     vmath::vec3 evaluateVelocityAtPositionLinear(vmath::vec3 pos);
 
+    /*
+        Batched versions of evaluateVelocityAtPositionLinear. Interpolation 
+        weights are computed once per position and shared between the U, V 
+        and W grids. Positions sorted by grid cell make the best use of the 
+        cache. The velocities array may alias the positions array.
+
+        The gradient of each velocity component is also evaluated if 
+        gradient arrays are given.
+    */
+    void evaluateVelocityAtPositionsLinear(vmath::vec3 *positions, int numPositions, 
+                                           vmath::vec3 *velocities);
+    void evaluateVelocityAtPositionsLinear(std::vector<vmath::vec3> &positions, 
+                                           std::vector<vmath::vec3> &velocities);
+    void evaluateVelocityAndGradientsAtPositionsLinear(vmath::vec3 *positions, int numPositions, 
+                                                       vmath::vec3 *velocities,
+                                                       vmath::vec3 *gradientsU, 
+                                                       vmath::vec3 *gradientsV, 
+                                                       vmath::vec3 *gradientsW);
+
     vmath::vec3 velocityIndexToPositionU(int i, int j, int k);
     vmath::vec3 velocityIndexToPositionV(int i, int j, int k);
     vmath::vec3 velocityIndexToPositionW(int i, int j, int k);
@@ -157,6 +181,12 @@ private:
     double _interpolateLinearU(double x, double y, double z);
     double _interpolateLinearV(double x, double y, double z);
     double _interpolateLinearW(double x, double y, double z);
+    vmath::vec3 _interpolateLinearGradient(Array3d<float> &grid, vmath::vec3 p, vmath::vec3 offset);
+    void _evaluateVelocityAtPositionsLinear(vmath::vec3 *positions, int numPositions, 
+                                            vmath::vec3 *velocities,
+                                            vmath::vec3 *gradientsU, 
+                                            vmath::vec3 *gradientsV, 
+                                            vmath::vec3 *gradientsW);
 
 
     int _isize = 10;
@@ -0,0 +1,935 @@
+/*
+MIT License
+
+Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "meshcache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "trianglemesh.h"
+#include "threadutils.h"
+#include "fluidsimassert.h"
+
+namespace MeshCache {
+
+const char _magic[4] = {'F', 'F', 'M', 'C'};
+const char _particleMagic[4] = {'F', 'F', 'P', 'C'};
+const unsigned int _version = 1;
+const unsigned char _codecDeltaVarint = 0;
+const int _rowsPerBlock = 16384;
+const int _maxQuantizationBits = 24;
+
+struct _StreamHeader {
+    unsigned char codec = _codecDeltaVarint;
+    unsigned int numRows = 0;
+    unsigned int numComponents = 0;
+    unsigned int rowsPerBlock = 0;
+    unsigned int numBlocks = 0;
+};
+
+class _Reader {
+public:
+    _Reader(const char *data, size_t size) : _data(data), _size(size) {}
+
+    void read(void *dst, size_t n) {
+        if (_offset + n > _size) {
+            throw std::runtime_error("Error: mesh cache data is truncated.");
+        }
+        std::memcpy(dst, _data + _offset, n);
+        _offset += n;
+    }
+
+    unsigned int readUInt() {
+        unsigned int v;
+        read(&v, sizeof(unsigned int));
+        return v;
+    }
+
+    float readFloat() {
+        float v;
+        read(&v, sizeof(float));
+        return v;
+    }
+
+    void skip(size_t n) {
+        if (_offset + n > _size) {
+            throw std::runtime_error("Error: mesh cache data is truncated.");
+        }
+        _offset += n;
+    }
+
+    const char *getPointer() {
+        return _data + _offset;
+    }
+
+private:
+    const char *_data;
+    size_t _size;
+    size_t _offset = 0;
+};
+
+void _writeBytes(std::vector<char> &data, const void *src, size_t n) {
+    size_t offset = data.size();
+    data.resize(offset + n);
+    std::memcpy(data.data() + offset, src, n);
+}
+
+void _writeUInt(std::vector<char> &data, unsigned int v) {
+    _writeBytes(data, &v, sizeof(unsigned int));
+}
+
+void _writeFloat(std::vector<char> &data, float v) {
+    _writeBytes(data, &v, sizeof(float));
+}
+
+int _clampBits(int bits) {
+    return std::max(1, std::min(bits, _maxQuantizationBits));
+}
+
+unsigned int _quantize(float value, float minval, float range, unsigned int maxq) {
+    if (range <= 0.0f) {
+        return 0;
+    }
+    float t = (value - minval) / range;
+    t = std::max(0.0f, std::min(t, 1.0f));
+    return (unsigned int)std::lround(t * (float)maxq);
+}
+
+float _dequantize(unsigned int q, float minval, float range, unsigned int maxq) {
+    return minval + range * ((float)q / (float)maxq);
+}
+
+/*
+    Stream blocks
+*/
+
+void _encodeBlocksThread(int startidx, int endidx,
+                         std::vector<unsigned int> *values, 
+                         unsigned int numRows, unsigned int numComponents,
+                         std::vector<std::vector<char> > *blockData) {
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        size_t rowStart = (size_t)bidx * _rowsPerBlock;
+        size_t rowEnd = std::min(rowStart + _rowsPerBlock, (size_t)numRows);
+        std::vector<char> *block = &(blockData->at(bidx));
+        block->reserve(2 * (rowEnd - rowStart) * numComponents);
+
+        long long previous[4] = {0, 0, 0, 0};
+        for (size_t row = rowStart; row < rowEnd; row++) {
+            for (unsigned int c = 0; c < numComponents; c++) {
+                long long v = (long long)values->at(row * numComponents + c);
+                long long delta = v - previous[c];
+                previous[c] = v;
+
+                unsigned long long zigzag = ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63);
+                while (zigzag >= 0x80) {
+                    block->push_back((char)((zigzag & 0x7F) | 0x80));
+                    zigzag >>= 7;
+                }
+                block->push_back((char)zigzag);
+            }
+        }
+    }
+}
+
+void _writeStream(std::vector<unsigned int> &values, unsigned int numComponents, 
+                  std::vector<char> &data) {
+    FLUIDSIM_ASSERT(numComponents >= 1 && numComponents <= 4);
+
+    unsigned int numRows = (unsigned int)(values.size() / numComponents);
+    unsigned int numBlocks = (numRows + _rowsPerBlock - 1) / _rowsPerBlock;
+    std::vector<std::vector<char> > blockData(numBlocks);
+
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, numBlocks);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numBlocks, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&_encodeBlocksThread, intervals[i], intervals[i + 1],
+                                 &values, numRows, numComponents, &blockData);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    _writeBytes(data, &_codecDeltaVarint, sizeof(unsigned char));
+    _writeUInt(data, numRows);
+    _writeUInt(data, numComponents);
+    _writeUInt(data, _rowsPerBlock);
+    _writeUInt(data, numBlocks);
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < blockData.size(); i++) {
+        _writeUInt(data, (unsigned int)blockData[i].size());
+        totalBytes += blockData[i].size();
+    }
+
+    data.reserve(data.size() + totalBytes);
+    for (size_t i = 0; i < blockData.size(); i++) {
+        _writeBytes(data, blockData[i].data(), blockData[i].size());
+    }
+}
+
+_StreamHeader _readStreamHeader(_Reader &reader, std::vector<unsigned int> &blockSizes) {
+    _StreamHeader header;
+    reader.read(&(header.codec), sizeof(unsigned char));
+    header.numRows = reader.readUInt();
+    header.numComponents = reader.readUInt();
+    header.rowsPerBlock = reader.readUInt();
+    header.numBlocks = reader.readUInt();
+
+    bool isValid = header.codec == _codecDeltaVarint &&
+                   header.numComponents >= 1 && header.numComponents <= 4 &&
+                   header.rowsPerBlock > 0 &&
+                   (unsigned long long)header.numBlocks * header.rowsPerBlock >= header.numRows;
+    if (!isValid) {
+        throw std::runtime_error("Error: unsupported mesh cache stream.");
+    }
+
+    blockSizes.resize(header.numBlocks);
+    for (unsigned int i = 0; i < header.numBlocks; i++) {
+        blockSizes[i] = reader.readUInt();
+    }
+
+    return header;
+}
+
+void _skipStream(_Reader &reader) {
+    std::vector<unsigned int> blockSizes;
+    _readStreamHeader(reader, blockSizes);
+    for (size_t i = 0; i < blockSizes.size(); i++) {
+        reader.skip(blockSizes[i]);
+    }
+}
+
+void _decodeBlocksThread(int startidx, int endidx, const char *streamData,
+                         std::vector<size_t> *blockOffsets,
+                         _StreamHeader header,
+                         std::vector<unsigned int> *values,
+                         std::vector<char> *blockErrors) {
+    unsigned int numComponents = header.numComponents;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        const unsigned char *p = (const unsigned char *)(streamData + blockOffsets->at(bidx));
+        const unsigned char *pend = (const unsigned char *)(streamData + blockOffsets->at(bidx + 1));
+        size_t rowStart = (size_t)bidx * header.rowsPerBlock;
+        size_t rowEnd = std::min(rowStart + header.rowsPerBlock, (size_t)header.numRows);
+
+        long long previous[4] = {0, 0, 0, 0};
+        for (size_t row = rowStart; row < rowEnd; row++) {
+            for (unsigned int c = 0; c < numComponents; c++) {
+                unsigned long long zigzag = 0;
+                int shift = 0;
+                bool isTerminated = false;
+                while (p < pend && shift < 64) {
+                    unsigned char byte = *p++;
+                    zigzag |= (unsigned long long)(byte & 0x7F) << shift;
+                    shift += 7;
+                    if (!(byte & 0x80)) {
+                        isTerminated = true;
+                        break;
+                    }
+                }
+
+                if (!isTerminated) {
+                    blockErrors->at(bidx) = 1;
+                    return;
+                }
+
+                long long delta = (long long)(zigzag >> 1) ^ -(long long)(zigzag & 1);
+                previous[c] += delta;
+                values->at(row * numComponents + c) = (unsigned int)previous[c];
+            }
+        }
+    }
+}
+
+void _readStream(_Reader &reader, std::vector<unsigned int> &values, 
+                 unsigned int numComponents, unsigned int maxRows) {
+    std::vector<unsigned int> blockSizes;
+    _StreamHeader header = _readStreamHeader(reader, blockSizes);
+    if (header.numComponents != numComponents) {
+        throw std::runtime_error("Error: unexpected mesh cache stream layout.");
+    }
+
+    std::vector<size_t> blockOffsets(header.numBlocks + 1, 0);
+    for (unsigned int i = 0; i < header.numBlocks; i++) {
+        blockOffsets[i + 1] = blockOffsets[i] + blockSizes[i];
+    }
+
+    const char *streamData = reader.getPointer();
+    reader.skip(blockOffsets.back());
+
+    // Only the blocks covering the first maxRows rows are decoded
+    header.numRows = std::min(header.numRows, maxRows);
+    unsigned int numBlocks = (header.numRows + header.rowsPerBlock - 1) / header.rowsPerBlock;
+
+    values.resize((size_t)header.numRows * numComponents);
+    std::vector<char> blockErrors(numBlocks, 0);
+
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, numBlocks);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numBlocks, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&_decodeBlocksThread, intervals[i], intervals[i + 1],
+                                 streamData, &blockOffsets, header, &values, &blockErrors);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    for (size_t i = 0; i < blockErrors.size(); i++) {
+        if (blockErrors[i]) {
+            throw std::runtime_error("Error: mesh cache stream is corrupt.");
+        }
+    }
+}
+
+void _readStream(_Reader &reader, std::vector<unsigned int> &values, unsigned int numComponents) {
+    _readStream(reader, values, numComponents, std::numeric_limits<unsigned int>::max());
+}
+
+/*
+    Container
+*/
+
+struct _Header {
+    Info info;
+    unsigned int positionBits = 16;
+    vmath::vec3 boundsMin;
+    vmath::vec3 boundsSize;
+};
+
+_Header _readHeader(_Reader &reader) {
+    char magic[4];
+    reader.read(magic, 4);
+    if (std::memcmp(magic, _magic, 4) != 0) {
+        throw std::runtime_error("Error: data is not in the mesh cache format.");
+    }
+
+    unsigned int version = reader.readUInt();
+    if (version != _version) {
+        throw std::runtime_error("Error: unsupported mesh cache version.");
+    }
+
+    _Header header;
+    header.info.numVertices = (int)reader.readUInt();
+    header.info.numTriangles = (int)reader.readUInt();
+    header.info.numChannels = (int)reader.readUInt();
+    header.positionBits = reader.readUInt();
+    if (header.positionBits < 1 || header.positionBits > (unsigned int)_maxQuantizationBits) {
+        throw std::runtime_error("Error: unsupported mesh cache quantization.");
+    }
+
+    header.boundsMin.x = reader.readFloat();
+    header.boundsMin.y = reader.readFloat();
+    header.boundsMin.z = reader.readFloat();
+    header.boundsSize.x = reader.readFloat();
+    header.boundsSize.y = reader.readFloat();
+    header.boundsSize.z = reader.readFloat();
+
+    return header;
+}
+
+void _writeChannel(Channel &channel, int bits, std::vector<char> &data) {
+    int components = channel.components;
+    if (components < 1 || components > 4 || channel.values.size() % components != 0) {
+        throw std::invalid_argument("Error: invalid mesh cache channel layout.");
+    }
+
+    std::vector<float> minvals(components, 0.0f);
+    std::vector<float> maxvals(components, 0.0f);
+    if (!channel.values.empty()) {
+        for (int c = 0; c < components; c++) {
+            minvals[c] = maxvals[c] = channel.values[c];
+        }
+        for (size_t i = 0; i < channel.values.size(); i++) {
+            int c = (int)(i % components);
+            minvals[c] = std::min(minvals[c], channel.values[i]);
+            maxvals[c] = std::max(maxvals[c], channel.values[i]);
+        }
+    }
+
+    unsigned int maxq = (1u << bits) - 1;
+    std::vector<unsigned int> quantized(channel.values.size());
+    for (size_t i = 0; i < channel.values.size(); i++) {
+        int c = (int)(i % components);
+        quantized[i] = _quantize(channel.values[i], minvals[c], maxvals[c] - minvals[c], maxq);
+    }
+
+    _writeUInt(data, (unsigned int)channel.name.size());
+    _writeBytes(data, channel.name.data(), channel.name.size());
+    _writeUInt(data, (unsigned int)components);
+    _writeUInt(data, (unsigned int)(channel.values.size() / components));
+    _writeUInt(data, (unsigned int)bits);
+    for (int c = 0; c < components; c++) {
+        _writeFloat(data, minvals[c]);
+        _writeFloat(data, maxvals[c] - minvals[c]);
+    }
+    _writeStream(quantized, components, data);
+}
+
+struct _ChannelHeader {
+    ChannelInfo info;
+    unsigned int bits = 0;
+    std::vector<float> minvals;
+    std::vector<float> ranges;
+};
+
+_ChannelHeader _readChannelHeader(_Reader &reader) {
+    _ChannelHeader header;
+    unsigned int nameLength = reader.readUInt();
+    header.info.name.resize(nameLength);
+    reader.read(&(header.info.name[0]), nameLength);
+
+    header.info.components = (int)reader.readUInt();
+    header.info.numRows = (int)reader.readUInt();
+    header.bits = reader.readUInt();
+    if (header.info.components < 1 || header.info.components > 4 || header.info.numRows < 0 ||
+            header.bits < 1 || header.bits > (unsigned int)_maxQuantizationBits) {
+        throw std::runtime_error("Error: unsupported mesh cache channel.");
+    }
+
+    header.minvals.resize(header.info.components);
+    header.ranges.resize(header.info.components);
+    for (int c = 0; c < header.info.components; c++) {
+        header.minvals[c] = reader.readFloat();
+        header.ranges[c] = reader.readFloat();
+    }
+
+    return header;
+}
+
+void _readChannel(_Reader &reader, Channel &channel) {
+    _ChannelHeader header = _readChannelHeader(reader);
+    channel.name = header.info.name;
+    channel.components = header.info.components;
+
+    std::vector<unsigned int> quantized;
+    _readStream(reader, quantized, channel.components);
+    if (quantized.size() != (size_t)header.info.numRows * channel.components) {
+        throw std::runtime_error("Error: mesh cache channel count mismatch.");
+    }
+
+    unsigned int maxq = (1u << header.bits) - 1;
+    channel.values.resize(quantized.size());
+    for (size_t i = 0; i < quantized.size(); i++) {
+        int c = (int)(i % channel.components);
+        channel.values[i] = _dequantize(quantized[i], header.minvals[c], header.ranges[c], maxq);
+    }
+}
+
+bool isMeshCacheData(const char *data, size_t size) {
+    return size >= 4 && std::memcmp(data, _magic, 4) == 0;
+}
+
+void encode(TriangleMesh &mesh, std::vector<Channel> &channels, 
+            EncodeParameters params, std::vector<char> &data) {
+    int positionBits = _clampBits(params.positionBits);
+    int channelBits = _clampBits(params.channelBits);
+
+    vmath::vec3 minp = params.bounds.getMinPoint();
+    vmath::vec3 maxp = params.bounds.getMaxPoint();
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        vmath::vec3 v = mesh.vertices[i];
+        minp = vmath::vec3(std::min(minp.x, v.x), std::min(minp.y, v.y), std::min(minp.z, v.z));
+        maxp = vmath::vec3(std::max(maxp.x, v.x), std::max(maxp.y, v.y), std::max(maxp.z, v.z));
+    }
+    vmath::vec3 size = maxp - minp;
+
+    data.clear();
+    _writeBytes(data, _magic, 4);
+    _writeUInt(data, _version);
+    _writeUInt(data, (unsigned int)mesh.vertices.size());
+    _writeUInt(data, (unsigned int)mesh.triangles.size());
+    _writeUInt(data, (unsigned int)channels.size());
+    _writeUInt(data, (unsigned int)positionBits);
+    _writeFloat(data, minp.x);
+    _writeFloat(data, minp.y);
+    _writeFloat(data, minp.z);
+    _writeFloat(data, size.x);
+    _writeFloat(data, size.y);
+    _writeFloat(data, size.z);
+
+    unsigned int maxq = (1u << positionBits) - 1;
+    std::vector<unsigned int> values(3 * mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        vmath::vec3 v = mesh.vertices[i];
+        values[3 * i + 0] = _quantize(v.x, minp.x, size.x, maxq);
+        values[3 * i + 1] = _quantize(v.y, minp.y, size.y, maxq);
+        values[3 * i + 2] = _quantize(v.z, minp.z, size.z, maxq);
+    }
+    _writeStream(values, 3, data);
+
+    values.resize(3 * mesh.triangles.size());
+    for (size_t i = 0; i < mesh.triangles.size(); i++) {
+        Triangle t = mesh.triangles[i];
+        values[3 * i + 0] = (unsigned int)t.tri[0];
+        values[3 * i + 1] = (unsigned int)t.tri[1];
+        values[3 * i + 2] = (unsigned int)t.tri[2];
+    }
+    _writeStream(values, 3, data);
+
+    values.clear();
+    values.shrink_to_fit();
+    for (size_t i = 0; i < channels.size(); i++) {
+        _writeChannel(channels[i], channelBits, data);
+    }
+}
+
+void encode(TriangleMesh &mesh, EncodeParameters params, std::vector<char> &data) {
+    std::vector<Channel> channels;
+    encode(mesh, channels, params, data);
+}
+
+void encode(Channel &channel, EncodeParameters params, std::vector<char> &data) {
+    TriangleMesh mesh;
+    std::vector<Channel> channels({channel});
+    encode(mesh, channels, params, data);
+}
+
+Info getInfo(const char *data, size_t size) {
+    _Reader reader(data, size);
+    return _readHeader(reader).info;
+}
+
+void decodeMesh(const char *data, size_t size, float *vertices, int *triangles) {
+    _Reader reader(data, size);
+    _Header header = _readHeader(reader);
+
+    std::vector<unsigned int> values;
+    _readStream(reader, values, 3);
+    if (values.size() != 3 * (size_t)header.info.numVertices) {
+        throw std::runtime_error("Error: mesh cache vertex count mismatch.");
+    }
+
+    unsigned int maxq = (1u << header.positionBits) - 1;
+    vmath::vec3 minp = header.boundsMin;
+    vmath::vec3 extent = header.boundsSize;
+    for (int i = 0; i < header.info.numVertices; i++) {
+        vertices[3 * i + 0] = _dequantize(values[3 * i + 0], minp.x, extent.x, maxq);
+        vertices[3 * i + 1] = _dequantize(values[3 * i + 1], minp.y, extent.y, maxq);
+        vertices[3 * i + 2] = _dequantize(values[3 * i + 2], minp.z, extent.z, maxq);
+    }
+
+    _readStream(reader, values, 3);
+    if (values.size() != 3 * (size_t)header.info.numTriangles) {
+        throw std::runtime_error("Error: mesh cache triangle count mismatch.");
+    }
+
+    for (size_t i = 0; i < values.size(); i++) {
+        if (values[i] >= (unsigned int)header.info.numVertices) {
+            throw std::runtime_error("Error: mesh cache triangle index out of range.");
+        }
+        triangles[i] = (int)values[i];
+    }
+}
+
+void decodeMesh(const char *data, size_t size, TriangleMesh &mesh) {
+    Info info = getInfo(data, size);
+    std::vector<float> vertices(3 * (size_t)info.numVertices);
+    std::vector<int> triangles(3 * (size_t)info.numTriangles);
+    decodeMesh(data, size, vertices.data(), triangles.data());
+
+    mesh.vertices.resize(info.numVertices);
+    for (int i = 0; i < info.numVertices; i++) {
+        mesh.vertices[i] = vmath::vec3(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+    }
+    mesh.triangles.resize(info.numTriangles);
+    for (int i = 0; i < info.numTriangles; i++) {
+        mesh.triangles[i] = Triangle(triangles[3 * i], triangles[3 * i + 1], triangles[3 * i + 2]);
+    }
+}
+
+// Positions the reader at the start of a channel header
+void _seekChannel(_Reader &reader, int channelIndex) {
+    _Header header = _readHeader(reader);
+    if (channelIndex < 0 || channelIndex >= header.info.numChannels) {
+        throw std::out_of_range("Error: mesh cache channel index out of range.");
+    }
+
+    _skipStream(reader);
+    _skipStream(reader);
+    for (int i = 0; i < channelIndex; i++) {
+        _readChannelHeader(reader);
+        _skipStream(reader);
+    }
+}
+
+ChannelInfo getChannelInfo(const char *data, size_t size, int channelIndex) {
+    _Reader reader(data, size);
+    _seekChannel(reader, channelIndex);
+    return _readChannelHeader(reader).info;
+}
+
+void decodeChannel(const char *data, size_t size, int channelIndex, Channel &channel) {
+    _Reader reader(data, size);
+    _seekChannel(reader, channelIndex);
+    _readChannel(reader, channel);
+}
+
+/*
+    Particle container
+*/
+
+struct _ParticleHeader {
+    ParticleInfo info;
+    std::vector<unsigned int> groupSizes;
+};
+
+_ParticleHeader _readParticleHeader(_Reader &reader) {
+    char magic[4];
+    reader.read(magic, 4);
+    if (std::memcmp(magic, _particleMagic, 4) != 0) {
+        throw std::runtime_error("Error: data is not in the particle cache format.");
+    }
+
+    unsigned int version = reader.readUInt();
+    if (version != _version) {
+        throw std::runtime_error("Error: unsupported particle cache version.");
+    }
+
+    _ParticleHeader header;
+    header.info.numGroups = (int)reader.readUInt();
+    header.info.idLimit = (int)reader.readUInt();
+    header.info.numChannels = (int)reader.readUInt();
+    if (header.info.numGroups < 0 || header.info.idLimit < 0 || header.info.numChannels < 0) {
+        throw std::runtime_error("Error: unsupported particle cache layout.");
+    }
+
+    header.info.idBinEnds.resize(header.info.numGroups);
+    header.groupSizes.resize(header.info.numGroups, 0);
+    for (int g = 0; g < header.info.numGroups; g++) {
+        // Only non-empty bins are stored as (ID, end) pairs
+        std::vector<unsigned int> sparseBins;
+        _readStream(reader, sparseBins, 2);
+
+        std::vector<unsigned int> *binEnds = &(header.info.idBinEnds[g]);
+        binEnds->assign(header.info.idLimit, 0);
+        int previousID = -1;
+        unsigned int previousEnd = 0;
+        for (size_t i = 0; i < sparseBins.size(); i += 2) {
+            int id = (int)sparseBins[i];
+            if (id <= previousID || id >= header.info.idLimit) {
+                throw std::runtime_error("Error: particle cache ID bins are corrupt.");
+            }
+            for (int fill = previousID + 1; fill < id; fill++) {
+                binEnds->at(fill) = previousEnd;
+            }
+            previousID = id;
+            previousEnd = sparseBins[i + 1];
+            binEnds->at(id) = previousEnd;
+        }
+        for (int fill = previousID + 1; fill < header.info.idLimit; fill++) {
+            binEnds->at(fill) = previousEnd;
+        }
+
+        for (int id = 1; id < header.info.idLimit; id++) {
+            if (binEnds->at(id) < binEnds->at(id - 1)) {
+                throw std::runtime_error("Error: particle cache ID bins are corrupt.");
+            }
+        }
+        header.groupSizes[g] = binEnds->empty() ? 0 : binEnds->back();
+    }
+
+    return header;
+}
+
+void _getParticlePositionParameters(std::vector<float> &values, 
+                                    ParticleEncodeParameters &params, 
+                                    int *bits) {
+    // The largest quantized coordinate must fit in 32 bits
+    float origin[3] = {params.cellOrigin.x, params.cellOrigin.y, params.cellOrigin.z};
+    float invdx = (float)(1.0 / params.cellSize);
+    float maxcell = 0.0f;
+    for (size_t i = 0; i < values.size(); i++) {
+        maxcell = std::max(maxcell, (values[i] - origin[i % 3]) * invdx);
+    }
+
+    int maxbits = _clampBits(params.positionBits);
+    while (maxbits > 1 && (double)(maxcell + 1.0f) * (double)(1u << maxbits) >= 4294967295.0) {
+        maxbits--;
+    }
+    *bits = maxbits;
+}
+
+void _writeParticleChannel(ParticleChannel &channel, 
+                           std::vector<unsigned int> &groupSizes,
+                           ParticleEncodeParameters &params, 
+                           std::vector<char> &data) {
+    int components = channel.components;
+    bool isInt = channel.type == ParticleChannelType::ints;
+    size_t numValues = isInt ? channel.intValues.size() : channel.values.size();
+    size_t numRows = 0;
+    for (size_t g = 0; g < groupSizes.size(); g++) {
+        numRows += groupSizes[g];
+    }
+
+    bool isValid = components >= 1 && components <= 4 && 
+                   numValues == numRows * components &&
+                   (channel.type != ParticleChannelType::positions || components == 3);
+    if (!isValid) {
+        throw std::invalid_argument("Error: invalid particle cache channel layout.");
+    }
+
+    std::vector<unsigned int> quantized(numValues);
+    std::vector<float> headerValues;
+    int bits = 0;
+    if (channel.type == ParticleChannelType::positions) {
+        _getParticlePositionParameters(channel.values, params, &bits);
+        float origin[3] = {params.cellOrigin.x, params.cellOrigin.y, params.cellOrigin.z};
+        double scale = (double)(1u << bits) / params.cellSize;
+        for (size_t i = 0; i < numValues; i++) {
+            double q = std::round((channel.values[i] - origin[i % 3]) * scale);
+            quantized[i] = (unsigned int)std::max(q, 0.0);
+        }
+        headerValues.push_back(params.cellOrigin.x);
+        headerValues.push_back(params.cellOrigin.y);
+        headerValues.push_back(params.cellOrigin.z);
+        headerValues.push_back((float)params.cellSize);
+    } else if (channel.type == ParticleChannelType::floats) {
+        bits = _clampBits(params.channelBits);
+        std::vector<float> minvals(components, 0.0f);
+        std::vector<float> maxvals(components, 0.0f);
+        if (numValues > 0) {
+            for (int c = 0; c < components; c++) {
+                minvals[c] = maxvals[c] = channel.values[c];
+            }
+        }
+        for (size_t i = 0; i < numValues; i++) {
+            int c = (int)(i % components);
+            minvals[c] = std::min(minvals[c], channel.values[i]);
+            maxvals[c] = std::max(maxvals[c], channel.values[i]);
+        }
+
+        unsigned int maxq = (1u << bits) - 1;
+        for (size_t i = 0; i < numValues; i++) {
+            int c = (int)(i % components);
+            quantized[i] = _quantize(channel.values[i], minvals[c], maxvals[c] - minvals[c], maxq);
+        }
+        for (int c = 0; c < components; c++) {
+            headerValues.push_back(minvals[c]);
+            headerValues.push_back(maxvals[c] - minvals[c]);
+        }
+    } else {
+        for (size_t i = 0; i < numValues; i++) {
+            quantized[i] = (unsigned int)channel.intValues[i];
+        }
+    }
+
+    _writeUInt(data, (unsigned int)channel.name.size());
+    _writeBytes(data, channel.name.data(), channel.name.size());
+    _writeUInt(data, (unsigned int)channel.type);
+    _writeUInt(data, (unsigned int)components);
+    _writeUInt(data, (unsigned int)bits);
+    for (size_t i = 0; i < headerValues.size(); i++) {
+        _writeFloat(data, headerValues[i]);
+    }
+
+    size_t rowOffset = 0;
+    std::vector<unsigned int> groupValues;
+    for (size_t g = 0; g < groupSizes.size(); g++) {
+        size_t begin = rowOffset * components;
+        size_t end = (rowOffset + groupSizes[g]) * components;
+        groupValues.assign(quantized.begin() + begin, quantized.begin() + end);
+        _writeStream(groupValues, components, data);
+        rowOffset += groupSizes[g];
+    }
+}
+
+void _readParticleChannel(_Reader &reader, _ParticleHeader &header, 
+                          std::vector<unsigned int> *groupRows,
+                          ParticleChannel &channel) {
+    unsigned int nameLength = reader.readUInt();
+    channel.name.resize(nameLength);
+    reader.read(&(channel.name[0]), nameLength);
+
+    unsigned int type = reader.readUInt();
+    channel.components = (int)reader.readUInt();
+    unsigned int bits = reader.readUInt();
+    bool isValid = type <= (unsigned int)ParticleChannelType::ints &&
+                   channel.components >= 1 && channel.components <= 4 &&
+                   bits <= (unsigned int)_maxQuantizationBits;
+    if (!isValid) {
+        throw std::runtime_error("Error: unsupported particle cache channel.");
+    }
+    channel.type = (ParticleChannelType)type;
+
+    std::vector<float> headerValues;
+    if (channel.type == ParticleChannelType::positions) {
+        headerValues.resize(4);
+    } else if (channel.type == ParticleChannelType::floats) {
+        headerValues.resize(2 * channel.components);
+    }
+    for (size_t i = 0; i < headerValues.size(); i++) {
+        headerValues[i] = reader.readFloat();
+    }
+
+    // A NULL row count skips the channel
+    if (groupRows == nullptr) {
+        for (int g = 0; g < header.info.numGroups; g++) {
+            _skipStream(reader);
+        }
+        return;
+    }
+
+    std::vector<unsigned int> quantized;
+    std::vector<unsigned int> groupValues;
+    for (int g = 0; g < header.info.numGroups; g++) {
+        _readStream(reader, groupValues, channel.components, groupRows->at(g));
+        if (groupValues.size() != (size_t)groupRows->at(g) * channel.components) {
+            throw std::runtime_error("Error: particle cache channel count mismatch.");
+        }
+        quantized.insert(quantized.end(), groupValues.begin(), groupValues.end());
+    }
+
+    channel.values.clear();
+    channel.intValues.clear();
+    if (channel.type == ParticleChannelType::positions) {
+        double scale = (double)headerValues[3] / (double)(1u << bits);
+        channel.values.resize(quantized.size());
+        for (size_t i = 0; i < quantized.size(); i++) {
+            channel.values[i] = (float)(headerValues[i % 3] + scale * quantized[i]);
+        }
+    } else if (channel.type == ParticleChannelType::floats) {
+        unsigned int maxq = (1u << bits) - 1;
+        channel.values.resize(quantized.size());
+        for (size_t i = 0; i < quantized.size(); i++) {
+            int c = (int)(i % channel.components);
+            channel.values[i] = _dequantize(quantized[i], headerValues[2 * c], headerValues[2 * c + 1], maxq);
+        }
+    } else {
+        channel.intValues.resize(quantized.size());
+        for (size_t i = 0; i < quantized.size(); i++) {
+            channel.intValues[i] = (int)quantized[i];
+        }
+    }
+}
+
+bool isParticleCacheData(const char *data, size_t size) {
+    return size >= 4 && std::memcmp(data, _particleMagic, 4) == 0;
+}
+
+void encodeParticles(std::vector<ParticleChannel> &channels, 
+                     std::vector<std::vector<unsigned int> > &idBinEnds,
+                     ParticleEncodeParameters params, std::vector<char> &data) {
+    if (params.cellSize <= 0.0) {
+        throw std::domain_error("Error: particle cache cell size must be greater than 0.");
+    }
+
+    unsigned int idLimit = idBinEnds.empty() ? 0 : (unsigned int)idBinEnds[0].size();
+    std::vector<unsigned int> groupSizes(idBinEnds.size(), 0);
+    for (size_t g = 0; g < idBinEnds.size(); g++) {
+        if (idBinEnds[g].size() != idLimit) {
+            throw std::invalid_argument("Error: particle cache groups must share an ID limit.");
+        }
+        groupSizes[g] = idLimit == 0 ? 0 : idBinEnds[g].back();
+    }
+
+    data.clear();
+    _writeBytes(data, _particleMagic, 4);
+    _writeUInt(data, _version);
+    _writeUInt(data, (unsigned int)idBinEnds.size());
+    _writeUInt(data, idLimit);
+    _writeUInt(data, (unsigned int)channels.size());
+    std::vector<unsigned int> sparseBins;
+    for (size_t g = 0; g < idBinEnds.size(); g++) {
+        sparseBins.clear();
+        unsigned int previousEnd = 0;
+        for (unsigned int id = 0; id < idLimit; id++) {
+            if (idBinEnds[g][id] != previousEnd) {
+                sparseBins.push_back(id);
+                sparseBins.push_back(idBinEnds[g][id]);
+                previousEnd = idBinEnds[g][id];
+            }
+        }
+        _writeStream(sparseBins, 2, data);
+    }
+
+    for (size_t i = 0; i < channels.size(); i++) {
+        _writeParticleChannel(channels[i], groupSizes, params, data);
+    }
+}
+
+void encodeParticles(ParticleChannel &channel, 
+                     std::vector<std::vector<unsigned int> > &idBinEnds,
+                     ParticleEncodeParameters params, std::vector<char> &data) {
+    std::vector<ParticleChannel> channels({channel});
+    encodeParticles(channels, idBinEnds, params, data);
+}
+
+ParticleInfo getParticleInfo(const char *data, size_t size) {
+    _Reader reader(data, size);
+    return _readParticleHeader(reader).info;
+}
+
+// Positions the reader at the start of a particle channel header
+void _seekParticleChannel(_Reader &reader, _ParticleHeader &header, int channelIndex) {
+    if (channelIndex < 0 || channelIndex >= header.info.numChannels) {
+        throw std::out_of_range("Error: particle cache channel index out of range.");
+    }
+
+    for (int i = 0; i < channelIndex; i++) {
+        ParticleChannel skipped;
+        _readParticleChannel(reader, header, nullptr, skipped);
+    }
+}
+
+ParticleChannelInfo getParticleChannelInfo(const char *data, size_t size, int channelIndex) {
+    _Reader reader(data, size);
+    _ParticleHeader header = _readParticleHeader(reader);
+    _seekParticleChannel(reader, header, channelIndex);
+
+    ParticleChannel channel;
+    _readParticleChannel(reader, header, nullptr, channel);
+
+    ParticleChannelInfo info;
+    info.name = channel.name;
+    info.type = channel.type;
+    info.components = channel.components;
+    return info;
+}
+
+void decodeParticleChannel(const char *data, size_t size, int channelIndex, 
+                           std::vector<int> &groupIDCounts, ParticleChannel &channel) {
+    _Reader reader(data, size);
+    _ParticleHeader header = _readParticleHeader(reader);
+    _seekParticleChannel(reader, header, channelIndex);
+    if ((int)groupIDCounts.size() != header.info.numGroups) {
+        throw std::invalid_argument("Error: particle cache group count mismatch.");
+    }
+
+    std::vector<unsigned int> groupRows(header.info.numGroups, 0);
+    for (int g = 0; g < header.info.numGroups; g++) {
+        int count = std::max(0, std::min(groupIDCounts[g], header.info.idLimit));
+        groupRows[g] = count == 0 ? 0 : header.info.idBinEnds[g][count - 1];
+    }
+
+    _readParticleChannel(reader, header, &groupRows, channel);
+}
+
+}
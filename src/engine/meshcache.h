@@ -0,0 +1,179 @@
+/*
+MIT License
+
+Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "aabb.h"
+
+class TriangleMesh;
+
+/*
+    Compact mesh cache container
+
+    Vertex positions are quantized relative to a bounding box, triangle
+    indices and per-vertex channel values are delta encoded, and each stream
+    is split into blocks that are zigzag/varint coded in parallel.
+
+    Layout (little endian):
+        char[4]  magic "FFMC"
+        uint32   version
+        uint32   numVertices, numTriangles, numChannels
+        uint32   positionBits
+        float[3] bounds minimum
+        float[3] bounds size
+        stream   quantized positions
+        stream   triangle indices
+        numChannels x {
+            uint32   name length, char[] name
+            uint32   components, rows, bits
+            float[]  minimum and range per component
+            stream   quantized values
+        }
+
+    A container without vertices or triangles holds per-vertex attribute
+    channels, such as surface velocity vectors.
+
+    Particle layout (little endian):
+        char[4]  magic "FFPC"
+        uint32   version
+        uint32   numGroups, idLimit, numChannels
+        numGroups x stream (ID, end offset) pairs of non-empty ID bins
+        numChannels x {
+            uint32   name length, char[] name
+            uint32   type, components, bits
+            type specific parameters:
+                positions: float[3] cell origin, float cell size
+                floats:    float[] minimum and range per component
+                ints:      none
+            stream   values for each group
+        }
+
+    Particles are ordered by group and then by display ID bin, and each group
+    is written as its own stream so that any ID prefix of a group can be
+    decoded without touching the blocks that follow it. Positions are stored
+    as a cell index and a quantized offset within the cell with 'bits'
+    fractional bits.
+
+    Stream:
+        uint8    codec
+        uint32   numRows, numComponents, rowsPerBlock, numBlocks
+        uint32[] block byte sizes
+        char[]   block data
+*/
+namespace MeshCache {
+
+    struct Channel {
+        std::string name;
+        int components = 1;
+        std::vector<float> values;
+    };
+
+    struct EncodeParameters {
+        // Positions outside of the bounds expand the bounds
+        AABB bounds;
+        int positionBits = 16;
+        int channelBits = 16;
+    };
+
+    struct Info {
+        int numVertices = 0;
+        int numTriangles = 0;
+        int numChannels = 0;
+    };
+
+    struct ChannelInfo {
+        std::string name;
+        int components = 1;
+        int numRows = 0;
+    };
+
+    enum class ParticleChannelType : int { 
+        positions = 0x00, 
+        floats    = 0x01, 
+        ints      = 0x02
+    };
+
+    struct ParticleChannel {
+        std::string name;
+        ParticleChannelType type = ParticleChannelType::floats;
+        int components = 1;
+        std::vector<float> values;
+        std::vector<int> intValues;
+    };
+
+    struct ParticleChannelInfo {
+        std::string name;
+        ParticleChannelType type = ParticleChannelType::floats;
+        int components = 1;
+    };
+
+    struct ParticleEncodeParameters {
+        vmath::vec3 cellOrigin;
+        double cellSize = 1.0;
+        int positionBits = 8;
+        int channelBits = 16;
+    };
+
+    struct ParticleInfo {
+        int numGroups = 0;
+        int idLimit = 0;
+        int numChannels = 0;
+
+        // idBinEnds[g][id] is the exclusive end of ID bin 'id' in group g
+        std::vector<std::vector<unsigned int> > idBinEnds;
+    };
+
+    bool isMeshCacheData(const char *data, size_t size);
+
+    void encode(TriangleMesh &mesh, std::vector<Channel> &channels, 
+                EncodeParameters params, std::vector<char> &data);
+    void encode(TriangleMesh &mesh, EncodeParameters params, std::vector<char> &data);
+    void encode(Channel &channel, EncodeParameters params, std::vector<char> &data);
+
+    Info getInfo(const char *data, size_t size);
+    void decodeMesh(const char *data, size_t size, TriangleMesh &mesh);
+    void decodeMesh(const char *data, size_t size, float *vertices, int *triangles);
+    ChannelInfo getChannelInfo(const char *data, size_t size, int channelIndex);
+    void decodeChannel(const char *data, size_t size, int channelIndex, Channel &channel);
+
+    bool isParticleCacheData(const char *data, size_t size);
+
+    void encodeParticles(std::vector<ParticleChannel> &channels, 
+                         std::vector<std::vector<unsigned int> > &idBinEnds,
+                         ParticleEncodeParameters params, std::vector<char> &data);
+    void encodeParticles(ParticleChannel &channel, 
+                         std::vector<std::vector<unsigned int> > &idBinEnds,
+                         ParticleEncodeParameters params, std::vector<char> &data);
+
+    ParticleInfo getParticleInfo(const char *data, size_t size);
+    ParticleChannelInfo getParticleChannelInfo(const char *data, size_t size, int channelIndex);
+
+    // Decodes the first groupIDCounts[g] ID bins of each group g
+    void decodeParticleChannel(const char *data, size_t size, int channelIndex, 
+                               std::vector<int> &groupIDCounts, ParticleChannel &channel);
+
+}
@@ -43,12 +43,16 @@ MeshFluidSource::~MeshFluidSource() {
 
 void MeshFluidSource::updateMeshStatic(TriangleMesh meshCurrent) {
     _meshObject.updateMeshStatic(meshCurrent);
+    _isUpToDate = false;
+    _isStaticCellCacheValid = false;
 }
 
 void MeshFluidSource::updateMeshAnimated(TriangleMesh meshPrevious, 
                                          TriangleMesh meshCurrent, 
                                          TriangleMesh meshNext) {
     _meshObject.updateMeshAnimated(meshPrevious, meshCurrent, meshNext);
+    _isUpToDate = false;
+    _isStaticCellCacheValid = false;
 }
 
 void MeshFluidSource::enable() {
@@ -185,6 +189,25 @@ void MeshFluidSource::update(double dt) {
 
     TriangleMesh sourceMesh = _meshObject.getMesh(_currentFrameInterpolation);
 
+    // A rigid source that has only been translated since the cached SDF was
+    // computed can reuse the SDF by moving its offset
+    vmath::vec3 translation;
+    bool isCacheReusable = _isSDFCacheValid && isRigidBody() && !_meshObject.isInversed() && 
+                           _isMeshInsideGrid(sourceMesh, _gridpad) &&
+                           _getMeshTranslation(_cachedSDFMesh, sourceMesh, translation);
+    if (isCacheReusable) {
+        _sourceSDFOffset = _cachedSDFOffset + translation;
+        _isSDFTranslated = true;
+        _isUpToDate = true;
+        return;
+    }
+
+    // The SDF is only cached when the padded bounds are not clipped by the 
+    // domain, otherwise a translated mesh could extend past the cached region
+    bool isCacheable = isRigidBody() && !_meshObject.isInversed() && 
+                       _isMeshInsideGrid(sourceMesh, _gridpad);
+    _cachedSDFMesh = isCacheable ? sourceMesh : TriangleMesh();
+
     GridIndex gmin, gmax;
     _getGridBoundsFromTriangleMesh(sourceMesh, _gridpad, gmin, gmax);
     _sourceSDFGridOffset = gmin;
@@ -221,6 +244,10 @@ void MeshFluidSource::update(double dt) {
         _calculateVelocityFieldData();
     }
 
+    _isSDFCacheValid = isCacheable;
+    _cachedSDFOffset = _sourceSDFOffset;
+    _isSDFTranslated = false;
+
     _isUpToDate = true;
 }
 
@@ -233,9 +260,42 @@ void MeshFluidSource::getCells(std::vector<GridIndex> &cells) {
 }
 
 void MeshFluidSource::getCells(float frameInterpolation, std::vector<GridIndex> &cells) {
+    if (_meshObject.isInversed()) {
+        _meshObject.getCells(frameInterpolation, cells);
+        return;
+    }
+
+    if (!_meshObject.isAnimated()) {
+        if (!_isStaticCellCacheValid) {
+            _staticCells.clear();
+            _meshObject.getCells(frameInterpolation, _staticCells);
+            _isStaticCellCacheValid = true;
+        }
+        cells.insert(cells.end(), _staticCells.begin(), _staticCells.end());
+        return;
+    }
+
+    float eps = 1e-6;
+    bool isSDFCurrent = _isUpToDate && fabs(frameInterpolation - _currentFrameInterpolation) < eps;
+    if (isSDFCurrent && _isSDFTranslated) {
+        _getCellsFromSignedDistanceField(cells);
+        return;
+    }
+
     _meshObject.getCells(frameInterpolation, cells);
 }
 
+void MeshFluidSource::getGridBounds(float frameInterpolation, GridIndex &gmin, GridIndex &gmax) {
+    if (_meshObject.isInversed()) {
+        gmin = GridIndex(0, 0, 0);
+        gmax = GridIndex(_isize - 1, _jsize - 1, _ksize - 1);
+        return;
+    }
+
+    TriangleMesh sourceMesh = _meshObject.getMesh(frameInterpolation);
+    _getGridBoundsFromTriangleMesh(sourceMesh, 1.0, gmin, gmax);
+}
+
 MeshObject* MeshFluidSource::getMeshObject() {
     return &_meshObject;
 }
@@ -374,6 +434,90 @@ void MeshFluidSource::_calculateVelocityFieldData() {
     _vfieldData = vdata;
 }
 
+void MeshFluidSource::_getCellsFromSignedDistanceField(std::vector<GridIndex> &cells) {
+    // Cells are marked from the grid nodes inside of the SDF, matching the
+    // node based voxelization of MeshObject::getCells
+    int isdf, jsdf, ksdf;
+    _sourceSDF.getGridDimensions(&isdf, &jsdf, &ksdf);
+
+    GridIndex nmin = Grid3d::positionToGridIndex(_sourceSDFOffset, _dx);
+    GridIndex nmax(nmin.i + isdf + 1, nmin.j + jsdf + 1, nmin.k + ksdf + 1);
+    nmin = GridIndex(std::max(nmin.i, 0), std::max(nmin.j, 0), std::max(nmin.k, 0));
+    nmax = GridIndex(std::min(nmax.i, _isize), std::min(nmax.j, _jsize), std::min(nmax.k, _ksize));
+    if (nmax.i < nmin.i || nmax.j < nmin.j || nmax.k < nmin.k) {
+        return;
+    }
+
+    GridIndex cmin(std::max(nmin.i - 1, 0), std::max(nmin.j - 1, 0), std::max(nmin.k - 1, 0));
+    GridIndex cmax(std::min(nmax.i, _isize - 1), std::min(nmax.j, _jsize - 1), std::min(nmax.k, _ksize - 1));
+    Array3d<bool> cellGrid(cmax.i - cmin.i + 1, cmax.j - cmin.j + 1, cmax.k - cmin.k + 1, false);
+
+    GridIndex nodeCells[8];
+    for (int k = nmin.k; k <= nmax.k; k++) {
+        for (int j = nmin.j; j <= nmax.j; j++) {
+            for (int i = nmin.i; i <= nmax.i; i++) {
+                vmath::vec3 p = Grid3d::GridIndexToPosition(i, j, k, _dx);
+                if (_sourceSDF.trilinearInterpolate(p - _sourceSDFOffset) >= 0.0f) {
+                    continue;
+                }
+
+                Grid3d::getVertexGridIndexNeighbours(i, j, k, nodeCells);
+                for (int nidx = 0; nidx < 8; nidx++) {
+                    GridIndex g(nodeCells[nidx].i - cmin.i, 
+                                nodeCells[nidx].j - cmin.j, 
+                                nodeCells[nidx].k - cmin.k);
+                    if (cellGrid.isIndexInRange(g)) {
+                        cellGrid.set(g, true);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int k = 0; k < cellGrid.depth; k++) {
+        for (int j = 0; j < cellGrid.height; j++) {
+            for (int i = 0; i < cellGrid.width; i++) {
+                if (cellGrid(i, j, k)) {
+                    cells.push_back(GridIndex(i + cmin.i, j + cmin.j, k + cmin.k));
+                }
+            }
+        }
+    }
+}
+
+bool MeshFluidSource::_getMeshTranslation(TriangleMesh &reference, TriangleMesh &m, 
+                                          vmath::vec3 &translation) {
+    if (reference.vertices.empty() || 
+            reference.vertices.size() != m.vertices.size() ||
+            reference.triangles.size() != m.triangles.size()) {
+        return false;
+    }
+
+    double eps = 1e-4 * _dx;
+    translation = m.vertices[0] - reference.vertices[0];
+    for (size_t i = 1; i < m.vertices.size(); i++) {
+        vmath::vec3 t = m.vertices[i] - reference.vertices[i];
+        if (vmath::length(t - translation) > eps) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool MeshFluidSource::_isMeshInsideGrid(TriangleMesh &m, double pad) {
+    if (m.vertices.empty()) {
+        return false;
+    }
+
+    AABB bbox(m.vertices);
+    bbox.expand(pad * _dx);
+    GridIndex gmin = Grid3d::positionToGridIndex(bbox.getMinPoint(), _dx);
+    GridIndex gmax = Grid3d::positionToGridIndex(bbox.getMaxPoint(), _dx);
+    return gmin.i >= 0 && gmin.j >= 0 && gmin.k >= 0 &&
+           gmax.i < _isize && gmax.j < _jsize && gmax.k < _ksize;
+}
+
 void MeshFluidSource::_getGridBoundsFromTriangleMesh(TriangleMesh &m, double pad, 
                                                      GridIndex &gmin, GridIndex &gmax) {
     AABB bbox(m.vertices);
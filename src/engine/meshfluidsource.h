@@ -99,6 +99,7 @@ public:
     float trilinearInterpolate(vmath::vec3 p);
     void getCells(std::vector<GridIndex> &cells);
     void getCells(float frameInterpolation, std::vector<GridIndex> &cells);
+    void getGridBounds(float frameInterpolation, GridIndex &gmin, GridIndex &gmax);
     MeshObject* getMeshObject();
     MeshLevelSet* getMeshLevelSet();
     vmath::vec3 getMeshLevelSetOffset();
@@ -136,6 +137,10 @@ private:
 
     void _initializeID();
     void _calculateVelocityFieldData();
+    void _getCellsFromSignedDistanceField(std::vector<GridIndex> &cells);
+    bool _getMeshTranslation(TriangleMesh &reference, TriangleMesh &m, 
+                             vmath::vec3 &translation);
+    bool _isMeshInsideGrid(TriangleMesh &m, double pad);
     void _getGridBoundsFromTriangleMesh(TriangleMesh &m, double pad, 
                                         GridIndex &gmin, GridIndex &gmax);
 
@@ -159,6 +164,14 @@ private:
     vmath::vec3 _sourceSDFOffset;
     double _gridpad = 4.0;
 
+    bool _isSDFCacheValid = false;
+    bool _isSDFTranslated = false;
+    TriangleMesh _cachedSDFMesh;
+    vmath::vec3 _cachedSDFOffset;
+
+    bool _isStaticCellCacheValid = false;
+    std::vector<GridIndex> _staticCells;
+
     int _ID;
     static int _IDCounter;
 
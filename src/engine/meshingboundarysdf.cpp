@@ -0,0 +1,176 @@
+/*
+MIT License
+
+Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "meshingboundarysdf.h"
+
+#include "meshlevelset.h"
+#include "interpolation.h"
+#include "threadutils.h"
+#include "grid3d.h"
+#include "fluidsimassert.h"
+
+MeshingBoundarySDF::MeshingBoundarySDF() {
+}
+
+MeshingBoundarySDF::MeshingBoundarySDF(int isize, int jsize, int ksize, double dx) :
+                                       _isize(isize), _jsize(jsize), _ksize(ksize), _dx(dx) {
+}
+
+MeshingBoundarySDF::~MeshingBoundarySDF() {
+}
+
+void MeshingBoundarySDF::setSolidSDF(MeshLevelSet *solidSDF) {
+    int si, sj, sk;
+    solidSDF->getGridDimensions(&si, &sj, &sk);
+    FLUIDSIM_ASSERT(si == _isize && sj == _jsize && sk == _ksize);
+    _solidSDF = solidSDF;
+    _solidPhi = solidSDF->getPhiArray3d()->getRawArray();
+}
+
+void MeshingBoundarySDF::setSolidOffset(float offset, int offsetWidth) {
+    _solidOffset = offset;
+    _solidOffsetWidth = offsetWidth;
+}
+
+void MeshingBoundarySDF::setBoundarySDF(MeshLevelSet *boundarySDF) {
+    int si, sj, sk;
+    boundarySDF->getGridDimensions(&si, &sj, &sk);
+    FLUIDSIM_ASSERT(si == _isize && sj == _jsize && sk == _ksize);
+    _boundarySDF = boundarySDF;
+    _boundaryPhi = boundarySDF->getPhiArray3d()->getRawArray();
+}
+
+float MeshingBoundarySDF::operator()(int i, int j, int k) {
+    return get(i, j, k);
+}
+
+float MeshingBoundarySDF::get(int i, int j, int k) {
+    FLUIDSIM_ASSERT(_solidSDF != nullptr || _boundarySDF != nullptr);
+    FLUIDSIM_ASSERT(Grid3d::isGridIndexInRange(i, j, k, _isize + 1, _jsize + 1, _ksize + 1));
+    return _getValue(i, j, k);
+}
+
+float MeshingBoundarySDF::trilinearInterpolate(vmath::vec3 pos) {
+    MeshLevelSet *levelset = _getSingleLevelSet();
+    if (levelset != nullptr) {
+        return levelset->trilinearInterpolate(pos);
+    }
+
+    // Matches Interpolation::trilinearInterpolate with nodes outside of the
+    // grid evaluating to zero
+    GridIndex g = Grid3d::positionToGridIndex(pos, _dx);
+    vmath::vec3 gpos = Grid3d::GridIndexToPosition(g, _dx);
+
+    double inv_dx = 1.0 / _dx;
+    double ix = (pos.x - gpos.x)*inv_dx;
+    double iy = (pos.y - gpos.y)*inv_dx;
+    double iz = (pos.z - gpos.z)*inv_dx;
+
+    GridIndex corners[8] = {
+        GridIndex(g.i,     g.j,     g.k),
+        GridIndex(g.i + 1, g.j,     g.k),
+        GridIndex(g.i,     g.j + 1, g.k),
+        GridIndex(g.i,     g.j,     g.k + 1),
+        GridIndex(g.i + 1, g.j,     g.k + 1),
+        GridIndex(g.i,     g.j + 1, g.k + 1),
+        GridIndex(g.i + 1, g.j + 1, g.k),
+        GridIndex(g.i + 1, g.j + 1, g.k + 1)
+    };
+
+    double points[8] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    for (int idx = 0; idx < 8; idx++) {
+        GridIndex c = corners[idx];
+        if (Grid3d::isGridIndexInRange(c, _isize + 1, _jsize + 1, _ksize + 1)) {
+            points[idx] = _getValue(c.i, c.j, c.k);
+        }
+    }
+
+    return Interpolation::trilinearInterpolate(points, ix, iy, iz);
+}
+
+void MeshingBoundarySDF::trilinearInterpolateSolidGridPoints(vmath::vec3 offset, double dx, 
+                                                             Array3d<bool> &grid) {
+    MeshLevelSet *levelset = _getSingleLevelSet();
+    if (levelset != nullptr) {
+        levelset->trilinearInterpolateSolidGridPoints(offset, dx, grid);
+        return;
+    }
+
+    size_t gridsize = grid.width * grid.height * grid.depth;
+    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, gridsize);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&MeshingBoundarySDF::_trilinearInterpolateSolidGridPointsThread, this,
+                                 intervals[i], intervals[i + 1], offset, dx, &grid);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+MeshLevelSet* MeshingBoundarySDF::_getSingleLevelSet() {
+    if (_solidSDF == nullptr) {
+        return _boundarySDF;
+    }
+    if (_boundarySDF == nullptr && _solidOffset == 0.0f) {
+        return _solidSDF;
+    }
+    return nullptr;
+}
+
+void MeshingBoundarySDF::_trilinearInterpolateSolidGridPointsThread(int startidx, int endidx, 
+                                                                    vmath::vec3 offset, double dx, 
+                                                                    Array3d<bool> *grid) {
+    double eps = 1e-6;
+    bool isAlignedSubd2 = fabs(2*dx - _dx) < eps && vmath::length(offset) < eps;
+
+    int isize = grid->width;
+    int jsize = grid->height;
+
+    if (isAlignedSubd2) {
+        for (int idx = startidx; idx < endidx; idx++) {
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
+
+            float d;
+            if (g.i % 2 == 0 && g.j % 2 == 0 && g.k % 2 == 0) {
+                d = _getValue(g.i >> 1, g.j >> 1, g.k >> 1);
+            } else {
+                vmath::vec3 p = Grid3d::GridIndexToPosition(g, dx);
+                d = trilinearInterpolate(p + offset);
+            }
+            grid->set(g, d < 0);
+        }
+    } else {
+        for (int idx = startidx; idx < endidx; idx++) {
+            GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
+            vmath::vec3 p = Grid3d::GridIndexToPosition(g, dx);
+            if (trilinearInterpolate(p + offset) < 0) {
+                grid->set(g, true);
+            }
+        }
+    }
+}
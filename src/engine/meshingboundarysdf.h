@@ -0,0 +1,109 @@
+/*
+MIT License
+
+Copyright (C) 2025 Ryan L. Guy & Dennis Fassbaender
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#if __MINGW32__ && !_WIN64
+    #include "mingw32_threads/mingw.thread.h"
+#else
+    #include <thread>
+#endif
+
+#include "vmath.h"
+#include "array3d.h"
+
+class MeshLevelSet;
+
+/*
+    Solid boundary field used by the surface mesher. Values are evaluated on 
+    demand from a per-frame solid SDF and a cached boundary SDF (domain boundary
+    or meshing volume) so that the combined field never needs to be stored. 
+    
+    Where both level sets are set, a value is min(solid + offset, boundary). The 
+    solid offset is only applied to nodes at least offsetWidth nodes from the 
+    domain border.
+*/
+class MeshingBoundarySDF
+{
+public:
+    MeshingBoundarySDF();
+    MeshingBoundarySDF(int isize, int jsize, int ksize, double dx);
+    ~MeshingBoundarySDF();
+
+    void getGridDimensions(int *i, int *j, int *k) { *i = _isize; *j = _jsize; *k = _ksize; }
+    double getCellSize() { return _dx; }
+
+    void setSolidSDF(MeshLevelSet *solidSDF);
+    void setSolidOffset(float offset, int offsetWidth);
+    void setBoundarySDF(MeshLevelSet *boundarySDF);
+
+    float operator()(int i, int j, int k);
+    float get(int i, int j, int k);
+    float trilinearInterpolate(vmath::vec3 pos);
+    void trilinearInterpolateSolidGridPoints(vmath::vec3 offset, double dx, 
+                                             Array3d<bool> &grid);
+
+private:
+
+    MeshLevelSet* _getSingleLevelSet();
+    void _trilinearInterpolateSolidGridPointsThread(int startidx, int endidx, 
+                                                    vmath::vec3 offset, double dx, 
+                                                    Array3d<bool> *grid);
+
+    inline float _getValue(int i, int j, int k) {
+        int flatidx = i + (_isize + 1) * (j + (_jsize + 1) * k);
+        if (_solidPhi == nullptr) {
+            return _boundaryPhi[flatidx];
+        }
+
+        float d = _solidPhi[flatidx];
+        if (_solidOffset != 0.0f && _isSolidOffsetNode(i, j, k)) {
+            d += _solidOffset;
+        }
+        if (_boundaryPhi != nullptr && _boundaryPhi[flatidx] < d) {
+            d = _boundaryPhi[flatidx];
+        }
+
+        return d;
+    }
+
+    inline bool _isSolidOffsetNode(int i, int j, int k) {
+        return i >= _solidOffsetWidth && i <= _isize - _solidOffsetWidth &&
+               j >= _solidOffsetWidth && j <= _jsize - _solidOffsetWidth &&
+               k >= _solidOffsetWidth && k <= _ksize - _solidOffsetWidth;
+    }
+
+    int _isize = 0;
+    int _jsize = 0;
+    int _ksize = 0;
+    double _dx = 0.0;
+
+    MeshLevelSet *_solidSDF = nullptr;
+    MeshLevelSet *_boundarySDF = nullptr;
+    float *_solidPhi = nullptr;
+    float *_boundaryPhi = nullptr;
+    float _solidOffset = 0.0f;
+    int _solidOffsetWidth = 0;
+
+};
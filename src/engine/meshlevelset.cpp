@@ -65,20 +65,18 @@ void MeshLevelSet::constructMinimalLevelSet(int isize, int jsize, int ksize, dou
     _isVelocityDataEnabled = false;
 }
 
+// The phi grid is shared with levelset as a copy-on-write snapshot. Both
+// level sets must call detach() before modifying phi in place.
 void MeshLevelSet::constructMinimalSignedDistanceField(MeshLevelSet &levelset) {
     levelset.getGridDimensions(&_isize, &_jsize, &_ksize);
     _dx = levelset.getCellSize();
-    _phi = Array3d<float>(_isize + 1, _jsize + 1, _ksize + 1);
+    _phi.constructSnapshot(levelset._phi);
     _isMinimalLevelSet = true;
     _isVelocityDataEnabled = false;
+}
 
-    for (int k = 0; k < _phi.depth; k++) {
-        for (int j = 0; j < _phi.height; j++) {
-            for (int i = 0; i < _phi.width; i++) {
-                _phi.set(i, j, k, levelset(i, j, k));
-            }
-        }
-    }
+void MeshLevelSet::detach() {
+    _phi.detach();
 }
 
 float MeshLevelSet::operator()(int i, int j, int k) {
@@ -283,9 +281,8 @@ void MeshLevelSet::trilinearInterpolatePoints(std::vector<vmath::vec3> &points,
 void MeshLevelSet::_trilinearInterpolatePointsThread(int startidx, int endidx,
                                                      std::vector<vmath::vec3> *points, 
                                                      std::vector<float> *results) {
-    for (int i = startidx; i < endidx; i++) {
-        (*results)[i] = trilinearInterpolate(points->at(i));
-    }
+    Interpolation::trilinearInterpolatePoints(points->data() + startidx, endidx - startidx, 
+                                              _dx, _phi, results->data() + startidx);
 }
 
 void MeshLevelSet::trilinearInterpolateSolidGridPoints(vmath::vec3 offset, double dx, 
@@ -532,6 +529,7 @@ VelocityDataGrid* MeshLevelSet::getVelocityDataGrid() {
 }
 
 Array3d<float>* MeshLevelSet::getPhiArray3d() {
+    _phi.detach();
     return &_phi;
 }
 
@@ -549,6 +547,7 @@ void MeshLevelSet::calculateSignedDistanceField(TriangleMesh &m,
                                                 int bandwidth) {
     FLUIDSIM_ASSERT(vertexVelocities.size() == m.vertices.size());
 
+    _phi.detach();
     _mesh = m;
     _vertexVelocities = vertexVelocities;
 
@@ -579,6 +578,7 @@ void MeshLevelSet::fastCalculateSignedDistanceField(TriangleMesh &m,
                                                     int bandwidth) {
     FLUIDSIM_ASSERT(vertexVelocities.size() == m.vertices.size());
 
+    _phi.detach();
     _mesh = m;
     _vertexVelocities = vertexVelocities;
 
@@ -601,6 +601,8 @@ void MeshLevelSet::fastCalculateSignedDistanceField(TriangleMesh &m,
 }
 
 void MeshLevelSet::calculateUnion(MeshLevelSet &levelset) {
+    _phi.detach();
+
     // Merge mesh data
     TriangleMesh *meshOther = levelset.getTriangleMesh();
     int triIndexOffset = (int)_mesh.triangles.size();
@@ -700,6 +702,7 @@ void MeshLevelSet::normalizeVelocityGrid() {
 }
 
 void MeshLevelSet::negate() {
+    _phi.detach();
     _phi.negate();
 
     if (_isVelocityDataEnabled) {
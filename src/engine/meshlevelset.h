@@ -98,6 +98,7 @@ public:
 
     void constructMinimalLevelSet(int isize, int jsize, int ksize, double dx);
     void constructMinimalSignedDistanceField(MeshLevelSet &levelset);
+    void detach();
 
     float operator()(int i, int j, int k);
     float operator()(GridIndex g);
@@ -25,6 +25,7 @@ SOFTWARE.
 #include "meshutils.h"
 
 #include <limits>
+#include <algorithm>
 
 #include "grid3d.h"
 #include "collision.h"
@@ -54,108 +55,143 @@ void structToTriangleMesh(TriangleMesh_t &mesh_data, TriangleMesh &mesh) {
     }
 }
 
-void _getTriangleGridZ(
-        TriangleMesh &m, double dx, Array3d<std::vector<int> > &ztrigrid) {
-    AABB tbbox;
-    GridIndex gmin, gmax;
-    std::vector<int> *tris;
-    for (unsigned int tidx = 0; tidx < m.triangles.size(); tidx++) {
-        tbbox = AABB(m.triangles[tidx], m.vertices);
-        Grid3d::getGridIndexBounds(
-            tbbox, dx, ztrigrid.width, ztrigrid.height, 1, &gmin, &gmax
-        );
+void _getTriangleColumnBoundsThread(int startidx, int endidx, 
+                                    TriangleMesh *m, double dx, int isize, int jsize,
+                                    std::vector<GridIndex> *columnMin, 
+                                    std::vector<GridIndex> *columnMax) {
+    double invdx = 1.0 / dx;
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        Triangle t = m->triangles[tidx];
+        vmath::vec3 v1 = m->vertices[t.tri[0]];
+        vmath::vec3 v2 = m->vertices[t.tri[1]];
+        vmath::vec3 v3 = m->vertices[t.tri[2]];
+        double xmin = std::min(v1.x, std::min(v2.x, v3.x));
+        double xmax = std::max(v1.x, std::max(v2.x, v3.x));
+        double ymin = std::min(v1.y, std::min(v2.y, v3.y));
+        double ymax = std::max(v1.y, std::max(v2.y, v3.y));
+
+        // Columns are sampled at cell centers, only columns whose center is
+        // within the triangle's bounds can be crossed
+        GridIndex gmin((int)ceil(xmin * invdx - 0.5), (int)ceil(ymin * invdx - 0.5), 0);
+        GridIndex gmax((int)floor(xmax * invdx - 0.5), (int)floor(ymax * invdx - 0.5), 0);
+        gmin.i = std::max(gmin.i, 0);
+        gmin.j = std::max(gmin.j, 0);
+        gmax.i = std::min(gmax.i, isize - 1);
+        gmax.j = std::min(gmax.j, jsize - 1);
+
+        (*columnMin)[tidx] = gmin;
+        (*columnMax)[tidx] = gmax;
+    }
+}
+
+void _getTriangleColumnBins(TriangleMesh &m, double dx, int isize, int jsize,
+                            std::vector<int> &columnStarts, 
+                            std::vector<int> &columnTriangles,
+                            bool computeSingleThreaded) {
+    size_t numTriangles = m.triangles.size();
+    std::vector<GridIndex> columnMin(numTriangles);
+    std::vector<GridIndex> columnMax(numTriangles);
+
+    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    if (computeSingleThreaded) {
+        numCPU = 1;
+    }
+    int numthreads = (int)std::min(numCPU, std::max(numTriangles, (size_t)1));
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numTriangles, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&_getTriangleColumnBoundsThread,
+                                 intervals[i], intervals[i + 1], 
+                                 &m, dx, isize, jsize, &columnMin, &columnMax);
+    }
 
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    columnStarts = std::vector<int>(isize * jsize + 1, 0);
+    for (size_t tidx = 0; tidx < numTriangles; tidx++) {
+        GridIndex gmin = columnMin[tidx];
+        GridIndex gmax = columnMax[tidx];
         for (int j = gmin.j; j <= gmax.j; j++) {
             for (int i = gmin.i; i <= gmax.i; i++) {
-                tris = ztrigrid.getPointer(i, j, 0);
-                tris->push_back(tidx);
+                columnStarts[Grid3d::getFlatIndex(i, j, 0, isize, jsize) + 1]++;
             }
         }
     }
-}
 
-void _getTriangleCollisionsZ(
-        vmath::vec3 origin, std::vector<int> &indices, TriangleMesh &m,
-        std::vector<float> &collisions) {
+    for (size_t i = 1; i < columnStarts.size(); i++) {
+        columnStarts[i] += columnStarts[i - 1];
+    }
 
-    vmath::vec3 dir(0.0, 0.0, 1.0);
-    vmath::vec3 v1, v2, v3, coll;
-    Triangle t;
-    for (unsigned int i = 0; i < indices.size(); i++) {
-        t = m.triangles[indices[i]];
-        v1 = m.vertices[t.tri[0]];
-        v2 = m.vertices[t.tri[1]];
-        v3 = m.vertices[t.tri[2]];
-        if (Collision::lineIntersectsTriangle(origin, dir, v1, v2, v3, &coll)) {
-            collisions.push_back(coll.z);
+    std::vector<int> columnOffsets(columnStarts.begin(), columnStarts.end() - 1);
+    columnTriangles = std::vector<int>(columnStarts.back());
+    for (size_t tidx = 0; tidx < numTriangles; tidx++) {
+        GridIndex gmin = columnMin[tidx];
+        GridIndex gmax = columnMax[tidx];
+        for (int j = gmin.j; j <= gmax.j; j++) {
+            for (int i = gmin.i; i <= gmax.i; i++) {
+                int flatidx = Grid3d::getFlatIndex(i, j, 0, isize, jsize);
+                columnTriangles[columnOffsets[flatidx]] = (int)tidx;
+                columnOffsets[flatidx]++;
+            }
         }
     }
 }
 
-double _randomDouble(double min, double max) {
-    return min + ((double)rand() / (double)RAND_MAX) * (max - min);
-}
-
-void _getCollisionGridZ(TriangleMesh &m, double dx, Array3d<std::vector<float> > &zcollisions, 
-                        bool computeSingleThreaded) {
+double _getEdgeFunctionXY(vmath::vec3 a, vmath::vec3 b, double px, double py) {
+    // The endpoints are evaluated in a canonical order so that two triangles
+    // sharing an edge compute exactly negated values
+    bool isSwapped = b.x < a.x || (b.x == a.x && b.y < a.y);
+    if (isSwapped) {
+        std::swap(a, b);
+    }
 
-    Array3d<std::vector<int> > ztrigrid(zcollisions.width, zcollisions.height, 1);
-    _getTriangleGridZ(m, dx, ztrigrid);
+    double w = ((double)b.x - (double)a.x) * (py - (double)a.y) - 
+               ((double)b.y - (double)a.y) * (px - (double)a.x);
+    return isSwapped ? -w : w;
+}
 
-    /* Triangles that align perfectly with grid cell centers may produce 
-       imperfect collision results due to an edge case where a line-mesh 
-       intersection can report two collisions when striking an edge that is 
-       shared by two triangles. To reduce the chance of this occurring, a random
-       jitter will be added to the position of the grid cell centers. 
-    */
-    double jit = 0.001 * dx;
-    vmath::vec3 jitter(_randomDouble(jit, -jit), 
-                       _randomDouble(jit, -jit), 
-                       _randomDouble(jit, -jit));
+bool _isTopLeftEdgeXY(vmath::vec3 a, vmath::vec3 b) {
+    return (a.y == b.y && b.x < a.x) || b.y < a.y;
+}
 
-    size_t gridsize = ztrigrid.width * ztrigrid.height;
-    size_t numCPU = ThreadUtils::getMaxThreadCount();
-    if (computeSingleThreaded) {
-        numCPU = 1;
+bool _getTriangleCrossingZ(vmath::vec3 v1, vmath::vec3 v2, vmath::vec3 v3, 
+                           double px, double py, double *z) {
+    double area = ((double)v2.x - (double)v1.x) * ((double)v3.y - (double)v1.y) - 
+                  ((double)v2.y - (double)v1.y) * ((double)v3.x - (double)v1.x);
+    if (area == 0.0) {
+        return false;
     }
-    int numthreads = (int)std::min(numCPU, gridsize);
-    std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
-    for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&_getCollisionGridZThread,
-                                 intervals[i], intervals[i + 1], 
-                                 dx, jitter, &m, &ztrigrid, &zcollisions);
+    if (area < 0.0) {
+        std::swap(v2, v3);
     }
 
-    for (int i = 0; i < numthreads; i++) {
-        threads[i].join();
+    // Points that fall exactly on an edge or vertex are assigned to a single
+    // triangle with a top-left rule, so that a column crossing through shared
+    // geometry is counted exactly once
+    double w1 = _getEdgeFunctionXY(v2, v3, px, py);
+    if (w1 < 0.0 || (w1 == 0.0 && !_isTopLeftEdgeXY(v2, v3))) {
+        return false;
     }
-    
-}
 
-void _getCollisionGridZThread(int startidx, int endidx, 
-                              double dx, 
-                              vmath::vec3 jitter,
-                              TriangleMesh *m, 
-                              Array3d<std::vector<int> > *ztrigrid,
-                              Array3d<std::vector<float> > *zcollisions) {
-
-    int isize = ztrigrid->width;
-    int jsize = ztrigrid->height;
-    std::vector<float> *zvals;
-    std::vector<int> *tris;
-    for (int idx = startidx; idx < endidx; idx++) {
-        GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
-        tris = ztrigrid->getPointer(g.i, g.j, 0);
-        if (tris->size() == 0) {
-            continue;
-        }
+    double w2 = _getEdgeFunctionXY(v3, v1, px, py);
+    if (w2 < 0.0 || (w2 == 0.0 && !_isTopLeftEdgeXY(v3, v1))) {
+        return false;
+    }
+
+    double w3 = _getEdgeFunctionXY(v1, v2, px, py);
+    if (w3 < 0.0 || (w3 == 0.0 && !_isTopLeftEdgeXY(v1, v2))) {
+        return false;
+    }
 
-        zvals = zcollisions->getPointer(g.i, g.j, 0);
-        zvals->reserve(tris->size());
-        vmath::vec3 gp = Grid3d::GridIndexToCellCenter(g.i, g.j, -1, dx) + jitter;
-        _getTriangleCollisionsZ(gp, *tris, *m, *zvals);
+    double wsum = w1 + w2 + w3;
+    if (wsum <= 0.0) {
+        return false;
     }
+
+    *z = (w1 * v1.z + w2 * v2.z + w3 * v3.z) / wsum;
+    return true;
 }
 
 void getCellsInsideTriangleMesh(
@@ -163,10 +199,11 @@ void getCellsInsideTriangleMesh(
         std::vector<GridIndex> &cells,
         bool computeSingleThreaded) {
 
-    Array3d<std::vector<float> > zcollisions(isize, jsize, 1);
-    _getCollisionGridZ(m, dx, zcollisions, computeSingleThreaded);
+    std::vector<int> columnStarts;
+    std::vector<int> columnTriangles;
+    _getTriangleColumnBins(m, dx, isize, jsize, columnStarts, columnTriangles, computeSingleThreaded);
 
-    size_t gridsize = isize * jsize * ksize;
+    size_t gridsize = isize * jsize;
     size_t numCPU = ThreadUtils::getMaxThreadCount();
     if (computeSingleThreaded) {
         numCPU = 1;
@@ -178,8 +215,8 @@ void getCellsInsideTriangleMesh(
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&_getCellsInsideTriangleMeshThread,
                                  intervals[i], intervals[i + 1], 
-                                 isize, jsize, ksize, dx,
-                                 &zcollisions,
+                                 isize, jsize, ksize, dx, &m,
+                                 &columnStarts, &columnTriangles,
                                  &(threadResults[i]));
     }
 
@@ -189,7 +226,7 @@ void getCellsInsideTriangleMesh(
         numcells += threadResults[i].size();
     }
 
-    cells.reserve(numcells);
+    cells.reserve(cells.size() + numcells);
     for (size_t i = 0; i < threadResults.size(); i++) {
         cells.insert(cells.end(), threadResults[i].begin(), threadResults[i].end());
     }
@@ -198,27 +235,52 @@ void getCellsInsideTriangleMesh(
 void _getCellsInsideTriangleMeshThread(
         int startidx, int endidx, 
         int isize, int jsize, int ksize, double dx,
-        Array3d<std::vector<float> > *zcollisions,
+        TriangleMesh *m,
+        std::vector<int> *columnStarts,
+        std::vector<int> *columnTriangles,
         std::vector<GridIndex> *cells) {
 
-    std::vector<float> *zvals;
+    std::vector<double> zvals;
     for (int idx = startidx; idx < endidx; idx++) {
+        int start = columnStarts->at(idx);
+        int end = columnStarts->at(idx + 1);
+        if (start == end) {
+            continue;
+        }
+
         GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
-        zvals = zcollisions->getPointer(g.i, g.j, 0);
-        if (zvals->size() % 2 != 0) {
+        double px = (g.i + 0.5) * dx;
+        double py = (g.j + 0.5) * dx;
+
+        zvals.clear();
+        for (int tidx = start; tidx < end; tidx++) {
+            Triangle t = m->triangles[columnTriangles->at(tidx)];
+            double z;
+            if (_getTriangleCrossingZ(m->vertices[t.tri[0]], 
+                                      m->vertices[t.tri[1]], 
+                                      m->vertices[t.tri[2]], px, py, &z)) {
+                zvals.push_back(z);
+            }
+        }
+
+        if (zvals.empty() || zvals.size() % 2 != 0) {
             continue;
         }
 
-        float z = Grid3d::GridIndexToCellCenter(g, dx).z;
-        int numless = 0;
-        for (size_t zidx = 0; zidx < zvals->size(); zidx++) {
-            if (zvals->at(zidx) < z) {
+        std::sort(zvals.begin(), zvals.end());
+
+        int kmin = std::max((int)floor(zvals.front() / dx - 0.5), 0);
+        int kmax = std::min((int)ceil(zvals.back() / dx - 0.5), ksize - 1);
+        size_t numless = 0;
+        for (int k = kmin; k <= kmax; k++) {
+            double z = (k + 0.5) * dx;
+            while (numless < zvals.size() && zvals[numless] < z) {
                 numless++;
             }
-        }
 
-        if (numless % 2 == 1) {
-            cells->push_back(g);
+            if (numless % 2 == 1) {
+                cells->push_back(GridIndex(g.i, g.j, k));
+            }
         }
     }
 }
@@ -40,25 +40,25 @@ namespace MeshUtils {
 
     void structToTriangleMesh(TriangleMesh_t &mesh_data, TriangleMesh &mesh);
 
-    void _getTriangleGridZ(
-        TriangleMesh &m, double dx, Array3d<std::vector<int> > &ztrigrid);
+    void _getTriangleColumnBoundsThread(
+        int startidx, int endidx, 
+        TriangleMesh *m, double dx, int isize, int jsize,
+        std::vector<GridIndex> *columnMin, 
+        std::vector<GridIndex> *columnMax);
 
-    void _getTriangleCollisionsZ(
-        vmath::vec3 origin, std::vector<int> &indices, TriangleMesh &m,
-        std::vector<double> &collisions);
+    void _getTriangleColumnBins(
+        TriangleMesh &m, double dx, int isize, int jsize,
+        std::vector<int> &columnStarts, 
+        std::vector<int> &columnTriangles,
+        bool computeSingleThreaded);
 
-    double _randomDouble(double min, double max);
+    double _getEdgeFunctionXY(vmath::vec3 a, vmath::vec3 b, double px, double py);
 
-    void _getCollisionGridZ(
-        TriangleMesh &m, double dx, Array3d<std::vector<float> > &zcollisions);
+    bool _isTopLeftEdgeXY(vmath::vec3 a, vmath::vec3 b);
 
-    void _getCollisionGridZThread(
-        int startidx, int endidx, 
-        double dx, 
-        vmath::vec3 jitter,
-        TriangleMesh *m, 
-        Array3d<std::vector<int> > *ztrigrid,
-        Array3d<std::vector<float> > *zcollisions);
+    bool _getTriangleCrossingZ(
+        vmath::vec3 v1, vmath::vec3 v2, vmath::vec3 v3, 
+        double px, double py, double *z);
 
     void getCellsInsideTriangleMesh(
         TriangleMesh &m, int isize, int jsize, int ksize, double dx,
@@ -69,7 +69,9 @@ namespace MeshUtils {
     void _getCellsInsideTriangleMeshThread(
         int startidx, int endidx, 
         int isize, int jsize, int ksize, double dx,
-        Array3d<std::vector<float> > *zcollisions,
+        TriangleMesh *m,
+        std::vector<int> *columnStarts,
+        std::vector<int> *columnTriangles,
         std::vector<GridIndex> *cells);
 
     bool isCellInside(double z, std::vector<double> *zvals);
@@ -168,28 +168,28 @@ void ParticleLevelSet::calculateSignedDistanceField(ParticleSystem &particles,
 }
 
 void ParticleLevelSet::postProcessSignedDistanceField(MeshLevelSet &solidPhi) {
-    // Extrapolate SDF into solids and enforce that distance values at nodes are not too small
+    // Extrapolate SDF into solids and enforce that distance values at nodes are not too small.
+    // Cells outside of the active blocks hold the background distance and are unaffected.
 
     int si, sj, sk;
     solidPhi.getGridDimensions(&si, &sj, &sk);
     FLUIDSIM_ASSERT(si == _isize && sj == _jsize && sk == _ksize);
 
-    float eps = 0.005 * _dx;
-    for(int k = 0; k < _ksize; k++) {
-        for(int j = 0; j < _jsize; j++) {
-            for(int i = 0; i < _isize; i++) {
-                if(_phi(i, j, k) < 0.5 * _dx) {
-                    if (solidPhi.getDistanceAtCellCenter(i, j, k) < 0) {
-                        _phi.set(i, j, k, -0.5f * _dx);
-                    }
-                }
+    if (_activeBlocks.empty()) {
+        return;
+    }
 
-                float val = _phi(i, j, k);
-                if (std::abs(val) < eps) {
-                    _phi.set(i, j, k, val > 0 ? eps : -eps);
-                }
-            }
-        }
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _activeBlocks.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _activeBlocks.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ParticleLevelSet::_postProcessSignedDistanceFieldThread, this,
+                                 intervals[i], intervals[i + 1], &solidPhi);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
     }
 }
 
@@ -258,9 +258,8 @@ void ParticleLevelSet::calculateCurvatureGrid(Array3d<float> &surfacePhi,
         }
     }
 
-    float width = _curvatureGridExactBand * _dx;
     LevelSetSolver solver;
-    solver.reinitializeUpwind(_phi, _dx, width, solverGridCells, surfacePhi);
+    solver.reinitializeFastSweeping(_phi, _dx, solverGridCells, surfacePhi);
 
     float outOfRangeDist = _outOfRangeDistance * _dx;
     for (int k = 0; k < _ksize; k++) {
@@ -298,6 +297,21 @@ void ParticleLevelSet::getGridDimensions(int *i, int *j, int *k) {
     _phi.getGridDimensions(i, j, k);
 }
 
+void ParticleLevelSet::getActiveBlocks(std::vector<GridIndex> &blocks) {
+    blocks = _activeBlocks;
+}
+
+int ParticleLevelSet::getBlockWidth() {
+    return _blockwidth;
+}
+
+void ParticleLevelSet::getBlockBounds(GridIndex block, GridIndex &gmin, GridIndex &gmax) {
+    gmin = GridIndex(block.i * _blockwidth, block.j * _blockwidth, block.k * _blockwidth);
+    gmax = GridIndex(std::min(gmin.i + _blockwidth, _isize), 
+                     std::min(gmin.j + _blockwidth, _jsize), 
+                     std::min(gmin.k + _blockwidth, _ksize));
+}
+
 void ParticleLevelSet::getCoarseGridDimensions(int *i, int *j, int *k) {
     _phi.getCoarseGridDimensions(i, j, k);
 }
@@ -313,6 +327,30 @@ void ParticleLevelSet::generateCoarseGrid(ParticleLevelSet &coarseGrid) {
     FLUIDSIM_ASSERT(_phi.isMatchingDimensionsForCoarseGrid(*coarsePhi));
 
     _phi.generateCoarseGrid(*coarsePhi);
+
+    // A coarse block covers two fine blocks along each axis
+    int bisize = (coarseGrid._isize + _blockwidth - 1) / _blockwidth;
+    int bjsize = (coarseGrid._jsize + _blockwidth - 1) / _blockwidth;
+    int bksize = (coarseGrid._ksize + _blockwidth - 1) / _blockwidth;
+    Array3d<bool> coarseBlocks(bisize, bjsize, bksize, false);
+    for (size_t bidx = 0; bidx < _activeBlocks.size(); bidx++) {
+        GridIndex b = _activeBlocks[bidx];
+        GridIndex cb(b.i / 2, b.j / 2, b.k / 2);
+        if (coarseBlocks.isIndexInRange(cb)) {
+            coarseBlocks.set(cb, true);
+        }
+    }
+
+    coarseGrid._activeBlocks.clear();
+    for (int k = 0; k < bksize; k++) {
+        for (int j = 0; j < bjsize; j++) {
+            for (int i = 0; i < bisize; i++) {
+                if (coarseBlocks(i, j, k)) {
+                    coarseGrid._activeBlocks.push_back(GridIndex(i, j, k));
+                }
+            }
+        }
+    }
 }
 
 ParticleLevelSet ParticleLevelSet::generateCoarseGrid() {
@@ -334,7 +372,7 @@ float ParticleLevelSet::_getMaxDistance() {
 
 void ParticleLevelSet::_computeSignedDistanceFromParticles(std::vector<vmath::vec3> &particles, 
                                                            double radius) {
-    _phi.fill(_getMaxDistance());
+    _resetActiveBlocks();
 
     if (particles.empty()) {
         return;
@@ -352,9 +390,7 @@ void ParticleLevelSet::_computeSignedDistanceFromParticles(std::vector<vmath::ve
 
     std::vector<GridBlock<float> > gridBlocks;
     blockphi.getActiveGridBlocks(gridBlocks);
-    BoundedBuffer<ComputeBlock> computeBlockQueue(gridBlocks.size());
-    BoundedBuffer<ComputeBlock> finishedComputeBlockQueue(gridBlocks.size());
-    int numComputeBlocks = 0;
+    std::vector<ComputeBlock> computeBlocks;
     for (size_t bidx = 0; bidx < gridBlocks.size(); bidx++) {
         GridBlock<float> b = gridBlocks[bidx];
         if (gridCountData.totalGridCount[b.id] == 0) {
@@ -362,51 +398,66 @@ void ParticleLevelSet::_computeSignedDistanceFromParticles(std::vector<vmath::ve
         }
 
         ComputeBlock computeBlock;
-        computeBlock.gridBlock = b;
+        computeBlock.blockIndex = b.index;
         computeBlock.particleData = &(sortedParticleData[blockToParticleDataIndex[b.id]]);
         computeBlock.numParticles = gridCountData.totalGridCount[b.id];
         computeBlock.radius = radius;
-        computeBlockQueue.push(computeBlock);
-        numComputeBlocks++;
+        computeBlocks.push_back(computeBlock);
+        _activeBlocks.push_back(b.index);
+    }
+
+    if (computeBlocks.empty()) {
+        return;
     }
 
+    // Blocks do not overlap so each thread writes its blocks directly into the grid
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, computeBlockQueue.size());
-    std::vector<std::thread> producerThreads(numthreads);
+    int numthreads = (int)fmin(numCPU, computeBlocks.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, computeBlocks.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
-        producerThreads[i] = std::thread(&ParticleLevelSet::_computeExactBandProducerThread, this,
-                                         &computeBlockQueue, &finishedComputeBlockQueue);
-    }
-
-    int numComputeBlocksProcessed = 0;
-    while (numComputeBlocksProcessed < numComputeBlocks) {
-        std::vector<ComputeBlock> finishedBlocks;
-        finishedComputeBlockQueue.popAll(finishedBlocks);
-        for (size_t i = 0; i < finishedBlocks.size(); i++) {
-            ComputeBlock block = finishedBlocks[i];
-            GridIndex gridOffset(block.gridBlock.index.i * _blockwidth,
-                                 block.gridBlock.index.j * _blockwidth,
-                                 block.gridBlock.index.k * _blockwidth);
-
-            int datasize = _blockwidth * _blockwidth * _blockwidth;
-            for (int vidx = 0; vidx < datasize; vidx++) {
-                GridIndex localidx = Grid3d::getUnflattenedIndex(vidx, _blockwidth, _blockwidth);
-                GridIndex phiidx = GridIndex(localidx.i + gridOffset.i,
-                                             localidx.j + gridOffset.j,
-                                             localidx.k + gridOffset.k);
-                if (_phi.isIndexInRange(phiidx)) {
-                    _phi.set(phiidx, block.gridBlock.data[vidx]);
-                }
-            }
-        }
+        threads[i] = std::thread(&ParticleLevelSet::_computeExactBandThread, this,
+                                 intervals[i], intervals[i + 1], &computeBlocks);
+    }
 
-        numComputeBlocksProcessed += finishedBlocks.size();
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void ParticleLevelSet::_resetActiveBlocks() {
+    if (_activeBlocks.empty()) {
+        return;
+    }
+
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _activeBlocks.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _activeBlocks.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ParticleLevelSet::_resetActiveBlocksThread, this,
+                                 intervals[i], intervals[i + 1]);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
     }
 
-    computeBlockQueue.notifyFinished();
-    for (size_t i = 0; i < producerThreads.size(); i++) {
-        computeBlockQueue.notifyFinished();
-        producerThreads[i].join();
+    _activeBlocks.clear();
+}
+
+void ParticleLevelSet::_resetActiveBlocksThread(int startidx, int endidx) {
+    float maxDistance = _getMaxDistance();
+    GridIndex gmin, gmax;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        getBlockBounds(_activeBlocks[bidx], gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    _phi.set(i, j, k, maxDistance);
+                }
+            }
+        }
     }
 }
 
@@ -615,52 +666,69 @@ void ParticleLevelSet::_sortParticlesIntoBlocks(std::vector<vmath::vec3> &partic
 
 }
 
-void ParticleLevelSet::_computeExactBandProducerThread(BoundedBuffer<ComputeBlock> *computeBlockQueue,
-                                                       BoundedBuffer<ComputeBlock> *finishedComputeBlockQueue) {
-    while (computeBlockQueue->size() > 0) {
-        std::vector<ComputeBlock> computeBlocks;
-        int numBlocks = computeBlockQueue->pop(_numComputeBlocksPerJob, computeBlocks);
-        if (numBlocks == 0) {
-            continue;
+void ParticleLevelSet::_computeExactBandThread(int startidx, int endidx, 
+                                               std::vector<ComputeBlock> *computeBlocks) {
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        ComputeBlock block = computeBlocks->at(bidx);
+        float r = block.radius;
+        float sr = _searchRadiusFactor * r;
+
+        GridIndex blockmin, blockmax;
+        getBlockBounds(block.blockIndex, blockmin, blockmax);
+        vmath::vec3 blockPositionOffset = Grid3d::GridIndexToPosition(blockmin, _dx);
+
+        for (int pidx = 0; pidx < block.numParticles; pidx++) {
+            vmath::vec3 p = block.particleData[pidx];
+            p -= blockPositionOffset;
+
+            vmath::vec3 pmin(p.x - sr, p.y - sr, p.z - sr);
+            vmath::vec3 pmax(p.x + sr, p.y + sr, p.z + sr);
+            GridIndex gmin = Grid3d::positionToGridIndex(pmin, _dx);
+            GridIndex gmax = Grid3d::positionToGridIndex(pmax, _dx);
+            gmin.i = std::max(gmin.i, 0);
+            gmin.j = std::max(gmin.j, 0);
+            gmin.k = std::max(gmin.k, 0);
+            gmax.i = std::min(gmax.i, blockmax.i - blockmin.i - 1);
+            gmax.j = std::min(gmax.j, blockmax.j - blockmin.j - 1);
+            gmax.k = std::min(gmax.k, blockmax.k - blockmin.k - 1);
+
+            for (int k = gmin.k; k <= gmax.k; k++) {
+                for (int j = gmin.j; j <= gmax.j; j++) {
+                    for (int i = gmin.i; i <= gmax.i; i++) {
+                        vmath::vec3 gpos = Grid3d::GridIndexToCellCenter(i, j, k, _dx);
+                        float dist = vmath::length(gpos - p) - r;
+                        GridIndex g(i + blockmin.i, j + blockmin.j, k + blockmin.k);
+                        if (dist < _phi(g)) {
+                             _phi.set(g, dist);
+                        }
+                    }
+                }
+            }
         }
+    }
+}
 
-        for (size_t bidx = 0; bidx < computeBlocks.size(); bidx++) {
-            ComputeBlock block = computeBlocks[bidx];
-            float r = block.radius;
-            float sr = _searchRadiusFactor * r;
-            GridIndex blockIndex = block.gridBlock.index;
-            vmath::vec3 blockPositionOffset = Grid3d::GridIndexToPosition(blockIndex, _blockwidth * _dx);
-
-            for (int pidx = 0; pidx < block.numParticles; pidx++) {
-                vmath::vec3 p = block.particleData[pidx];
-                p -= blockPositionOffset;
-
-                vmath::vec3 pmin(p.x - sr, p.y - sr, p.z - sr);
-                vmath::vec3 pmax(p.x + sr, p.y + sr, p.z + sr);
-                GridIndex gmin = Grid3d::positionToGridIndex(pmin, _dx);
-                GridIndex gmax = Grid3d::positionToGridIndex(pmax, _dx);
-                gmin.i = std::max(gmin.i, 0);
-                gmin.j = std::max(gmin.j, 0);
-                gmin.k = std::max(gmin.k, 0);
-                gmax.i = std::min(gmax.i, _blockwidth - 1);
-                gmax.j = std::min(gmax.j, _blockwidth - 1);
-                gmax.k = std::min(gmax.k, _blockwidth - 1);
-
-                for (int k = gmin.k; k <= gmax.k; k++) {
-                    for (int j = gmin.j; j <= gmax.j; j++) {
-                        for (int i = gmin.i; i <= gmax.i; i++) {
-                            vmath::vec3 gpos = Grid3d::GridIndexToCellCenter(i, j, k, _dx);
-                            float dist = vmath::length(gpos - p) - r;
-                            int flatidx = Grid3d::getFlatIndex(i, j, k, _blockwidth, _blockwidth);
-                            if (dist < block.gridBlock.data[flatidx]) {
-                                 block.gridBlock.data[flatidx] = dist;
-                            }
+void ParticleLevelSet::_postProcessSignedDistanceFieldThread(int startidx, int endidx, 
+                                                             MeshLevelSet *solidPhi) {
+    float eps = 0.005 * _dx;
+    GridIndex gmin, gmax;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        getBlockBounds(_activeBlocks[bidx], gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    if(_phi(i, j, k) < 0.5 * _dx) {
+                        if (solidPhi->getDistanceAtCellCenter(i, j, k) < 0) {
+                            _phi.set(i, j, k, -0.5f * _dx);
                         }
                     }
+
+                    float val = _phi(i, j, k);
+                    if (std::abs(val) < eps) {
+                        _phi.set(i, j, k, val > 0 ? eps : -eps);
+                    }
                 }
             }
-
-            finishedComputeBlockQueue->push(block);
         }
     }
 }
@@ -34,7 +34,6 @@ SOFTWARE.
 #include "array3d.h"
 #include "vmath.h"
 #include "blockarray3d.h"
-#include "boundedbuffer.h"
 #include "particlesystem.h"
 
 class MeshLevelSet;
@@ -68,6 +67,15 @@ public:
     void postProcessSignedDistanceField(MeshLevelSet &solidPhi);
     void calculateCurvatureGrid(Array3d<float> &surfacePhi, Array3d<float> &kgrid);
 
+    /*
+        Only cells within the active blocks may hold values other than the 
+        far-field background distance. Consumers that only care about the 
+        liquid or its narrow band can restrict themselves to these blocks.
+    */
+    void getActiveBlocks(std::vector<GridIndex> &blocks);
+    int getBlockWidth();
+    void getBlockBounds(GridIndex block, GridIndex &gmin, GridIndex &gmax);
+
     Array3d<float>* getPhiGrid();
     void getGridDimensions(int *i, int *j, int *k);
     void getCoarseGridDimensions(int *i, int *j, int *k);
@@ -94,7 +102,7 @@ private:
     };
 
     struct ComputeBlock {
-        GridBlock<float> gridBlock;
+        GridIndex blockIndex;
         vmath::vec3 *particleData;
         int numParticles = 0;
         float radius = 0.0f;
@@ -125,8 +133,12 @@ private:
                                   ParticleGridCountData &countdata, 
                                   std::vector<vmath::vec3> &sortedParticleData, 
                                   std::vector<int> &blockToParticleDataIndex);
-    void _computeExactBandProducerThread(BoundedBuffer<ComputeBlock> *computeBlockQueue,
-                                         BoundedBuffer<ComputeBlock> *finishedComputeBlockQueue);
+    void _resetActiveBlocks();
+    void _resetActiveBlocksThread(int startidx, int endidx);
+    void _computeExactBandThread(int startidx, int endidx, 
+                                 std::vector<ComputeBlock> *computeBlocks);
+    void _postProcessSignedDistanceFieldThread(int startidx, int endidx, 
+                                               MeshLevelSet *solidPhi);
 
     void _initializeCurvatureGridScalarField(ScalarField &field);
     void _initializeCurvatureGridScalarFieldThread(int startidx, int endidx, 
@@ -139,12 +151,12 @@ private:
     int _ksize = 0;
     double _dx = 0.0;
     Array3d<float> _phi;
+    std::vector<GridIndex> _activeBlocks;
 
     int _curvatureGridExactBand = 3;
     int _curvatureGridExtrapolationLayers = 3;
     float _outOfRangeDistance = 5.0f;  // in # of grid cells
 
     int _blockwidth = 10;
-    int _numComputeBlocksPerJob = 10;
     float _searchRadiusFactor = 2.0f;
 };
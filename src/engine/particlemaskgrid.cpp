@@ -24,16 +24,32 @@ SOFTWARE.
 
 #include "particlemaskgrid.h"
 
+#include <algorithm>
+
 #include "grid3d.h"
+#include "threadutils.h"
 
 ParticleMaskGrid::ParticleMaskGrid() {
 }
 
 ParticleMaskGrid::ParticleMaskGrid(int i, int j, int k, double dx) :
         _isize(i), _jsize(j), _ksize(k), _dx(dx), _subdx(0.5 * dx),
+        _gmin(0, 0, 0), _gmax(i - 1, j - 1, k - 1),
         _maskGrid(i, j, k, 0x00) {
 }
 
+ParticleMaskGrid::ParticleMaskGrid(int i, int j, int k, double dx, 
+                                   GridIndex gmin, GridIndex gmax) :
+        _isize(i), _jsize(j), _ksize(k), _dx(dx), _subdx(0.5 * dx) {
+    _gmin = GridIndex(std::max(gmin.i, 0), std::max(gmin.j, 0), std::max(gmin.k, 0));
+    _gmax = GridIndex(std::min(gmax.i, i - 1), std::min(gmax.j, j - 1), std::min(gmax.k, k - 1));
+
+    int isub = std::max(_gmax.i - _gmin.i + 1, 1);
+    int jsub = std::max(_gmax.j - _gmin.j + 1, 1);
+    int ksub = std::max(_gmax.k - _gmin.k + 1, 1);
+    _maskGrid = Array3d<unsigned char>(isub, jsub, ksub, 0x00);
+}
+
 ParticleMaskGrid::~ParticleMaskGrid() {
 }
 
@@ -44,17 +60,24 @@ void ParticleMaskGrid::clear() {
 
 unsigned char ParticleMaskGrid::operator()(int i, int j, int k) {
     FLUIDSIM_ASSERT(Grid3d::isGridIndexInRange(i, j, k, _isize, _jsize, _ksize));
-    return _maskGrid(i, j, k);
+    if (!_isCellInBounds(i, j, k)) {
+        return 0x00;
+    }
+    return _maskGrid(i - _gmin.i, j - _gmin.j, k - _gmin.k);
 }
 
 unsigned char ParticleMaskGrid::operator()(GridIndex g) {
-    FLUIDSIM_ASSERT(Grid3d::isGridIndexInRange(g, _isize, _jsize, _ksize));
-    return _maskGrid(g);
+    return (*this)(g.i, g.j, g.k);
 }
 
 void ParticleMaskGrid::addParticle(vmath::vec3 p) {
     FLUIDSIM_ASSERT(Grid3d::isPositionInGrid(p, _dx, _isize, _jsize, _ksize));
 
+    GridIndex g = Grid3d::positionToGridIndex(p, _dx);
+    if (!_isCellInBounds(g.i, g.j, g.k)) {
+        return;
+    }
+
     unsigned char maskcase = 0x00;
     GridIndex subg = Grid3d::positionToGridIndex(p, _subdx);
     if (subg.i % 2 == 1) {
@@ -68,13 +91,65 @@ void ParticleMaskGrid::addParticle(vmath::vec3 p) {
     }
     unsigned char maskval = 1 << maskcase;
 
-    GridIndex g = Grid3d::positionToGridIndex(p, _dx);
+    g = GridIndex(g.i - _gmin.i, g.j - _gmin.j, g.k - _gmin.k);
     _maskGrid.set(g, _maskGrid(g) | maskval);
 }
 
 void ParticleMaskGrid::addParticles(std::vector<vmath::vec3> &particles) {
-    for (size_t i = 0; i < particles.size(); i++) {
-        addParticle(particles[i]);
+    addParticles(particles, 0, particles.size());
+}
+
+void ParticleMaskGrid::addParticles(std::vector<vmath::vec3> &particles, 
+                                    size_t startidx, size_t endidx) {
+    if (endidx <= startidx) {
+        return;
+    }
+
+    // Mask keys are computed in parallel and merged serially so that
+    // no two threads write to the same mask byte
+    size_t numParticles = endidx - startidx;
+    std::vector<int64_t> keys(numParticles, -1);
+
+    int particlesPerThread = 100000;
+    int workerThreads = (int)(numParticles / particlesPerThread) + 1;
+    int numthreads = std::min(ThreadUtils::getMaxThreadCount(), workerThreads);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(startidx, endidx, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ParticleMaskGrid::_computeParticleMaskKeysThread, this,
+                                 intervals[i], intervals[i + 1], startidx, &particles, &keys);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    unsigned char *mask = _maskGrid.getRawArray();
+    for (size_t i = 0; i < keys.size(); i++) {
+        int64_t key = keys[i];
+        if (key == -1) {
+            continue;
+        }
+        mask[key >> 3] |= (unsigned char)(1 << (key & 7));
+    }
+}
+
+void ParticleMaskGrid::_computeParticleMaskKeysThread(int startidx, int endidx, size_t keyOffset,
+                                                      std::vector<vmath::vec3> *particles,
+                                                      std::vector<int64_t> *keys) {
+    int isub = _maskGrid.width;
+    int jsub = _maskGrid.height;
+    for (int idx = startidx; idx < endidx; idx++) {
+        vmath::vec3 p = particles->at(idx);
+        GridIndex g = Grid3d::positionToGridIndex(p, _dx);
+        if (!_isCellInBounds(g.i, g.j, g.k)) {
+            continue;
+        }
+
+        GridIndex subg = Grid3d::positionToGridIndex(p, _subdx);
+        int maskcase = (subg.i & 1) | ((subg.j & 1) << 1) | ((subg.k & 1) << 2);
+        int flatidx = Grid3d::getFlatIndex(g.i - _gmin.i, g.j - _gmin.j, g.k - _gmin.k, isub, jsub);
+        (*keys)[idx - keyOffset] = ((int64_t)flatidx << 3) | maskcase;
     }
 }
 
@@ -96,8 +171,11 @@ bool ParticleMaskGrid::isSubCellSet(int i, int j, int k) {
     int gi = (int)(i / 2);
     int gj = (int)(j / 2);
     int gk = (int)(k / 2);
+    if (!_isCellInBounds(gi, gj, gk)) {
+        return false;
+    }
 
-    return (_maskGrid(gi, gj, gk) & maskval) != 0;
+    return (_maskGrid(gi - _gmin.i, gj - _gmin.j, gk - _gmin.k) & maskval) != 0;
 }
 
 bool ParticleMaskGrid::isSubCellSet(GridIndex g) {
@@ -109,4 +187,8 @@ bool ParticleMaskGrid::isSubCellSet(vmath::vec3 p) {
 
     GridIndex g = Grid3d::positionToGridIndex(p, _subdx);
     return isSubCellSet(g.i, g.j, g.k);
+}
+
+bool ParticleMaskGrid::isCellFull(GridIndex g) {
+    return (*this)(g) == 0xFF;
 }
\ No newline at end of file
@@ -24,6 +24,9 @@ SOFTWARE.
 
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
 #include "array3d.h"
 #include "vmath.h"
 
@@ -32,6 +35,11 @@ class ParticleMaskGrid
 public:
     ParticleMaskGrid();
     ParticleMaskGrid(int i, int j, int k, double dx);
+
+    // Mask restricted to the cells within [gmin, gmax]. Particles outside 
+    // of the bounds are ignored and sub cells outside of the bounds are 
+    // reported as unset.
+    ParticleMaskGrid(int i, int j, int k, double dx, GridIndex gmin, GridIndex gmax);
     ~ParticleMaskGrid();
 
     void clear();
@@ -39,17 +47,30 @@ public:
     unsigned char operator()(GridIndex g);
     void addParticle(vmath::vec3 p);
     void addParticles(std::vector<vmath::vec3> &particles);
+    void addParticles(std::vector<vmath::vec3> &particles, size_t startidx, size_t endidx);
     bool isSubCellSet(int i, int j, int k);
     bool isSubCellSet(GridIndex g);
     bool isSubCellSet(vmath::vec3 p);
+    bool isCellFull(GridIndex g);
 
 private:
 
+    inline bool _isCellInBounds(int i, int j, int k) {
+        return i >= _gmin.i && j >= _gmin.j && k >= _gmin.k &&
+               i <= _gmax.i && j <= _gmax.j && k <= _gmax.k;
+    }
+
+    void _computeParticleMaskKeysThread(int startidx, int endidx, size_t keyOffset,
+                                        std::vector<vmath::vec3> *particles,
+                                        std::vector<int64_t> *keys);
+
     int _isize = 0;
     int _jsize = 0;
     int _ksize = 0;
     double _dx = 0.0;
     double _subdx = 0.0;
+    GridIndex _gmin;
+    GridIndex _gmax;
 
     Array3d<unsigned char> _maskGrid;
 
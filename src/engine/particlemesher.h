@@ -33,7 +33,7 @@ SOFTWARE.
 #include "boundedbuffer.h"
 
 class TriangleMesh;
-class MeshLevelSet;
+class MeshingBoundarySDF;
 
 struct ParticleMesherParameters {
     int isize = 0;
@@ -49,7 +49,7 @@ struct ParticleMesherParameters {
     double previewdx = 0.0;
     
     std::vector<vmath::vec3> *particles;
-    MeshLevelSet *solidSDF;
+    MeshingBoundarySDF *solidSDF;
 };
 
 class ParticleMesher {
@@ -183,7 +183,7 @@ private:
     ScalarField _pfield;
 
     std::vector<vmath::vec3> *_particles;
-    MeshLevelSet *_solidSDF;
+    MeshingBoundarySDF *_solidSDF;
 
     // Internal Parameters
     int _blockwidth = 10;
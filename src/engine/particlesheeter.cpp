@@ -21,11 +21,11 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
-
 #include "particlesheeter.h"
-#include "array3d.h"
-#include "particlemaskgrid.h"
-#include "grid3d.h"
+
+#include <algorithm>
+#include <limits>
+
 #include "gridutils.h"
 #include "interpolation.h"
 #include "threadutils.h"
@@ -40,37 +40,27 @@ ParticleSheeter::~ParticleSheeter() {
 void ParticleSheeter::generateSheetParticles(ParticleSheeterParameters params,
                                              std::vector<vmath::vec3> &generatedParticles) {
     _initializeParameters(params);
-    
-    Array3d<unsigned char> countGrid(_isize, _jsize, _ksize, (char)0);
-    _getMarkerParticleCellCounts(countGrid);
-
-    std::vector<vmath::vec3> sheetParticles;
-    _identifySheetParticlesPhase1(countGrid, sheetParticles);
-
-    Array3d<bool> sheetCells(_isize, _jsize, _ksize, false);
-    _getSheetCells(sheetParticles, sheetCells);
-
-    sheetParticles.clear();
-    countGrid.fill(0);
-    _identifySheetParticlesPhase2(sheetCells, countGrid, sheetParticles);
+    if (_particles->size() == 0) {
+        return;
+    }
 
-    if (sheetParticles.empty()) {
+    _initializeActiveTiles();
+    if (_activeTiles.empty()) {
         return;
     }
 
-    ParticleMaskGrid maskgrid(_isize, _jsize, _ksize, _dx);
-    _initializeMaskGrid(maskgrid);
+    _sortParticlesIntoTileCells();
 
-    std::vector<vmath::vec3> sheetSeedCandidates;
-    _getSheetSeedCandidates(sheetCells, sheetSeedCandidates);
+    _identifySheetCells();
+    _featherSheetCells(false);
+    _featherSheetCells(true);
 
-    SortedParticleData sheetParticleData;
-    _sortSheetParticlesIntoGrid(sheetParticles, sheetParticleData);
+    int numSheetParticles = _identifySheetParticles();
+    if (numSheetParticles == 0) {
+        return;
+    }
 
-    SortedParticleData sheetCandidateParticleData;
-    _sortSheetSeedCandidateParticlesIntoGrid(sheetSeedCandidates, sheetCandidateParticleData);
-    
-    _selectSeedParticles(sheetCandidateParticleData, sheetParticleData, maskgrid, generatedParticles);
+    _selectSeedParticles(generatedParticles);
 }
 
 void ParticleSheeter::_initializeParameters(ParticleSheeterParameters params) {
@@ -82,554 +72,639 @@ void ParticleSheeter::_initializeParameters(ParticleSheeterParameters params) {
    _ksize = params.ksize;
    _dx = params.dx;
    _sheetFillThreshold = params.sheetFillThreshold;
-}
-
-void ParticleSheeter::_getMarkerParticleCellCounts(Array3d<unsigned char> &countGrid) {
-    std::vector<vmath::vec3> *positions;
-    _particles->getAttributeValues("POSITION", positions);
 
-    for (size_t i = 0; i < positions->size(); i++) {
-        vmath::vec3 p = positions->at(i);
-        GridIndex g = Grid3d::positionToGridIndex(p, _dx);
-        if ((int)(countGrid(g)) == 255) {
-            continue;
-        }
-        countGrid.add(g, (char)1);
-    }
+   _particles->getAttributeValues("POSITION", _positions);
+   _tileWidth = 1 << _tileWidthBits;
+   _tileSize = _tileWidth * _tileWidth * _tileWidth;
 }
 
-void ParticleSheeter::_identifySheetParticlesPhase1(Array3d<unsigned char> &countGrid, 
-                                                    std::vector<vmath::vec3> &sheetParticles) {
+void ParticleSheeter::_initializeActiveTiles() {
+    int tisize = (_isize + _tileWidth - 1) / _tileWidth;
+    int tjsize = (_jsize + _tileWidth - 1) / _tileWidth;
+    int tksize = (_ksize + _tileWidth - 1) / _tileWidth;
+    Array3d<bool> tiles(tisize, tjsize, tksize, false);
+
+    int numTiles = tiles.width * tiles.height * tiles.depth;
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, _particles->size());
-    std::vector<std::vector<vmath::vec3> > threadResults(numthreads);
+    int numthreads = (int)fmin(numCPU, numTiles);
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _particles->size(), numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numTiles, numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ParticleSheeter::_identifySheetParticlesPhase1Thread, this,
-                                 intervals[i], intervals[i + 1], &countGrid, &(threadResults[i]));
+        threads[i] = std::thread(&ParticleSheeter::_getNearSurfaceTilesThread, this,
+                                 intervals[i], intervals[i + 1], &tiles);
     }
 
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
-        sheetParticles.insert(sheetParticles.end(), threadResults[i].begin(), threadResults[i].end());
     }
-}
-
-void ParticleSheeter::_identifySheetParticlesPhase1Thread(int startidx, int endidx, 
-                                                    Array3d<unsigned char> *countGrid, 
-                                                    std::vector<vmath::vec3> *result) {
-    float maxdepth = _maxSheetDepth * _dx;
-    float depthTestDistance = _depthTestDistance * _dx;
-    float depthTestStepDistance = _depthTestStepDistance * _dx;
-    float eps = 1e-5;
-    vmath::vec3 hdx(0.5*_dx, 0.5*_dx, 0.5*_dx);
-
-    std::vector<vmath::vec3> *positions;
-    _particles->getAttributeValues("POSITION", positions);
-
-    for (int i = startidx; i < endidx; i++) {
-        vmath::vec3 p = positions->at(i);
-        GridIndex g = Grid3d::positionToGridIndex(p, _dx);
-        if ((int)(countGrid->get(g)) >= _maxParticlesPerCell) {
-            // too dense to be a sheet that needs reseeding
-            continue;
-        }
-
-        float phi = Interpolation::trilinearInterpolate(p - hdx, _dx, *_fluidSurfaceLevelSet);
-        if (phi >= maxdepth || phi < -maxdepth) {
-            // not near surface
-            continue;
-        }
 
-        vmath::vec3 dir;
-        Interpolation::trilinearInterpolateGradient(p - hdx, _dx, *_fluidSurfaceLevelSet, &dir);
-        dir = -dir;
-        if (vmath::length(dir) < eps) {
-            // invalid gradient vector
-            continue;
-        }
-
-        // If you travel inwards from the surface normal, does the depth increase?
-        // If so, then the point is not part of a thin sheet
-        dir = vmath::normalize(dir);
-        int numSteps = (int)std::ceil(depthTestDistance / depthTestStepDistance);
-        float currentPhi = phi;
-        bool depthTestSuccess = false;
-        for (int stepidx = 0; stepidx < numSteps; stepidx++) {
-            vmath::vec3 nextp = p + stepidx * depthTestStepDistance * dir;
-            float nextPhi = Interpolation::trilinearInterpolate(nextp - hdx, _dx, *_fluidSurfaceLevelSet);
-            if (nextPhi > currentPhi || nextPhi >= 0.0f) {
-                depthTestSuccess = true;
-                break;
+    // A particle near the surface may sample its level set value from a 
+    // neighbouring tile, and feathered sheet cells and seed neighbourhoods 
+    // reach at most a few cells past the tile that contains a sheet particle
+    GridUtils::featherGrid26(&tiles, ThreadUtils::getMaxThreadCount());
+
+    _tileIDs = Array3d<int>(tisize, tjsize, tksize, -1);
+    _activeTiles.clear();
+    for (int k = 0; k < tksize; k++) {
+        for (int j = 0; j < tjsize; j++) {
+            for (int i = 0; i < tisize; i++) {
+                if (tiles(i, j, k)) {
+                    _tileIDs.set(i, j, k, (int)_activeTiles.size());
+                    _activeTiles.push_back(GridIndex(i, j, k));
+                }
             }
-            currentPhi = nextPhi;
         }
+    }
+}
 
-        if (!depthTestSuccess) {
-            continue;
+void ParticleSheeter::_getNearSurfaceTilesThread(int startidx, int endidx, Array3d<bool> *tiles) {
+    float maxdepth = _maxSheetDepth * _dx;
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        GridIndex t = Grid3d::getUnflattenedIndex(tidx, tiles->width, tiles->height);
+        GridIndex gmin(t.i * _tileWidth, t.j * _tileWidth, t.k * _tileWidth);
+        GridIndex gmax(std::min(gmin.i + _tileWidth, _isize), 
+                       std::min(gmin.j + _tileWidth, _jsize), 
+                       std::min(gmin.k + _tileWidth, _ksize));
+
+        bool isNearSurface = false;
+        for (int k = gmin.k; k < gmax.k && !isNearSurface; k++) {
+            for (int j = gmin.j; j < gmax.j && !isNearSurface; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    float phi = _fluidSurfaceLevelSet->get(i, j, k);
+                    if (phi < maxdepth && phi >= -maxdepth) {
+                        isNearSurface = true;
+                        break;
+                    }
+                }
+            }
         }
 
-        result->push_back(p);
+        tiles->set(t, isNearSurface);
     }
 }
 
-void ParticleSheeter::_getSheetCells(std::vector<vmath::vec3> &sheetParticles, 
-                                     Array3d<bool> &sheetCells) {
-
+void ParticleSheeter::_sortParticlesIntoTileCells() {
+    int numTiles = _activeTiles.size();
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, sheetParticles.size());
+    int numthreads = (int)fmin(numCPU, _positions->size());
+
+    // A thread only counts the range of tiles touched by its particles, 
+    // beginning at threadTileStarts[i]
+    std::vector<int> particleSlots(_positions->size());
+    std::vector<std::vector<int> > threadTileCounts(numthreads);
+    std::vector<int> threadTileStarts(numthreads, 0);
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, sheetParticles.size(), numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _positions->size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ParticleSheeter::_getSheetCellsThread, this,
-                                 intervals[i], intervals[i + 1], &sheetParticles, &sheetCells);
+        threads[i] = std::thread(&ParticleSheeter::_countTileParticlesThread, this,
+                                 intervals[i], intervals[i + 1], &particleSlots,
+                                 &(threadTileCounts[i]), &(threadTileStarts[i]));
     }
 
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
     }
 
-    GridUtils::featherGrid6(&sheetCells, ThreadUtils::getMaxThreadCount());
-    GridUtils::featherGrid6(&sheetCells, ThreadUtils::getMaxThreadCount());
-
-    int buffer = 3;
-    for (int k = 0; k < sheetCells.depth; k++) {
-        for (int j = 0; j < sheetCells.height; j++) {
-            for (int i = 0; i < sheetCells.width; i++) {
-                if (i < buffer || j < buffer || k < buffer || 
-                        i >= sheetCells.width - buffer || 
-                        j >= sheetCells.height - buffer || 
-                        k >= sheetCells.depth - buffer) {
-                    sheetCells.set(i, j, k, false);
-                }
+    // Each thread scatters into its own range of a tile bucket, which keeps
+    // particles within a tile in their original order
+    std::vector<int> tileStarts(numTiles + 1, 0);
+    for (int tidx = 0; tidx < numTiles; tidx++) {
+        int offset = tileStarts[tidx];
+        for (int i = 0; i < numthreads; i++) {
+            int localidx = tidx - threadTileStarts[i];
+            if (localidx < 0 || localidx >= (int)threadTileCounts[i].size()) {
+                continue;
             }
+            int count = threadTileCounts[i][localidx];
+            threadTileCounts[i][localidx] = offset;
+            offset += count;
         }
+        tileStarts[tidx + 1] = offset;
     }
-}
 
-void ParticleSheeter::_getSheetCellsThread(int startidx, int endidx,
-                                           std::vector<vmath::vec3> *sheetParticles, 
-                                           Array3d<bool> *sheetCells) {
-    for (int i = startidx; i < endidx; i++) {
-        GridIndex g = Grid3d::positionToGridIndex(sheetParticles->at(i), _dx);
-        sheetCells->set(g, true);
-    }
-}
-
-void ParticleSheeter::_identifySheetParticlesPhase2(Array3d<bool> &sheetCells,
-                                                    Array3d<unsigned char> &countGrid, 
-                                                    std::vector<vmath::vec3> &sheetParticles) {
-    int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, _particles->size());
-    std::vector<std::vector<vmath::vec3> > threadResults(numthreads);
-    std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _particles->size(), numthreads);
+    std::vector<int> tileParticles(tileStarts.back());
+    std::vector<short> tileParticleCells(tileStarts.back());
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ParticleSheeter::_identifySheetParticlesPhase2Thread, this,
-                                 intervals[i], intervals[i + 1], &sheetCells, &countGrid, &(threadResults[i]));
+        threads[i] = std::thread(&ParticleSheeter::_scatterTileParticlesThread, this,
+                                 intervals[i], intervals[i + 1], &particleSlots,
+                                 &(threadTileCounts[i]), threadTileStarts[i], 
+                                 &tileParticles, &tileParticleCells);
     }
 
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
     }
 
-    countGrid.fill((unsigned char)0);
+    _cellStarts = std::vector<int>(numTiles * _tileSize + 1, 0);
+    _cellParticles = std::vector<int>(tileParticles.size());
+    _cellStarts.back() = tileParticles.size();
+
+    numthreads = (int)fmin(numCPU, numTiles);
+    threads = std::vector<std::thread>(numthreads);
+    intervals = ThreadUtils::splitRangeIntoIntervals(0, numTiles, numthreads);
     for (int i = 0; i < numthreads; i++) {
-        for (size_t j = 0; j < threadResults[i].size(); j++) {
-            vmath::vec3 p = threadResults[i][j];
-            GridIndex g = Grid3d::positionToGridIndex(p, _dx);
-            if ((int)(countGrid(g)) >= _maxSheetParticlesPerCell) {
-                continue;
-            }
+        threads[i] = std::thread(&ParticleSheeter::_sortTileParticlesIntoCellsThread, this,
+                                 intervals[i], intervals[i + 1], 
+                                 &tileStarts, &tileParticles, &tileParticleCells);
+    }
 
-            sheetParticles.push_back(p);
-            countGrid.add(g, (char)1);
-        }
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
     }
 }
 
-void ParticleSheeter::_identifySheetParticlesPhase2Thread(int startidx, int endidx, 
-                                                          Array3d<bool> *sheetCells,
-                                                          Array3d<unsigned char> *countGrid, 
-                                                          std::vector<vmath::vec3> *result) {
-    std::vector<vmath::vec3> *positions;
-    _particles->getAttributeValues("POSITION", positions);
-
-    vmath::vec3 hdx(0.5*_dx, 0.5*_dx, 0.5*_dx);
-    float maxdepth = _maxSheetDepth * _dx;
+void ParticleSheeter::_countTileParticlesThread(int startidx, int endidx, 
+                                                std::vector<int> *particleSlots,
+                                                std::vector<int> *tileCounts,
+                                                int *tileStart) {
+    int mintile = std::numeric_limits<int>::max();
+    int maxtile = -1;
     for (int i = startidx; i < endidx; i++) {
-        vmath::vec3 p = positions->at(i);
-        GridIndex g = Grid3d::positionToGridIndex(p, _dx);
-        if (!sheetCells->get(g)) {
-            continue;
+        GridIndex g = Grid3d::positionToGridIndex(_positions->at(i), _dx);
+        int slot = _getCellSlot(g.i, g.j, g.k);
+        (*particleSlots)[i] = slot;
+        if (slot != -1) {
+            int tileid = slot >> (3 * _tileWidthBits);
+            mintile = std::min(mintile, tileid);
+            maxtile = std::max(maxtile, tileid);
         }
+    }
 
-        if ((int)(countGrid->get(g)) >= _maxSheetParticlesPerCell) {
-            continue;
-        }
+    if (maxtile == -1) {
+        tileCounts->clear();
+        *tileStart = 0;
+        return;
+    }
 
-        float phi = Interpolation::trilinearInterpolate(p - hdx, _dx, *_fluidSurfaceLevelSet);
-        if (phi >= maxdepth || phi < -maxdepth) {
-            // not near surface
-            continue;
+    tileCounts->assign(maxtile - mintile + 1, 0);
+    *tileStart = mintile;
+    for (int i = startidx; i < endidx; i++) {
+        int slot = (*particleSlots)[i];
+        if (slot != -1) {
+            (*tileCounts)[(slot >> (3 * _tileWidthBits)) - mintile]++;
         }
-
-        result->push_back(p);
-
-        // This is a threading race condition, but inaccuracies in the count will
-        // be resolved in the method that spawns this thread
-        countGrid->add(g, (char)1);
     }
 }
 
-void ParticleSheeter::_initializeMaskGrid(ParticleMaskGrid &maskgrid) {
-    std::vector<vmath::vec3> *positions;
-    _particles->getAttributeValues("POSITION", positions);
-
-    for (size_t i = 0; i < positions->size(); i++) {
-        maskgrid.addParticle(positions->at(i));
+void ParticleSheeter::_scatterTileParticlesThread(int startidx, int endidx, 
+                                                  std::vector<int> *particleSlots,
+                                                  std::vector<int> *tileOffsets,
+                                                  int tileStart,
+                                                  std::vector<int> *tileParticles,
+                                                  std::vector<short> *tileParticleCells) {
+    for (int i = startidx; i < endidx; i++) {
+        int slot = (*particleSlots)[i];
+        if (slot != -1) {
+            int tileid = slot >> (3 * _tileWidthBits);
+            int &offset = (*tileOffsets)[tileid - tileStart];
+            (*tileParticles)[offset] = i;
+            (*tileParticleCells)[offset] = (short)(slot - tileid * _tileSize);
+            offset++;
+        }
     }
 }
 
-void ParticleSheeter::_getSheetSeedCandidates(Array3d<bool> &sheetCells, 
-                                              std::vector<vmath::vec3> &sheetSeedCandidates) {
+void ParticleSheeter::_sortTileParticlesIntoCellsThread(int startidx, int endidx, 
+                                                        std::vector<int> *tileStarts,
+                                                        std::vector<int> *tileParticles,
+                                                        std::vector<short> *tileParticleCells) {
+    std::vector<int> localOffsets(_tileSize);
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        int start = tileStarts->at(tidx);
+        int end = tileStarts->at(tidx + 1);
+        int slotOffset = tidx * _tileSize;
+
+        std::fill(localOffsets.begin(), localOffsets.end(), 0);
+        for (int pidx = start; pidx < end; pidx++) {
+            localOffsets[tileParticleCells->at(pidx)]++;
+        }
 
-    std::vector<GridIndex> sheetCellVector;
-    for (int k = 0; k < _ksize; k++) {
-        for (int j = 0; j < _jsize; j++) {
-            for (int i = 0; i < _isize; i++) {
-                if (sheetCells(i, j, k)) {
-                    sheetCellVector.push_back(GridIndex(i, j, k));
-                }
-            }
+        int offset = start;
+        for (int i = 0; i < _tileSize; i++) {
+            int count = localOffsets[i];
+            _cellStarts[slotOffset + i] = offset;
+            localOffsets[i] = offset;
+            offset += count;
+        }
+
+        for (int pidx = start; pidx < end; pidx++) {
+            int localidx = tileParticleCells->at(pidx);
+            _cellParticles[localOffsets[localidx]] = tileParticles->at(pidx);
+            localOffsets[localidx]++;
         }
     }
+}
+
+void ParticleSheeter::_identifySheetCells() {
+    _sheetCells = std::vector<char>(_activeTiles.size() * _tileSize, 0);
 
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, sheetCellVector.size());
-    std::vector<std::vector<vmath::vec3> > threadResults(numthreads);
+    int numthreads = (int)fmin(numCPU, _activeTiles.size());
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, sheetCellVector.size(), numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _activeTiles.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ParticleSheeter::_getSheetSeedCandidatesThread, this,
-                                 intervals[i], intervals[i + 1], &sheetCellVector, &(threadResults[i]));
+        threads[i] = std::thread(&ParticleSheeter::_identifySheetCellsThread, this,
+                                 intervals[i], intervals[i + 1]);
     }
 
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
-        sheetSeedCandidates.insert(sheetSeedCandidates.end(), threadResults[i].begin(), threadResults[i].end());
     }
-
 }
 
-void ParticleSheeter::_getSheetSeedCandidatesThread(int startidx, int endidx, 
-                                                   std::vector<GridIndex> *sheetCellVector,
-                                                   std::vector<vmath::vec3> *result) {
-    GridIndex indexOffsets[8] = {
-        GridIndex(0, 0, 0),
-        GridIndex(0, 0, 1),
-        GridIndex(0, 1, 0),
-        GridIndex(0, 1, 1),
-        GridIndex(1, 0, 0),
-        GridIndex(1, 0, 1),
-        GridIndex(1, 1, 0),
-        GridIndex(1, 1, 1)
-    };
+void ParticleSheeter::_identifySheetCellsThread(int startidx, int endidx) {
+    for (int slot = startidx * _tileSize; slot < endidx * _tileSize; slot++) {
+        int start = _cellStarts[slot];
+        int end = _cellStarts[slot + 1];
+        if (end - start >= _maxParticlesPerCell) {
+            // too dense to be a sheet that needs reseeding
+            continue;
+        }
 
-    float maxSeedDepth = _maxSheedSeedCandidateDepth * _dx;
-    double subdx = 0.5 * _dx;
-    vmath::vec3 hdx(0.5*_dx, 0.5*_dx, 0.5*_dx);
-    for (int i = startidx; i < endidx; i++) {
-        GridIndex cell = sheetCellVector->at(i);
-        for (int gidx = 0; gidx < 8; gidx++) {
-            GridIndex offset = indexOffsets[gidx];
-            GridIndex subIndex(2*cell.i + offset.i, 
-                               2*cell.j + offset.j, 
-                               2*cell.k + offset.k);
-            vmath::vec3 seed = Grid3d::GridIndexToCellCenter(subIndex, subdx);
-
-            float phi = Interpolation::trilinearInterpolate(seed - hdx, _dx, *_fluidSurfaceLevelSet);
-            if (phi >= 0.0f || phi < -maxSeedDepth) {
-                continue;
+        for (int pidx = start; pidx < end; pidx++) {
+            if (_isSheetParticleCandidate(_positions->at(_cellParticles[pidx]))) {
+                _sheetCells[slot] = 1;
+                break;
             }
-
-            result->push_back(seed);
         }
     }
 }
 
-void ParticleSheeter::_sortSheetParticlesIntoGrid(std::vector<vmath::vec3> &sheetParticles, 
-                                                  SortedParticleData &sheetParticleData) {
+bool ParticleSheeter::_isSheetParticleCandidate(vmath::vec3 p) {
+    float maxdepth = _maxSheetDepth * _dx;
+    float depthTestDistance = _depthTestDistance * _dx;
+    float depthTestStepDistance = _depthTestStepDistance * _dx;
+    float eps = 1e-5;
+    vmath::vec3 hdx(0.5*_dx, 0.5*_dx, 0.5*_dx);
 
-    int spatialGridReduction = (int)std::ceil(_sheetSearchRadius);
-    int sr = spatialGridReduction;
-    sheetParticleData.particlesPerCell = sr * sr * sr * _maxSheetParticlesPerCell;
+    float phi = Interpolation::trilinearInterpolate(p - hdx, _dx, *_fluidSurfaceLevelSet);
+    if (phi >= maxdepth || phi < -maxdepth) {
+        // not near surface
+        return false;
+    }
 
-    sheetParticleData.dx = spatialGridReduction * _dx;
-    sheetParticleData.isize = (int)std::ceil((float)_isize / (float)spatialGridReduction);
-    sheetParticleData.jsize = (int)std::ceil((float)_jsize / (float)spatialGridReduction);
-    sheetParticleData.ksize = (int)std::ceil((float)_ksize / (float)spatialGridReduction);
+    vmath::vec3 dir;
+    Interpolation::trilinearInterpolateGradient(p - hdx, _dx, *_fluidSurfaceLevelSet, &dir);
+    dir = -dir;
+    if (vmath::length(dir) < eps) {
+        // invalid gradient vector
+        return false;
+    }
 
-    _sortParticlesIntoGrid(sheetParticles, sheetParticleData);
+    // If you travel inwards from the surface normal, does the depth increase?
+    // If so, then the point is not part of a thin sheet
+    dir = vmath::normalize(dir);
+    int numSteps = (int)std::ceil(depthTestDistance / depthTestStepDistance);
+    float currentPhi = phi;
+    for (int stepidx = 0; stepidx < numSteps; stepidx++) {
+        vmath::vec3 nextp = p + stepidx * depthTestStepDistance * dir;
+        float nextPhi = Interpolation::trilinearInterpolate(nextp - hdx, _dx, *_fluidSurfaceLevelSet);
+        if (nextPhi > currentPhi || nextPhi >= 0.0f) {
+            return true;
+        }
+        currentPhi = nextPhi;
+    }
 
+    return false;
 }
 
-void ParticleSheeter::_sortSheetSeedCandidateParticlesIntoGrid(std::vector<vmath::vec3> &candidateParticles, 
-                                                               SortedParticleData &candidateParticleData) {
-    int spatialGridReduction = (int)std::ceil(_sheetSearchRadius);
-    int sr = spatialGridReduction;
-    candidateParticleData.particlesPerCell = sr * sr * sr * _maxSheetSeedCandidatesPerCell;
+void ParticleSheeter::_featherSheetCells(bool isBorderRemoved) {
+    std::vector<char> sheetCells = _sheetCells;
 
-    candidateParticleData.dx = spatialGridReduction * _dx;
-    candidateParticleData.isize = (int)std::ceil((float)_isize / (float)spatialGridReduction);
-    candidateParticleData.jsize = (int)std::ceil((float)_jsize / (float)spatialGridReduction);
-    candidateParticleData.ksize = (int)std::ceil((float)_ksize / (float)spatialGridReduction);
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _activeTiles.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _activeTiles.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ParticleSheeter::_featherSheetCellsThread, this,
+                                 intervals[i], intervals[i + 1], &sheetCells, isBorderRemoved);
+    }
 
-    _sortParticlesIntoGrid(candidateParticles, candidateParticleData);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
 }
 
-void ParticleSheeter::_sortParticlesIntoGrid(std::vector<vmath::vec3> &particles, 
-                                             SortedParticleData &sortData) {
+void ParticleSheeter::_featherSheetCellsThread(int startidx, int endidx, 
+                                               std::vector<char> *sheetCells, 
+                                               bool isBorderRemoved) {
+    int buffer = 3;
+    GridIndex nbs[6];
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        for (int localidx = 0; localidx < _tileSize; localidx++) {
+            int slot = tidx * _tileSize + localidx;
+            GridIndex g = _getSlotCell(tidx, localidx);
+            if (!Grid3d::isGridIndexInRange(g, _isize, _jsize, _ksize)) {
+                continue;
+            }
 
-    _initializeSortDataValidCells(particles, sortData);
+            if (isBorderRemoved && 
+                    (g.i < buffer || g.j < buffer || g.k < buffer || 
+                     g.i >= _isize - buffer || 
+                     g.j >= _jsize - buffer || 
+                     g.k >= _ksize - buffer)) {
+                _sheetCells[slot] = 0;
+                continue;
+            }
 
-    sortData.particleData = std::vector<vmath::vec3>(sortData.numValidCells * sortData.particlesPerCell);
-    sortData.dataOffsets  = Array3d<std::pair<int, int> >(
-            sortData.isize, sortData.jsize, sortData.ksize, std::pair<int, int>(-1, -1)
-            );
+            if (sheetCells->at(slot)) {
+                continue;
+            }
 
-    int currentidx = 0;
-    for (int k = 0; k < sortData.ksize; k++) {
-        for (int j = 0; j < sortData.jsize; j++) {
-            for (int i = 0; i < sortData.isize; i++) {
-                if (sortData.validCells(i, j, k)) {
-                    int dataidx = sortData.particlesPerCell * currentidx;
-                    sortData.dataOffsets.set(i, j, k, std::pair<int, int>(dataidx, dataidx));
-                    currentidx++;
+            Grid3d::getNeighbourGridIndices6(g, nbs);
+            for (int nidx = 0; nidx < 6; nidx++) {
+                int nslot = _getCellSlot(nbs[nidx].i, nbs[nidx].j, nbs[nidx].k);
+                if (nslot != -1 && sheetCells->at(nslot)) {
+                    _sheetCells[slot] = 1;
+                    break;
                 }
             }
         }
     }
-
-    for (size_t i = 0; i < particles.size(); i++) {
-        GridIndex g = Grid3d::positionToGridIndex(particles[i], sortData.dx);
-        std::pair<int, int> offset = sortData.dataOffsets(g);
-        sortData.particleData[offset.second] = particles[i];
-        offset.second++;
-        sortData.dataOffsets.set(g, offset);
-    }
 }
 
-void ParticleSheeter::_initializeSortDataValidCells(std::vector<vmath::vec3> &particles, 
-                                                    SortedParticleData &sortData) {
-    sortData.validCells  = Array3d<bool>(
-            sortData.isize, sortData.jsize, sortData.ksize, false
-            );
+int ParticleSheeter::_identifySheetParticles() {
+    size_t numSlots = _activeTiles.size() * _tileSize;
+    _sheetParticleCounts = std::vector<unsigned char>(numSlots, 0);
+    _sheetParticles = std::vector<int>(numSlots * _maxSheetParticlesPerCell, -1);
 
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, particles.size());
+    int numthreads = (int)fmin(numCPU, _activeTiles.size());
+    std::vector<int> threadResults(numthreads, 0);
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, particles.size(), numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _activeTiles.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ParticleSheeter::_initializeSortDataValidCellsThread, this,
-                                 intervals[i], intervals[i + 1], &particles, &sortData);
+        threads[i] = std::thread(&ParticleSheeter::_identifySheetParticlesThread, this,
+                                 intervals[i], intervals[i + 1], &(threadResults[i]));
     }
 
+    int numSheetParticles = 0;
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
+        numSheetParticles += threadResults[i];
     }
 
-    int numValidCells = 0;
-    for (int k = 0; k < sortData.ksize; k++) {
-        for (int j = 0; j < sortData.jsize; j++) {
-            for (int i = 0; i < sortData.isize; i++) {
-                if (sortData.validCells(i, j, k)) {
-                    numValidCells++;
-                }
+    return numSheetParticles;
+}
+
+void ParticleSheeter::_identifySheetParticlesThread(int startidx, int endidx, int *numSheetParticles) {
+    vmath::vec3 hdx(0.5*_dx, 0.5*_dx, 0.5*_dx);
+    float maxdepth = _maxSheetDepth * _dx;
+    for (int slot = startidx * _tileSize; slot < endidx * _tileSize; slot++) {
+        if (!_sheetCells[slot]) {
+            continue;
+        }
+
+        int count = 0;
+        for (int pidx = _cellStarts[slot]; pidx < _cellStarts[slot + 1]; pidx++) {
+            if (count >= _maxSheetParticlesPerCell) {
+                break;
+            }
+
+            int particleidx = _cellParticles[pidx];
+            vmath::vec3 p = _positions->at(particleidx);
+            float phi = Interpolation::trilinearInterpolate(p - hdx, _dx, *_fluidSurfaceLevelSet);
+            if (phi >= maxdepth || phi < -maxdepth) {
+                // not near surface
+                continue;
             }
+
+            _sheetParticles[slot * _maxSheetParticlesPerCell + count] = particleidx;
+            count++;
         }
-    }
 
-    sortData.numValidCells = numValidCells;
+        _sheetParticleCounts[slot] = (unsigned char)count;
+        *numSheetParticles += count;
+    }
 }
 
-void ParticleSheeter::_initializeSortDataValidCellsThread(int startidx, int endidx, 
-                                                          std::vector<vmath::vec3> *particles, 
-                                                          SortedParticleData *sortData) {
-    for (int i = startidx; i < endidx; i++) {
-        GridIndex g = Grid3d::positionToGridIndex(particles->at(i), sortData->dx);
-        sortData->validCells.set(g, true);
+bool ParticleSheeter::_getSubCellMaskLocation(vmath::vec3 p, int *slot, unsigned char *bit) {
+    GridIndex sg = Grid3d::positionToGridIndex(p, 0.5 * _dx);
+    *slot = _getCellSlot(sg.i / 2, sg.j / 2, sg.k / 2);
+    if (*slot == -1) {
+        return false;
     }
+
+    *bit = (unsigned char)(1 << ((sg.i % 2) + 2 * (sg.j % 2) + 4 * (sg.k % 2)));
+    return true;
 }
 
-void ParticleSheeter::_selectSeedParticles(SortedParticleData &sheetCandidateParticleData, 
-                                           SortedParticleData &sheetParticleData,
-                                           ParticleMaskGrid &maskgrid,
-                                           std::vector<vmath::vec3> &generatedParticles) {
-
-    std::vector<GridIndex> candidateCells;
-    for (int k = 0; k < sheetCandidateParticleData.ksize; k++) {
-        for (int j = 0; j < sheetCandidateParticleData.jsize; j++) {
-            for (int i = 0; i < sheetCandidateParticleData.isize; i++) {
-                if (sheetCandidateParticleData.validCells(i, j, k)) {
-                    candidateCells.push_back(GridIndex(i, j, k));
-                }
-            }
+bool ParticleSheeter::_isSubCellOccupied(int slot, unsigned char bit) {
+    for (int pidx = _cellStarts[slot]; pidx < _cellStarts[slot + 1]; pidx++) {
+        int pslot;
+        unsigned char pbit;
+        _getSubCellMaskLocation(_positions->at(_cellParticles[pidx]), &pslot, &pbit);
+        if (pbit == bit) {
+            return true;
         }
     }
 
+    return false;
+}
+
+void ParticleSheeter::_selectSeedParticles(std::vector<vmath::vec3> &generatedParticles) {
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, candidateCells.size());
+    int numthreads = (int)fmin(numCPU, _activeTiles.size());
     std::vector<std::vector<vmath::vec3> > threadResults(numthreads);
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, candidateCells.size(), numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _activeTiles.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&ParticleSheeter::_selectSeedParticlesThread, this,
-                                 intervals[i], intervals[i + 1], 
-                                 &candidateCells, &maskgrid, &sheetCandidateParticleData, &sheetParticleData, 
-                                 &(threadResults[i]));
+                                 intervals[i], intervals[i + 1], &(threadResults[i]));
     }
 
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
-        generatedParticles.insert(generatedParticles.end(), threadResults[i].begin(), threadResults[i].end());
     }
 
+    // Seeds were only tested against the existing particles. Resolving seeds 
+    // that share a sub cell in tile order keeps the output independent of
+    // the thread count.
+    std::vector<unsigned char> seedMask(_activeTiles.size() * _tileSize, 0);
+    for (int i = 0; i < numthreads; i++) {
+        for (size_t j = 0; j < threadResults[i].size(); j++) {
+            vmath::vec3 p = threadResults[i][j];
+            int slot;
+            unsigned char bit;
+            _getSubCellMaskLocation(p, &slot, &bit);
+            if (seedMask[slot] & bit) {
+                continue;
+            }
+
+            seedMask[slot] |= bit;
+            generatedParticles.push_back(p);
+        }
+    }
 }
 
-void ParticleSheeter::_selectSeedParticlesThread(int startidx, int endidx,
-                                                 std::vector<GridIndex> *candidateCells,
-                                                 ParticleMaskGrid *maskgrid,
-                                                 SortedParticleData *sheetCandidateParticleData,
-                                                 SortedParticleData *sheetParticleData,
+void ParticleSheeter::_selectSeedParticlesThread(int startidx, int endidx, 
                                                  std::vector<vmath::vec3> *result) {
+    GridIndex indexOffsets[8] = {
+        GridIndex(0, 0, 0),
+        GridIndex(0, 0, 1),
+        GridIndex(0, 1, 0),
+        GridIndex(0, 1, 1),
+        GridIndex(1, 0, 0),
+        GridIndex(1, 0, 1),
+        GridIndex(1, 1, 0),
+        GridIndex(1, 1, 1)
+    };
 
     float eps = 1e-5;
     float maxradius = _sheetSearchRadius * _dx;
-    std::vector<vmath::vec3> candidateParticles;
+    float maxradiusSq = maxradius * maxradius;
+    int searchWidth = (int)std::ceil(_sheetSearchRadius);
+    float maxSeedDepth = _maxSheedSeedCandidateDepth * _dx;
+    double subdx = 0.5 * _dx;
+    vmath::vec3 hdx(0.5*_dx, 0.5*_dx, 0.5*_dx);
+    vmath::vec3 candidates[8];
     std::vector<vmath::vec3> neighbours;
     std::vector<vmath::vec3> nearestneighbours;
-    for (int gidx = startidx; gidx < endidx; gidx++) {
-        GridIndex candidateCell = candidateCells->at(gidx);
-
-        neighbours.clear();
-        for (int k = candidateCell.k - 1; k <= candidateCell.k + 1; k++) {
-            for (int j = candidateCell.j - 1; j <= candidateCell.j + 1; j++) {
-                for (int i = candidateCell.i - 1; i <= candidateCell.i + 1; i++) {
-                    if (!sheetParticleData->dataOffsets.isIndexInRange(i, j, k)) {
-                        continue;
-                    }
-
-                    std::pair<int, int> offset = sheetParticleData->dataOffsets(i, j, k);
-                    if (offset.first == -1) {
-                        continue;
-                    }
-
-                    for (int dataidx = offset.first; dataidx < offset.second; dataidx++) {
-                        vmath::vec3 np = sheetParticleData->particleData[dataidx];
-                        neighbours.push_back(sheetParticleData->particleData[dataidx]);
-                    }
-                }
+    for (int tidx = startidx; tidx < endidx; tidx++) {
+        for (int localidx = 0; localidx < _tileSize; localidx++) {
+            int slot = tidx * _tileSize + localidx;
+            if (!_sheetCells[slot]) {
+                continue;
             }
-        }
-
-        if (neighbours.size() < 3) {
-            continue;
-        }
-
-        std::pair<int, int> candidateDataOffset = sheetCandidateParticleData->dataOffsets(candidateCell);
-        candidateParticles.clear();
-        for (int cdataidx = candidateDataOffset.first; cdataidx < candidateDataOffset.second; cdataidx++) {
-            candidateParticles.push_back(sheetCandidateParticleData->particleData[cdataidx]);
-        }
-
-        for (size_t cidx = 0; cidx < candidateParticles.size(); cidx++) {
-            vmath::vec3 p = candidateParticles[cidx];
 
-            nearestneighbours.clear();
-            for (size_t nidx = 0; nidx < neighbours.size(); nidx++) {
-                vmath::vec3 np = neighbours[nidx];
-                if (vmath::length(np - p) < maxradius) {
-                    nearestneighbours.push_back(np);
+            GridIndex cell = _getSlotCell(tidx, localidx);
+            int numCandidates = 0;
+            for (int gidx = 0; gidx < 8; gidx++) {
+                GridIndex offset = indexOffsets[gidx];
+                GridIndex subIndex(2*cell.i + offset.i, 
+                                   2*cell.j + offset.j, 
+                                   2*cell.k + offset.k);
+                vmath::vec3 seed = Grid3d::GridIndexToCellCenter(subIndex, subdx);
+
+                float phi = Interpolation::trilinearInterpolate(seed - hdx, _dx, *_fluidSurfaceLevelSet);
+                if (phi >= 0.0f || phi < -maxSeedDepth) {
+                    continue;
                 }
+
+                candidates[numCandidates] = seed;
+                numCandidates++;
             }
 
-            if (nearestneighbours.size() < 3) {
+            if (numCandidates == 0) {
                 continue;
             }
 
-            vmath::vec3 centroid;
-            for (size_t nidx = 0; nidx < nearestneighbours.size(); nidx++) {
-                centroid += nearestneighbours[nidx];
-            }
-            centroid /= nearestneighbours.size();
-
-            float len1 = 1e6;
-            float len2 = 1e6;
-            float len3 = 1e6;
-            vmath::vec3 p1, p2, p3;
-            for (size_t nidx = 0; nidx < nearestneighbours.size(); nidx++) {
-                vmath::vec3 np = nearestneighbours[nidx];
-                float len = vmath::length(np - p);
-                if (len < len1) {
-                    len3 = len2;
-                    len2 = len1;
-                    len1 = len;
-                    p3 = p2;
-                    p2 = p1;
-                    p1 = np;
-                } else if (len < len2) {
-                    len3 = len2;
-                    len2 = len;
-                    p3 = p2;
-                    p2 = np;
-                } else if (len < len3) {
-                    len3 = len;
-                    p3 = np;
+            // Seed candidates lie inside this cell, so every sheet particle
+            // within the search radius of a candidate is in this
+            // neighbourhood
+            neighbours.clear();
+            for (int k = cell.k - searchWidth; k <= cell.k + searchWidth; k++) {
+                for (int j = cell.j - searchWidth; j <= cell.j + searchWidth; j++) {
+                    for (int i = cell.i - searchWidth; i <= cell.i + searchWidth; i++) {
+                        int nslot = _getCellSlot(i, j, k);
+                        if (nslot == -1) {
+                            continue;
+                        }
+
+                        int count = _sheetParticleCounts[nslot];
+                        for (int nidx = 0; nidx < count; nidx++) {
+                            int particleidx = _sheetParticles[nslot * _maxSheetParticlesPerCell + nidx];
+                            neighbours.push_back(_positions->at(particleidx));
+                        }
+                    }
                 }
             }
 
-            vmath::vec3 vt1 = p2 - p1;
-            vmath::vec3 vt2 = p3 - p1;
-            vmath::vec3 cross = vmath::cross(vt1, vt2);
-            if (vmath::length(vt1) < eps || vmath::length(vt2) < eps || vmath::length(cross) < eps) {
+            if (neighbours.size() < 3) {
                 continue;
             }
 
-            vmath::vec3 normal = vmath::normalize(cross);
-            float distance = -vmath::dot(normal, (p - p1));
-            p = p + _projectionFactor * distance * normal;
-            if (!Grid3d::isPositionInGrid(p, _dx, _isize, _jsize, _ksize) || maskgrid->isSubCellSet(p)) {
-                continue;
-            }
+            for (int cidx = 0; cidx < numCandidates; cidx++) {
+                vmath::vec3 p = candidates[cidx];
 
-            vmath::vec3 cdir = centroid - p;
-            if (vmath::length(cdir) < eps) {
-                continue;
-            }
+                nearestneighbours.clear();
+                for (size_t nidx = 0; nidx < neighbours.size(); nidx++) {
+                    vmath::vec3 np = neighbours[nidx];
+                    if (vmath::lengthsq(np - p) < maxradiusSq) {
+                        nearestneighbours.push_back(np);
+                    }
+                }
 
-            cdir = vmath::normalize(cdir);
-            float mindot = 1.01f;
-            for (size_t nidx = 0; nidx < nearestneighbours.size(); nidx++) {
-                vmath::vec3 np = nearestneighbours[nidx];
-                vmath::vec3 ndir = np - p;
-                if (vmath::length(ndir) < eps) {
+                if (nearestneighbours.size() < 3) {
                     continue;
                 }
 
-                ndir = vmath::normalize(ndir);
-                float dot = vmath::dot(cdir, ndir);
-                if (dot < mindot) {
-                    mindot = dot;
+                vmath::vec3 centroid;
+                for (size_t nidx = 0; nidx < nearestneighbours.size(); nidx++) {
+                    centroid += nearestneighbours[nidx];
+                }
+                centroid /= nearestneighbours.size();
+
+                float len1 = 1e6;
+                float len2 = 1e6;
+                float len3 = 1e6;
+                vmath::vec3 p1, p2, p3;
+                for (size_t nidx = 0; nidx < nearestneighbours.size(); nidx++) {
+                    vmath::vec3 np = nearestneighbours[nidx];
+                    float len = vmath::length(np - p);
+                    if (len < len1) {
+                        len3 = len2;
+                        len2 = len1;
+                        len1 = len;
+                        p3 = p2;
+                        p2 = p1;
+                        p1 = np;
+                    } else if (len < len2) {
+                        len3 = len2;
+                        len2 = len;
+                        p3 = p2;
+                        p2 = np;
+                    } else if (len < len3) {
+                        len3 = len;
+                        p3 = np;
+                    }
+                }
+
+                vmath::vec3 vt1 = p2 - p1;
+                vmath::vec3 vt2 = p3 - p1;
+                vmath::vec3 cross = vmath::cross(vt1, vt2);
+                if (vmath::length(vt1) < eps || vmath::length(vt2) < eps || vmath::length(cross) < eps) {
+                    continue;
+                }
+
+                vmath::vec3 normal = vmath::normalize(cross);
+                float distance = -vmath::dot(normal, (p - p1));
+                p = p + _projectionFactor * distance * normal;
+                if (!Grid3d::isPositionInGrid(p, _dx, _isize, _jsize, _ksize)) {
+                    continue;
                 }
-            }
 
-            if (mindot < _sheetFillThreshold) {
-                result->push_back(p);
-                maskgrid->addParticle(p);
+                int pslot;
+                unsigned char bit;
+                if (!_getSubCellMaskLocation(p, &pslot, &bit) || _isSubCellOccupied(pslot, bit)) {
+                    continue;
+                }
+
+                vmath::vec3 cdir = centroid - p;
+                if (vmath::length(cdir) < eps) {
+                    continue;
+                }
+
+                cdir = vmath::normalize(cdir);
+                float mindot = 1.01f;
+                for (size_t nidx = 0; nidx < nearestneighbours.size(); nidx++) {
+                    vmath::vec3 np = nearestneighbours[nidx];
+                    vmath::vec3 ndir = np - p;
+                    if (vmath::length(ndir) < eps) {
+                        continue;
+                    }
+
+                    ndir = vmath::normalize(ndir);
+                    float dot = vmath::dot(cdir, ndir);
+                    if (dot < mindot) {
+                        mindot = dot;
+                    }
+                }
+
+                if (mindot < _sheetFillThreshold) {
+                    result->push_back(p);
+                }
             }
         }
-
     }
 }
\ No newline at end of file
@@ -27,7 +27,8 @@ SOFTWARE.
 #include "markerparticle.h"
 #include "fragmentedvector.h"
 #include "meshlevelset.h"
-#include "particlemaskgrid.h"
+#include "array3d.h"
+#include "grid3d.h"
 #include "vmath.h"
 #include "particlesystem.h"
 
@@ -54,69 +55,70 @@ public:
     
 private:
 
-    struct SortedParticleData {
-        int particlesPerCell = 0;
-        int isize = 0;
-        int jsize = 0;
-        int ksize = 0;
-        double dx = 0.0;
-
-        Array3d<bool> validCells;
-        int numValidCells = 0;
-
-        std::vector<vmath::vec3> particleData;
-        Array3d<std::pair<int, int> > dataOffsets;
-    };
-    
     void _initializeParameters(ParticleSheeterParameters params);
-    void _getMarkerParticleCellCounts(Array3d<unsigned char> &countGrid);
-    void _identifySheetParticlesPhase1(Array3d<unsigned char> &countGrid, 
-                                       std::vector<vmath::vec3> &sheetParticles);
-    void _identifySheetParticlesPhase1Thread(int startidx, int endidx, 
-                                             Array3d<unsigned char> *countGrid, 
-                                             std::vector<vmath::vec3> *result);
-    void _getSheetCells(std::vector<vmath::vec3> &sheetParticles, 
-                        Array3d<bool> &sheetCells);
-    void _getSheetCellsThread(int startidx, int endidx,
-                              std::vector<vmath::vec3> *sheetParticles, 
-                              Array3d<bool> *sheetCells);
-    void _identifySheetParticlesPhase2(Array3d<bool> &sheetCells,
-                                       Array3d<unsigned char> &countGrid, 
-                                       std::vector<vmath::vec3> &sheetParticles);
-    void _identifySheetParticlesPhase2Thread(int startidx, int endidx, 
-                                             Array3d<bool> *sheetCells,
-                                             Array3d<unsigned char> *countGrid, 
-                                             std::vector<vmath::vec3> *result);
-    void _initializeMaskGrid(ParticleMaskGrid &maskgrid);
-    void _getSheetSeedCandidates(Array3d<bool> &sheetCells, 
-                                 std::vector<vmath::vec3> &sheetSeedCandidates);
-    void _getSheetSeedCandidatesThread(int startidx, int endidx, 
-                                       std::vector<GridIndex> *sheetCellVector,
-                                       std::vector<vmath::vec3> *result);
-    void _sortSheetParticlesIntoGrid(std::vector<vmath::vec3> &sheetParticles, 
-                                     SortedParticleData &sheetParticleData);
-    void _sortSheetSeedCandidateParticlesIntoGrid(std::vector<vmath::vec3> &candidateParticles, 
-                                                  SortedParticleData &candidateParticleData);
-    
-    void _sortParticlesIntoGrid(std::vector<vmath::vec3> &particles, 
-                                SortedParticleData &sortData);
-    void _initializeSortDataValidCells(std::vector<vmath::vec3> &particles, 
-                                       SortedParticleData &sortData);
-    void _initializeSortDataValidCellsThread(int startidx, int endidx, 
-                                             std::vector<vmath::vec3> *particles, 
-                                             SortedParticleData *sortData);
-
-    void _selectSeedParticles(SortedParticleData &sheetCandidateParticleData, 
-                              SortedParticleData &sheetParticleData,
-                              ParticleMaskGrid &maskgrid,
-                              std::vector<vmath::vec3> &generatedParticles);
-    void _selectSeedParticlesThread(int startidx, int endidx,
-                                    std::vector<GridIndex> *candidateCells,
-                                    ParticleMaskGrid *maskgrid,
-                                    SortedParticleData *sheetCandidateParticleData,
-                                    SortedParticleData *sheetParticleData,
+
+    void _initializeActiveTiles();
+    void _getNearSurfaceTilesThread(int startidx, int endidx, Array3d<bool> *tiles);
+
+    void _sortParticlesIntoTileCells();
+    void _countTileParticlesThread(int startidx, int endidx, 
+                                   std::vector<int> *particleSlots,
+                                   std::vector<int> *tileCounts,
+                                   int *tileStart);
+    void _scatterTileParticlesThread(int startidx, int endidx, 
+                                     std::vector<int> *particleSlots,
+                                     std::vector<int> *tileOffsets,
+                                     int tileStart,
+                                     std::vector<int> *tileParticles,
+                                     std::vector<short> *tileParticleCells);
+    void _sortTileParticlesIntoCellsThread(int startidx, int endidx, 
+                                           std::vector<int> *tileStarts,
+                                           std::vector<int> *tileParticles,
+                                           std::vector<short> *tileParticleCells);
+
+    void _identifySheetCells();
+    void _identifySheetCellsThread(int startidx, int endidx);
+    bool _isSheetParticleCandidate(vmath::vec3 p);
+    void _featherSheetCells(bool isBorderRemoved);
+    void _featherSheetCellsThread(int startidx, int endidx, 
+                                  std::vector<char> *sheetCells, 
+                                  bool isBorderRemoved);
+
+    int _identifySheetParticles();
+    void _identifySheetParticlesThread(int startidx, int endidx, int *numSheetParticles);
+
+    bool _getSubCellMaskLocation(vmath::vec3 p, int *slot, unsigned char *bit);
+    bool _isSubCellOccupied(int slot, unsigned char bit);
+
+    void _selectSeedParticles(std::vector<vmath::vec3> &generatedParticles);
+    void _selectSeedParticlesThread(int startidx, int endidx, 
                                     std::vector<vmath::vec3> *result);
 
+    inline int _getCellSlot(int i, int j, int k) {
+        if (!Grid3d::isGridIndexInRange(i, j, k, _isize, _jsize, _ksize)) {
+            return -1;
+        }
+
+        int tileid = _tileIDs(i >> _tileWidthBits, j >> _tileWidthBits, k >> _tileWidthBits);
+        if (tileid == -1) {
+            return -1;
+        }
+
+        int mask = _tileWidth - 1;
+        int localidx = (i & mask) + 
+                       ((j & mask) << _tileWidthBits) + 
+                       ((k & mask) << (2 * _tileWidthBits));
+        return (tileid << (3 * _tileWidthBits)) + localidx;
+    }
+
+    inline GridIndex _getSlotCell(int tileid, int localidx) {
+        GridIndex t = _activeTiles[tileid];
+        int mask = _tileWidth - 1;
+        return GridIndex((t.i << _tileWidthBits) + (localidx & mask), 
+                         (t.j << _tileWidthBits) + ((localidx >> _tileWidthBits) & mask), 
+                         (t.k << _tileWidthBits) + (localidx >> (2 * _tileWidthBits)));
+    }
+
     // External parameters
     ParticleSystem *_particles;
     Array3d<float> *_fluidSurfaceLevelSet;
@@ -133,8 +135,24 @@ private:
     float _depthTestStepDistance = 0.5f;
     int _maxParticlesPerCell = 6;
     int _maxSheetParticlesPerCell = 4;
-    int _maxSheetSeedCandidatesPerCell = 8;
     float _maxSheedSeedCandidateDepth = 1.0f;
     float _sheetSearchRadius = 2.0f;
     float _projectionFactor = 0.75;
+
+    // Sheeting is only computed within tiles that contain the narrow band of
+    // the surface level set and their neighbours. Per cell data is stored in
+    // tile slots, slot = tileid * tileSize + local cell index. The tile width
+    // is a power of two so that slot lookups can be computed with shifts.
+    int _tileWidthBits = 2;
+    int _tileWidth = 4;
+    int _tileSize = 64;
+    Array3d<int> _tileIDs;
+    std::vector<GridIndex> _activeTiles;
+
+    std::vector<vmath::vec3> *_positions = NULL;
+    std::vector<int> _cellStarts;
+    std::vector<int> _cellParticles;
+    std::vector<char> _sheetCells;
+    std::vector<unsigned char> _sheetParticleCounts;
+    std::vector<int> _sheetParticles;
 };
@@ -98,6 +98,18 @@ void ParticleSystem::removeParticles(std::vector<bool> &toRemove) {
     update();
 }
 
+void ParticleSystem::reorderParticles(std::vector<size_t> &order) {
+    _reorderVectorList(_charAttributes, order);
+    _reorderVectorList(_ucharAttributes, order);
+    _reorderVectorList(_boolAttributes, order);
+    _reorderVectorList(_intAttributes, order);
+    _reorderVectorList(_idAttributes, order);
+    _reorderVectorList(_uint16Attributes, order);
+    _reorderVectorList(_uLongLongAttributes, order);
+    _reorderVectorList(_floatAttributes, order);
+    _reorderVectorList(_vector3Attributes, order);
+}
+
 void ParticleSystem::printParticle(size_t index) {
     for (size_t aidx = 0; aidx < _attributes.size(); aidx++) {
         ParticleSystemAttribute att = _attributes[aidx];
@@ -75,6 +75,7 @@ public:
     void resize(size_t n);
     void reserve(size_t n);
     void removeParticles(std::vector<bool> &toRemove);
+    void reorderParticles(std::vector<size_t> &order);
     void printParticle(size_t index);
 
     std::vector<ParticleSystemAttribute> getAttributes() { return _attributes; }
@@ -293,6 +294,24 @@ private:
         }
     }
 
+    template<class T>
+    inline void _reorderVector(T &vector, std::vector<size_t> &order) {
+        FLUIDSIM_ASSERT(vector.size() == order.size());
+
+        T reordered(vector.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            reordered[i] = vector[order[i]];
+        }
+        vector.swap(reordered);
+    }
+
+    template<class T>
+    inline void _reorderVectorList(T &vectorList, std::vector<size_t> &order) {
+        for (size_t i = 0; i < vectorList.size(); i++) {
+            _reorderVector(vectorList[i], order);
+        }
+    }
+
     template<class T>
     inline void _mergeVectors(T &vectorList1, T &vectorList2) {
         for (size_t i = 0; i < vectorList1.size(); i++) {
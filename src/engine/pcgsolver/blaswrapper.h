@@ -23,37 +23,39 @@ purposes, all without asking permission. See Other Information below.
 namespace BLAS{
 
 // dot products ==============================================================
+// Accumulated in double precision so that single precision vectors can be
+// used without losing accuracy in the reductions
 
 template<class T>
-void dotThread(int startidx, int endidx, std::vector<T> *x, std::vector<T> *y, T *result) {
+void dotThread(int startidx, int endidx, std::vector<T> *x, std::vector<T> *y, double *result) {
     for (int i = startidx; i < endidx; i++) {
-        *result += x->at(i) * y->at(i);
+        *result += (double)x->at(i) * (double)y->at(i);
     }
 }
 
 template<class T>
-inline T dot(std::vector<T> &x, std::vector<T> &y) { 
+inline double dot(std::vector<T> &x, std::vector<T> &y) { 
     //return cblas_ddot((int)x.size(), &x[0], 1, &y[0], 1); 
 
     int numCPU = ThreadUtils::getMaxThreadCount();
     int numthreads = (int)fmin(numCPU, std::ceil((float)x.size() / (float)ELEMENTS_PER_THREAD));
     if (numthreads == 1) {
-        T sum = 0;
+        double sum = 0;
         for(size_t i = 0; i < x.size(); i++) {
-            sum += x[i] * y[i];
+            sum += (double)x[i] * (double)y[i];
         }
         return sum;
     }
 
     std::vector<std::thread> threads(numthreads);
-    std::vector<T> results(numthreads, 0);
+    std::vector<double> results(numthreads, 0);
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, x.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&dotThread<T>,
                                  intervals[i], intervals[i + 1], &x, &y, &(results[i]));
     }
 
-    T sum = 0;
+    double sum = 0;
     for (int i = 0; i < numthreads; i++) {
         threads[i].join();
         sum += results[i];
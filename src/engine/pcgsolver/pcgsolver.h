@@ -268,7 +268,33 @@ struct PCGSolver {
     bool solve(const SparseMatrix<T> &matrix, const std::vector<T> &rhs, 
                std::vector<T> &result, T &residualOut, int &iterationsOut) {
 
-        unsigned int n = matrix.n;
+        r = rhs;
+        if (BLAS::absMax(r) == 0) {
+            residualOut = 0;
+            iterationsOut = 0;
+            return true;
+        }
+
+        setMatrix(matrix);
+        return solve(rhs, result, residualOut, iterationsOut);
+    }
+
+    // Forms the preconditioner and fixed matrix so that several right hand
+    // sides can be solved against the same matrix without refactoring it
+    void setMatrix(const SparseMatrix<T> &matrix) {
+        formPreconditioner(matrix);
+        fixedMatrix.fromMatrix(matrix);
+    }
+
+    FixedSparseMatrix<T>& getFixedMatrix() {
+        return fixedMatrix;
+    }
+
+    // Solves against the matrix from the last setMatrix call
+    bool solve(const std::vector<T> &rhs, std::vector<T> &result, 
+               T &residualOut, int &iterationsOut) {
+
+        unsigned int n = fixedMatrix.n;
         if (m.size() != n) { 
             m.resize(n); 
             s.resize(n); 
@@ -285,7 +311,6 @@ struct PCGSolver {
         }
         double tol = toleranceFactor * residualOut;
 
-        formPreconditioner(matrix);
         applyPreconditioner(r, z);
         double rho = BLAS::dot(z, r);
         if (rho == 0 || rho != rho) {
@@ -294,7 +319,6 @@ struct PCGSolver {
         }
 
         s = z;
-        fixedMatrix.fromMatrix(matrix);
 
         int iteration;
         for (iteration = 0; iteration < maxIterations; iteration++){
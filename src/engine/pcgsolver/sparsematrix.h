@@ -170,11 +170,11 @@ struct FixedSparseMatrix {
 typedef FixedSparseMatrix<float> FixedSparseMatrixf;
 typedef FixedSparseMatrix<double> FixedSparseMatrixd;
 
-// perform result=matrix*x
-template<class T>
+// perform result=matrix*x, accumulating in the precision of x
+template<class T, class V>
 void _multiplyThread(int startidx, int endidx, 
                      FixedSparseMatrix<T> *matrix, 
-                     std::vector<T> *x, std::vector<T> *result) {
+                     std::vector<V> *x, std::vector<V> *result) {
     for(int i = startidx; i < endidx; i++){
         (*result)[i] = 0;
         for (size_t j = matrix->rowstart[i]; j < matrix->rowstart[i + 1]; j++){
@@ -183,8 +183,8 @@ void _multiplyThread(int startidx, int endidx,
     }
 }
 
-template<class T>
-void multiply(FixedSparseMatrix<T> &matrix, std::vector<T> &x, std::vector<T> &result) {
+template<class T, class V>
+void multiply(FixedSparseMatrix<T> &matrix, std::vector<V> &x, std::vector<V> &result) {
     FLUIDSIM_ASSERT(matrix.n == x.size());
     result.resize(matrix.n);
 
@@ -205,7 +205,7 @@ void multiply(FixedSparseMatrix<T> &matrix, std::vector<T> &x, std::vector<T> &r
     std::vector<std::thread> threads(numthreads);
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, matrix.n, numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&_multiplyThread<T>,
+        threads[i] = std::thread(&_multiplyThread<T, V>,
                                  intervals[i], intervals[i + 1], &matrix, &x, &result);
     }
 
@@ -23,9 +23,14 @@ SOFTWARE.
 */
 
 #include "polygonizer3d.h"
+
+#include <algorithm>
+
 #include "scalarfield.h"
 #include "grid3d.h"
-#include "meshlevelset.h"
+#include "trianglemesh.h"
+#include "fluidsimassert.h"
+#include "meshingboundarysdf.h"
 
 Polygonizer3d::Polygonizer3d() {
 }
@@ -45,7 +50,7 @@ Polygonizer3d::Polygonizer3d(ScalarField *scalarField) {
     _isScalarFieldSet = true;
 }
 
-Polygonizer3d::Polygonizer3d(ScalarField *scalarField, MeshLevelSet *solidSDF) {
+Polygonizer3d::Polygonizer3d(ScalarField *scalarField, MeshingBoundarySDF *solidSDF) {
     _scalarField = scalarField;
     _solidSDF = solidSDF;
 
@@ -363,107 +368,6 @@ vmath::vec3 Polygonizer3d::_getVertexPosition(GridIndex g) {
     return (float)_dx*vmath::vec3((float)g.i, (float)g.j, (float)g.k);
 }
 
-void Polygonizer3d::_findSurfaceCells(Array3d<bool> &isSurfaceCell) {
-
-    bool isEmpty = true;
-    for (int k = 0; k < _ksize + 1; k++) {
-        for (int j = 0; j < _jsize + 1; j++) {
-            for (int i = 0; i < _isize + 1; i++) {
-                if (_scalarField->getScalarFieldValue(i, j, k) > _surfaceThreshold) {
-                    isEmpty = false;
-                    goto endLoop;
-                }
-            }
-        }
-    }
-    endLoop:
-
-    if (isEmpty) {
-        return;
-    }
-
-    std::vector<GridIndex> workQueue({GridIndex(0, 0, 0),
-                                      GridIndex(1, 0, 0),
-                                      GridIndex(0, 1, 0),
-                                      GridIndex(1, 1, 0),
-                                      GridIndex(0, 0, 1),
-                                      GridIndex(1, 0, 1),
-                                      GridIndex(0, 1, 1),
-                                      GridIndex(1, 1, 1)});
-
-    int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, workQueue.size());
-    std::vector<std::thread> threads(numthreads);
-    FLUIDSIM_ASSERT(numthreads > 0);
-
-    Array3d<bool> hasInsideNode(_isize, _jsize, _ksize, false);
-    Array3d<bool> hasOutsideNode(_isize, _jsize, _ksize, false);
-
-    while (!workQueue.empty()) {
-
-        numthreads = (int)fmin(numCPU, workQueue.size());
-        for (int tidx = 0; tidx < numthreads; tidx++) {
-            GridIndex gridOffset = workQueue.back();
-            workQueue.pop_back();
-
-            threads[tidx] = std::thread(&Polygonizer3d::_getCellNodeStatusThread, this,
-                                        gridOffset, &hasInsideNode, &hasOutsideNode);
-        }
-
-        for (int tidx = 0; tidx < numthreads; tidx++) {
-            threads[tidx].join();
-        }
-    }
-
-    for (int k = 0; k < _ksize; k++) {
-        for (int j = 0; j < _jsize; j++) {
-            for (int i = 0; i < _isize; i++) {
-                if (hasInsideNode(i, j, k) && hasOutsideNode(i, j, k)) {
-                    isSurfaceCell.set(i, j, k, true);
-                }
-            }
-        }
-    }
-
-}
-
-void Polygonizer3d::_getCellNodeStatusThread(GridIndex gridOffset, 
-                                             Array3d<bool> *hasInsideNode, 
-                                             Array3d<bool> *hasOutsideNode) {
-
-    for (int k = 0; k < _ksize; k++) {
-        for (int j = 0; j < _jsize; j++) {
-            for (int i = 0; i < _isize; i++) {
-                double v = _scalarField->getScalarFieldValue(i + gridOffset.i,
-                                                             j + gridOffset.j,
-                                                             k + gridOffset.k);
-                if (v > _surfaceThreshold) {
-                    hasInsideNode->set(i, j, k, true);
-                } else {
-                    hasOutsideNode->set(i, j, k, true);
-                }
-            }
-        }
-    }
-}
-
-int Polygonizer3d::_calculateCubeIndex(GridIndex g) {
-    GridIndex vs[8];
-    Grid3d::getGridIndexVertices(g, vs);
-
-    int cubeIndex = 0;
-    if (_scalarField->getScalarFieldValue(vs[0]) > _surfaceThreshold) { cubeIndex |= 1; }
-    if (_scalarField->getScalarFieldValue(vs[1]) > _surfaceThreshold) { cubeIndex |= 2; }
-    if (_scalarField->getScalarFieldValue(vs[2]) > _surfaceThreshold) { cubeIndex |= 4; }
-    if (_scalarField->getScalarFieldValue(vs[3]) > _surfaceThreshold) { cubeIndex |= 8; }
-    if (_scalarField->getScalarFieldValue(vs[4]) > _surfaceThreshold) { cubeIndex |= 16; }
-    if (_scalarField->getScalarFieldValue(vs[5]) > _surfaceThreshold) { cubeIndex |= 32; }
-    if (_scalarField->getScalarFieldValue(vs[6]) > _surfaceThreshold) { cubeIndex |= 64; }
-    if (_scalarField->getScalarFieldValue(vs[7]) > _surfaceThreshold) { cubeIndex |= 128; }
-
-    return cubeIndex;
-}
-
 vmath::vec3 Polygonizer3d::_vertexInterp(vmath::vec3 p1, vmath::vec3 p2, 
                                          double valp1, double valp2) {
     double minmu = 0.0;
@@ -501,155 +405,162 @@ vmath::vec3 Polygonizer3d::_vertexInterp(vmath::vec3 p1, vmath::vec3 p2,
     return p1 + (float)mu*(p2 - p1);
 }
 
-void Polygonizer3d::_calculateVertexList(GridIndex g,
-                                         int cubeIndex, 
-                                         EdgeGrid &edges,
-                                         std::vector<vmath::vec3> &meshVertices,
-                                         int vertexList[12]) {
-    GridIndex vertices[8];
-    double values[8];
-    vmath::vec3 positions[8];
-    vmath::vec3 v;
-
-    Grid3d::getGridIndexVertices(g, vertices);
-    for (int i = 0; i < 8; i++) {
-        values[i] = _scalarField->getScalarFieldValue(vertices[i]);
-        positions[i] = _getVertexPosition(vertices[i]);
-    }
-
-    if (_edgeTable[cubeIndex] & 1) {
-        if (edges.U(vertices[0]) == -1) {
-            v = _vertexInterp(positions[0], positions[1], values[0], values[1]);
-            meshVertices.push_back(v);
-            edges.U.set(vertices[0], (int)meshVertices.size() - 1);
-        }
-        vertexList[0] = edges.U(vertices[0]);
-    }
-    if (_edgeTable[cubeIndex] & 2) {
-        if (edges.W(vertices[1]) == -1) {
-            v = _vertexInterp(positions[1], positions[2], values[1], values[2]);
-            meshVertices.push_back(v);
-            edges.W.set(vertices[1], (int)meshVertices.size() - 1);
-        }
-        vertexList[1] = edges.W(vertices[1]);
-    }
-    if (_edgeTable[cubeIndex] & 4) {
-        if (edges.U(vertices[3]) == -1) {
-            v = _vertexInterp(positions[2], positions[3], values[2], values[3]);
-            meshVertices.push_back(v);
-            edges.U.set(vertices[3], (int)meshVertices.size() - 1);
-        }
-        vertexList[2] = edges.U(vertices[3]);
-    }
-    if (_edgeTable[cubeIndex] & 8) {
-        if (edges.W(vertices[0]) == -1) {
-            v = _vertexInterp(positions[3], positions[0], values[3], values[0]);
-            meshVertices.push_back(v);
-            edges.W.set(vertices[0], (int)meshVertices.size() - 1);
-        }
-        vertexList[3] = edges.W(vertices[0]);
-    }
-    if (_edgeTable[cubeIndex] & 16) {
-        if (edges.U(vertices[4]) == -1) {
-            v = _vertexInterp(positions[4], positions[5], values[4], values[5]);
-            meshVertices.push_back(v);
-            edges.U.set(vertices[4], (int)meshVertices.size() - 1);
+void Polygonizer3d::_getNodeValuePlane(int k, std::vector<double> &values) {
+    int ni = _isize + 1;
+    for (int j = 0; j < _jsize + 1; j++) {
+        for (int i = 0; i < _isize + 1; i++) {
+            values[i + ni * j] = _scalarField->getScalarFieldValue(i, j, k);
         }
-        vertexList[4] = edges.U(vertices[4]);
-    }
-    if (_edgeTable[cubeIndex] & 32) {
-        if (edges.W(vertices[5]) == -1) {
-            v = _vertexInterp(positions[5], positions[6], values[5], values[6]);
-            meshVertices.push_back(v);
-            edges.W.set(vertices[5], (int)meshVertices.size() - 1);
-        }
-        vertexList[5] = edges.W(vertices[5]);
-    }
-    if (_edgeTable[cubeIndex] & 64) {
-        if (edges.U(vertices[7]) == -1) {
-            v = _vertexInterp(positions[6], positions[7], values[6], values[7]);
-            meshVertices.push_back(v);
-            edges.U.set(vertices[7], (int)meshVertices.size() - 1);
-        }
-        vertexList[6] = edges.U(vertices[7]);
-    }
-    if (_edgeTable[cubeIndex] & 128) {
-        if (edges.W(vertices[4]) == -1) {
-            v = _vertexInterp(positions[7], positions[4], values[7], values[4]);
-            meshVertices.push_back(v);
-            edges.W.set(vertices[4], (int)meshVertices.size() - 1);
-        }
-        vertexList[7] = edges.W(vertices[4]);
-    }
-    if (_edgeTable[cubeIndex] & 256) {
-        if (edges.V(vertices[0]) == -1) {
-            v = _vertexInterp(positions[0], positions[4], values[0], values[4]);
-            meshVertices.push_back(v);
-            edges.V.set(vertices[0], (int)meshVertices.size() - 1);
-        }
-        vertexList[8] = edges.V(vertices[0]);
-    }
-    if (_edgeTable[cubeIndex] & 512) {
-        if (edges.V(vertices[1]) == -1) {
-            v = _vertexInterp(positions[1], positions[5], values[1], values[5]);
-            meshVertices.push_back(v);
-            edges.V.set(vertices[1], (int)meshVertices.size() - 1);
-        }
-        vertexList[9] = edges.V(vertices[1]);
-    }
-    if (_edgeTable[cubeIndex] & 1024) {
-        if (edges.V(vertices[2]) == -1) {
-            v = _vertexInterp(positions[2], positions[6], values[2], values[6]);
-            meshVertices.push_back(v);
-            edges.V.set(vertices[2], (int)meshVertices.size() - 1);
-        }
-        vertexList[10] = edges.V(vertices[2]);
-    }
-    if (_edgeTable[cubeIndex] & 2048) {
-        if (edges.V(vertices[3]) == -1) {
-            v = _vertexInterp(positions[3], positions[7], values[3], values[7]);
-            meshVertices.push_back(v);
-            edges.V.set(vertices[3], (int)meshVertices.size() - 1);
-        }
-        vertexList[11] = edges.V(vertices[3]);
     }
 }
 
 // method of polygonizing a cell is adapted from:
 // http://paulbourke.net/geometry/polygonise/
-void Polygonizer3d::_polygonizeCell(GridIndex g,
-                                    EdgeGrid &edges, 
-                                    TriangleMesh &mesh) {
-
-    int cubeIndex = _calculateCubeIndex(g);
-
-    /* Cube is entirely in/out of the surface */
-    if (_edgeTable[cubeIndex] == 0) {
-        return;
+void Polygonizer3d::_polygonizeSlabThread(SlabMeshData *slab, bool isBottomPlaneShared) {
+    // Cell corner offsets in the order of Grid3d::getGridIndexVertices
+    const int cornerOffsets[8][3] = {
+        {0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1},
+        {0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}
+    };
+
+    // For each cell edge: the two interpolated corners, the edge direction 
+    // (0 = U, 1 = V, 2 = W), and the corner the edge is keyed by
+    const int edgeCorners[12][2] = {
+        {0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6}, 
+        {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}
+    };
+    const int edgeDirections[12] = {0, 2, 0, 2, 0, 2, 0, 2, 1, 1, 1, 1};
+    const int edgeKeyCorners[12] = {0, 1, 3, 0, 4, 5, 7, 4, 0, 1, 2, 3};
+
+    int ni = _isize + 1;
+    int usize = _isize * (_jsize + 1);
+    int vsize = (_isize + 1) * _jsize;
+    int wsize = (_isize + 1) * (_jsize + 1);
+
+    std::vector<int> bottomU(usize, -1);
+    std::vector<int> bottomV(vsize, -1);
+    std::vector<int> topU(usize, -1);
+    std::vector<int> topV(vsize, -1);
+    std::vector<int> edgesW(wsize, -1);
+    if (isBottomPlaneShared) {
+        for (int idx = 0; idx < usize; idx++) {
+            bottomU[idx] = -2 - idx;
+        }
+        for (int idx = 0; idx < vsize; idx++) {
+            bottomV[idx] = -2 - (usize + idx);
+        }
     }
 
+    std::vector<double> bottomValues(wsize);
+    std::vector<double> topValues(wsize);
+    _getNodeValuePlane(slab->kstart, bottomValues);
+
+    GridIndex vertices[8];
+    double values[8];
     int vertexList[12];
-    _calculateVertexList(g, cubeIndex, edges, mesh.vertices, vertexList);
+    for (int k = slab->kstart; k < slab->kend; k++) {
+        _getNodeValuePlane(k + 1, topValues);
+        std::fill(topU.begin(), topU.end(), -1);
+        std::fill(topV.begin(), topV.end(), -1);
+        std::fill(edgesW.begin(), edgesW.end(), -1);
 
-    for (int i = 0; _triTable[cubeIndex][i] != -1; i += 3) {
-        Triangle t = Triangle(vertexList[_triTable[cubeIndex][i]],
-                              vertexList[_triTable[cubeIndex][i + 1]],
-                              vertexList[_triTable[cubeIndex][i + 2]]);
+        for (int j = 0; j < _jsize; j++) {
+            for (int i = 0; i < _isize; i++) {
+                int cubeIndex = 0;
+                for (int cidx = 0; cidx < 8; cidx++) {
+                    const int *offset = cornerOffsets[cidx];
+                    int slot = (i + offset[0]) + ni * (j + offset[1]);
+                    values[cidx] = offset[2] == 0 ? bottomValues[slot] : topValues[slot];
+                    if (values[cidx] > _surfaceThreshold) {
+                        cubeIndex |= 1 << cidx;
+                    }
+                }
+
+                /* Cube is entirely in/out of the surface */
+                if (_edgeTable[cubeIndex] == 0) {
+                    continue;
+                }
+
+                for (int cidx = 0; cidx < 8; cidx++) {
+                    const int *offset = cornerOffsets[cidx];
+                    vertices[cidx] = GridIndex(i + offset[0], j + offset[1], k + offset[2]);
+                }
 
-        mesh.triangles.push_back(t);
+                for (int eidx = 0; eidx < 12; eidx++) {
+                    if (!(_edgeTable[cubeIndex] & (1 << eidx))) {
+                        continue;
+                    }
+
+                    GridIndex key = vertices[edgeKeyCorners[eidx]];
+                    bool isTop = key.k != k;
+                    int *edge;
+                    if (edgeDirections[eidx] == 0) {
+                        int slot = key.i + _isize * key.j;
+                        edge = isTop ? &(topU[slot]) : &(bottomU[slot]);
+                    } else if (edgeDirections[eidx] == 1) {
+                        int slot = key.i + ni * key.j;
+                        edge = isTop ? &(topV[slot]) : &(bottomV[slot]);
+                    } else {
+                        edge = &(edgesW[key.i + ni * key.j]);
+                    }
+
+                    if (*edge == -1) {
+                        int c1 = edgeCorners[eidx][0];
+                        int c2 = edgeCorners[eidx][1];
+                        vmath::vec3 p1 = _getVertexPosition(vertices[c1]);
+                        vmath::vec3 p2 = _getVertexPosition(vertices[c2]);
+                        slab->vertices.push_back(_vertexInterp(p1, p2, values[c1], values[c2]));
+                        *edge = (int)slab->vertices.size() - 1;
+                    }
+                    vertexList[eidx] = *edge;
+                }
+
+                for (int tidx = 0; _triTable[cubeIndex][tidx] != -1; tidx += 3) {
+                    slab->triangles.push_back(Triangle(vertexList[_triTable[cubeIndex][tidx]],
+                                                       vertexList[_triTable[cubeIndex][tidx + 1]],
+                                                       vertexList[_triTable[cubeIndex][tidx + 2]]));
+                }
+            }
+        }
+
+        bottomValues.swap(topValues);
+        bottomU.swap(topU);
+        bottomV.swap(topV);
     }
+
+    slab->topEdgesU.swap(bottomU);
+    slab->topEdgesV.swap(bottomV);
 }
 
-void Polygonizer3d::_calculateSurfaceTriangles(Array3d<bool> &isSurfaceCell,
-                                               TriangleMesh &mesh) {
-    EdgeGrid edges(_isize, _jsize, _ksize);
-    for (int k = 0; k < _ksize; k++) {
-        for (int j = 0; j < _jsize; j++) {
-            for (int i = 0; i < _isize; i++) {
-                if (isSurfaceCell(i, j, k)) {
-                    _polygonizeCell(GridIndex(i, j, k), edges, mesh);
+void Polygonizer3d::_mergeSlabMeshThread(int startidx, int endidx,
+                                         std::vector<SlabMeshData> *slabs,
+                                         std::vector<int> *vertexOffsets,
+                                         std::vector<int> *triangleOffsets,
+                                         TriangleMesh *mesh) {
+    int usize = _isize * (_jsize + 1);
+    for (int sidx = startidx; sidx < endidx; sidx++) {
+        SlabMeshData *slab = &(slabs->at(sidx));
+        int voffset = vertexOffsets->at(sidx);
+        std::copy(slab->vertices.begin(), slab->vertices.end(), mesh->vertices.begin() + voffset);
+
+        int toffset = triangleOffsets->at(sidx);
+        for (size_t tidx = 0; tidx < slab->triangles.size(); tidx++) {
+            Triangle t = slab->triangles[tidx];
+            for (int vidx = 0; vidx < 3; vidx++) {
+                int index = t.tri[vidx];
+                if (index >= 0) {
+                    t.tri[vidx] = index + voffset;
+                    continue;
                 }
+
+                // Edge vertex was created by the previous slab on its top plane
+                SlabMeshData *prev = &(slabs->at(sidx - 1));
+                int slot = -2 - index;
+                int previndex = slot < usize ? prev->topEdgesU[slot] : prev->topEdgesV[slot - usize];
+                FLUIDSIM_ASSERT(previndex >= 0);
+                t.tri[vidx] = previndex + vertexOffsets->at(sidx - 1);
             }
+            mesh->triangles[toffset + tidx] = t;
         }
     }
 }
@@ -666,11 +577,60 @@ void Polygonizer3d::setSurfaceCellMask(Array3d<bool> *mask) {
 TriangleMesh Polygonizer3d::polygonizeSurface() {
     FLUIDSIM_ASSERT(_isScalarFieldSet);
 
-    Array3d<bool> isSurfaceCell(_isize, _jsize, _ksize, false);
-    _findSurfaceCells(isSurfaceCell);
-
     TriangleMesh mesh;
-    _calculateSurfaceTriangles(isSurfaceCell, mesh);
+    if (_isize <= 0 || _jsize <= 0 || _ksize <= 0) {
+        return mesh;
+    }
+
+    // Cell layers are split into slabs that are polygonized independently. 
+    // Slabs are traversed in the same order as a full grid sweep so that 
+    // merged vertex and triangle order does not depend on the thread count.
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numslabs = (int)fmin(numCPU, _ksize);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _ksize, numslabs);
+    std::vector<SlabMeshData> slabs(numslabs);
+    std::vector<std::thread> threads(numslabs);
+    for (int i = 0; i < numslabs; i++) {
+        slabs[i].kstart = intervals[i];
+        slabs[i].kend = intervals[i + 1];
+        threads[i] = std::thread(&Polygonizer3d::_polygonizeSlabThread, this,
+                                 &(slabs[i]), i > 0);
+    }
+
+    for (int i = 0; i < numslabs; i++) {
+        threads[i].join();
+    }
+
+    std::vector<int> vertexOffsets(numslabs, 0);
+    std::vector<int> triangleOffsets(numslabs, 0);
+    int vertexCount = 0;
+    int triangleCount = 0;
+    for (int i = 0; i < numslabs; i++) {
+        vertexOffsets[i] = vertexCount;
+        triangleOffsets[i] = triangleCount;
+        vertexCount += (int)slabs[i].vertices.size();
+        triangleCount += (int)slabs[i].triangles.size();
+    }
+
+    if (triangleCount == 0) {
+        return mesh;
+    }
+
+    mesh.vertices.resize(vertexCount);
+    mesh.triangles.resize(triangleCount);
+
+    int numthreads = (int)fmin(numCPU, numslabs);
+    threads = std::vector<std::thread>(numthreads);
+    intervals = ThreadUtils::splitRangeIntoIntervals(0, numslabs, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&Polygonizer3d::_mergeSlabMeshThread, this,
+                                 intervals[i], intervals[i + 1], 
+                                 &slabs, &vertexOffsets, &triangleOffsets, &mesh);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
 
     return mesh;
-}
\ No newline at end of file
+}
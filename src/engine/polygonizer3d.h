@@ -30,20 +30,23 @@ SOFTWARE.
     #include <thread>
 #endif
 
+#include <vector>
+
 #include "threadutils.h"
 #include "array3d.h"
 #include "vmath.h"
+#include "triangle.h"
 
 class ScalarField;
 class TriangleMesh;
-class MeshLevelSet;
+class MeshingBoundarySDF;
 
 class Polygonizer3d
 {
 public:
     Polygonizer3d();
     Polygonizer3d(ScalarField *scalarField);
-    Polygonizer3d(ScalarField *scalarField, MeshLevelSet *solidSDF);
+    Polygonizer3d(ScalarField *scalarField, MeshingBoundarySDF *solidSDF);
 
     ~Polygonizer3d();
 
@@ -51,37 +54,31 @@ public:
     TriangleMesh polygonizeSurface();
 
 private:
-    struct EdgeGrid {
-        Array3d<int> U;         // store index to vertex
-        Array3d<int> V;
-        Array3d<int> W;
-
-        EdgeGrid() : U(Array3d<int>(0, 0, 0)),
-                     V(Array3d<int>(0, 0, 0)),
-                     W(Array3d<int>(0, 0, 0)) {}
-
-        EdgeGrid(int i, int j, int k) : 
-                     U(Array3d<int>(i, j + 1, k + 1, -1)),
-                     V(Array3d<int>(i + 1, j, k + 1, -1)),
-                     W(Array3d<int>(i + 1, j + 1, k, -1)) {}
+    /*
+        Edge vertex indices for a slab of cell layers are stored in slices: 
+        U and V edges for the bottom and top node planes of the current layer,
+        and W edges crossing the current layer. Triangles that reference an 
+        edge on the bottom plane of a slab owned by the previous slab store the
+        encoded edge slot (-2 - slot) until the slabs are merged.
+    */
+    struct SlabMeshData {
+        int kstart = 0;
+        int kend = 0;
+        std::vector<vmath::vec3> vertices;
+        std::vector<Triangle> triangles;
+        std::vector<int> topEdgesU;
+        std::vector<int> topEdgesV;
     };
 
     vmath::vec3 _getVertexPosition(GridIndex v);
-    double _getVertexFieldValue(GridIndex v);
-    void _polygonizeCell(GridIndex g, EdgeGrid &edges, TriangleMesh &mesh);
-    int _calculateCubeIndex(GridIndex g);
-    void _calculateVertexList(GridIndex g,
-                              int cubeIndex, 
-                              EdgeGrid &edges, 
-                              std::vector<vmath::vec3> &meshVertices, 
-                              int vertList[12]);
     vmath::vec3 _vertexInterp(vmath::vec3 p1, vmath::vec3 p2, double valp1, double valp2);
-    void _calculateSurfaceTriangles(Array3d<bool> &isSurfaceCell, TriangleMesh &mesh);
-    void _findSurfaceCells(Array3d<bool> &isSurfaceCell);
-    void _getCellNodeStatusThread(GridIndex gridOffset, 
-                                  Array3d<bool> *hasInsideNode, 
-                                  Array3d<bool> *hasOutsideNode);
-
+    void _getNodeValuePlane(int k, std::vector<double> &values);
+    void _polygonizeSlabThread(SlabMeshData *slab, bool isBottomPlaneShared);
+    void _mergeSlabMeshThread(int startidx, int endidx,
+                              std::vector<SlabMeshData> *slabs,
+                              std::vector<int> *vertexOffsets,
+                              std::vector<int> *triangleOffsets,
+                              TriangleMesh *mesh);
 
     static const int _edgeTable[256];
     static const int _triTable[256][16];
@@ -96,7 +93,7 @@ private:
     ScalarField *_scalarField;
     bool _isScalarFieldSet = false;
 
-    MeshLevelSet *_solidSDF;
+    MeshingBoundarySDF *_solidSDF;
     bool _isSolidSDFSet = false;
 
     Array3d<bool> *_surfaceCellMask;
@@ -75,15 +75,22 @@ bool PressureSolver::solve(PressureSolverParameters params) {
 
     std::vector<double> soln(_matSize, 0);
     for (size_t i = 0; i < soln.size(); i++) {
-        GridIndex g = _pressureCells[i];
+        GridIndex g = _pressureCells->at(i);
         float pressure = _pressureGrid->get(g);
         soln[i] = pressure;
     }
 
-    SparseMatrixd matrix(_matSize, 7);
-    _calculateMatrixCoefficients(matrix);
+    bool success = false;
+    if (_isMixedPrecisionEnabled) {
+        SparseMatrixf matrix(_matSize, 7);
+        _calculateMatrixCoefficients(matrix);
+        success = _solveLinearSystem(matrix, rhs, soln);
+    } else {
+        SparseMatrixd matrix(_matSize, 7);
+        _calculateMatrixCoefficients(matrix);
+        success = _solveLinearSystem(matrix, rhs, soln);
+    }
 
-    bool success = _solveLinearSystem(matrix, rhs, soln);
     if (!success) {
         return false;
     }
@@ -135,27 +142,16 @@ void PressureSolver::_initialize(PressureSolverParameters params) {
     _surfaceTensionConstant = params.surfaceTensionConstant;
     _curvatureGrid = params.curvatureGrid;
 
-    _pressureCells = GridIndexVector(_isize, _jsize, _ksize);
-    for(int k = 1; k < _ksize - 1; k++) {
-        for(int j = 1; j < _jsize - 1; j++) {
-            for(int i = 1; i < _isize - 1; i++) {
-                if(_liquidSDF->get(i, j, k) < 0) {
-                    _pressureCells.push_back(i, j, k);
-                }
-            }
-        }
-    }
-
-    _matSize = (int)_pressureCells.size();
+    _isMixedPrecisionEnabled = params.isMixedPrecisionEnabled;
+    _isIterativeRefinementEnabled = params.isIterativeRefinementEnabled;
 
-    _initializeGridIndexKeyMap();
-}
-
-void PressureSolver::_initializeGridIndexKeyMap() {
-    _keymap = GridIndexKeyMap(_isize, _jsize, _ksize);
-    for (unsigned int idx = 0; idx < _pressureCells.size(); idx++) {
-        _keymap.insert(_pressureCells[idx], idx);
+    _pressureCells = params.liquidCells;
+    if (_pressureCells == nullptr) {
+        _localPressureCells.update(*_liquidSDF, 1);
+        _pressureCells = &_localPressureCells;
     }
+
+    _matSize = (int)_pressureCells->size();
 }
 
 void PressureSolver::_conditionSolidVelocityField() {
@@ -607,9 +603,9 @@ void PressureSolver::_calculateSurfaceCellStatusThread(int startidx, int endidx,
 
 void PressureSolver::_calculateNegativeDivergenceVector(std::vector<double> &rhs) {
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, _pressureCells.size());
+    int numthreads = (int)fmin(numCPU, _pressureCells->size());
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _pressureCells.size(), 
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _pressureCells->size(), 
                                                                       numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&PressureSolver::_calculateNegativeDivergenceVectorThread, this,
@@ -627,7 +623,7 @@ void PressureSolver::_calculateNegativeDivergenceVectorThread(int startidx,
     double stfactor = _deltaTime / (_dx * _dx);
     double eps = 1e-9;
     for (int idx = startidx; idx < endidx; idx++) {
-        GridIndex g = _pressureCells[idx];
+        GridIndex g = _pressureCells->at(idx);
         int i = g.i;
         int j = g.j;
         int k = g.k;
@@ -748,15 +744,21 @@ double PressureSolver::_getSurfaceTensionTerm(GridIndex g1, GridIndex g2) {
     return _surfaceTensionConstant * curvature;
 }
 
-void PressureSolver::_calculateMatrixCoefficients(SparseMatrixd &matrix) {
+template <class T>
+void PressureSolver::_calculateMatrixCoefficients(SparseMatrix<T> &matrix) {
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, _pressureCells.size());
+    int numthreads = (int)fmin(numCPU, _pressureCells->size());
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _pressureCells.size(), 
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _pressureCells->size(), 
                                                                       numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&PressureSolver::_calculateMatrixCoefficientsThread, this,
-                                 intervals[i], intervals[i + 1], &matrix);
+        if (_densityGrid != nullptr) {
+            threads[i] = std::thread(&PressureSolver::_calculateMatrixCoefficientsThread<T, true>, this,
+                                     intervals[i], intervals[i + 1], &matrix);
+        } else {
+            threads[i] = std::thread(&PressureSolver::_calculateMatrixCoefficientsThread<T, false>, this,
+                                     intervals[i], intervals[i + 1], &matrix);
+        }
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -764,12 +766,13 @@ void PressureSolver::_calculateMatrixCoefficients(SparseMatrixd &matrix) {
     }
 }
 
+template <class T, bool IsVariableDensity>
 void PressureSolver::_calculateMatrixCoefficientsThread(int startidx, int endidx,
-                                                        SparseMatrixd *matrix) {
+                                                        SparseMatrix<T> *matrix) {
     double factor = _deltaTime / (_dx * _dx);
     double eps = 1e-9;
     for (int idx = startidx; idx < endidx; idx++) {
-        GridIndex g = _pressureCells[idx];
+        GridIndex g = _pressureCells->at(idx);
         int i = g.i;
         int j = g.j;
         int k = g.k;
@@ -782,13 +785,13 @@ void PressureSolver::_calculateMatrixCoefficientsThread(int startidx, int endidx
         GridIndex gFront( i, j,                                                     std::min(k + 1, _ksize - 1));
         GridIndex gBack(  i, j,                                                     std::max(k - 1, 0));
 
-        double rhoCenter = _densityGrid->get(g);
-        double rhoRight =  (rhoCenter + _densityGrid->get(gRight))  / 2.0;
-        double rhoLeft =   (rhoCenter + _densityGrid->get(gLeft))   / 2.0;
-        double rhoTop =    (rhoCenter + _densityGrid->get(gTop))    / 2.0;
-        double rhoBottom = (rhoCenter + _densityGrid->get(gBottom)) / 2.0;
-        double rhoFront =  (rhoCenter + _densityGrid->get(gFront))  / 2.0;
-        double rhoBack =   (rhoCenter + _densityGrid->get(gBack))   / 2.0;
+        double rhoCenter = _getDensity<IsVariableDensity>(g);
+        double rhoRight =  (rhoCenter + _getDensity<IsVariableDensity>(gRight))  / 2.0;
+        double rhoLeft =   (rhoCenter + _getDensity<IsVariableDensity>(gLeft))   / 2.0;
+        double rhoTop =    (rhoCenter + _getDensity<IsVariableDensity>(gTop))    / 2.0;
+        double rhoBottom = (rhoCenter + _getDensity<IsVariableDensity>(gBottom)) / 2.0;
+        double rhoFront =  (rhoCenter + _getDensity<IsVariableDensity>(gFront))  / 2.0;
+        double rhoBack =   (rhoCenter + _getDensity<IsVariableDensity>(gBack))   / 2.0;
 
         double volRight =  _weightGrid->U(i + 1, j,     k    );
         double volLeft =   _weightGrid->U(i,     j,     k    );
@@ -883,9 +886,23 @@ bool PressureSolver::_solveLinearSystem(SparseMatrixd &matrix, std::vector<doubl
         success = solver.solve(matrix, rhs, soln, estimatedError, numIterations);
     }
 
+    return _applyLinearSystemSolution(soln, success, numIterations, estimatedError);
+}
+
+bool PressureSolver::_solveLinearSystem(SparseMatrixf &matrix, std::vector<double> &rhs, 
+                                        std::vector<double> &soln) {
+    double estimatedError = -1.0f;
+    int numIterations = 0;
+    bool success = _solveLinearSystemMixedPrecision(matrix, rhs, soln, &numIterations, &estimatedError);
+
+    return _applyLinearSystemSolution(soln, success, numIterations, estimatedError);
+}
+
+bool PressureSolver::_applyLinearSystemSolution(std::vector<double> &soln, bool success, 
+                                                int numIterations, double estimatedError) {
     _pressureGrid->fill(0.0f);
-    for (size_t i = 0; i < _pressureCells.size(); i++) {
-        GridIndex g = _pressureCells[i];
+    for (size_t i = 0; i < _pressureCells->size(); i++) {
+        GridIndex g = _pressureCells->at(i);
         _pressureGrid->set(g, soln[i]);
     }
 
@@ -915,6 +932,76 @@ bool PressureSolver::_solveLinearSystem(SparseMatrixd &matrix, std::vector<doubl
     return retval;
 }
 
+bool PressureSolver::_solveLinearSystemMixedPrecision(SparseMatrixf &matrix, std::vector<double> &b, 
+                                                      std::vector<double> &x, int *iterations, double *error) {
+    unsigned int n = matrix.n;
+    PCGSolver<float> solver;
+    std::vector<float> bf(b.begin(), b.end());
+    std::vector<float> xf(x.begin(), x.end());
+
+    bool isRefinementRequired = _isIterativeRefinementEnabled && 
+                                _pressureSolveTolerance < _mixedPrecisionToleranceLimit;
+    if (!isRefinementRequired) {
+        float tolerance = (float)std::max(_pressureSolveTolerance, _mixedPrecisionToleranceLimit);
+        float residual = 0.0f;
+        solver.setSolverParameters(tolerance, _maxCGIterations);
+        bool success = solver.solve(matrix, bf, xf, residual, *iterations);
+        x.assign(xf.begin(), xf.end());
+        *error = residual;
+        return success;
+    }
+
+    // Iterative refinement: the residual is evaluated in double precision 
+    // and each single precision solve only has to reduce it by a factor 
+    // that single precision can resolve. The matrix is factored once and 
+    // reused for every correction solve.
+    solver.setMatrix(matrix);
+    FixedSparseMatrixf &fixedMatrix = solver.getFixedMatrix();
+    std::vector<double> product(n, 0.0);
+    std::vector<double> residual(n, 0.0);
+
+    double targetError = std::min(_pressureSolveTolerance * BLAS::absMax(b), 1.0);
+    double residualError = 0.0;
+    int totalIterations = 0;
+    bool success = false;
+    for (int step = 0; step <= _maxIterativeRefinementSteps; step++) {
+        multiply(fixedMatrix, x, product);
+        for (unsigned int i = 0; i < n; i++) {
+            residual[i] = b[i] - product[i];
+        }
+
+        residualError = BLAS::absMax(residual);
+        if (residualError <= targetError) {
+            success = true;
+            break;
+        }
+
+        if (step == _maxIterativeRefinementSteps || totalIterations >= _maxCGIterations) {
+            break;
+        }
+
+        for (unsigned int i = 0; i < n; i++) {
+            bf[i] = (float)residual[i];
+            xf[i] = 0.0f;
+        }
+
+        float stepTolerance = (float)std::max(targetError / residualError, _mixedPrecisionToleranceLimit);
+        float stepResidual = 0.0f;
+        int stepIterations = 0;
+        solver.setSolverParameters(stepTolerance, _maxCGIterations - totalIterations);
+        solver.solve(bf, xf, stepResidual, stepIterations);
+        totalIterations += stepIterations;
+
+        for (unsigned int i = 0; i < n; i++) {
+            x[i] += xf[i];
+        }
+    }
+
+    *iterations = totalIterations;
+    *error = residualError;
+    return success;
+}
+
 bool PressureSolver::_solveLinearSystemJacobi(SparseMatrixd &matrix, std::vector<double> &b, 
                                               std::vector<double> &x, int *iterations, double *error) {
     // Not currently supported for Apple systems
@@ -1035,8 +1122,13 @@ void PressureSolver::_applyPressureToVelocityFieldMT(FluidMaterialGrid &mgrid, i
     std::vector<std::thread> threads(numthreads);
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&PressureSolver::_applyPressureToVelocityFieldThread, this,
-                                 intervals[i], intervals[i + 1], &mgrid, dir);
+        if (_densityGrid != nullptr) {
+            threads[i] = std::thread(&PressureSolver::_applyPressureToVelocityFieldThread<true>, this,
+                                     intervals[i], intervals[i + 1], &mgrid, dir);
+        } else {
+            threads[i] = std::thread(&PressureSolver::_applyPressureToVelocityFieldThread<false>, this,
+                                     intervals[i], intervals[i + 1], &mgrid, dir);
+        }
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -1044,6 +1136,7 @@ void PressureSolver::_applyPressureToVelocityFieldMT(FluidMaterialGrid &mgrid, i
     }
 }
 
+template <bool IsVariableDensity>
 void PressureSolver::_applyPressureToVelocityFieldThread(int startidx, int endidx, 
                                                           FluidMaterialGrid *mgrid,
                                                           int dir) {
@@ -1091,7 +1184,7 @@ void PressureSolver::_applyPressureToVelocityFieldThread(int startidx, int endid
                     }
                 }
 
-                float rhoU = (_densityGrid->get(pi, pj, pk) + _densityGrid->get(pi + 1, pj, pk)) / 2.0f;
+                float rhoU = (_getDensity<IsVariableDensity>(pi, pj, pk) + _getDensity<IsVariableDensity>(pi + 1, pj, pk)) / 2.0f;
 
                 _vFieldFluid->addU(g, -factor * (p2 - p1) / rhoU);
                 _validVelocities->validU.set(g, true);
@@ -1142,7 +1235,7 @@ void PressureSolver::_applyPressureToVelocityFieldThread(int startidx, int endid
                     }
                 }
 
-                float rhoV = (_densityGrid->get(pi, pj, pk) + _densityGrid->get(pi, pj + 1, pk)) / 2.0f;
+                float rhoV = (_getDensity<IsVariableDensity>(pi, pj, pk) + _getDensity<IsVariableDensity>(pi, pj + 1, pk)) / 2.0f;
 
                 _vFieldFluid->addV(g, -factor * (p2 - p1) / rhoV);
                 _validVelocities->validV.set(g, true);
@@ -1192,7 +1285,7 @@ void PressureSolver::_applyPressureToVelocityFieldThread(int startidx, int endid
                     }
                 }
 
-                float rhoW = (_densityGrid->get(pi, pj, pk) + _densityGrid->get(pi, pj, pk + 1)) / 2.0f;
+                float rhoW = (_getDensity<IsVariableDensity>(pi, pj, pk) + _getDensity<IsVariableDensity>(pi, pj, pk + 1)) / 2.0f;
 
                 _vFieldFluid->addW(g, -factor * (p2 - p1) / rhoW);
                 _validVelocities->validW.set(g, true);
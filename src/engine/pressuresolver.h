@@ -35,8 +35,7 @@ SOFTWARE.
 #pragma once
 
 #include "pcgsolver/sparsematrix.h"
-#include "gridindexkeymap.h"
-#include "gridindexvector.h"
+#include "activecellindex.h"
 #include "fluidmaterialgrid.h"
 #include "vmath.h"
 #include "fluidsimassert.h"
@@ -109,7 +108,20 @@ struct PressureSolverParameters {
     Array3d<float> *liquidSDF;
     WeightGrid *weightGrid;
     Array3d<float> *pressureGrid;
-    Array3d<float> *densityGrid;
+
+    // Optional, a constant unit density is assumed if not set
+    Array3d<float> *densityGrid = nullptr;
+
+    // Optional, the liquidSDF cells with phi < 0 excluding the grid border.
+    // Built by the solver if not set
+    ActiveCellIndex *liquidCells = nullptr;
+
+    // Solve with a single precision matrix and vectors, accumulating 
+    // reductions in double precision. If the tolerance is beyond single 
+    // precision and refinement is enabled, the residual is recomputed in 
+    // double precision and the solution corrected until it converges
+    bool isMixedPrecisionEnabled = false;
+    bool isIterativeRefinementEnabled = true;
 
     bool isSurfaceTensionEnabled = false;
     double surfaceTensionConstant;
@@ -140,19 +152,19 @@ public:
 private:
 
     inline int _GridToVectorIndex(GridIndex g) {
-        return _keymap.find(g);
+        return _pressureCells->find(g);
     }
     inline int _GridToVectorIndex(int i, int j, int k) {
-        return _keymap.find(i, j, k);
+        return _pressureCells->find(i, j, k);
     }
     inline GridIndex _VectorToGridIndex(int i) {
-        return _pressureCells.at(i);
+        return _pressureCells->at(i);
     }
     inline int _isPressureCell(GridIndex g) {
-        return _keymap.find(g) != -1;
+        return _pressureCells->contains(g);
     }
     inline int _isPressureCell(int i, int j, int k) {
-        return _keymap.find(i, j, k) != -1;
+        return _pressureCells->contains(i, j, k);
     }
 
     template <typename T>
@@ -161,7 +173,6 @@ private:
     }
 
     void _initialize(PressureSolverParameters params);
-    void _initializeGridIndexKeyMap();
     void _conditionSolidVelocityField();
     void _computeBordersAirGridThread(int startidx, int endidx, 
                                       Array3d<bool> *bordersAir);
@@ -183,19 +194,41 @@ private:
     void _calculateNegativeDivergenceVectorThread(int startidx, 
                                                   int endidx, std::vector<double> *rhs);
     double _getSurfaceTensionTerm(GridIndex g1, GridIndex g2);
-    void _calculateMatrixCoefficients(SparseMatrixd &matrix);
+    template <class T>
+    void _calculateMatrixCoefficients(SparseMatrix<T> &matrix);
+    template <class T, bool IsVariableDensity>
     void _calculateMatrixCoefficientsThread(int startidx, int endidx,
-                                            SparseMatrixd *matrix);
+                                            SparseMatrix<T> *matrix);
     bool _solveLinearSystem(SparseMatrixd &matrix, std::vector<double> &rhs, 
                             std::vector<double> &soln);
+    bool _solveLinearSystem(SparseMatrixf &matrix, std::vector<double> &rhs, 
+                            std::vector<double> &soln);
+    bool _applyLinearSystemSolution(std::vector<double> &soln, bool success, 
+                                    int numIterations, double estimatedError);
 
     bool _solveLinearSystemJacobi(SparseMatrixd &matrix, std::vector<double> &b, 
                                   std::vector<double> &x, int *iterations, double *error);
+    bool _solveLinearSystemMixedPrecision(SparseMatrixf &matrix, std::vector<double> &b, 
+                                          std::vector<double> &x, int *iterations, double *error);
 
     void _applyPressureToVelocityFieldMT(FluidMaterialGrid &mgrid, int dir);
+    template <bool IsVariableDensity>
     void _applyPressureToVelocityFieldThread(int startidx, int endidx,
                                              FluidMaterialGrid *mgrid, int dir);
 
+    template <bool IsVariableDensity>
+    inline float _getDensity(int i, int j, int k) {
+        if constexpr (IsVariableDensity) {
+            return _densityGrid->get(i, j, k);
+        } else {
+            return 1.0f;
+        }
+    }
+    template <bool IsVariableDensity>
+    inline float _getDensity(GridIndex g) {
+        return _getDensity<IsVariableDensity>(g.i, g.j, g.k);
+    }
+
     
     int _isize = 0;
     int _jsize = 0;
@@ -210,21 +243,26 @@ private:
     int _surfaceTensionClusterThreshold = 36;
     int _blockwidth = 4;
 
+    bool _isMixedPrecisionEnabled = false;
+    bool _isIterativeRefinementEnabled = true;
+    double _mixedPrecisionToleranceLimit = 1e-5;
+    int _maxIterativeRefinementSteps = 5;
+
     MACVelocityField *_vFieldFluid;
     MACVelocityField *_vFieldSolid;
     ValidVelocityComponentGrid *_validVelocities;
     Array3d<float> *_liquidSDF;
     WeightGrid *_weightGrid;
     Array3d<float> *_pressureGrid;
-    Array3d<float> *_densityGrid;
+    Array3d<float> *_densityGrid = nullptr;
 
     bool _isSurfaceTensionEnabled = false;
     double _surfaceTensionConstant;
     Array3d<float> *_curvatureGrid;
 
-    GridIndexVector _pressureCells;
+    ActiveCellIndex *_pressureCells = nullptr;
+    ActiveCellIndex _localPressureCells;
     int _matSize = 0;
-    GridIndexKeyMap _keymap;
     Array3d<char> _surfaceTensionClusterStatus;
 
     std::string _solverStatus;
@@ -28,7 +28,7 @@ SOFTWARE.
 #include "fluidsimassert.h"
 #include "grid3d.h"
 #include "fluidmaterialgrid.h"
-#include "meshlevelset.h"
+#include "meshingboundarysdf.h"
 
 ScalarField::ScalarField() {
 }
@@ -369,7 +369,7 @@ void ScalarField::setMaterialGrid(FluidMaterialGrid &matGrid) {
     }
 }
 
-void ScalarField::setSolidSDF(MeshLevelSet &solidSDF) {
+void ScalarField::setSolidSDF(MeshingBoundarySDF &solidSDF) {
     int si, sj, sk;
     solidSDF.getGridDimensions(&si, &sj, &sk);
     double sdx = solidSDF.getCellSize();
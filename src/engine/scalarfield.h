@@ -28,7 +28,7 @@ SOFTWARE.
 #include "array3d.h"
 
 class FluidMaterialGrid;
-class MeshLevelSet;
+class MeshingBoundarySDF;
 class GridIndexVector;
 
 class ScalarField
@@ -65,7 +65,7 @@ public:
     void addEllipsoidValue(vmath::vec3 p, vmath::mat3 G, double value);
     void setMaterialGrid(FluidMaterialGrid &matGrid);
     void setMaterialGrid(GridIndexVector &solidCells);
-    void setSolidSDF(MeshLevelSet &solidSDF);
+    void setSolidSDF(MeshingBoundarySDF &solidSDF);
     void setSolidCells(GridIndexVector &solidCells);
     void getScalarField(Array3d<float> &field);
     double getScalarFieldValue(GridIndex g);
@@ -27,19 +27,25 @@ SOFTWARE.
 #include <algorithm>
 
 #include "grid3d.h"
+#include "threadutils.h"
 
 SpatialPointGrid::SpatialPointGrid() {
 }
 
 SpatialPointGrid::SpatialPointGrid(int isize, int jsize, int ksize, double dx) :
                                         _isize(isize), _jsize(jsize), _ksize(ksize), _dx(dx),
-                                        _grid(_isize, _jsize, _ksize),
                                         _bbox(vmath::vec3(), _dx*_isize, _dx*_jsize, _dx*_ksize) {
 }
 
 SpatialPointGrid::~SpatialPointGrid() {
 }
 
+void SpatialPointGrid::getGridDimensions(int *i, int *j, int *k) {
+    *i = _isize;
+    *j = _jsize;
+    *k = _ksize;
+}
+
 void SpatialPointGrid::clear() {
     _gridPoints.clear();
     _gridPoints.shrink_to_fit();
@@ -47,16 +53,21 @@ void SpatialPointGrid::clear() {
     _refIDToGridPointIndexTable.clear();
     _refIDToGridPointIndexTable.shrink_to_fit();
 
-    _grid.fill(CellNode());
+    _cellStart.clear();
+    _cellStart.shrink_to_fit();
+
+    _pointCellIndices.clear();
+    _pointCellIndices.shrink_to_fit();
 }
 
 std::vector<GridPointReference> SpatialPointGrid::insert(std::vector<vmath::vec3> &points) {
-    clear();
-
     std::vector<GridPointReference> referenceList;
-    _sortGridPointsByGridIndex(points, _gridPoints, referenceList);
-    _updateRefIDToGridPointIndexTable();
-    _insertCellNodesIntoGrid();
+    referenceList.reserve(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        referenceList.push_back(GridPointReference((int)i));
+    }
+
+    _buildCellList(points);
 
     return referenceList;
 }
@@ -72,10 +83,6 @@ std::vector<GridPointReference> SpatialPointGrid::insert(FragmentedVector<vmath:
     return insert(vps);
 }
 
-bool compareByFlatGridIndex(const std::pair<GridPoint, unsigned int> p1, const std::pair<GridPoint, unsigned int> p2) {
-    return p1.second < p2.second;
-}
-
 void SpatialPointGrid::queryPointsInsideSphere(vmath::vec3 p, double r, std::vector<vmath::vec3> &points) {
     _queryPointsInsideSphere(p, r, -1, points);
 }
@@ -132,24 +139,35 @@ void SpatialPointGrid::queryPointReferencesInsideSphere(GridPointReference ref,
     _queryPointReferencesInsideSphere(gp.position, r, exclusions, refs);
 }
 
+void SpatialPointGrid::queryPointReferencesInsideSphere(int startid, int endid, double r, 
+                                                        std::vector<int> &offsets, 
+                                                        std::vector<GridPointReference> &refs) {
+    FLUIDSIM_ASSERT(startid >= 0 && endid <= (int)_gridPoints.size());
+
+    offsets.clear();
+    refs.clear();
+    offsets.push_back(0);
+    for (int id = startid; id < endid; id++) {
+        GridPoint gp = _gridPoints[_refIDToGridPointIndexTable[id]];
+        _queryPointReferencesInsideSphere(gp.position, r, gp.ref.id, refs);
+        offsets.push_back((int)refs.size());
+    }
+}
+
 void SpatialPointGrid::queryPointsInsideAABB(AABB bbox, std::vector<vmath::vec3> &points) {
     GridIndex gmin, gmax;
     Grid3d::getGridIndexBounds(bbox, _dx, _isize, _jsize, _ksize, &gmin, &gmax);
 
     vmath::vec3 v;
     GridPoint gp;
-    CellNode node;
     for (int k = gmin.k; k <= gmax.k; k++) {
         for (int j = gmin.j; j <= gmax.j; j++) {
-            for (int i = gmin.i; i <= gmax.i; i++) {
-                if (_grid(i, j, k).count > 0) {
-                    node = _grid(i, j, k);
-                    for (int idx = node.start; idx < node.start + node.count; idx++) {
-                        gp = _gridPoints[idx];
-                        if (bbox.isPointInside(gp.position)) {
-                            points.push_back(gp.position);
-                        }
-                    }
+            int rowstart = _cellStart[_getFlatIndex(gmin.i, j, k)];
+            int rowend = _cellStart[_getFlatIndex(gmax.i, j, k) + 1];
+            for (int idx = rowstart; idx < rowend; idx++) {
+                gp = _gridPoints[idx];
+                if (bbox.isPointInside(gp.position)) {
+                    points.push_back(gp.position);
                 }
             }
         }
@@ -162,18 +180,14 @@ void SpatialPointGrid::queryPointReferencesInsideAABB(AABB bbox, std::vector<Gri
 
     vmath::vec3 v;
     GridPoint gp;
-    CellNode node;
     for (int k = gmin.k; k <= gmax.k; k++) {
         for (int j = gmin.j; j <= gmax.j; j++) {
-            for (int i = gmin.i; i <= gmax.i; i++) {
-                if (_grid(i, j, k).count > 0) {
-                    node = _grid(i, j, k);
-                    for (int idx = node.start; idx < node.start + node.count; idx++) {
-                        gp = _gridPoints[idx];
-                        if (bbox.isPointInside(gp.position)) {
-                            refs.push_back(gp.ref);
-                        }
-                    }
+            int rowstart = _cellStart[_getFlatIndex(gmin.i, j, k)];
+            int rowend = _cellStart[_getFlatIndex(gmax.i, j, k) + 1];
+            for (int idx = rowstart; idx < rowend; idx++) {
+                gp = _gridPoints[idx];
+                if (bbox.isPointInside(gp.position)) {
+                    refs.push_back(gp.ref);
                 }
             }
         }
@@ -261,79 +275,111 @@ void SpatialPointGrid::getConnectedPointReferenceComponents(double radius,
 }
 
 
-void SpatialPointGrid::_sortGridPointsByGridIndex(std::vector<vmath::vec3> &points,
-                                                  std::vector<GridPoint> &sortedPoints,
-                                                  std::vector<GridPointReference> &refList) {
+void SpatialPointGrid::_buildCellList(std::vector<vmath::vec3> &points) {
+    // Counting sort of the points by flat cell index. Each thread counts 
+    // its own interval of points so that the scatter keeps points in 
+    // index order within a cell
+    size_t numPoints = points.size();
+    size_t numCells = (size_t)_isize * (size_t)_jsize * (size_t)_ksize;
+    _pointCellIndices.resize(numPoints);
+    _gridPoints.resize(numPoints);
+    _refIDToGridPointIndexTable.resize(numPoints);
+    _cellStart.assign(numCells + 1, 0);
+
+    // A histogram spans the whole grid, so the number of histograms is 
+    // limited to keep their memory proportional to the number of points
+    size_t maxHistograms = std::max((size_t)1, (4 * numPoints) / std::max((size_t)1, numCells));
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(fmin(numCPU, numPoints), maxHistograms);
+    numthreads = std::max(numthreads, 1);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numPoints, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&SpatialPointGrid::_computeCellIndicesThread, this,
+                                 intervals[i], intervals[i + 1], &points);
+    }
 
-    std::pair<GridPoint, unsigned int> pair;
-    std::vector<std::pair<GridPoint, unsigned int> > pointIndexPairs;
-    pointIndexPairs.reserve(points.size());
-    refList.reserve(points.size());
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
 
-    GridPoint gp;
-    GridPointReference ref;
-    unsigned int flatIndex;
-    for (unsigned int i = 0; i < points.size(); i++) {
-        FLUIDSIM_ASSERT(_bbox.isPointInside(points[i]));
+    std::vector<std::vector<int> > histograms(numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&SpatialPointGrid::_countCellPointsThread, this,
+                                 intervals[i], intervals[i + 1], &(histograms[i]));
+    }
 
-        ref = GridPointReference(i);
-        gp = GridPoint(points[i], ref);
-        flatIndex = _getFlatIndex(Grid3d::positionToGridIndex(points[i], _dx));
-        pair = std::pair<GridPoint, unsigned int>(gp, flatIndex);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
 
-        pointIndexPairs.push_back(pair);
-        refList.push_back(ref);
+    // Histogram counts are replaced with each thread's offset into a cell 
+    // and _cellStart[c] is set to the number of points in cell c
+    std::vector<int> cellIntervals = ThreadUtils::splitRangeIntoIntervals(0, numCells, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&SpatialPointGrid::_computeCellOffsetsThread, this,
+                                 cellIntervals[i], cellIntervals[i + 1], &histograms);
     }
 
-    std::sort(pointIndexPairs.begin(), pointIndexPairs.end(), compareByFlatGridIndex);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
 
-    sortedPoints.reserve(points.size());
-    for (unsigned int i = 0; i < pointIndexPairs.size(); i++) {
-        sortedPoints.push_back(pointIndexPairs[i].first);
+    int sum = 0;
+    for (size_t i = 0; i < numCells; i++) {
+        int count = _cellStart[i];
+        _cellStart[i] = sum;
+        sum += count;
     }
-}
+    _cellStart[numCells] = sum;
 
-void SpatialPointGrid::_updateRefIDToGridPointIndexTable() {
-    _refIDToGridPointIndexTable.clear();
-    _refIDToGridPointIndexTable.shrink_to_fit();
-    _refIDToGridPointIndexTable = std::vector<int>(_gridPoints.size(), -1);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&SpatialPointGrid::_insertGridPointsThread, this,
+                                 intervals[i], intervals[i + 1], &points, &(histograms[i]));
+    }
 
-    GridPoint gp;
-    for (unsigned int i = 0; i < _gridPoints.size(); i++) {
-        gp = _gridPoints[i];
-        FLUIDSIM_ASSERT(gp.ref.id >= 0 && gp.ref.id < (int)_gridPoints.size());
-        _refIDToGridPointIndexTable[gp.ref.id] = i;
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
     }
 }
 
-void SpatialPointGrid::_insertCellNodesIntoGrid() {
-    GridPoint gp;
-    GridIndex g;
-    for (unsigned int idx = 0; idx < _gridPoints.size(); idx++) {
-        gp = _gridPoints[idx];
-        g = Grid3d::positionToGridIndex(gp.position, _dx);
-
-        if (_grid(g).start == -1) {
-            int start = idx;
-            int count = 0;
-
-            while (idx < _gridPoints.size()) {
-                count++;
-                idx++;
-
-                if (idx == _gridPoints.size()) {
-                    break;
-                }
+void SpatialPointGrid::_computeCellIndicesThread(int startidx, int endidx, 
+                                                 std::vector<vmath::vec3> *points) {
+    for (int i = startidx; i < endidx; i++) {
+        FLUIDSIM_ASSERT(_bbox.isPointInside(points->at(i)));
+        _pointCellIndices[i] = _getFlatIndex(Grid3d::positionToGridIndex(points->at(i), _dx));
+    }
+}
 
-                gp = _gridPoints[idx];
-                if (Grid3d::positionToGridIndex(gp.position, _dx) != g) {
-                    idx--;
-                    break;
-                }
-            }
+void SpatialPointGrid::_countCellPointsThread(int startidx, int endidx, 
+                                              std::vector<int> *histogram) {
+    histogram->assign((size_t)_isize * (size_t)_jsize * (size_t)_ksize, 0);
+    for (int i = startidx; i < endidx; i++) {
+        (*histogram)[_pointCellIndices[i]]++;
+    }
+}
 
-            _grid.set(g, CellNode(start, count));
+void SpatialPointGrid::_computeCellOffsetsThread(int startidx, int endidx, 
+                                                 std::vector<std::vector<int> > *histograms) {
+    for (int c = startidx; c < endidx; c++) {
+        int sum = 0;
+        for (size_t t = 0; t < histograms->size(); t++) {
+            int count = (*histograms)[t][c];
+            (*histograms)[t][c] = sum;
+            sum += count;
         }
+        _cellStart[c] = sum;
+    }
+}
+
+void SpatialPointGrid::_insertGridPointsThread(int startidx, int endidx, 
+                                               std::vector<vmath::vec3> *points,
+                                               std::vector<int> *offsets) {
+    for (int i = startidx; i < endidx; i++) {
+        unsigned int c = _pointCellIndices[i];
+        int idx = _cellStart[c] + (*offsets)[c]++;
+        _refIDToGridPointIndexTable[i] = idx;
+        _gridPoints[idx] = GridPoint(points->at(i), GridPointReference(i));
     }
 }
 
@@ -346,21 +392,17 @@ void SpatialPointGrid::_queryPointsInsideSphere(vmath::vec3 p, double r, int ref
     double distsq;
     vmath::vec3 v;
     GridPoint gp;
-    CellNode node;
     for (int k = gmin.k; k <= gmax.k; k++) {
         for (int j = gmin.j; j <= gmax.j; j++) {
-            for (int i = gmin.i; i <= gmax.i; i++) {
-                if (_grid(i, j, k).count > 0) {
-                    node = _grid(i, j, k);
-                    for (int idx = node.start; idx < node.start + node.count; idx++) {
-                        gp = _gridPoints[idx];
-                        if (gp.ref.id != refID) {
-                            v = gp.position - p;
-                            distsq = vmath::dot(v, v);
-                            if (distsq < maxdistsq) {
-                                points.push_back(gp.position);
-                            }
-                        }
+            int rowstart = _cellStart[_getFlatIndex(gmin.i, j, k)];
+            int rowend = _cellStart[_getFlatIndex(gmax.i, j, k) + 1];
+            for (int idx = rowstart; idx < rowend; idx++) {
+                gp = _gridPoints[idx];
+                if (gp.ref.id != refID) {
+                    v = gp.position - p;
+                    distsq = vmath::dot(v, v);
+                    if (distsq < maxdistsq) {
+                        points.push_back(gp.position);
                     }
                 }
             }
@@ -380,21 +422,17 @@ void SpatialPointGrid::_queryPointsInsideSphere(vmath::vec3 p, double r,
     double distsq;
     vmath::vec3 v;
     GridPoint gp;
-    CellNode node;
     for (int k = gmin.k; k <= gmax.k; k++) {
         for (int j = gmin.j; j <= gmax.j; j++) {
-            for (int i = gmin.i; i <= gmax.i; i++) {
-                if (_grid(i, j, k).count > 0) {
-                    node = _grid(i, j, k);
-                    for (int idx = node.start; idx < node.start + node.count; idx++) {
-                        gp = _gridPoints[idx];
-                        if (!exclusions[gp.ref.id]) {
-                            v = gp.position - p;
-                            distsq = vmath::dot(v, v);
-                            if (distsq < maxdistsq) {
-                                points.push_back(gp.position);
-                            }
-                        }
+            int rowstart = _cellStart[_getFlatIndex(gmin.i, j, k)];
+            int rowend = _cellStart[_getFlatIndex(gmax.i, j, k) + 1];
+            for (int idx = rowstart; idx < rowend; idx++) {
+                gp = _gridPoints[idx];
+                if (!exclusions[gp.ref.id]) {
+                    v = gp.position - p;
+                    distsq = vmath::dot(v, v);
+                    if (distsq < maxdistsq) {
+                        points.push_back(gp.position);
                     }
                 }
             }
@@ -411,21 +449,17 @@ void SpatialPointGrid::_queryPointReferencesInsideSphere(vmath::vec3 p, double r
     double distsq;
     vmath::vec3 v;
     GridPoint gp;
-    CellNode node;
     for (int k = gmin.k; k <= gmax.k; k++) {
         for (int j = gmin.j; j <= gmax.j; j++) {
-            for (int i = gmin.i; i <= gmax.i; i++) {
-                if (_grid(i, j, k).count > 0) {
-                    node = _grid(i, j, k);
-                    for (int idx = node.start; idx < node.start + node.count; idx++) {
-                        gp = _gridPoints[idx];
-                        if (gp.ref.id != refID) {
-                            v = gp.position - p;
-                            distsq = vmath::dot(v, v);
-                            if (distsq < maxdistsq) {
-                                refs.push_back(gp.ref);
-                            }
-                        }
+            int rowstart = _cellStart[_getFlatIndex(gmin.i, j, k)];
+            int rowend = _cellStart[_getFlatIndex(gmax.i, j, k) + 1];
+            for (int idx = rowstart; idx < rowend; idx++) {
+                gp = _gridPoints[idx];
+                if (gp.ref.id != refID) {
+                    v = gp.position - p;
+                    distsq = vmath::dot(v, v);
+                    if (distsq < maxdistsq) {
+                        refs.push_back(gp.ref);
                     }
                 }
             }
@@ -445,21 +479,17 @@ void SpatialPointGrid::_queryPointReferencesInsideSphere(vmath::vec3 p, double r
     double distsq;
     vmath::vec3 v;
     GridPoint gp;
-    CellNode node;
     for (int k = gmin.k; k <= gmax.k; k++) {
         for (int j = gmin.j; j <= gmax.j; j++) {
-            for (int i = gmin.i; i <= gmax.i; i++) {
-                if (_grid(i, j, k).count > 0) {
-                    node = _grid(i, j, k);
-                    for (int idx = node.start; idx < node.start + node.count; idx++) {
-                        gp = _gridPoints[idx];
-                        if (!exclusions[gp.ref.id]) {
-                            v = gp.position - p;
-                            distsq = vmath::dot(v, v);
-                            if (distsq < maxdistsq) {
-                                refs.push_back(gp.ref);
-                            }
-                        }
+            int rowstart = _cellStart[_getFlatIndex(gmin.i, j, k)];
+            int rowend = _cellStart[_getFlatIndex(gmax.i, j, k) + 1];
+            for (int idx = rowstart; idx < rowend; idx++) {
+                gp = _gridPoints[idx];
+                if (!exclusions[gp.ref.id]) {
+                    v = gp.position - p;
+                    distsq = vmath::dot(v, v);
+                    if (distsq < maxdistsq) {
+                        refs.push_back(gp.ref);
                     }
                 }
             }
@@ -58,6 +58,7 @@ public:
     SpatialPointGrid(int isize, int jsize, int ksize, double _dx);
     ~SpatialPointGrid();
 
+    void getGridDimensions(int *i, int *j, int *k);
     void clear();
     std::vector<GridPointReference> insert(std::vector<vmath::vec3> &points);
     std::vector<GridPointReference> insert(FragmentedVector<vmath::vec3> &points);
@@ -78,6 +79,14 @@ public:
                                           std::vector<bool> &exclusions,
                                           std::vector<GridPointReference> &refs);
 
+    // Batched query for the points with reference IDs in [startid, endid). 
+    // The references within radius r of point startid + n, excluding itself, 
+    // are written to refs[offsets[n]] to refs[offsets[n + 1] - 1]. Buffers are 
+    // cleared but keep their capacity so that they can be reused between batches.
+    void queryPointReferencesInsideSphere(int startid, int endid, double r, 
+                                          std::vector<int> &offsets, 
+                                          std::vector<GridPointReference> &refs);
+
     void queryPointsInsideAABB(AABB bbox, std::vector<vmath::vec3> &points);
     void queryPointReferencesInsideAABB(AABB bbox, std::vector<GridPointReference> &refs);
 
@@ -92,14 +101,6 @@ public:
 
 private:
 
-    struct CellNode {
-        int start;
-        int count;
-
-        CellNode() : start(-1), count(-1) {}
-        CellNode(int startIndex, int numPoints) : start(startIndex), count(numPoints) {}
-    };
-
     inline unsigned int _getFlatIndex(int i, int j, int k) {
         return (unsigned int)i + (unsigned int)_isize *
                ((unsigned int)j + (unsigned int)_jsize * (unsigned int)k);
@@ -110,11 +111,16 @@ private:
                ((unsigned int)g.j + (unsigned int)_jsize * (unsigned int)g.k);
     }
 
-    void _sortGridPointsByGridIndex(std::vector<vmath::vec3> &points,
-                                    std::vector<GridPoint> &sortedPoints,
-                                    std::vector<GridPointReference> &refList);
-    void _updateRefIDToGridPointIndexTable();
-    void _insertCellNodesIntoGrid();
+    void _buildCellList(std::vector<vmath::vec3> &points);
+    void _computeCellIndicesThread(int startidx, int endidx, 
+                                   std::vector<vmath::vec3> *points);
+    void _countCellPointsThread(int startidx, int endidx, 
+                                std::vector<int> *histogram);
+    void _computeCellOffsetsThread(int startidx, int endidx, 
+                                   std::vector<std::vector<int> > *histograms);
+    void _insertGridPointsThread(int startidx, int endidx, 
+                                 std::vector<vmath::vec3> *points,
+                                 std::vector<int> *offsets);
     void _queryPointsInsideSphere(vmath::vec3 p, double r, int refID, std::vector<vmath::vec3> &points);
     void _queryPointsInsideSphere(vmath::vec3 p, double r, 
                                   std::vector<bool> &exclusions, 
@@ -134,8 +140,12 @@ private:
     int _ksize = 0;
     double _dx = 0.0;
 
+    // Points are stored sorted by flat cell index so that a row of cells 
+    // maps to a contiguous range. The points within cell c are 
+    // _gridPoints[_cellStart[c]] to _gridPoints[_cellStart[c + 1] - 1]
     std::vector<GridPoint> _gridPoints;
     std::vector<int> _refIDToGridPointIndexTable;
-    Array3d<CellNode> _grid;
+    std::vector<int> _cellStart;
+    std::vector<unsigned int> _pointCellIndices;
     AABB _bbox;
 };
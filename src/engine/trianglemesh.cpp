@@ -30,6 +30,7 @@ SOFTWARE.
 
 #include "fluidsimassert.h"
 #include "spatialpointgrid.h"
+#include "threadutils.h"
 
 TriangleMesh::TriangleMesh() {
 }
@@ -48,7 +49,7 @@ int TriangleMesh::numTriangles() {
 void TriangleMesh::clear() {
     vertices.clear();
     triangles.clear();
-    _vertexTriangles.clear();
+    _clearVertexTriangles();
 }
 
 bool TriangleMesh::loadPLY(std::string PLYFilename) {
@@ -301,20 +302,20 @@ void TriangleMesh::getFaceNeighbours(unsigned int tidx, std::vector<int> &n) {
 }
 
 void TriangleMesh::getFaceNeighbours(Triangle t, std::vector<int> &n) {
-    FLUIDSIM_ASSERT(vertices.size() == _vertexTriangles.size());
+    FLUIDSIM_ASSERT(vertices.size() + 1 == _vertexTriangleOffsets.size());
 
-    std::vector<int> vn;
     for (int i = 1; i < 3; i++) {
-        vn = _vertexTriangles[t.tri[i]];
-        n.insert(n.end(), vn.begin(), vn.end());
+        int vidx = t.tri[i];
+        n.insert(n.end(), _vertexTriangles.begin() + _vertexTriangleOffsets[vidx], 
+                          _vertexTriangles.begin() + _vertexTriangleOffsets[vidx + 1]);
     }
 }
 
 void TriangleMesh::getVertexNeighbours(unsigned int vidx, std::vector<int> &n) {
-    FLUIDSIM_ASSERT(vertices.size() == _vertexTriangles.size());
+    FLUIDSIM_ASSERT(vertices.size() + 1 == _vertexTriangleOffsets.size());
     FLUIDSIM_ASSERT(vidx < vertices.size());
-    std::vector<int> vn = _vertexTriangles[vidx];
-    n.insert(n.end(), vn.begin(), vn.end());
+    n.insert(n.end(), _vertexTriangles.begin() + _vertexTriangleOffsets[vidx], 
+                      _vertexTriangles.begin() + _vertexTriangleOffsets[vidx + 1]);
 }
 
 std::vector<bool> TriangleMesh::getManifoldVertexList() {
@@ -546,25 +547,124 @@ bool TriangleMesh::_loadPLYTriangleData(std::ifstream *file, std::string &header
 }
 
 void TriangleMesh::_updateVertexTriangles() {
+    size_t numVertices = vertices.size();
+    _vertexTriangleOffsets.assign(numVertices + 1, 0);
+    _vertexTriangles.resize(3 * triangles.size());
+
+    Triangle t;
+    for (size_t i = 0; i < triangles.size(); i++) {
+        t = triangles[i];
+        _vertexTriangleOffsets[t.tri[0] + 1]++;
+        _vertexTriangleOffsets[t.tri[1] + 1]++;
+        _vertexTriangleOffsets[t.tri[2] + 1]++;
+    }
+
+    for (size_t i = 0; i < numVertices; i++) {
+        _vertexTriangleOffsets[i + 1] += _vertexTriangleOffsets[i];
+    }
+
+    std::vector<int> insertIndex(_vertexTriangleOffsets.begin(), _vertexTriangleOffsets.end() - 1);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        t = triangles[i];
+        _vertexTriangles[insertIndex[t.tri[0]]++] = (int)i;
+        _vertexTriangles[insertIndex[t.tri[1]]++] = (int)i;
+        _vertexTriangles[insertIndex[t.tri[2]]++] = (int)i;
+    }
+}
+
+void TriangleMesh::_clearVertexTriangles() {
+    _vertexTriangleOffsets.clear();
+    _vertexTriangleOffsets.shrink_to_fit();
     _vertexTriangles.clear();
-    _vertexTriangles.reserve(vertices.size());
+    _vertexTriangles.shrink_to_fit();
+}
 
-    for (unsigned int i = 0; i < vertices.size(); i++) {
-        std::vector<int> triangles;
-        triangles.reserve(14);  // 14 is the maximum number of adjacent triangles
-                                // to a vertex
-        _vertexTriangles.push_back(triangles);
+void TriangleMesh::_updateVertexNeighbours() {
+    _updateVertexTriangles();
+
+    size_t numVertices = vertices.size();
+    _vertexNeighbourOffsets.assign(numVertices + 1, 0);
+
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, numVertices);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, numVertices, numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&TriangleMesh::_updateVertexNeighboursThread, this,
+                                 intervals[i], intervals[i + 1], true);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    for (size_t i = 0; i < numVertices; i++) {
+        _vertexNeighbourOffsets[i + 1] += _vertexNeighbourOffsets[i];
+    }
+    _vertexNeighbours.resize(_vertexNeighbourOffsets[numVertices]);
+    _vertexNeighbourCounts.resize(_vertexNeighbourOffsets[numVertices]);
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&TriangleMesh::_updateVertexNeighboursThread, this,
+                                 intervals[i], intervals[i + 1], false);
     }
 
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    _clearVertexTriangles();
+}
+
+void TriangleMesh::_updateVertexNeighboursThread(int startidx, int endidx, bool isCountPass) {
+    // The count pass writes the number of unique neighbours of vertex v into
+    // _vertexNeighbourOffsets[v + 1]. The insert pass fills the neighbour lists.
+    std::vector<int> neighbours;
     Triangle t;
-    for (unsigned int i = 0; i < triangles.size(); i++) {
-        t = triangles[i];
-        _vertexTriangles[t.tri[0]].push_back(i);
-        _vertexTriangles[t.tri[1]].push_back(i);
-        _vertexTriangles[t.tri[2]].push_back(i);
+    for (int vidx = startidx; vidx < endidx; vidx++) {
+        neighbours.clear();
+        for (int tidx = _vertexTriangleOffsets[vidx]; tidx < _vertexTriangleOffsets[vidx + 1]; tidx++) {
+            t = triangles[_vertexTriangles[tidx]];
+            for (int i = 0; i < 3; i++) {
+                if (t.tri[i] != vidx) {
+                    neighbours.push_back(t.tri[i]);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+
+        int offset = isCountPass ? 0 : _vertexNeighbourOffsets[vidx];
+        int numUnique = 0;
+        for (size_t i = 0; i < neighbours.size(); i++) {
+            if (i > 0 && neighbours[i] == neighbours[i - 1]) {
+                if (!isCountPass) {
+                    _vertexNeighbourCounts[offset + numUnique - 1]++;
+                }
+                continue;
+            }
+
+            if (!isCountPass) {
+                _vertexNeighbours[offset + numUnique] = neighbours[i];
+                _vertexNeighbourCounts[offset + numUnique] = 1;
+            }
+            numUnique++;
+        }
+
+        if (isCountPass) {
+            _vertexNeighbourOffsets[vidx + 1] = numUnique;
+        }
     }
 }
 
+void TriangleMesh::_clearVertexNeighbours() {
+    _vertexNeighbourOffsets.clear();
+    _vertexNeighbourOffsets.shrink_to_fit();
+    _vertexNeighbours.clear();
+    _vertexNeighbours.shrink_to_fit();
+    _vertexNeighbourCounts.clear();
+    _vertexNeighbourCounts.shrink_to_fit();
+}
+
 void TriangleMesh::getTrianglePosition(unsigned int index, vmath::vec3 tri[3]) {
     FLUIDSIM_ASSERT(index < triangles.size());
 
@@ -619,89 +719,58 @@ vmath::vec3 TriangleMesh::getCentroid() {
     return c;
 }
 
-void TriangleMesh::_smoothTriangleMesh(double value) {
-    std::vector<vmath::vec3> newvertices;
-    newvertices.reserve(vertices.size());
+void TriangleMesh::_smoothValues(double value, int iterations, 
+                                 std::vector<vmath::vec3> &values) {
+    _updateVertexNeighbours();
 
-    vmath::vec3 v;
-    vmath::vec3 nv;
-    vmath::vec3 avg;
-    Triangle t;
-    for (unsigned int i = 0; i < vertices.size(); i++) {
-        int count = 0;
-        avg = vmath::vec3();
-        for (unsigned int j = 0; j < _vertexTriangles[i].size(); j++) {
-            t = triangles[_vertexTriangles[i][j]];
-            if (t.tri[0] != (int)i) {
-                avg += vertices[t.tri[0]];
-                count++;
-            }
-            if (t.tri[1] != (int)i) {
-                avg += vertices[t.tri[1]];
-                count++;
-            }
-            if (t.tri[2] != (int)i) {
-                avg += vertices[t.tri[2]];
-                count++;
-            }
-        }
+    std::vector<vmath::vec3> newvalues(values.size());
 
-        avg /= (float)count;
-        v = vertices[i];
-        nv = v + (float)value * (avg - v);
-        newvertices.push_back(nv);
-    }
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, values.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, values.size(), numthreads);
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&TriangleMesh::_smoothValuesThread, this,
+                                     intervals[i], intervals[i + 1], value, &values, &newvalues);
+        }
 
-    vertices = newvertices;
-}
+        for (int i = 0; i < numthreads; i++) {
+            threads[i].join();
+        }
 
-void TriangleMesh::smooth(double value, int iterations) {
-    if (iterations == 0) {
-        return;
+        values.swap(newvalues);
     }
 
-    _vertexTriangles.clear();
-    _updateVertexTriangles();
-    for (int i = 0; i < iterations; i++) {
-        _smoothTriangleMesh(value);
-    }
-    _vertexTriangles.clear();
+    _clearVertexNeighbours();
 }
 
-std::vector<vmath::vec3> TriangleMesh::_smoothTriangleMeshColors(double value, std::vector<vmath::vec3> &colors) {
-    std::vector<vmath::vec3> newcolors;
-    newcolors.reserve(vertices.size());
-
-    vmath::vec3 c;
-    vmath::vec3 nc;
+void TriangleMesh::_smoothValuesThread(int startidx, int endidx, double value,
+                                       std::vector<vmath::vec3> *values, 
+                                       std::vector<vmath::vec3> *newvalues) {
+    vmath::vec3 v;
     vmath::vec3 avg;
-    Triangle t;
-    for (unsigned int i = 0; i < vertices.size(); i++) {
+    for (int i = startidx; i < endidx; i++) {
         int count = 0;
         avg = vmath::vec3();
-        for (unsigned int j = 0; j < _vertexTriangles[i].size(); j++) {
-            t = triangles[_vertexTriangles[i][j]];
-            if (t.tri[0] != (int)i) {
-                avg += colors[t.tri[0]];
-                count++;
-            }
-            if (t.tri[1] != (int)i) {
-                avg += colors[t.tri[1]];
-                count++;
-            }
-            if (t.tri[2] != (int)i) {
-                avg += colors[t.tri[2]];
-                count++;
-            }
+        for (int nidx = _vertexNeighbourOffsets[i]; nidx < _vertexNeighbourOffsets[i + 1]; nidx++) {
+            int ncount = _vertexNeighbourCounts[nidx];
+            avg += (float)ncount * (*values)[_vertexNeighbours[nidx]];
+            count += ncount;
         }
 
         avg /= (float)count;
-        c = colors[i];
-        nc = c + (float)value * (avg - c);
-        newcolors.push_back(nc);
+        v = (*values)[i];
+        (*newvalues)[i] = v + (float)value * (avg - v);
     }
+}
 
-    return newcolors;
+void TriangleMesh::smooth(double value, int iterations) {
+    if (iterations == 0) {
+        return;
+    }
+
+    _smoothValues(value, iterations, vertices);
 }
 
 std::vector<vmath::vec3> TriangleMesh::smoothColors(double value, int iterations, std::vector<vmath::vec3> colors) {
@@ -709,12 +778,7 @@ std::vector<vmath::vec3> TriangleMesh::smoothColors(double value, int iterations
         return colors;
     }
 
-    _vertexTriangles.clear();
-    _updateVertexTriangles();
-    for (int i = 0; i < iterations; i++) {
-        colors = _smoothTriangleMeshColors(value, colors);
-    }
-    _vertexTriangles.clear();
+    _smoothValues(value, iterations, colors);
 
     return colors;
 }
@@ -724,7 +788,7 @@ void TriangleMesh::updateVertexTriangles() {
 }
 
 void TriangleMesh::clearVertexTriangles() {
-    _vertexTriangles.clear();
+    _clearVertexTriangles();
 }
 
 void TriangleMesh::_getPolyhedronFromTriangle(int tidx, 
@@ -988,32 +1052,33 @@ bool sortVertexPairByFirstIndex(const std::pair<int, int> &a,
 void TriangleMesh::_findDuplicateVertexPairs(int i, int j, int k, double dx, 
                                              std::vector<std::pair<int, int> > &vertexPairs) {
     SpatialPointGrid grid(i, j, k, dx);
-    std::vector<GridPointReference> refs = grid.insert(vertices);
-
-    std::vector<bool> isPaired(vertices.size(), false);
+    grid.insert(vertices);
 
     double eps = 10e-6;
+    std::vector<int> queryOffsets;
     std::vector<GridPointReference> query;
+    grid.queryPointReferencesInsideSphere(0, (int)vertices.size(), eps, queryOffsets, query);
+
+    std::vector<bool> isPaired(vertices.size(), false);
     for (unsigned int i = 0; i < vertices.size(); i++) {
 
         if (isPaired[i]) {
             continue;
         }
 
-        query.clear();
-        grid.queryPointReferencesInsideSphere(refs[i], eps, query);
-
-        if (query.size() == 0) {
+        int qstart = queryOffsets[i];
+        int qend = queryOffsets[i + 1];
+        if (qstart == qend) {
             continue;
         }
 
         GridPointReference closestRef;
-        if (query.size() == 1) {
-            closestRef = query[0];
+        if (qend - qstart == 1) {
+            closestRef = query[qstart];
         } else {
             double mindist = std::numeric_limits<double>::infinity();
 
-            for (unsigned int idx = 0; idx < query.size(); idx++) {
+            for (int idx = qstart; idx < qend; idx++) {
                 vmath::vec3 v = vertices[i] - vertices[query[idx].id];
                 double distsq = vmath::lengthsq(v);
                 if (distsq < mindist) {
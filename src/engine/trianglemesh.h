@@ -36,7 +36,8 @@ class AABB;
 
 enum class TriangleMeshFormat : char { 
     ply   = 0x00, 
-    bobj  = 0x01
+    bobj  = 0x01,
+    meshcache = 0x02
 };
 
 class TriangleMesh
@@ -92,9 +93,15 @@ private:
     bool _loadPLYTriangleData(std::ifstream *file, std::string &header);
 
     void _updateVertexTriangles();
+    void _clearVertexTriangles();
+    void _updateVertexNeighbours();
+    void _updateVertexNeighboursThread(int startidx, int endidx, bool isCountPass);
+    void _clearVertexNeighbours();
     bool _trianglesEqual(Triangle &t1, Triangle &t2);
-    void _smoothTriangleMesh(double value);
-    std::vector<vmath::vec3> _smoothTriangleMeshColors(double value, std::vector<vmath::vec3> &colors);
+    void _smoothValues(double value, int iterations, std::vector<vmath::vec3> &values);
+    void _smoothValuesThread(int startidx, int endidx, double value,
+                             std::vector<vmath::vec3> *values, 
+                             std::vector<vmath::vec3> *newvalues);
 
     void _getPolyhedra(std::vector<std::vector<int> > &polyList);
     void _getPolyhedronFromTriangle(int triangle, 
@@ -119,5 +126,15 @@ private:
         return sstream.str();
     }
 
-    std::vector<std::vector<int> > _vertexTriangles;
+    // Vertex to triangle adjacency. The triangles adjacent to vertex v are
+    // _vertexTriangles[_vertexTriangleOffsets[v]] to
+    // _vertexTriangles[_vertexTriangleOffsets[v + 1] - 1]
+    std::vector<int> _vertexTriangleOffsets;
+    std::vector<int> _vertexTriangles;
+
+    // Vertex to vertex adjacency in the same layout. A neighbour count 
+    // is the number of triangles that share the edge to the neighbour.
+    std::vector<int> _vertexNeighbourOffsets;
+    std::vector<int> _vertexNeighbours;
+    std::vector<unsigned char> _vertexNeighbourCounts;
 };
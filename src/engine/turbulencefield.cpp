@@ -49,16 +49,18 @@ float TurbulenceField::operator()(GridIndex g) {
 }
 
 void TurbulenceField::_getVelocityGrid(MACVelocityField *macfield, 
-                                       Array3d<vmath::vec3> &vgrid) {
+                                       Array3d<float> &vx, 
+                                       Array3d<float> &vy, 
+                                       Array3d<float> &vz) {
 
-    size_t gridsize = vgrid.width * vgrid.height * vgrid.depth;
-    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    int gridsize = vx.depth;
+    int numCPU = ThreadUtils::getMaxThreadCount();
     int numthreads = (int)std::min(numCPU, gridsize);
     std::vector<std::thread> threads(numthreads);
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&TurbulenceField::_getVelocityGridThread, this,
-                                 intervals[i], intervals[i + 1], macfield, &vgrid);
+                                 intervals[i], intervals[i + 1], macfield, &vx, &vy, &vz);
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -66,14 +68,20 @@ void TurbulenceField::_getVelocityGrid(MACVelocityField *macfield,
     }
 }
 
-void TurbulenceField::_getVelocityGridThread(int startidx, int endidx, 
+void TurbulenceField::_getVelocityGridThread(int startk, int endk, 
                                              MACVelocityField *vfield, 
-                                             Array3d<vmath::vec3> *vgrid) {
-    int isize = vgrid->width;
-    int jsize = vgrid->height;
-    for (int idx = startidx; idx < endidx; idx++) {
-        GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
-        vgrid->set(g, vfield->evaluateVelocityAtCellCenter(g.i, g.j, g.k));
+                                             Array3d<float> *vx, 
+                                             Array3d<float> *vy, 
+                                             Array3d<float> *vz) {
+    for (int k = startk; k < endk; k++) {
+        for (int j = 0; j < vx->height; j++) {
+            for (int i = 0; i < vx->width; i++) {
+                vmath::vec3 v = vfield->evaluateVelocityAtCellCenter(i, j, k);
+                vx->set(i, j, k, v.x);
+                vy->set(i, j, k, v.y);
+                vz->set(i, j, k, v.z);
+            }
+        }
     }
 }
 
@@ -109,8 +117,11 @@ void TurbulenceField::calculateTurbulenceField(MACVelocityField *vfield,
     }
     _field.fill(0.0f);
 
-    Array3d<vmath::vec3> vgrid = Array3d<vmath::vec3>(_isize, _jsize, _ksize);
-    _getVelocityGrid(vfield, vgrid);
+    Array3d<float> vx(_isize, _jsize, _ksize);
+    Array3d<float> vy(_isize, _jsize, _ksize);
+    Array3d<float> vz(_isize, _jsize, _ksize);
+    _getVelocityGrid(vfield, vx, vy, vz);
+    _initializeStencil();
 
     int numCPU = ThreadUtils::getMaxThreadCount();
     int numthreads = (int)fmin(numCPU, fluidCells.size());
@@ -118,7 +129,7 @@ void TurbulenceField::calculateTurbulenceField(MACVelocityField *vfield,
     std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, fluidCells.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
         threads[i] = std::thread(&TurbulenceField::_calculateTurbulenceFieldThread, this,
-                                 intervals[i], intervals[i + 1], &vgrid, &fluidCells);
+                                 intervals[i], intervals[i + 1], &vx, &vy, &vz, &fluidCells);
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -126,12 +137,47 @@ void TurbulenceField::calculateTurbulenceField(MACVelocityField *vfield,
     }
 }
 
+void TurbulenceField::_initializeStencil() {
+    // The neighbourhood of a cell spans offsets [-2, 1] along each axis. The
+    // geometric terms only depend on the offset and are computed once here.
+    _stencil.clear();
+    for (int dk = -2; dk <= 1; dk++) {
+        for (int dj = -2; dj <= 1; dj++) {
+            for (int di = -2; di <= 1; di++) {
+                if (di == 0 && dj == 0 && dk == 0) {
+                    continue;
+                }
+
+                vmath::vec3 xij = -_dx * vmath::vec3((float)di, (float)dj, (float)dk);
+                double xlen = vmath::length(xij);
+
+                StencilOffset s;
+                s.di = di;
+                s.dj = dj;
+                s.dk = dk;
+                s.flatOffset = di + _isize * (dj + _jsize * dk);
+                s.nx = xij.x / (float)xlen;
+                s.ny = xij.y / (float)xlen;
+                s.nz = xij.z / (float)xlen;
+                s.weight = (float)(1.0 - xlen / _radius);
+                _stencil.push_back(s);
+            }
+        }
+    }
+}
+
 void TurbulenceField::_calculateTurbulenceFieldThread(int startidx, int endidx,
-                                                      Array3d<vmath::vec3> *vgrid,
+                                                      Array3d<float> *vx, 
+                                                      Array3d<float> *vy, 
+                                                      Array3d<float> *vz,
                                                       GridIndexVector *fluidCells) {
-    double eps = 10e-6;
-    double invradius = 1.0 / _radius;
-    vmath::vec3 vi, vj, vij, vijnorm, xi, xj, xij, xijnorm;
+    // Neighbours are limited to the range [0, size - 1) along each axis
+    float eps = 10e-6;
+    const float *vxraw = vx->getRawArray();
+    const float *vyraw = vy->getRawArray();
+    const float *vzraw = vz->getRawArray();
+    const StencilOffset *stencil = _stencil.data();
+    int stencilsize = (int)_stencil.size();
 
     for (int idx = startidx; idx < endidx; idx++) {
         GridIndex g = fluidCells->at(idx);
@@ -139,34 +185,50 @@ void TurbulenceField::_calculateTurbulenceFieldThread(int startidx, int endidx,
         int j = g.j;
         int k = g.k;
 
-        vi = vgrid->get(i, j, k);
-        xi = Grid3d::GridIndexToCellCenter(i, j, k, _dx);
-        double vlen, xlen;
-        double turb = 0.0;
-
-        for (int nk = fmax(k - 2, 0); nk < fmin(k + 2, _ksize - 1); nk++) {
-            for (int nj = fmax(j - 2, 0); nj < fmin(j + 2, _jsize - 1); nj++) {
-                for (int ni = fmax(i - 2, 0); ni < fmin(i + 2, _isize - 1); ni++) {
-                    vj = vgrid->get(ni, nj, nk);
-                    vij = vi - vj;
-                    vlen = vmath::length(vij);
+        int flatidx = Grid3d::getFlatIndex(i, j, k, _isize, _jsize);
+        float vix = vxraw[flatidx];
+        float viy = vyraw[flatidx];
+        float viz = vzraw[flatidx];
+        bool isInterior = i >= 2 && j >= 2 && k >= 2 && 
+                          i + 3 <= _isize && j + 3 <= _jsize && k + 3 <= _ksize;
 
-                    if (fabs(vlen) < eps) {
-                        continue;
-                    }
-                    vijnorm = vij / (float)vlen;
-
-                    xj = Grid3d::GridIndexToCellCenter(ni, nj, nk, _dx);
-                    xij = xi - xj;
-                    xlen = vmath::length(xij);
-                    xijnorm = xij / (float)xlen;
+        // Terms are evaluated in single precision and accumulated in double
+        double turb = 0.0;
+        if (isInterior) {
+            for (int sidx = 0; sidx < stencilsize; sidx++) {
+                const StencilOffset &s = stencil[sidx];
+                int nidx = flatidx + s.flatOffset;
+                float dvx = vix - vxraw[nidx];
+                float dvy = viy - vyraw[nidx];
+                float dvz = viz - vzraw[nidx];
+                float vlen = sqrt(dvx * dvx + dvy * dvy + dvz * dvz);
+                float t = (vlen - (dvx * s.nx + dvy * s.ny + dvz * s.nz)) * s.weight;
+                turb += vlen < eps ? 0.0 : (double)t;
+            }
+        } else {
+            for (int sidx = 0; sidx < stencilsize; sidx++) {
+                const StencilOffset &s = stencil[sidx];
+                int ni = i + s.di;
+                int nj = j + s.dj;
+                int nk = k + s.dk;
+                if (ni < 0 || nj < 0 || nk < 0 || 
+                        ni >= _isize - 1 || nj >= _jsize - 1 || nk >= _ksize - 1) {
+                    continue;
+                }
 
-                    turb += vlen*(1.0 - vmath::dot(vijnorm, xijnorm))*(1.0 - (xlen*invradius));
+                int nidx = flatidx + s.flatOffset;
+                float dvx = vix - vxraw[nidx];
+                float dvy = viy - vyraw[nidx];
+                float dvz = viz - vzraw[nidx];
+                float vlen = sqrt(dvx * dvx + dvy * dvy + dvz * dvz);
+                if (vlen < eps) {
+                    continue;
                 }
+                turb += (double)((vlen - (dvx * s.nx + dvy * s.ny + dvz * s.nz)) * s.weight);
             }
         }
 
-        _field.set(i, j, k, turb);
+        _field.set(i, j, k, (float)turb);
     }
 }
 
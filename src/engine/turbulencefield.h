@@ -30,6 +30,8 @@ SOFTWARE.
     #include <thread>
 #endif
 
+#include <vector>
+
 #include "vmath.h"
 #include "array3d.h"
 
@@ -55,17 +57,32 @@ public:
     float operator()(GridIndex g);
 
 private:
+
+    struct StencilOffset {
+        int di, dj, dk;
+        int flatOffset;
+        float nx, ny, nz;    // normalized direction from neighbour to center
+        float weight;        // 1 - distance / radius
+    };
     
     void _getVelocityGrid(MACVelocityField *macfield, 
-                          Array3d<vmath::vec3> &vgrid);
-    void _getVelocityGridThread(int startidx, int endidx, 
+                          Array3d<float> &vx, 
+                          Array3d<float> &vy, 
+                          Array3d<float> &vz);
+    void _getVelocityGridThread(int startk, int endk, 
                                 MACVelocityField *vfield, 
-                                Array3d<vmath::vec3> *vgrid);
+                                Array3d<float> *vx, 
+                                Array3d<float> *vy, 
+                                Array3d<float> *vz);
+    void _initializeStencil();
     void _calculateTurbulenceFieldThread(int startidx, int endidx,
-                                         Array3d<vmath::vec3> *vgrid,
+                                         Array3d<float> *vx, 
+                                         Array3d<float> *vy, 
+                                         Array3d<float> *vz,
                                          GridIndexVector *fluidCells);
 
     Array3d<float> _field;
+    std::vector<StencilOffset> _stencil;
 
     int _isize, _jsize, _ksize;
     double _dx;
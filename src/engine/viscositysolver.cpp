@@ -34,6 +34,9 @@ SOFTWARE.
 
 #include "viscositysolver.h"
 
+#include <sstream>
+#include <algorithm>
+
 #include "threadutils.h"
 #include "levelsetutils.h"
 #include "macvelocityfield.h"
@@ -62,18 +65,14 @@ bool ViscositySolver::applyViscosityToVelocityField(ViscositySolverParameters pa
         return true;
     }
 
-    SparseMatrixf matrix(matsize, 15);
-    std::vector<float> rhs(matsize, 0);
-    std::vector<float> soln(matsize, 0);
-
-    _initializeLinearSystem(matrix, rhs);
+    _initializeLinearSystem();
 
-    bool success = _solveLinearSystem(matrix, rhs, soln);
+    bool success = _solveLinearSystem();
     if (!success) {
         return false;
     }
 
-    _applySolutionToVelocityField(soln);
+    _applySolutionToVelocityField();
 
     return true;
 }
@@ -100,15 +99,16 @@ void ViscositySolver::_initialize(ViscositySolverParameters params) {
 }
 
 void ViscositySolver::_computeFaceStateGrid() {
-    Array3d<float> solidCenterPhi(_isize, _jsize, _ksize);
-    _computeSolidCenterPhi(solidCenterPhi);
-
-    _state = FaceStateGrid(_isize, _jsize, _ksize);
+    if (_state.isize != _isize || _state.jsize != _jsize || _state.ksize != _ksize) {
+        _state = FaceStateGrid(_isize, _jsize, _ksize);
+        _solidCenterPhi = Array3d<float>(_isize, _jsize, _ksize);
+    }
+    _computeSolidCenterPhi(_solidCenterPhi);
 
     int U = 0; int V = 1; int W = 2;
-    _computeFaceStateGridMT(solidCenterPhi, U);
-    _computeFaceStateGridMT(solidCenterPhi, V);
-    _computeFaceStateGridMT(solidCenterPhi, W);
+    _computeFaceStateGridMT(_solidCenterPhi, U);
+    _computeFaceStateGridMT(_solidCenterPhi, V);
+    _computeFaceStateGridMT(_solidCenterPhi, W);
 }
 
 void ViscositySolver::_computeFaceStateGridMT(Array3d<float> &solidCenterPhi, int dir) {
@@ -207,37 +207,7 @@ void ViscositySolver::_computeSolidCenterPhiThread(int startidx, int endidx,
 }
 
 void ViscositySolver::_computeVolumeGrid() {
-    Array3d<bool> validCells(_isize + 1, _jsize + 1, _ksize + 1, false);
-    for (int k = 0; k < _ksize; k++) {
-        for (int j = 0; j < _jsize; j++) {
-            for (int i = 0; i < _isize; i++) {
-                if (_liquidSDF->get(i, j, k) < 0) {
-                    validCells.set(i, j, k, true);
-                }
-            }
-        }
-    }
-
-    int layers = 2;
-    for (int layer = 0; layer < layers; layer++) {
-        GridIndex nbs[6];
-        Array3d<bool> tempValid = validCells;
-        for (int k = 0; k < _ksize + 1; k++) {
-            for (int j = 0; j < _jsize + 1; j++) {
-                for (int i = 0; i < _isize + 1; i++) {
-                    if (validCells(i, j, k)) {
-                        Grid3d::getNeighbourGridIndices6(i, j, k, nbs);
-                        for (int nidx = 0; nidx < 6; nidx++) {
-                            if (tempValid.isIndexInRange(nbs[nidx])) {
-                                tempValid.set(nbs[nidx], true);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        validCells = tempValid;
-    }
+    _computeValidCells();
 
     if (_volumes.isize != _isize || _volumes.jsize != _jsize || _volumes.ksize != _ksize) {
         _volumes = ViscosityVolumeGrid(_isize, _jsize, _ksize);
@@ -248,7 +218,7 @@ void ViscositySolver::_computeVolumeGrid() {
     }
 
     vmath::vec3 centerStart(0.25f * _dx, 0.25f * _dx, 0.25f * _dx);
-    _estimateVolumeFractions(&_subcellVolumeGrid, &validCells, centerStart, 0.5f * _dx);
+    _estimateVolumeFractions(&_subcellVolumeGrid, &_validCells, centerStart, 0.5f * _dx);
 
     struct WorkGroup {
         Array3d<float> *grid;
@@ -279,7 +249,7 @@ void ViscositySolver::_computeVolumeGrid() {
             workqueue.pop_back();
 
             threads[tidx] = std::thread(&ViscositySolver::_computeVolumeGridThread, this,
-                                        workgroup.grid, &validCells, &_subcellVolumeGrid, 
+                                        workgroup.grid, &_validCells, &_subcellVolumeGrid, 
                                         workgroup.gridOffset);
         }
 
@@ -289,6 +259,95 @@ void ViscositySolver::_computeVolumeGrid() {
     }
 }
 
+void ViscositySolver::_computeValidCells() {
+    if (_validCells.width != _isize + 1 || 
+            _validCells.height != _jsize + 1 || 
+            _validCells.depth != _ksize + 1) {
+        _validCells = Array3d<bool>(_isize + 1, _jsize + 1, _ksize + 1, false);
+        _dilatedValidCells = Array3d<bool>(_isize + 1, _jsize + 1, _ksize + 1, false);
+    }
+
+    // Liquid cells can only exist within the active blocks of the liquid SDF
+    _validCells.fill(false);
+    std::vector<GridIndex> liquidBlocks;
+    _liquidSDF->getActiveBlocks(liquidBlocks);
+
+    size_t numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)std::min(numCPU, liquidBlocks.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, liquidBlocks.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_computeValidCellsThread, this,
+                                 intervals[i], intervals[i + 1], &liquidBlocks, &_validCells);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+
+    // Dilate by two layers, ping-ponging between the two persistent grids
+    size_t gridsize = _validCells.width * _validCells.height * _validCells.depth;
+    numthreads = (int)std::min(numCPU, gridsize);
+    threads = std::vector<std::thread>(numthreads);
+    intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
+
+    Array3d<bool> *source = &_validCells;
+    Array3d<bool> *dest = &_dilatedValidCells;
+    int layers = 2;
+    for (int layer = 0; layer < layers; layer++) {
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&ViscositySolver::_dilateValidCellsThread, this,
+                                     intervals[i], intervals[i + 1], source, dest);
+        }
+
+        for (int i = 0; i < numthreads; i++) {
+            threads[i].join();
+        }
+
+        std::swap(source, dest);
+    }
+}
+
+void ViscositySolver::_computeValidCellsThread(int startidx, int endidx, 
+                                               std::vector<GridIndex> *liquidBlocks,
+                                               Array3d<bool> *validCells) {
+    GridIndex gmin, gmax;
+    for (int bidx = startidx; bidx < endidx; bidx++) {
+        _liquidSDF->getBlockBounds(liquidBlocks->at(bidx), gmin, gmax);
+        for (int k = gmin.k; k < gmax.k; k++) {
+            for (int j = gmin.j; j < gmax.j; j++) {
+                for (int i = gmin.i; i < gmax.i; i++) {
+                    if (_liquidSDF->get(i, j, k) < 0) {
+                        validCells->set(i, j, k, true);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ViscositySolver::_dilateValidCellsThread(int startidx, int endidx, 
+                                              Array3d<bool> *validCells, 
+                                              Array3d<bool> *dilatedCells) {
+    int isize = validCells->width;
+    int jsize = validCells->height;
+    GridIndex nbs[6];
+    for (int idx = startidx; idx < endidx; idx++) {
+        GridIndex g = Grid3d::getUnflattenedIndex(idx, isize, jsize);
+        bool isValid = validCells->get(g);
+        if (!isValid) {
+            Grid3d::getNeighbourGridIndices6(g, nbs);
+            for (int nidx = 0; nidx < 6; nidx++) {
+                if (validCells->isIndexInRange(nbs[nidx]) && validCells->get(nbs[nidx])) {
+                    isValid = true;
+                    break;
+                }
+            }
+        }
+        dilatedCells->set(g, isValid);
+    }
+}
+
 void ViscositySolver::_estimateVolumeFractions(Array3d<float> *volumes, 
                                                Array3d<bool> *validCells, 
                                                vmath::vec3 centerStart, 
@@ -381,122 +440,93 @@ void ViscositySolver::_destroyVolumeGrid() {
 }
 
 void ViscositySolver::_computeMatrixIndexTable() {
+    // The table persists between solves. Only the entries of the previous 
+    // unknowns need to be cleared when the grid dimensions are unchanged.
+    if (_matrixIndex.isMatchingDimensions(_isize, _jsize, _ksize)) {
+        int numCPU = ThreadUtils::getMaxThreadCount();
+        int numthreads = (int)fmin(numCPU, _rows.size());
+        std::vector<std::thread> threads(numthreads);
+        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _rows.size(), numthreads);
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&ViscositySolver::_clearMatrixIndexTableThread, this,
+                                     intervals[i], intervals[i + 1]);
+        }
 
-    int dim = (_isize + 1) * _jsize * _ksize + 
-              _isize * (_jsize + 1) * _ksize + 
-              _isize * _jsize * (_ksize + 1);
-    FaceIndexer fidx(_isize, _jsize, _ksize);
-
-    std::vector<bool> isIndexInMatrix(dim, false);
-    for (int k = 1; k < _ksize; k++) {
-        for (int j = 1; j < _jsize; j++) {
-            for (int i = 1; i < _isize; i++) {
-                if (_state.U(i, j, k) != FaceState::fluid) {
-                    continue;
-                }
-
-                float v = _volumes.U(i, j, k);
-                float vRight = _volumes.center(i, j, k);
-                float vLeft = _volumes.center(i - 1, j, k);
-                float vTop = _volumes.edgeW(i, j + 1, k);
-                float vBottom = _volumes.edgeW(i, j, k);
-                float vFront = _volumes.edgeV(i, j, k + 1);
-                float vBack = _volumes.edgeV(i, j, k);
-
-                if (v > 0.0 || vRight > 0.0 || vLeft > 0.0 || vTop > 0.0 || 
-                        vBottom > 0.0 || vFront > 0.0 || vBack > 0.0) {
-                    int index = fidx.U(i, j, k);
-                    isIndexInMatrix[index] = true;
-                }
-            }
+        for (int i = 0; i < numthreads; i++) {
+            threads[i].join();
         }
+        _matrixIndex.matrixSize = 0;
+    } else {
+        _matrixIndex.initialize(_isize, _jsize, _ksize);
     }
 
-    for (int k = 1; k < _ksize; k++) {
-        for (int j = 1; j < _jsize; j++) {
-            for (int i = 1; i < _isize; i++) {
-                if (_state.V(i, j, k) != FaceState::fluid) {
-                    continue;
-                }
+    int U = 0; int V = 1; int W = 2;
+    _computeMatrixIndexTableMT(U);
+    _computeMatrixIndexTableMT(V);
+    _computeMatrixIndexTableMT(W);
+
+    // Number the unknowns in face index order with a prefix sum over the 
+    // per-thread counts and record the grid index of each unknown for the 
+    // matrix-free operator
+    std::vector<int> &table = _matrixIndex.indexTable;
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, table.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, table.size(), numthreads);
+    std::vector<int> counts(numthreads, 0);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_countMatrixIndexTableThread, this,
+                                 intervals[i], intervals[i + 1], &(counts[i]));
+    }
 
-                float v = _volumes.V(i, j, k);
-                float vRight = _volumes.edgeW(i + 1, j, k);
-                float vLeft = _volumes.edgeW(i, j, k);
-                float vTop = _volumes.center(i, j, k);
-                float vBottom = _volumes.center(i, j - 1, k);
-                float vFront = _volumes.edgeU(i, j, k + 1);
-                float vBack = _volumes.edgeU(i, j, k);
-
-                if (v > 0.0 || vRight > 0.0 || vLeft > 0.0 || vTop > 0.0 || 
-                        vBottom > 0.0 || vFront > 0.0 || vBack > 0.0) {
-                    int index = fidx.V(i, j, k);
-                    isIndexInMatrix[index] = true;
-                }
-            }
-        }
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
     }
 
-    for (int k = 1; k < _ksize; k++) {
-        for (int j = 1; j < _jsize; j++) {
-            for (int i = 1; i < _isize; i++) {
-                if (_state.W(i, j, k) != FaceState::fluid) {
-                    continue;
-                }
+    std::vector<int> offsets(numthreads + 1, 0);
+    for (int i = 0; i < numthreads; i++) {
+        offsets[i + 1] = offsets[i] + counts[i];
+    }
+    _matrixIndex.matrixSize = offsets[numthreads];
+    _rows.assign(_matrixIndex.matrixSize, SystemRow());
 
-                float v = _volumes.W(i, j, k);
-                float vRight = _volumes.edgeV(i + 1, j, k);
-                float vLeft = _volumes.edgeV(i, j, k);
-                float vTop = _volumes.edgeU(i, j + 1, k);
-                float vBottom = _volumes.edgeU(i, j, k);
-                float vFront = _volumes.center(i, j, k);
-                float vBack = _volumes.center(i, j, k - 1);
-
-                if (v > 0.0 || vRight > 0.0 || vLeft > 0.0 || vTop > 0.0 || 
-                        vBottom > 0.0 || vFront > 0.0 || vBack > 0.0) {
-                    int index = fidx.W(i, j, k);
-                    isIndexInMatrix[index] = true;
-                }
-            }
-        }
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_numberMatrixIndexTableThread, this,
+                                 intervals[i], intervals[i + 1], offsets[i]);
     }
 
-    std::vector<int> gridToMatrixIndex(dim, -1);
-    int matrixindex = 0;
-    for (size_t i = 0; i < isIndexInMatrix.size(); i++) {
-        if (isIndexInMatrix[i]) {
-            gridToMatrixIndex[i] = matrixindex;
-            matrixindex++;
-        }
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
     }
 
-    _matrixIndex = MatrixIndexer(_isize, _jsize, _ksize, gridToMatrixIndex);
-}
+    // Unknowns of the same velocity component are only coupled to their six 
+    // axis neighbours, so colouring by component and cell parity leaves no 
+    // coupling within a colour
+    _colorRows.resize(_numColors);
+    for (int i = 0; i < _numColors; i++) {
+        _colorRows[i].clear();
+    }
 
-void ViscositySolver::_initializeLinearSystem(SparseMatrixf &matrix, std::vector<float> &rhs) {
-    _initializeLinearSystemU(matrix, rhs);
-    _initializeLinearSystemV(matrix, rhs);
-    _initializeLinearSystemW(matrix, rhs);
+    for (size_t ridx = 0; ridx < _rows.size(); ridx++) {
+        GridIndex g = _rows[ridx].g;
+        int color = 2 * _rows[ridx].dir + ((g.i + g.j + g.k) % 2);
+        _colorRows[color].push_back((int)ridx);
+    }
 }
 
-void ViscositySolver::_initializeLinearSystemU(SparseMatrixf &matrix, std::vector<float> &rhs) {
-    std::vector<GridIndex> indices;
-    for (int k = 1; k < _ksize; k++) {
-        for (int j = 1; j < _jsize; j++) {
-            for (int i = 1; i < _isize; i++) {
-                if(_state.U(i, j, k) == FaceState::fluid && _matrixIndex.U(i, j, k) != -1) {
-                    indices.push_back(GridIndex(i, j, k));
-                }
-            }
-        }
+void ViscositySolver::_computeMatrixIndexTableMT(int dir) {
+    int gridsize = (_isize - 1) * (_jsize - 1) * (_ksize - 1);
+    if (gridsize <= 0) {
+        return;
     }
 
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, indices.size());
+    int numthreads = (int)fmin(numCPU, gridsize);
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, indices.size(), numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, gridsize, numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ViscositySolver::_initializeLinearSystemThreadU, this,
-                                 intervals[i], intervals[i + 1], &indices, &matrix, &rhs);
+        threads[i] = std::thread(&ViscositySolver::_computeMatrixIndexTableThread, this,
+                                 intervals[i], intervals[i + 1], dir);
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -504,51 +534,140 @@ void ViscositySolver::_initializeLinearSystemU(SparseMatrixf &matrix, std::vecto
     }
 }
 
-void ViscositySolver::_initializeLinearSystemV(SparseMatrixf &matrix, std::vector<float> &rhs) {
-    std::vector<GridIndex> indices;
-    for (int k = 1; k < _ksize; k++) {
-        for (int j = 1; j < _jsize; j++) {
-            for (int i = 1; i < _isize; i++) {
-                if(_state.V(i, j, k) == FaceState::fluid && _matrixIndex.V(i, j, k) != -1) {
-                    indices.push_back(GridIndex(i, j, k));
-                }
-            }
-        }
+void ViscositySolver::_clearMatrixIndexTableThread(int startidx, int endidx) {
+    for (int idx = startidx; idx < endidx; idx++) {
+        SystemRow &row = _rows[idx];
+        _matrixIndex.indexTable[_matrixIndex.getFaceIndex(row.g, row.dir)] = -1;
     }
+}
 
-    int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, indices.size());
-    std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, indices.size(), numthreads);
-    for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ViscositySolver::_initializeLinearSystemThreadV, this,
-                                 intervals[i], intervals[i + 1], &indices, &matrix, &rhs);
+void ViscositySolver::_countMatrixIndexTableThread(int startidx, int endidx, int *count) {
+    std::vector<int> &table = _matrixIndex.indexTable;
+    int n = 0;
+    for (int idx = startidx; idx < endidx; idx++) {
+        if (table[idx] != -1) {
+            n++;
+        }
     }
+    *count = n;
+}
 
-    for (int i = 0; i < numthreads; i++) {
-        threads[i].join();
+void ViscositySolver::_numberMatrixIndexTableThread(int startidx, int endidx, int startindex) {
+    int U = 0; int V = 1; int W = 2;
+    int usize = (_isize + 1) * _jsize * _ksize;
+    int vsize = _isize * (_jsize + 1) * _ksize;
+    std::vector<int> &table = _matrixIndex.indexTable;
+
+    int matrixindex = startindex;
+    for (int fidx = startidx; fidx < endidx; fidx++) {
+        if (table[fidx] == -1) {
+            continue;
+        }
+
+        SystemRow &row = _rows[matrixindex];
+        if (fidx < usize) {
+            row.dir = U;
+            row.g = Grid3d::getUnflattenedIndex(fidx, _isize + 1, _jsize);
+        } else if (fidx < usize + vsize) {
+            row.dir = V;
+            row.g = Grid3d::getUnflattenedIndex(fidx - usize, _isize, _jsize + 1);
+        } else {
+            row.dir = W;
+            row.g = Grid3d::getUnflattenedIndex(fidx - usize - vsize, _isize, _jsize);
+        }
+
+        table[fidx] = matrixindex;
+        matrixindex++;
     }
 }
 
-void ViscositySolver::_initializeLinearSystemW(SparseMatrixf &matrix, std::vector<float> &rhs) {
-    std::vector<GridIndex> indices;
-    for (int k = 1; k < _ksize; k++) {
-        for (int j = 1; j < _jsize; j++) {
-            for (int i = 1; i < _isize; i++) {
-                if(_state.W(i, j, k) == FaceState::fluid && _matrixIndex.W(i, j, k) != -1) {
-                    indices.push_back(GridIndex(i, j, k));
-                }
+void ViscositySolver::_computeMatrixIndexTableThread(int startidx, int endidx, int dir) {
+    int U = 0; int V = 1; int W = 2;
+    FaceIndexer &fidx = _matrixIndex.faceIndexer;
+    std::vector<int> &table = _matrixIndex.indexTable;
+
+    for (int idx = startidx; idx < endidx; idx++) {
+        GridIndex g = Grid3d::getUnflattenedIndex(idx, _isize - 1, _jsize - 1);
+        int i = g.i + 1;
+        int j = g.j + 1;
+        int k = g.k + 1;
+
+        if (dir == U) {
+
+            if (_state.U(i, j, k) != FaceState::fluid) {
+                continue;
+            }
+
+            float v = _volumes.U(i, j, k);
+            float vRight = _volumes.center(i, j, k);
+            float vLeft = _volumes.center(i - 1, j, k);
+            float vTop = _volumes.edgeW(i, j + 1, k);
+            float vBottom = _volumes.edgeW(i, j, k);
+            float vFront = _volumes.edgeV(i, j, k + 1);
+            float vBack = _volumes.edgeV(i, j, k);
+
+            if (v > 0.0 || vRight > 0.0 || vLeft > 0.0 || vTop > 0.0 || 
+                    vBottom > 0.0 || vFront > 0.0 || vBack > 0.0) {
+                table[fidx.U(i, j, k)] = 1;
             }
+
+        } else if (dir == V) {
+
+            if (_state.V(i, j, k) != FaceState::fluid) {
+                continue;
+            }
+
+            float v = _volumes.V(i, j, k);
+            float vRight = _volumes.edgeW(i + 1, j, k);
+            float vLeft = _volumes.edgeW(i, j, k);
+            float vTop = _volumes.center(i, j, k);
+            float vBottom = _volumes.center(i, j - 1, k);
+            float vFront = _volumes.edgeU(i, j, k + 1);
+            float vBack = _volumes.edgeU(i, j, k);
+
+            if (v > 0.0 || vRight > 0.0 || vLeft > 0.0 || vTop > 0.0 || 
+                    vBottom > 0.0 || vFront > 0.0 || vBack > 0.0) {
+                table[fidx.V(i, j, k)] = 1;
+            }
+
+        } else if (dir == W) {
+
+            if (_state.W(i, j, k) != FaceState::fluid) {
+                continue;
+            }
+
+            float v = _volumes.W(i, j, k);
+            float vRight = _volumes.edgeV(i + 1, j, k);
+            float vLeft = _volumes.edgeV(i, j, k);
+            float vTop = _volumes.edgeU(i, j + 1, k);
+            float vBottom = _volumes.edgeU(i, j, k);
+            float vFront = _volumes.center(i, j, k);
+            float vBack = _volumes.center(i, j, k - 1);
+
+            if (v > 0.0 || vRight > 0.0 || vLeft > 0.0 || vTop > 0.0 || 
+                    vBottom > 0.0 || vFront > 0.0 || vBack > 0.0) {
+                table[fidx.W(i, j, k)] = 1;
+            }
+
         }
     }
+}
+
+void ViscositySolver::_initializeLinearSystem() {
+    int matsize = _matrixIndex.matrixSize;
+    _rhs.assign(matsize, 0.0f);
+    _soln.assign(matsize, 0.0f);
+    _residual.assign(matsize, 0.0f);
+    _search.assign(matsize, 0.0f);
+    _aux.assign(matsize, 0.0f);
 
     int numCPU = ThreadUtils::getMaxThreadCount();
-    int numthreads = (int)fmin(numCPU, indices.size());
+    int numthreads = (int)fmin(numCPU, _rows.size());
     std::vector<std::thread> threads(numthreads);
-    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, indices.size(), numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _rows.size(), numthreads);
     for (int i = 0; i < numthreads; i++) {
-        threads[i] = std::thread(&ViscositySolver::_initializeLinearSystemThreadW, this,
-                                 intervals[i], intervals[i + 1], &indices, &matrix, &rhs);
+        threads[i] = std::thread(&ViscositySolver::_initializeLinearSystemThread, this,
+                                 intervals[i], intervals[i + 1]);
     }
 
     for (int i = 0; i < numthreads; i++) {
@@ -556,288 +675,371 @@ void ViscositySolver::_initializeLinearSystemW(SparseMatrixf &matrix, std::vecto
     }
 }
 
-void ViscositySolver::_initializeLinearSystemThreadU(int startidx, int endidx, 
-                                                     std::vector<GridIndex> *indices,
-                                                     SparseMatrixf *matrix, 
-                                                     std::vector<float> *rhs) {
-    MatrixIndexer &mj = _matrixIndex;
-    FaceState FLUID = FaceState::fluid;
+void ViscositySolver::_initializeLinearSystemThread(int startidx, int endidx) {
+    int U = 0; int V = 1; int W = 2;
+    for (int ridx = startidx; ridx < endidx; ridx++) {
+        SystemRow &row = _rows[ridx];
+        GridIndex g = row.g;
+        if (row.dir == U) {
+            _rhs[ridx] = _initializeSystemRowU(row);
+            _soln[ridx] = _velocityField->U(g);
+        } else if (row.dir == V) {
+            _rhs[ridx] = _initializeSystemRowV(row);
+            _soln[ridx] = _velocityField->V(g);
+        } else if (row.dir == W) {
+            _rhs[ridx] = _initializeSystemRowW(row);
+            _soln[ridx] = _velocityField->W(g);
+        }
+    }
+}
+
+float ViscositySolver::_initializeSystemRowU(SystemRow &row) {
     FaceState SOLID = FaceState::solid;
+    int i = row.g.i;
+    int j = row.g.j;
+    int k = row.g.k;
 
     float invdx = 1.0f / _dx;
     float factor = _deltaTime * invdx * invdx;
-    for (int idx = startidx; idx < endidx; idx++) {
-        int i = indices->at(idx).i;
-        int j = indices->at(idx).j;
-        int k = indices->at(idx).k;
-        int row = _matrixIndex.U(i, j, k);
-
-        float viscRight = _viscosity->get(i, j, k);
-        float viscLeft = _viscosity->get(i - 1, j, k);
-
-        float viscTop    = 0.25f * (_viscosity->get(i - 1, j + 1, k) + 
-                                    _viscosity->get(i - 1, j,     k) + 
-                                    _viscosity->get(i,     j + 1, k) + 
-                                    _viscosity->get(i,     j,     k));
-        float viscBottom = 0.25f * (_viscosity->get(i - 1, j,     k) + 
-                                    _viscosity->get(i - 1, j - 1, k) + 
-                                    _viscosity->get(i,     j,     k) + 
-                                    _viscosity->get(i,     j - 1, k));
-
-        float viscFront = 0.25f * (_viscosity->get(i - 1, j, k + 1) + 
-                                   _viscosity->get(i - 1, j, k    ) + 
-                                   _viscosity->get(i,     j, k + 1) + 
-                                   _viscosity->get(i,     j, k    ));
-        float viscBack  = 0.25f * (_viscosity->get(i - 1, j, k    ) + 
-                                   _viscosity->get(i - 1, j, k - 1) + 
-                                   _viscosity->get(i,     j, k    ) + 
-                                   _viscosity->get(i,     j, k - 1));
-
-        float volRight = _volumes.center(i, j, k);
-        float volLeft = _volumes.center(i-1, j, k);
-        float volTop = _volumes.edgeW(i, j + 1, k);
-        float volBottom = _volumes.edgeW(i, j, k);
-        float volFront = _volumes.edgeV(i, j, k + 1);
-        float volBack = _volumes.edgeV(i, j, k);
-
-        float factorRight  = 2 * factor * viscRight * volRight;
-        float factorLeft   = 2 * factor * viscLeft * volLeft;
-        float factorTop    = factor * viscTop * volTop;
-        float factorBottom = factor * viscBottom * volBottom;
-        float factorFront  = factor * viscFront * volFront;
-        float factorBack   = factor * viscBack * volBack;
-
-        float diag = _volumes.U(i, j, k) + factorRight + factorLeft + factorTop + factorBottom + factorFront + factorBack;
-        matrix->set(row, row, diag);
-        if (_state.U(i + 1, j,     k    ) == FLUID) { matrix->add(row, mj.U(i + 1, j,     k    ), -factorRight ); }
-        if (_state.U(i - 1, j,     k    ) == FLUID) { matrix->add(row, mj.U(i - 1, j,     k    ), -factorLeft  ); }
-        if (_state.U(i,     j + 1, k    ) == FLUID) { matrix->add(row, mj.U(i,     j + 1, k    ), -factorTop   ); }
-        if (_state.U(i,     j - 1, k    ) == FLUID) { matrix->add(row, mj.U(i,     j - 1, k    ), -factorBottom); }
-        if (_state.U(i,     j,     k + 1) == FLUID) { matrix->add(row, mj.U(i,     j,     k + 1), -factorFront ); }
-        if (_state.U(i,     j,     k - 1) == FLUID) { matrix->add(row, mj.U(i,     j,     k - 1), -factorBack  ); }
-
-        if (_state.V(i,     j + 1, k    ) == FLUID) { matrix->add(row, mj.V(i,     j + 1, k    ), -factorTop   ); }
-        if (_state.V(i - 1, j + 1, k    ) == FLUID) { matrix->add(row, mj.V(i - 1, j + 1, k    ),  factorTop   ); }
-        if (_state.V(i,     j,     k    ) == FLUID) { matrix->add(row, mj.V(i,     j,     k    ),  factorBottom); }
-        if (_state.V(i - 1, j,     k    ) == FLUID) { matrix->add(row, mj.V(i - 1, j,     k    ), -factorBottom); }
-        
-        if (_state.W(i,     j,     k + 1) == FLUID) { matrix->add(row, mj.W(i,     j,     k + 1), -factorFront ); }
-        if (_state.W(i - 1, j,     k + 1) == FLUID) { matrix->add(row, mj.W(i - 1, j,     k + 1),  factorFront ); }
-        if (_state.W(i,     j,     k    ) == FLUID) { matrix->add(row, mj.W(i,     j,     k    ),  factorBack  ); }
-        if (_state.W(i - 1, j,     k    ) == FLUID) { matrix->add(row, mj.W(i - 1, j,     k    ), -factorBack  ); }
-
-        float rval = _volumes.U(i, j, k) * _velocityField->U(i, j, k);
-        if (_state.U(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->U(i + 1, j,     k    ); }
-        if (_state.U(i - 1, j,     k)     == SOLID) { rval -= -factorLeft   * _velocityField->U(i - 1, j,     k    ); }
-        if (_state.U(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->U(i,     j + 1, k    ); }
-        if (_state.U(i,     j - 1, k)     == SOLID) { rval -= -factorBottom * _velocityField->U(i,     j - 1, k    ); }
-        if (_state.U(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->U(i,     j,     k + 1); }
-        if (_state.U(i,     j,     k - 1) == SOLID) { rval -= -factorBack   * _velocityField->U(i,     j,     k - 1); }
-
-        if (_state.V(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->V(i,     j + 1, k    ); }
-        if (_state.V(i - 1, j + 1, k)     == SOLID) { rval -=  factorTop    * _velocityField->V(i - 1, j + 1, k    ); }
-        if (_state.V(i,     j,     k)     == SOLID) { rval -=  factorBottom * _velocityField->V(i,     j,     k    ); }
-        if (_state.V(i - 1, j,     k)     == SOLID) { rval -= -factorBottom * _velocityField->V(i - 1, j,     k    ); }
-
-        if (_state.W(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->W(i,     j,     k + 1); } 
-        if (_state.W(i - 1, j,     k + 1) == SOLID) { rval -=  factorFront  * _velocityField->W(i - 1, j,     k + 1); } 
-        if (_state.W(i,     j,     k)     == SOLID) { rval -=  factorBack   * _velocityField->W(i,     j,     k    ); } 
-        if (_state.W(i - 1, j,     k)     == SOLID) { rval -= -factorBack   * _velocityField->W(i - 1, j,     k    ); } 
-        (*rhs)[row] = rval;
-    }
-}
-
-void ViscositySolver::_initializeLinearSystemThreadV(int startidx, int endidx, 
-                                                     std::vector<GridIndex> *indices,
-                                                     SparseMatrixf *matrix, 
-                                                     std::vector<float> *rhs) {
-    MatrixIndexer &mj = _matrixIndex;
-    FaceState FLUID = FaceState::fluid;
+
+    float viscRight = _viscosity->get(i, j, k);
+    float viscLeft = _viscosity->get(i - 1, j, k);
+
+    float viscTop    = 0.25f * (_viscosity->get(i - 1, j + 1, k) + 
+                                _viscosity->get(i - 1, j,     k) + 
+                                _viscosity->get(i,     j + 1, k) + 
+                                _viscosity->get(i,     j,     k));
+    float viscBottom = 0.25f * (_viscosity->get(i - 1, j,     k) + 
+                                _viscosity->get(i - 1, j - 1, k) + 
+                                _viscosity->get(i,     j,     k) + 
+                                _viscosity->get(i,     j - 1, k));
+
+    float viscFront = 0.25f * (_viscosity->get(i - 1, j, k + 1) + 
+                               _viscosity->get(i - 1, j, k    ) + 
+                               _viscosity->get(i,     j, k + 1) + 
+                               _viscosity->get(i,     j, k    ));
+    float viscBack  = 0.25f * (_viscosity->get(i - 1, j, k    ) + 
+                               _viscosity->get(i - 1, j, k - 1) + 
+                               _viscosity->get(i,     j, k    ) + 
+                               _viscosity->get(i,     j, k - 1));
+
+    float volRight = _volumes.center(i, j, k);
+    float volLeft = _volumes.center(i-1, j, k);
+    float volTop = _volumes.edgeW(i, j + 1, k);
+    float volBottom = _volumes.edgeW(i, j, k);
+    float volFront = _volumes.edgeV(i, j, k + 1);
+    float volBack = _volumes.edgeV(i, j, k);
+
+    float factorRight  = 2 * factor * viscRight * volRight;
+    float factorLeft   = 2 * factor * viscLeft * volLeft;
+    float factorTop    = factor * viscTop * volTop;
+    float factorBottom = factor * viscBottom * volBottom;
+    float factorFront  = factor * viscFront * volFront;
+    float factorBack   = factor * viscBack * volBack;
+
+    row.factorRight = factorRight;
+    row.factorLeft = factorLeft;
+    row.factorTop = factorTop;
+    row.factorBottom = factorBottom;
+    row.factorFront = factorFront;
+    row.factorBack = factorBack;
+    row.diag = _volumes.U(i, j, k) + factorRight + factorLeft + factorTop + factorBottom + factorFront + factorBack;
+
+    float rval = _volumes.U(i, j, k) * _velocityField->U(i, j, k);
+    if (_state.U(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->U(i + 1, j,     k    ); }
+    if (_state.U(i - 1, j,     k)     == SOLID) { rval -= -factorLeft   * _velocityField->U(i - 1, j,     k    ); }
+    if (_state.U(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->U(i,     j + 1, k    ); }
+    if (_state.U(i,     j - 1, k)     == SOLID) { rval -= -factorBottom * _velocityField->U(i,     j - 1, k    ); }
+    if (_state.U(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->U(i,     j,     k + 1); }
+    if (_state.U(i,     j,     k - 1) == SOLID) { rval -= -factorBack   * _velocityField->U(i,     j,     k - 1); }
+
+    if (_state.V(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->V(i,     j + 1, k    ); }
+    if (_state.V(i - 1, j + 1, k)     == SOLID) { rval -=  factorTop    * _velocityField->V(i - 1, j + 1, k    ); }
+    if (_state.V(i,     j,     k)     == SOLID) { rval -=  factorBottom * _velocityField->V(i,     j,     k    ); }
+    if (_state.V(i - 1, j,     k)     == SOLID) { rval -= -factorBottom * _velocityField->V(i - 1, j,     k    ); }
+
+    if (_state.W(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->W(i,     j,     k + 1); } 
+    if (_state.W(i - 1, j,     k + 1) == SOLID) { rval -=  factorFront  * _velocityField->W(i - 1, j,     k + 1); } 
+    if (_state.W(i,     j,     k)     == SOLID) { rval -=  factorBack   * _velocityField->W(i,     j,     k    ); } 
+    if (_state.W(i - 1, j,     k)     == SOLID) { rval -= -factorBack   * _velocityField->W(i - 1, j,     k    ); } 
+
+    return rval;
+}
+
+float ViscositySolver::_initializeSystemRowV(SystemRow &row) {
     FaceState SOLID = FaceState::solid;
+    int i = row.g.i;
+    int j = row.g.j;
+    int k = row.g.k;
 
     float invdx = 1.0f / _dx;
     float factor = _deltaTime * invdx * invdx;
-    for (int idx = startidx; idx < endidx; idx++) {
-        int i = indices->at(idx).i;
-        int j = indices->at(idx).j;
-        int k = indices->at(idx).k;
-        int row = _matrixIndex.V(i, j, k);  
-
-        float viscRight = 0.25f * (_viscosity->get(i,     j - 1, k) + 
-                                   _viscosity->get(i + 1, j - 1, k) + 
-                                   _viscosity->get(i,     j,     k) + 
-                                   _viscosity->get(i + 1, j,     k));
-        float viscLeft  = 0.25f * (_viscosity->get(i,     j - 1, k) + 
-                                   _viscosity->get(i - 1, j - 1, k) + 
-                                   _viscosity->get(i,     j,     k) + 
-                                   _viscosity->get(i - 1, j,     k));
-        
-        float viscTop = _viscosity->get(i, j, k);
-        float viscBottom = _viscosity->get(i, j - 1, k);
-        
-        float viscFront = 0.25f * (_viscosity->get(i, j - 1, k    ) + 
-                                   _viscosity->get(i, j - 1, k + 1) + 
-                                   _viscosity->get(i, j,     k    ) + 
-                                   _viscosity->get(i, j,     k + 1));
-        float viscBack  = 0.25f * (_viscosity->get(i, j - 1, k    ) + 
-                                   _viscosity->get(i, j - 1, k - 1) + 
-                                   _viscosity->get(i, j,     k    ) + 
-                                   _viscosity->get(i, j,     k - 1));
-
-        float volRight = _volumes.edgeW(i + 1, j, k);
-        float volLeft = _volumes.edgeW(i, j, k);
-        float volTop = _volumes.center(i, j, k);
-        float volBottom = _volumes.center(i, j - 1, k);
-        float volFront = _volumes.edgeU(i, j, k + 1);
-        float volBack = _volumes.edgeU(i, j, k);
-
-        float factorRight  = factor * viscRight * volRight;
-        float factorLeft   = factor * viscLeft * volLeft;
-        float factorTop    = 2 * factor * viscTop * volTop;
-        float factorBottom = 2 * factor * viscBottom * volBottom;
-        float factorFront  = factor * viscFront * volFront;
-        float factorBack   = factor * viscBack*volBack;
-
-        float diag = _volumes.V(i, j, k) + factorRight + factorLeft + factorTop + factorBottom + factorFront + factorBack;
-        matrix->set(row, row, diag);
-        if (_state.V(i + 1, j,     k    ) == FLUID) { matrix->add(row, mj.V(i + 1, j,     k    ), -factorRight ); }
-        if (_state.V(i - 1, j,     k    ) == FLUID) { matrix->add(row, mj.V(i - 1, j,     k    ), -factorLeft  ); }
-        if (_state.V(i,     j + 1, k    ) == FLUID) { matrix->add(row, mj.V(i,     j + 1, k    ), -factorTop   ); }
-        if (_state.V(i,     j - 1, k    ) == FLUID) { matrix->add(row, mj.V(i,     j - 1, k    ), -factorBottom); }
-        if (_state.V(i,     j,     k + 1) == FLUID) { matrix->add(row, mj.V(i,     j,     k + 1), -factorFront ); }
-        if (_state.V(i,     j,     k - 1) == FLUID) { matrix->add(row, mj.V(i,     j,     k - 1), -factorBack  ); }
-
-        if (_state.U(i + 1, j,     k    ) == FLUID) { matrix->add(row, mj.U(i + 1, j,     k    ), -factorRight ); }
-        if (_state.U(i + 1, j - 1, k    ) == FLUID) { matrix->add(row, mj.U(i + 1, j - 1, k    ),  factorRight ); }
-        if (_state.U(i,     j,     k    ) == FLUID) { matrix->add(row, mj.U(i,     j,     k    ),  factorLeft  ); }
-        if (_state.U(i,     j - 1, k    ) == FLUID) { matrix->add(row, mj.U(i,     j - 1, k    ), -factorLeft  ); }
+
+    float viscRight = 0.25f * (_viscosity->get(i,     j - 1, k) + 
+                               _viscosity->get(i + 1, j - 1, k) + 
+                               _viscosity->get(i,     j,     k) + 
+                               _viscosity->get(i + 1, j,     k));
+    float viscLeft  = 0.25f * (_viscosity->get(i,     j - 1, k) + 
+                               _viscosity->get(i - 1, j - 1, k) + 
+                               _viscosity->get(i,     j,     k) + 
+                               _viscosity->get(i - 1, j,     k));
     
-        if (_state.W(i,     j,     k + 1) == FLUID) { matrix->add(row, mj.W(i,     j,     k + 1), -factorFront ); }
-        if (_state.W(i,     j - 1, k + 1) == FLUID) { matrix->add(row, mj.W(i,     j - 1, k + 1),  factorFront ); }
-        if (_state.W(i,     j,     k    ) == FLUID) { matrix->add(row, mj.W(i,     j,     k    ),  factorBack  ); }
-        if (_state.W(i,     j - 1, k    ) == FLUID) { matrix->add(row, mj.W(i,     j - 1, k    ), -factorBack  ); }
-
-        float rval = _volumes.V(i, j, k) * _velocityField->V(i, j, k);
-        if (_state.V(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->V(i + 1, j,     k    ); }
-        if (_state.V(i - 1, j,     k)     == SOLID) { rval -= -factorLeft   * _velocityField->V(i - 1, j,     k    ); }
-        if (_state.V(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->V(i,     j + 1, k    ); }
-        if (_state.V(i ,    j - 1, k)     == SOLID) { rval -= -factorBottom * _velocityField->V(i,     j - 1, k    ); }
-        if (_state.V(i    , j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->V(i,     j,     k + 1); }
-        if (_state.V(i,     j,     k - 1) == SOLID) { rval -= -factorBack   * _velocityField->V(i,     j,     k - 1); }
-
-        if (_state.U(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->U(i + 1, j,     k    ); }
-        if (_state.U(i + 1, j - 1, k)     == SOLID) { rval -=  factorRight  * _velocityField->U(i + 1, j - 1, k    ); }
-        if (_state.U(i,     j,     k)     == SOLID) { rval -=  factorLeft   * _velocityField->U(i,     j,     k    ); }
-        if (_state.U(i,     j - 1, k)     == SOLID) { rval -= -factorLeft   * _velocityField->U(i,     j - 1, k    ); }
-
-        if (_state.W(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->W(i,     j,     k + 1); }
-        if (_state.W(i,     j - 1, k + 1) == SOLID) { rval -=  factorFront  * _velocityField->W(i,     j - 1, k + 1); }
-        if (_state.W(i,     j,     k)     == SOLID) { rval -=  factorBack   * _velocityField->W(i,     j,     k    ); }
-        if (_state.W(i,     j - 1, k)     == SOLID) { rval -= -factorBack   * _velocityField->W(i,     j - 1, k    ); }
-        (*rhs)[row] = rval;
-    }
-}
-
-void ViscositySolver::_initializeLinearSystemThreadW(int startidx, int endidx, 
-                                                     std::vector<GridIndex> *indices,
-                                                     SparseMatrixf *matrix, 
-                                                     std::vector<float> *rhs) {
-    MatrixIndexer &mj = _matrixIndex;
-    FaceState FLUID = FaceState::fluid;
+    float viscTop = _viscosity->get(i, j, k);
+    float viscBottom = _viscosity->get(i, j - 1, k);
+    
+    float viscFront = 0.25f * (_viscosity->get(i, j - 1, k    ) + 
+                               _viscosity->get(i, j - 1, k + 1) + 
+                               _viscosity->get(i, j,     k    ) + 
+                               _viscosity->get(i, j,     k + 1));
+    float viscBack  = 0.25f * (_viscosity->get(i, j - 1, k    ) + 
+                               _viscosity->get(i, j - 1, k - 1) + 
+                               _viscosity->get(i, j,     k    ) + 
+                               _viscosity->get(i, j,     k - 1));
+
+    float volRight = _volumes.edgeW(i + 1, j, k);
+    float volLeft = _volumes.edgeW(i, j, k);
+    float volTop = _volumes.center(i, j, k);
+    float volBottom = _volumes.center(i, j - 1, k);
+    float volFront = _volumes.edgeU(i, j, k + 1);
+    float volBack = _volumes.edgeU(i, j, k);
+
+    float factorRight  = factor * viscRight * volRight;
+    float factorLeft   = factor * viscLeft * volLeft;
+    float factorTop    = 2 * factor * viscTop * volTop;
+    float factorBottom = 2 * factor * viscBottom * volBottom;
+    float factorFront  = factor * viscFront * volFront;
+    float factorBack   = factor * viscBack*volBack;
+
+    row.factorRight = factorRight;
+    row.factorLeft = factorLeft;
+    row.factorTop = factorTop;
+    row.factorBottom = factorBottom;
+    row.factorFront = factorFront;
+    row.factorBack = factorBack;
+    row.diag = _volumes.V(i, j, k) + factorRight + factorLeft + factorTop + factorBottom + factorFront + factorBack;
+
+    float rval = _volumes.V(i, j, k) * _velocityField->V(i, j, k);
+    if (_state.V(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->V(i + 1, j,     k    ); }
+    if (_state.V(i - 1, j,     k)     == SOLID) { rval -= -factorLeft   * _velocityField->V(i - 1, j,     k    ); }
+    if (_state.V(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->V(i,     j + 1, k    ); }
+    if (_state.V(i ,    j - 1, k)     == SOLID) { rval -= -factorBottom * _velocityField->V(i,     j - 1, k    ); }
+    if (_state.V(i    , j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->V(i,     j,     k + 1); }
+    if (_state.V(i,     j,     k - 1) == SOLID) { rval -= -factorBack   * _velocityField->V(i,     j,     k - 1); }
+
+    if (_state.U(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->U(i + 1, j,     k    ); }
+    if (_state.U(i + 1, j - 1, k)     == SOLID) { rval -=  factorRight  * _velocityField->U(i + 1, j - 1, k    ); }
+    if (_state.U(i,     j,     k)     == SOLID) { rval -=  factorLeft   * _velocityField->U(i,     j,     k    ); }
+    if (_state.U(i,     j - 1, k)     == SOLID) { rval -= -factorLeft   * _velocityField->U(i,     j - 1, k    ); }
+
+    if (_state.W(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->W(i,     j,     k + 1); }
+    if (_state.W(i,     j - 1, k + 1) == SOLID) { rval -=  factorFront  * _velocityField->W(i,     j - 1, k + 1); }
+    if (_state.W(i,     j,     k)     == SOLID) { rval -=  factorBack   * _velocityField->W(i,     j,     k    ); }
+    if (_state.W(i,     j - 1, k)     == SOLID) { rval -= -factorBack   * _velocityField->W(i,     j - 1, k    ); }
+
+    return rval;
+}
+
+float ViscositySolver::_initializeSystemRowW(SystemRow &row) {
     FaceState SOLID = FaceState::solid;
+    int i = row.g.i;
+    int j = row.g.j;
+    int k = row.g.k;
 
     float invdx = 1.0f / _dx;
     float factor = _deltaTime * invdx * invdx;
-    for (int idx = startidx; idx < endidx; idx++) {
-        int i = indices->at(idx).i;
-        int j = indices->at(idx).j;
-        int k = indices->at(idx).k;
-        int row = _matrixIndex.W(i, j, k);
-
-        float viscRight = 0.25f * (_viscosity->get(i,     j, k    ) + 
-                                   _viscosity->get(i,     j, k - 1) + 
-                                   _viscosity->get(i + 1, j, k    ) + 
-                                   _viscosity->get(i + 1, j, k - 1));
-        float viscLeft  = 0.25f * (_viscosity->get(i,     j, k    ) + 
-                                   _viscosity->get(i,     j, k - 1) + 
-                                   _viscosity->get(i - 1, j, k    ) + 
-                                   _viscosity->get(i - 1, j, k - 1));
-
-        float viscTop    = 0.25f * (_viscosity->get(i, j,     k    ) + 
-                                    _viscosity->get(i, j,     k - 1) + 
-                                    _viscosity->get(i, j + 1, k    ) + 
-                                    _viscosity->get(i, j + 1, k - 1));
-        float viscBottom = 0.25f * (_viscosity->get(i, j,     k    ) + 
-                                    _viscosity->get(i, j,     k - 1) + 
-                                    _viscosity->get(i, j - 1, k    ) + 
-                                    _viscosity->get(i, j - 1, k - 1));
-
-        float viscFront = _viscosity->get(i, j, k);   
-        float viscBack = _viscosity->get(i, j, k - 1); 
-
-        float volRight = _volumes.edgeV(i + 1, j, k);
-        float volLeft = _volumes.edgeV(i, j, k);
-        float volTop = _volumes.edgeU(i, j + 1, k);
-        float volBottom = _volumes.edgeU(i, j, k);
-        float volFront = _volumes.center(i, j, k);
-        float volBack = _volumes.center(i, j, k - 1);
-
-        float factorRight  = factor * viscRight * volRight;
-        float factorLeft   = factor * viscLeft * volLeft;
-        float factorTop    = factor * viscTop * volTop;
-        float factorBottom = factor * viscBottom * volBottom;
-        float factorFront  = 2 * factor * viscFront * volFront;
-        float factorBack   = 2 * factor * viscBack*volBack;
-
-        float diag = _volumes.W(i, j, k) + factorRight + factorLeft + factorTop + factorBottom + factorFront + factorBack;
-        matrix->set(row, row, diag);
-        if (_state.W(i + 1, j,     k    ) == FLUID) { matrix->add(row, mj.W(i + 1, j,     k    ), -factorRight ); }
-        if (_state.W(i - 1, j,     k    ) == FLUID) { matrix->add(row, mj.W(i - 1, j,     k    ), -factorLeft  ); }
-        if (_state.W(i,     j + 1, k    ) == FLUID) { matrix->add(row, mj.W(i,     j + 1, k    ), -factorTop   ); }
-        if (_state.W(i,     j - 1, k    ) == FLUID) { matrix->add(row, mj.W(i,     j - 1, k    ), -factorBottom); }
-        if (_state.W(i,     j,     k + 1) == FLUID) { matrix->add(row, mj.W(i,     j,     k + 1), -factorFront ); }
-        if (_state.W(i,     j,     k - 1) == FLUID) { matrix->add(row, mj.W(i,     j,     k - 1), -factorBack  ); }
-
-        if (_state.U(i + 1, j,     k    ) == FLUID) { matrix->add(row, mj.U(i + 1, j,     k    ), -factorRight ); } 
-        if (_state.U(i + 1, j,     k - 1) == FLUID) { matrix->add(row, mj.U(i + 1, j,     k - 1),  factorRight ); }
-        if (_state.U(i,     j,     k    ) == FLUID) { matrix->add(row, mj.U(i,     j,     k    ),  factorLeft  ); }
-        if (_state.U(i,     j,     k - 1) == FLUID) { matrix->add(row, mj.U(i,     j,     k - 1), -factorLeft  ); }
-        
-        if (_state.V(i,     j + 1, k    ) == FLUID) { matrix->add(row, mj.V(i,     j + 1, k    ), -factorTop   ); }
-        if (_state.V(i,     j + 1, k - 1) == FLUID) { matrix->add(row, mj.V(i,     j + 1, k - 1),  factorTop   ); }
-        if (_state.V(i,     j,     k    ) == FLUID) { matrix->add(row, mj.V(i,     j,     k    ),  factorBottom); }
-        if (_state.V(i,     j,     k - 1) == FLUID) { matrix->add(row, mj.V(i,     j,     k - 1), -factorBottom); }
 
-        float rval = _volumes.W(i, j, k) * _velocityField->W(i, j, k);
-        if (_state.W(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->W(i + 1, j,     k    ); }
-        if (_state.W(i - 1, j,     k)     == SOLID) { rval -= -factorLeft   * _velocityField->W(i - 1, j,     k    ); }
-        if (_state.W(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->W(i,     j + 1, k    ); }
-        if (_state.W(i,     j - 1, k)     == SOLID) { rval -= -factorBottom * _velocityField->W(i,     j - 1, k    ); }
-        if (_state.W(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->W(i,     j,     k + 1); }
-        if (_state.W(i,     j,     k - 1) == SOLID) { rval -= -factorBack   * _velocityField->W(i,     j,     k - 1); }
+    float viscRight = 0.25f * (_viscosity->get(i,     j, k    ) + 
+                               _viscosity->get(i,     j, k - 1) + 
+                               _viscosity->get(i + 1, j, k    ) + 
+                               _viscosity->get(i + 1, j, k - 1));
+    float viscLeft  = 0.25f * (_viscosity->get(i,     j, k    ) + 
+                               _viscosity->get(i,     j, k - 1) + 
+                               _viscosity->get(i - 1, j, k    ) + 
+                               _viscosity->get(i - 1, j, k - 1));
+
+    float viscTop    = 0.25f * (_viscosity->get(i, j,     k    ) + 
+                                _viscosity->get(i, j,     k - 1) + 
+                                _viscosity->get(i, j + 1, k    ) + 
+                                _viscosity->get(i, j + 1, k - 1));
+    float viscBottom = 0.25f * (_viscosity->get(i, j,     k    ) + 
+                                _viscosity->get(i, j,     k - 1) + 
+                                _viscosity->get(i, j - 1, k    ) + 
+                                _viscosity->get(i, j - 1, k - 1));
+
+    float viscFront = _viscosity->get(i, j, k);   
+    float viscBack = _viscosity->get(i, j, k - 1); 
+
+    float volRight = _volumes.edgeV(i + 1, j, k);
+    float volLeft = _volumes.edgeV(i, j, k);
+    float volTop = _volumes.edgeU(i, j + 1, k);
+    float volBottom = _volumes.edgeU(i, j, k);
+    float volFront = _volumes.center(i, j, k);
+    float volBack = _volumes.center(i, j, k - 1);
+
+    float factorRight  = factor * viscRight * volRight;
+    float factorLeft   = factor * viscLeft * volLeft;
+    float factorTop    = factor * viscTop * volTop;
+    float factorBottom = factor * viscBottom * volBottom;
+    float factorFront  = 2 * factor * viscFront * volFront;
+    float factorBack   = 2 * factor * viscBack*volBack;
+
+    row.factorRight = factorRight;
+    row.factorLeft = factorLeft;
+    row.factorTop = factorTop;
+    row.factorBottom = factorBottom;
+    row.factorFront = factorFront;
+    row.factorBack = factorBack;
+    row.diag = _volumes.W(i, j, k) + factorRight + factorLeft + factorTop + factorBottom + factorFront + factorBack;
+
+    float rval = _volumes.W(i, j, k) * _velocityField->W(i, j, k);
+    if (_state.W(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->W(i + 1, j,     k    ); }
+    if (_state.W(i - 1, j,     k)     == SOLID) { rval -= -factorLeft   * _velocityField->W(i - 1, j,     k    ); }
+    if (_state.W(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->W(i,     j + 1, k    ); }
+    if (_state.W(i,     j - 1, k)     == SOLID) { rval -= -factorBottom * _velocityField->W(i,     j - 1, k    ); }
+    if (_state.W(i,     j,     k + 1) == SOLID) { rval -= -factorFront  * _velocityField->W(i,     j,     k + 1); }
+    if (_state.W(i,     j,     k - 1) == SOLID) { rval -= -factorBack   * _velocityField->W(i,     j,     k - 1); }
+
+    if (_state.U(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->U(i + 1, j,     k    ); }
+    if (_state.U(i + 1, j,     k - 1) == SOLID) { rval -=  factorRight  * _velocityField->U(i + 1, j,     k - 1); }
+    if (_state.U(i,     j,     k)     == SOLID) { rval -=  factorLeft   * _velocityField->U(i,     j,     k    ); }
+    if (_state.U(i,     j,     k - 1) == SOLID) { rval -= -factorLeft   * _velocityField->U(i,     j,     k - 1); }
+
+    if (_state.V(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->V(i,     j + 1, k    ); }
+    if (_state.V(i,     j + 1, k - 1) == SOLID) { rval -=  factorTop    * _velocityField->V(i,     j + 1, k - 1); }
+    if (_state.V(i,     j,     k)     == SOLID) { rval -=  factorBottom * _velocityField->V(i,     j,     k    ); }
+    if (_state.V(i,     j,     k - 1) == SOLID) { rval -= -factorBottom * _velocityField->V(i,     j,     k - 1); }
+
+    return rval;
+}
 
-        if (_state.U(i + 1, j,     k)     == SOLID) { rval -= -factorRight  * _velocityField->U(i + 1, j,     k    ); }
-        if (_state.U(i + 1, j,     k - 1) == SOLID) { rval -=  factorRight  * _velocityField->U(i + 1, j,     k - 1); }
-        if (_state.U(i,     j,     k)     == SOLID) { rval -=  factorLeft   * _velocityField->U(i,     j,     k    ); }
-        if (_state.U(i,     j,     k - 1) == SOLID) { rval -= -factorLeft   * _velocityField->U(i,     j,     k - 1); }
+float ViscositySolver::_computeOffDiagonalProduct(SystemRow &row, std::vector<float> &x) {
+    int U = 0; int V = 1; int W = 2;
+    MatrixIndexer &mj = _matrixIndex;
+    int i = row.g.i;
+    int j = row.g.j;
+    int k = row.g.k;
+
+    float sum = 0.0f;
+    if (row.dir == U) {
+
+        sum -= row.factorRight  * _getSystemValue(x, mj.U(i + 1, j,     k    ));
+        sum -= row.factorLeft   * _getSystemValue(x, mj.U(i - 1, j,     k    ));
+        sum -= row.factorTop    * _getSystemValue(x, mj.U(i,     j + 1, k    ));
+        sum -= row.factorBottom * _getSystemValue(x, mj.U(i,     j - 1, k    ));
+        sum -= row.factorFront  * _getSystemValue(x, mj.U(i,     j,     k + 1));
+        sum -= row.factorBack   * _getSystemValue(x, mj.U(i,     j,     k - 1));
+
+        sum -= row.factorTop    * _getSystemValue(x, mj.V(i,     j + 1, k    ));
+        sum += row.factorTop    * _getSystemValue(x, mj.V(i - 1, j + 1, k    ));
+        sum += row.factorBottom * _getSystemValue(x, mj.V(i,     j,     k    ));
+        sum -= row.factorBottom * _getSystemValue(x, mj.V(i - 1, j,     k    ));
+
+        sum -= row.factorFront  * _getSystemValue(x, mj.W(i,     j,     k + 1));
+        sum += row.factorFront  * _getSystemValue(x, mj.W(i - 1, j,     k + 1));
+        sum += row.factorBack   * _getSystemValue(x, mj.W(i,     j,     k    ));
+        sum -= row.factorBack   * _getSystemValue(x, mj.W(i - 1, j,     k    ));
+
+    } else if (row.dir == V) {
+
+        sum -= row.factorRight  * _getSystemValue(x, mj.V(i + 1, j,     k    ));
+        sum -= row.factorLeft   * _getSystemValue(x, mj.V(i - 1, j,     k    ));
+        sum -= row.factorTop    * _getSystemValue(x, mj.V(i,     j + 1, k    ));
+        sum -= row.factorBottom * _getSystemValue(x, mj.V(i,     j - 1, k    ));
+        sum -= row.factorFront  * _getSystemValue(x, mj.V(i,     j,     k + 1));
+        sum -= row.factorBack   * _getSystemValue(x, mj.V(i,     j,     k - 1));
+
+        sum -= row.factorRight  * _getSystemValue(x, mj.U(i + 1, j,     k    ));
+        sum += row.factorRight  * _getSystemValue(x, mj.U(i + 1, j - 1, k    ));
+        sum += row.factorLeft   * _getSystemValue(x, mj.U(i,     j,     k    ));
+        sum -= row.factorLeft   * _getSystemValue(x, mj.U(i,     j - 1, k    ));
+
+        sum -= row.factorFront  * _getSystemValue(x, mj.W(i,     j,     k + 1));
+        sum += row.factorFront  * _getSystemValue(x, mj.W(i,     j - 1, k + 1));
+        sum += row.factorBack   * _getSystemValue(x, mj.W(i,     j,     k    ));
+        sum -= row.factorBack   * _getSystemValue(x, mj.W(i,     j - 1, k    ));
+
+    } else if (row.dir == W) {
+
+        sum -= row.factorRight  * _getSystemValue(x, mj.W(i + 1, j,     k    ));
+        sum -= row.factorLeft   * _getSystemValue(x, mj.W(i - 1, j,     k    ));
+        sum -= row.factorTop    * _getSystemValue(x, mj.W(i,     j + 1, k    ));
+        sum -= row.factorBottom * _getSystemValue(x, mj.W(i,     j - 1, k    ));
+        sum -= row.factorFront  * _getSystemValue(x, mj.W(i,     j,     k + 1));
+        sum -= row.factorBack   * _getSystemValue(x, mj.W(i,     j,     k - 1));
+
+        sum -= row.factorRight  * _getSystemValue(x, mj.U(i + 1, j,     k    ));
+        sum += row.factorRight  * _getSystemValue(x, mj.U(i + 1, j,     k - 1));
+        sum += row.factorLeft   * _getSystemValue(x, mj.U(i,     j,     k    ));
+        sum -= row.factorLeft   * _getSystemValue(x, mj.U(i,     j,     k - 1));
+
+        sum -= row.factorTop    * _getSystemValue(x, mj.V(i,     j + 1, k    ));
+        sum += row.factorTop    * _getSystemValue(x, mj.V(i,     j + 1, k - 1));
+        sum += row.factorBottom * _getSystemValue(x, mj.V(i,     j,     k    ));
+        sum -= row.factorBottom * _getSystemValue(x, mj.V(i,     j,     k - 1));
 
-        if (_state.V(i,     j + 1, k)     == SOLID) { rval -= -factorTop    * _velocityField->V(i,     j + 1, k    ); }
-        if (_state.V(i,     j + 1, k - 1) == SOLID) { rval -=  factorTop    * _velocityField->V(i,     j + 1, k - 1); }
-        if (_state.V(i,     j,     k)     == SOLID) { rval -=  factorBottom * _velocityField->V(i,     j,     k    ); }
-        if (_state.V(i,     j,     k - 1) == SOLID) { rval -= -factorBottom * _velocityField->V(i,     j,     k - 1); }
-        (*rhs)[row] = rval;
     }
+
+    return sum;
 }
 
-bool ViscositySolver::_solveLinearSystem(SparseMatrixf &matrix, std::vector<float> &rhs, 
-                                         std::vector<float> &soln) {
+bool ViscositySolver::_solveLinearSystem() {
+    /*
+        Conjugate gradient with a multicoloured symmetric Gauss-Seidel 
+        preconditioner. The solve is warm-started from the current 
+        velocities and converges when the residual falls below the 
+        tolerance relative to the right hand side.
+    */
+    int numIterations = 0;
+    double estimatedError = _absMax(_rhs);
+    bool success = false;
+    bool isSolved = false;
+
+    if (estimatedError == 0.0) {
+        std::fill(_soln.begin(), _soln.end(), 0.0f);
+        isSolved = true;
+        success = true;
+    }
 
-    PCGSolver<float> solver;
-    solver.setSolverParameters(_solverTolerance, _maxSolverIterations);
+    double tol = std::min(_solverTolerance * estimatedError, _maxErrorTolerance);
+    if (!isSolved) {
+        estimatedError = _computeResidual();
+        if (estimatedError <= tol) {
+            isSolved = true;
+            success = true;
+        }
+    }
+
+    double rho = 0.0;
+    if (!isSolved) {
+        _applyPreconditioner(_residual, _aux);
+        rho = _dot(_aux, _residual);
+        if (rho == 0 || rho != rho) {
+            isSolved = true;
+            success = false;
+        } else {
+            _search = _aux;
+        }
+    }
+
+    while (!isSolved && numIterations < _maxSolverIterations) {
+        double searchDot = 0.0;
+        _applyOperator(_search, _aux, &searchDot);
+        double alpha = rho / searchDot;
+        estimatedError = _updateSolutionAndResidual(alpha);
+        numIterations++;
+
+        if (estimatedError <= tol) {
+            success = true;
+            break;
+        }
+
+        _applyPreconditioner(_residual, _aux);
+        double rhoNew = _dot(_aux, _residual);
+        double beta = rhoNew / rho;
+        _updateSearchDirection(beta);
+        rho = rhoNew;
+    }
 
-    float estimatedError;
-    int numIterations;
-    bool success = solver.solve(matrix, rhs, soln, estimatedError, numIterations);
     _solverIterations = numIterations;
     _solverError = (float)estimatedError;
 
@@ -863,39 +1065,232 @@ bool ViscositySolver::_solveLinearSystem(SparseMatrixf &matrix, std::vector<floa
     return retval;
 }
 
-void ViscositySolver::_applySolutionToVelocityField(std::vector<float> &soln) {
-    _velocityField->clear();
-    for(int k = 0; k < _ksize; k++) {
-        for(int j = 0; j < _jsize; j++) {
-            for(int i = 0; i < _isize + 1; i++) {
-                int matidx = _matrixIndex.U(i, j, k);
-                if (matidx != -1) {
-                    _velocityField->setU(i, j, k, soln[matidx]);
-                }
-            }
-        }
+void ViscositySolver::_applyOperator(std::vector<float> &x, std::vector<float> &result, double *dotOut) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _rows.size());
+    std::vector<double> threadDots(numthreads, 0.0);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _rows.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_applyOperatorThread, this,
+                                 intervals[i], intervals[i + 1], &x, &result, &(threadDots[i]));
     }
 
-    for(int k = 0; k < _ksize; k++) {
-        for(int j = 0; j < _jsize + 1; j++) {
-            for(int i = 0; i < _isize; i++) {
-                int matidx = _matrixIndex.V(i, j, k);
-                if (matidx != -1) {
-                    _velocityField->setV(i, j, k, soln[matidx]);
-                }
-            }
+    *dotOut = 0.0;
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+        *dotOut += threadDots[i];
+    }
+}
+
+void ViscositySolver::_applyOperatorThread(int startidx, int endidx, 
+                                           std::vector<float> *x, 
+                                           std::vector<float> *result,
+                                           double *dotOut) {
+    double dot = 0.0;
+    for (int ridx = startidx; ridx < endidx; ridx++) {
+        SystemRow &row = _rows[ridx];
+        float val = row.diag * (*x)[ridx] + _computeOffDiagonalProduct(row, *x);
+        (*result)[ridx] = val;
+        dot += (double)val * (double)(*x)[ridx];
+    }
+    *dotOut = dot;
+}
+
+void ViscositySolver::_applyPreconditioner(std::vector<float> &r, std::vector<float> &z) {
+    std::fill(z.begin(), z.end(), 0.0f);
+
+    // Forward sweep through the colours followed by a backward sweep
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    for (int pass = 0; pass < 2 * _numColors; pass++) {
+        int color = pass < _numColors ? pass : 2 * _numColors - pass - 1;
+        std::vector<int> *rows = &(_colorRows[color]);
+        if (rows->empty()) {
+            continue;
+        }
+
+        int numthreads = (int)fmin(numCPU, rows->size());
+        std::vector<std::thread> threads(numthreads);
+        std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, rows->size(), numthreads);
+        for (int i = 0; i < numthreads; i++) {
+            threads[i] = std::thread(&ViscositySolver::_applyPreconditionerThread, this,
+                                     intervals[i], intervals[i + 1], rows, &r, &z);
+        }
+
+        for (int i = 0; i < numthreads; i++) {
+            threads[i].join();
         }
     }
+}
 
-    for(int k = 0; k < _ksize + 1; k++) {
-        for(int j = 0; j < _jsize; j++) {
-            for(int i = 0; i < _isize; i++) {
-                int matidx = _matrixIndex.W(i, j, k);
-                if (matidx != -1) {
-                    _velocityField->setW(i, j, k, soln[matidx]);
-                }
-            }
+void ViscositySolver::_applyPreconditionerThread(int startidx, int endidx, 
+                                                 std::vector<int> *rows,
+                                                 std::vector<float> *r, 
+                                                 std::vector<float> *z) {
+    float eps = 1e-9;
+    for (int idx = startidx; idx < endidx; idx++) {
+        int ridx = rows->at(idx);
+        SystemRow &row = _rows[ridx];
+        if (row.diag < eps) {
+            // null row
+            (*z)[ridx] = 0.0f;
+            continue;
         }
+
+        (*z)[ridx] = ((*r)[ridx] - _computeOffDiagonalProduct(row, *z)) / row.diag;
+    }
+}
+
+double ViscositySolver::_dot(std::vector<float> &x, std::vector<float> &y) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, x.size());
+    std::vector<double> threadDots(numthreads, 0.0);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, x.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_dotThread, this,
+                                 intervals[i], intervals[i + 1], &x, &y, &(threadDots[i]));
+    }
+
+    double dot = 0.0;
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+        dot += threadDots[i];
+    }
+
+    return dot;
+}
+
+void ViscositySolver::_dotThread(int startidx, int endidx, 
+                                 std::vector<float> *x, std::vector<float> *y, 
+                                 double *dotOut) {
+    double dot = 0.0;
+    for (int i = startidx; i < endidx; i++) {
+        dot += (double)(*x)[i] * (double)(*y)[i];
+    }
+    *dotOut = dot;
+}
+
+double ViscositySolver::_updateSolutionAndResidual(double alpha) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _soln.size());
+    std::vector<double> threadMax(numthreads, 0.0);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _soln.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_updateSolutionAndResidualThread, this,
+                                 intervals[i], intervals[i + 1], alpha, &(threadMax[i]));
     }
 
+    double maxval = 0.0;
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+        maxval = std::max(maxval, threadMax[i]);
+    }
+
+    return maxval;
+}
+
+void ViscositySolver::_updateSolutionAndResidualThread(int startidx, int endidx, 
+                                                       double alpha, double *maxOut) {
+    float a = (float)alpha;
+    float maxval = 0.0f;
+    for (int i = startidx; i < endidx; i++) {
+        _soln[i] += a * _search[i];
+        _residual[i] -= a * _aux[i];
+        maxval = std::max(maxval, std::abs(_residual[i]));
+    }
+    *maxOut = maxval;
+}
+
+void ViscositySolver::_updateSearchDirection(double beta) {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _search.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _search.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_updateSearchDirectionThread, this,
+                                 intervals[i], intervals[i + 1], beta);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void ViscositySolver::_updateSearchDirectionThread(int startidx, int endidx, double beta) {
+    float b = (float)beta;
+    for (int i = startidx; i < endidx; i++) {
+        _search[i] = _aux[i] + b * _search[i];
+    }
+}
+
+double ViscositySolver::_computeResidual() {
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _rows.size());
+    std::vector<double> threadMax(numthreads, 0.0);
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _rows.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_computeResidualThread, this,
+                                 intervals[i], intervals[i + 1], &(threadMax[i]));
+    }
+
+    double maxval = 0.0;
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+        maxval = std::max(maxval, threadMax[i]);
+    }
+
+    return maxval;
+}
+
+void ViscositySolver::_computeResidualThread(int startidx, int endidx, double *maxOut) {
+    float maxval = 0.0f;
+    for (int ridx = startidx; ridx < endidx; ridx++) {
+        SystemRow &row = _rows[ridx];
+        float ax = row.diag * _soln[ridx] + _computeOffDiagonalProduct(row, _soln);
+        _residual[ridx] = _rhs[ridx] - ax;
+        maxval = std::max(maxval, std::abs(_residual[ridx]));
+    }
+    *maxOut = maxval;
+}
+
+double ViscositySolver::_absMax(std::vector<float> &x) {
+    float maxval = 0.0f;
+    for (size_t i = 0; i < x.size(); i++) {
+        maxval = std::max(maxval, std::abs(x[i]));
+    }
+    return maxval;
+}
+
+void ViscositySolver::_applySolutionToVelocityField() {
+    _velocityField->clear();
+
+    int numCPU = ThreadUtils::getMaxThreadCount();
+    int numthreads = (int)fmin(numCPU, _rows.size());
+    std::vector<std::thread> threads(numthreads);
+    std::vector<int> intervals = ThreadUtils::splitRangeIntoIntervals(0, _rows.size(), numthreads);
+    for (int i = 0; i < numthreads; i++) {
+        threads[i] = std::thread(&ViscositySolver::_applySolutionToVelocityFieldThread, this,
+                                 intervals[i], intervals[i + 1]);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+void ViscositySolver::_applySolutionToVelocityFieldThread(int startidx, int endidx) {
+    int U = 0; int V = 1; int W = 2;
+    for (int ridx = startidx; ridx < endidx; ridx++) {
+        SystemRow &row = _rows[ridx];
+        if (row.dir == U) {
+            _velocityField->setU(row.g, _soln[ridx]);
+        } else if (row.dir == V) {
+            _velocityField->setV(row.g, _soln[ridx]);
+        } else if (row.dir == W) {
+            _velocityField->setW(row.g, _soln[ridx]);
+        }
+    }
 }
@@ -25,8 +25,10 @@ SOFTWARE.
 
 #pragma once
 
+#include <vector>
+#include <string>
+
 #include "array3d.h"
-#include "pcgsolver/pcgsolver.h"
 #include "vmath.h"
 
 class MACVelocityField;
@@ -63,7 +65,7 @@ public:
 private:
 
     struct ViscosityVolumeGrid {
-        int isize, jsize, ksize;
+        int isize = 0, jsize = 0, ksize = 0;
         Array3d<float> center;
         Array3d<float> U;
         Array3d<float> V;
@@ -114,7 +116,7 @@ private:
     };
 
     struct FaceStateGrid {
-        int isize, jsize, ksize;
+        int isize = 0, jsize = 0, ksize = 0;
         Array3d<FaceState> U;
         Array3d<FaceState> V;
         Array3d<FaceState> W;
@@ -128,7 +130,9 @@ private:
     };
 
     struct FaceIndexer {
-        int isize, jsize, ksize;
+        int isize = 0;
+        int jsize = 0;
+        int ksize = 0;
 
         FaceIndexer() {}
         FaceIndexer(int i, int j, int k) : isize(i), jsize(j), ksize(k) {
@@ -150,27 +154,36 @@ private:
 
         private:
 
-            int _voffset;
-            int _woffset;
+            int _voffset = 0;
+            int _woffset = 0;
     };
 
     struct MatrixIndexer {
         std::vector<int> indexTable;
         FaceIndexer faceIndexer;
-        int matrixSize;
+        int matrixSize = 0;
 
         MatrixIndexer() {}
-        MatrixIndexer(int i, int j, int k, std::vector<int> matrixIndexTable) :
-                indexTable(matrixIndexTable), faceIndexer(i, j, k) {
-
-            int matsize = 0;
-            for (size_t i = 0; i < indexTable.size(); i++) {
-                if (indexTable[i] != -1) {
-                    matsize++;
-                }
-            }
 
-            matrixSize = matsize;
+        void initialize(int i, int j, int k) {
+            faceIndexer = FaceIndexer(i, j, k);
+            int dim = (i + 1) * j * k + i * (j + 1) * k + i * j * (k + 1);
+            indexTable.assign(dim, -1);
+            matrixSize = 0;
+        }
+
+        bool isMatchingDimensions(int i, int j, int k) {
+            return !indexTable.empty() && faceIndexer.isize == i && 
+                   faceIndexer.jsize == j && faceIndexer.ksize == k;
+        }
+
+        int getFaceIndex(GridIndex g, int dir) {
+            if (dir == 0) {
+                return faceIndexer.U(g.i, g.j, g.k);
+            } else if (dir == 1) {
+                return faceIndexer.V(g.i, g.j, g.k);
+            }
+            return faceIndexer.W(g.i, g.j, g.k);
         }
 
         int U(int i, int j, int k) {
@@ -186,6 +199,24 @@ private:
         }
     };
 
+    /*
+        One unknown of the system. The operator is applied matrix-free: the 
+        14 off-diagonal entries of a row are +/- one of its six stencil 
+        factors and the neighbour columns are looked up in the matrix index 
+        table.
+    */
+    struct SystemRow {
+        GridIndex g;
+        int dir = 0;
+        float diag = 0.0f;
+        float factorRight = 0.0f;
+        float factorLeft = 0.0f;
+        float factorTop = 0.0f;
+        float factorBottom = 0.0f;
+        float factorFront = 0.0f;
+        float factorBack = 0.0f;
+    };
+
     void _initialize(ViscositySolverParameters params);
     void _computeFaceStateGrid();
     void _computeFaceStateGridMT(Array3d<float> &solidCenterPhi, int dir);
@@ -195,6 +226,7 @@ private:
     void _computeSolidCenterPhiThread(int startidx, int endidx, 
                                       Array3d<float> *solidCenterPhi);
     void _computeVolumeGrid();
+    void _computeValidCells();
     void _estimateVolumeFractions(Array3d<float> *volumes, 
                                   Array3d<bool> *validCells, 
                                   vmath::vec3 centerStart, 
@@ -209,28 +241,57 @@ private:
                                   Array3d<float> *subcellVolumes,
                                   GridIndex gridOffset);
 
+    void _computeValidCellsThread(int startidx, int endidx, 
+                                  std::vector<GridIndex> *liquidBlocks,
+                                  Array3d<bool> *validCells);
+    void _dilateValidCellsThread(int startidx, int endidx, 
+                                 Array3d<bool> *validCells, 
+                                 Array3d<bool> *dilatedCells);
+
     void _destroyVolumeGrid();
     void _computeMatrixIndexTable();
-    void _initializeLinearSystem(SparseMatrixf &matrix, std::vector<float> &rhs);
-    void _initializeLinearSystemU(SparseMatrixf &matrix, std::vector<float> &rhs);
-    void _initializeLinearSystemV(SparseMatrixf &matrix, std::vector<float> &rhs);
-    void _initializeLinearSystemW(SparseMatrixf &matrix, std::vector<float> &rhs);
-    void _initializeLinearSystemThreadU(int startidx, int endidx,
-                                        std::vector<GridIndex> *indices,
-                                        SparseMatrixf *matrix, 
-                                        std::vector<float> *rhs);
-    void _initializeLinearSystemThreadV(int startidx, int endidx,
-                                        std::vector<GridIndex> *indices,
-                                        SparseMatrixf *matrix, 
-                                        std::vector<float> *rhs);
-    void _initializeLinearSystemThreadW(int startidx, int endidx,
-                                        std::vector<GridIndex> *indices,
-                                        SparseMatrixf *matrix, 
-                                        std::vector<float> *rhs);
-
-    bool _solveLinearSystem(SparseMatrixf &matrix, std::vector<float> &rhs, 
-                            std::vector<float> &soln);
-    void _applySolutionToVelocityField(std::vector<float> &soln);
+    void _computeMatrixIndexTableMT(int dir);
+    void _computeMatrixIndexTableThread(int startidx, int endidx, int dir);
+    void _clearMatrixIndexTableThread(int startidx, int endidx);
+    void _countMatrixIndexTableThread(int startidx, int endidx, int *count);
+    void _numberMatrixIndexTableThread(int startidx, int endidx, int startindex);
+    void _initializeLinearSystem();
+    void _initializeLinearSystemThread(int startidx, int endidx);
+    float _initializeSystemRowU(SystemRow &row);
+    float _initializeSystemRowV(SystemRow &row);
+    float _initializeSystemRowW(SystemRow &row);
+
+    inline float _getSystemValue(std::vector<float> &x, int index) {
+        return index == -1 ? 0.0f : x[index];
+    }
+    float _computeOffDiagonalProduct(SystemRow &row, std::vector<float> &x);
+
+    bool _solveLinearSystem();
+    void _applyOperator(std::vector<float> &x, std::vector<float> &result, double *dotOut);
+    void _applyOperatorThread(int startidx, int endidx, 
+                              std::vector<float> *x, 
+                              std::vector<float> *result,
+                              double *dotOut);
+    void _applyPreconditioner(std::vector<float> &r, std::vector<float> &z);
+    void _applyPreconditionerThread(int startidx, int endidx, 
+                                    std::vector<int> *rows,
+                                    std::vector<float> *r, 
+                                    std::vector<float> *z);
+    double _dot(std::vector<float> &x, std::vector<float> &y);
+    void _dotThread(int startidx, int endidx, 
+                    std::vector<float> *x, std::vector<float> *y, 
+                    double *dotOut);
+    double _updateSolutionAndResidual(double alpha);
+    void _updateSolutionAndResidualThread(int startidx, int endidx, 
+                                          double alpha, double *maxOut);
+    void _updateSearchDirection(double beta);
+    void _updateSearchDirectionThread(int startidx, int endidx, double beta);
+    double _computeResidual();
+    void _computeResidualThread(int startidx, int endidx, double *maxOut);
+    double _absMax(std::vector<float> &x);
+
+    void _applySolutionToVelocityField();
+    void _applySolutionToVelocityFieldThread(int startidx, int endidx);
 
     int _isize;
     int _jsize;
@@ -242,13 +303,28 @@ private:
     MeshLevelSet *_solidSDF;
     Array3d<float> *_viscosity;
 
+    // Persistent between solves so that buffers are only reallocated when
+    // the grid dimensions change
     FaceStateGrid _state;
+    Array3d<float> _solidCenterPhi;
+    Array3d<bool> _validCells;
+    Array3d<bool> _dilatedValidCells;
     ViscosityVolumeGrid _volumes;
     Array3d<float> _subcellVolumeGrid;
     MatrixIndexer _matrixIndex;
 
+    std::vector<SystemRow> _rows;
+    std::vector<std::vector<int> > _colorRows;
+    std::vector<float> _rhs;
+    std::vector<float> _soln;
+    std::vector<float> _residual;
+    std::vector<float> _search;
+    std::vector<float> _aux;
+    int _numColors = 6;
+
     double _solverTolerance = 1e-4;
     double _acceptableTolerace = 10.0;
+    double _maxErrorTolerance = 1.0;
     int _maxSolverIterations = 900;
 
     std::string _solverStatus;